@@ -4,34 +4,100 @@
 #include <stdint.h>
 #include <stdbool.h>
 
-#define CHECK_HEALTH_STACK       512
-#define CHECK_HEALTH_PRIORITY    5
-#define THREAD_TIMEOUT_MS        500
-#define HEALTH_CHECK_INTERVAL_MS 100
+struct k_thread;
 
-typedef enum {
-    THREAD_MOTOR_CONTROL = 0,
-    THREAD_COMMUNICATION,
-    THREAD_COUNT
-} thread_id_t;
+#define CHECK_HEALTH_STACK     512
+#define CHECK_HEALTH_PRIORITY  5
+#define HEALTH_MAX_THREADS     8
+#define HEALTH_WDT_PERIOD_MS   2000
+#define HEALTH_WDT_FEED_MS     1000 /* only wake up when idle to feed the watchdog */
+#define HEALTH_STACK_SAMPLE_MS 5000 /* default stack sampling period */
+#define HEALTH_STACK_MIN_FREE  128  /* headroom under which a stack is a fault */
+
+/* Returned by health_register(), negative values are errors and are ignored when reporting */
+typedef int health_handle_t;
+
+/* Measured quantities that take part in the system health */
+enum health_sensor {
+    HEALTH_SENSOR_BATTERY = 0,
+    HEALTH_SENSOR_TEMPERATURE,
+    HEALTH_SENSOR_COUNT
+};
 
 /**
  * @brief: Starts the check health thread
+ *
+ * With CONFIG_FEEDER_EVENT_LOOP the monitor gets no thread, its state machine is attached to the event loop instead.
  */
 void start_check_health_thread(void);
 
 /**
- * @brief: Threads call this to report they're alive
- * @param: thread_id Which thread is reporting
+ * @brief: Runs the health state machine once, called by the event loop (CONFIG_FEEDER_EVENT_LOOP)
+ * @param: events EVENT_LOOP_* bits posted since the last run, 0 on a heartbeat
+ * @return: ms until the machine has to run again
+ */
+uint32_t health_loop_run(uint32_t events);
+
+/**
+ * @brief: Adds a thread to the monitored set, can be called before or after the health thread starts
+ * @param: name Name used in the logs, must stay valid forever
+ * @param: timeout_ms Time without heartbeats after which the thread is considered stalled
+ * @return: handle to report with, -EINVAL on a zero or too long timeout, -ENOMEM if the table is full
+ */
+health_handle_t health_register(const char *name, uint32_t timeout_ms);
+
+/**
+ * @brief: Threads call this to report they're alive, lock free
+ * @param: handle Handle given by health_register()
  */
-// TODO: unit test left to do
-void thread_report_alive(thread_id_t thread_id);
+void thread_report_alive(health_handle_t handle);
+
+/**
+ * @brief: Adds the stack of a registered thread to the ones sampled by the health thread
+ *
+ * The worker loops never measure their own stack, the health thread scans every watched stack once per sampling period
+ * and keeps the lowest free space seen. Going under HEALTH_STACK_MIN_FREE makes the system unhealthy.
+ *
+ * @param: handle Handle given by health_register()
+ * @param: thread Thread owning the stack
+ * @return: 0 on success, -EINVAL on a bad handle
+ */
+int health_stack_watch(health_handle_t handle, const struct k_thread *thread);
+
+/**
+ * @brief: Changes the stack sampling period
+ * @param: period_ms New period, 0 stops the sampling
+ */
+void health_stack_set_period(uint32_t period_ms);
+
+/**
+ * @brief: Lowest free stack space seen on a watched thread since boot
+ * @return: free bytes, -ENODATA if not sampled yet, -EINVAL on a bad handle
+ */
+int health_stack_min_free(health_handle_t handle);
+
+/**
+ * @brief: Lowest free stack space seen on any watched thread since boot
+ * @return: free bytes, -ENODATA if no stack was sampled yet
+ */
+int health_stack_headroom(void);
+
+/**
+ * @brief: Time since the oldest heartbeat among the registered threads, 0 without threads
+ */
+uint32_t health_beat_age_max_ms(void);
+
+/**
+ * @brief: Sets whether a measured quantity is within its limits, lock free
+ * @param: sensor Quantity
+ * @param: ok false keeps the system unhealthy until the same sensor reports ok again
+ */
+void health_sensor_report(enum health_sensor sensor, bool ok);
 
 /**
  * @brief: Main supervisor calls this to check overall system health
  * @return: true if all monitored systems are healthy, false otherwise
  */
-// TODO: unit tests left
 bool is_system_healthy(void);
 
 #ifdef SMART_FEEDER_UNIT_TEST
@@ -39,6 +105,11 @@ bool is_system_healthy(void);
  * @brief: Stops the motor control thread
  */
 void stop_check_health_thread(void);
+
+/**
+ * @brief: Forgets every registered thread
+ */
+void health_reset(void);
 #endif
 
 #endif
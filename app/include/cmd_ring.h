@@ -0,0 +1,53 @@
+#ifndef CMD_RING_H
+#define CMD_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <zephyr/sys/atomic.h>
+
+/* Must be a power of two */
+#define CMD_RING_LEN 32
+
+enum motor_cmd_type {
+    MOTOR_CMD_FEED = 0, /* arg: grams */
+    MOTOR_CMD_JOG,      /* arg: signed steps */
+    MOTOR_CMD_STOP,
+    MOTOR_CMD_SET_SPEED, /* arg: steps/s */
+};
+
+struct motor_cmd {
+    uint8_t type;
+    int32_t arg;
+    uint32_t stamp; /* k_cycle_get_32() when the command was posted */
+    uint32_t gen;   /* stop generation when the command was posted, older moves are dropped */
+};
+
+/**
+ * Single producer / single consumer ring. The producer only writes `head`, the consumer only writes `tail`, so no
+ * lock is needed and neither side ever blocks on the other.
+ */
+struct cmd_ring {
+    atomic_t head;
+    atomic_t tail;
+    struct motor_cmd slots[CMD_RING_LEN];
+};
+
+/**
+ * @brief: Resets the ring to empty, must not race with the producer or the consumer
+ */
+void cmd_ring_init(struct cmd_ring *ring);
+
+/**
+ * @brief: Producer side, copies a command into the ring
+ * @return: true on success, false if the ring is full
+ */
+bool cmd_ring_put(struct cmd_ring *ring, const struct motor_cmd *cmd);
+
+/**
+ * @brief: Consumer side, takes up to max commands in one go
+ * @return: number of commands copied to out
+ */
+size_t cmd_ring_get_batch(struct cmd_ring *ring, struct motor_cmd *out, size_t max);
+
+#endif
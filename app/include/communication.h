@@ -1,14 +1,76 @@
 #ifndef COMMUNICATION_H
 #define COMMUNICATION_H
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <zephyr/sys/ring_buffer.h>
+
 #define COMMUNICATION_STACK    512
 #define COMMUNICATION_PRIORITY 4
+#define COMM_TX_STACK          512
+#define COMM_TX_PRIORITY       6
+
+#define COMM_RX_DMA_BUF_SIZE   64 /* two of them, the driver fills one while we hand out the other */
+#define COMM_RX_RING_SIZE      1024
+#define COMM_TX_RING_SIZE      512
+#define COMM_RX_TIMEOUT_US     200 /* idle time on the line before a partial DMA buffer is reported */
+#define COMM_TX_TIMEOUT_MS     100
+#define COMM_HEARTBEAT_MS      250
+#define COMM_HEALTH_TIMEOUT_MS (2 * COMM_HEARTBEAT_MS)
+#define COMM_WDT_PERIOD_MS     (4 * COMM_HEARTBEAT_MS)
+#define COMM_IDLE_MS           200 /* quiet line time before the link counts as idle */
+
+/**
+ * @brief: Called from the comm thread every time new bytes are available
+ *
+ * The handler reads (or claims) what it needs from the RX ring buffer, what it leaves stays there for the next call.
+ */
+typedef void (*comm_rx_handler_t)(struct ring_buf *rx);
+
+struct comm_stats {
+    uint32_t rx_bytes;
+    uint32_t rx_dropped;
+    uint32_t rx_errors;
+    uint32_t rx_wakeups;
+    uint32_t tx_bytes;  /* bytes the UART reported done */
+    uint32_t tx_errors; /* chunks dropped: the transfer failed, was aborted, or a stuck UART reset the ring */
+};
 
 /**
  * @brief: starts the communication thread
+ *
+ * With CONFIG_FEEDER_EVENT_LOOP the link gets no thread, its state machine is attached to the event loop instead.
  */
 void start_comm_thread(void);
 
+/**
+ * @brief: Runs the comm state machine once, called by the event loop (CONFIG_FEEDER_EVENT_LOOP)
+ * @param: events EVENT_LOOP_* bits posted since the last run, 0 on a heartbeat
+ */
+void comm_loop_run(uint32_t events);
+
+/**
+ * @brief: Sets the consumer of the received bytes, NULL discards them
+ */
+void comm_set_rx_handler(comm_rx_handler_t handler);
+
+/**
+ * @brief: Queues bytes for transmission, the TX work queue sends them
+ * @return: 0 on success, -ENOBUFS if they don't fit in the TX ring
+ */
+int comm_send(const uint8_t *data, size_t len);
+
+/**
+ * @brief: Copies the communication counters
+ */
+void comm_get_stats(struct comm_stats *stats);
+
+/**
+ * @brief: Tells if the link is quiet: nothing left to send and no byte received for COMM_IDLE_MS
+ */
+bool comm_is_idle(void);
+
 #ifdef SMART_FEEDER_UNIT_TEST
 /**
  * @brief: Stops the motor control thread
@@ -1,14 +1,66 @@
 #ifndef CONFIGURATION_H
 #define CONFIGURATION_H
 
-#define CONFIG_ID 1
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <zephyr/kernel.h>
+#include "schedule.h"
 
+/* Whole struct blob written by older firmware, migrated on boot */
+#define CFG_NVS_ID_LEGACY 1
+
+/* Every field has its own NVS entry, big ones are split in chunks with consecutive ids */
+#define CFG_NVS_ID_RANDOM_VALUE 0x100
+#define CFG_NVS_ID_MAX_SPEED    0x101
+#define CFG_NVS_ID_ACCEL        0x102
+#define CFG_NVS_ID_SCHEDULE     0x110
+#define CFG_SCHEDULE_CHUNK      16 /* slots per NVS entry */
+
+/* Sectors of the storage partition given to the NVS, one of them is always kept free for the garbage collection */
+#define CFG_NVS_SECTORS  3
+#define CFG_NVS_ATE_SIZE 8 /* allocation entry the NVS writes along with every entry */
+
+/* New fields go at the end, the legacy blob has to stay a prefix of the struct */
 struct config {
     int random_value;
+    struct schedule_slot schedule[SCHEDULE_MAX_SLOTS];
+    uint32_t max_speed_sps; /* motor cruise speed, steps/s */
+    uint32_t accel;         /* motor acceleration, steps/s^2 */
+};
+
+/**
+ * @brief: Settings read from the hot paths, published as a whole by config_publish()
+ */
+struct config_hot {
+    int random_value;
+    uint32_t max_speed_sps;
+    uint32_t accel;
+};
+
+/**
+ * @brief: Describes how a field of the config is stored
+ */
+struct config_field {
+    const char *name;
+    uint16_t id;      /* NVS id of the first chunk */
+    uint8_t version;  /* stored as the first byte of every entry */
+    uint16_t offset;  /* in struct config */
+    uint16_t size;
+    uint16_t chunk;   /* bytes per NVS entry, size must be a multiple */
+    const void *dflt; /* NULL means all zeros */
+    /**
+     * Converts an entry written with an older version, NULL or an error loads the default instead
+     */
+    int (*migrate)(void *dst, const uint8_t *src, size_t len, uint8_t version);
 };
 
 extern struct config cfg;
 
+/* Held by whoever changes a part of cfg several bytes at a time (the schedule slots), save_config() copies every entry
+ * under it so a half written slot is never stored */
+extern struct k_mutex config_lock;
+
 /**
  * @brief: Initialize the nvs to use it
  * @return: 0 on sucess
@@ -16,14 +68,14 @@ extern struct config cfg;
 int init_nvs(void);
 
 /**
- * @brief: Save the current configuration to the nvs
+ * @brief: Save the fields of the current configuration that changed since the last load or save
  * @return: 0 on success
  */
 int save_config(void);
 
 /**
- * @brief: Reads the current config stored on the nvs
- * @return: 0 on success
+ * @brief: Reads the current config stored on the nvs, migrating older formats
+ * @return: 0 on success, -ENOENT if nothing is stored
  */
 int load_config(void);
 
@@ -32,4 +84,68 @@ int load_config(void);
  */
 void set_dflt_cfg(void);
 
+/**
+ * @brief: Tells if the config has changes that save_config() would write
+ */
+bool config_is_dirty(void);
+
+/**
+ * @brief: Bytes handed to the NVS by the last save_config()
+ */
+size_t config_last_commit_bytes(void);
+
+/**
+ * @brief: Publishes the hot settings of cfg to the readers, only from threads
+ *
+ * Writers are serialized, readers are never blocked: the new values go to the buffer the readers aren't using and
+ * become visible all at once.
+ */
+void config_publish(void);
+
+/**
+ * @brief: Copies a consistent snapshot of the hot settings, lock free and usable from ISRs
+ * @param: out Snapshot
+ * @return: version of the snapshot, it changes on every publish
+ */
+uint32_t config_hot_get(struct config_hot *out);
+
+/**
+ * @brief: Version of the last published snapshot, cheap way to know if a cached copy is stale
+ */
+uint32_t config_hot_version(void);
+
+/**
+ * @brief: Bytes left in the active NVS sector, 0 before init_nvs()
+ */
+size_t config_nvs_free(void);
+
+/**
+ * @brief: Runs the NVS garbage collection ahead of time if the active sector can't take the next commit
+ *
+ * The next commit is the chunks changed since the last one, or the largest entry when nothing changed, so a sector
+ * is only left once it's close to full.
+ *
+ * Moves the NVS to its next sector, which collects and erases the oldest one now instead of in a later save_config().
+ * Meant for the storage queue while the feeder is idle.
+ * @return: 1 if the garbage collection ran, 0 if there was enough room, negative error code otherwise
+ */
+int config_nvs_gc_if_low(void);
+
+#ifdef SMART_FEEDER_UNIT_TEST
+/**
+ * @brief: Called by config_publish() halfway through filling the buffer, lets tests widen the race window
+ */
+void config_set_publish_hook(void (*hook)(void));
+
+struct device;
+
+/**
+ * @brief: Mounts the config NVS again on another flash device or sector count, to compare layouts
+ * @param: dev Flash device holding the storage partition
+ * @param: sector_count Sectors of the partition to use
+ * @return: 0 on success, negative error code otherwise
+ */
+int config_nvs_remount(const struct device *dev, uint16_t sector_count);
+#endif
+
 #endif
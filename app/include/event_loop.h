@@ -0,0 +1,42 @@
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <stdint.h>
+#include <zephyr/sys/util.h>
+
+struct k_thread;
+
+#define EVENT_LOOP_STACK        768 /* the machines run one after the other, never nested */
+#define EVENT_LOOP_PRIORITY     1   /* same as the motor thread, a move still starts right after its command */
+#define EVENT_LOOP_HEARTBEAT_MS 250 /* every machine runs at least that often, to report alive */
+
+/* Reasons to wake the loop up, posted from ISRs, UART callbacks or other threads */
+#define EVENT_LOOP_MOTOR  BIT(0) /* a command was posted or a move ended */
+#define EVENT_LOOP_COMM   BIT(1) /* bytes waiting in the RX ring */
+#define EVENT_LOOP_HEALTH BIT(2) /* a stall, a recovery or a new stack sampling period */
+#define EVENT_LOOP_ALL    (EVENT_LOOP_MOTOR | EVENT_LOOP_COMM | EVENT_LOOP_HEALTH)
+
+/**
+ * @brief: Starts the event loop thread, only once whoever calls it first
+ */
+void event_loop_start(void);
+
+/**
+ * @brief: Wakes the loop up, callable from an ISR
+ * @param: events EVENT_LOOP_* bits, handed to every machine on the next run
+ */
+void event_loop_post(uint32_t events);
+
+/**
+ * @brief: Thread running the loop, NULL before event_loop_start()
+ */
+const struct k_thread *event_loop_thread(void);
+
+#ifdef SMART_FEEDER_UNIT_TEST
+/**
+ * @brief: Stops the event loop thread
+ */
+void stop_event_loop(void);
+#endif
+
+#endif
@@ -0,0 +1,107 @@
+#ifndef FEEDLOG_H
+#define FEEDLOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define FEEDLOG_MAGIC       0x464C4731 /* "FLG1", bump when the record layout changes */
+#define FEEDLOG_MAX_SECTORS 64
+#define FEEDLOG_QUEUE_LEN   16
+#define FEEDLOG_ENTRY_WIRE  13 /* packed size of an entry on the binary protocol */
+
+/**
+ * @brief: One dispense
+ */
+struct feedlog_entry {
+    uint32_t time;        /* unix seconds, stamped by feedlog_append() */
+    uint32_t steps;       /* steps actually done */
+    uint16_t grams;       /* requested amount */
+    uint16_t duration_ms; /* first to last step */
+    int8_t result;        /* 0 or -errno (stopped, rejected) */
+};
+
+struct feedlog_stats {
+    uint32_t appended;      /* records written to flash */
+    uint32_t dropped;       /* records lost because the queue was full */
+    uint32_t sectors_read;  /* sectors scanned by queries */
+    uint32_t sectors_total; /* sectors of the partition */
+    uint32_t capacity;      /* records the partition holds */
+};
+
+/**
+ * @brief: Where a paged query resumes, zeroed to start from the oldest record
+ */
+struct feedlog_cursor {
+    uint32_t seq; /* sequence of the sector */
+    uint32_t rec; /* record in that sector */
+};
+
+/**
+ * @brief: Called by feedlog_query() for every record of the range, oldest first
+ * @return: 0 to continue, anything else stops the query
+ */
+typedef int (*feedlog_visit_cb_t)(const struct feedlog_entry *entry, void *user_data);
+
+/**
+ * @brief: Opens the feed log partition and rebuilds the time index from the sector contents
+ * @return: 0 on success, -ENODEV if the board has no feedlog partition
+ */
+int feedlog_init(void);
+
+/**
+ * @brief: Queues a record, never blocks, the flash write is done by the storage queue
+ *
+ * Records logged before feedlog_init() are kept in the queue and written once the log is mounted.
+ *
+ * @param: entry Record to log, its time is overwritten with the current time
+ * @return: 0 on success, -ENOBUFS if the queue is full, -ENODEV if the log could not be mounted
+ */
+int feedlog_append(const struct feedlog_entry *entry);
+
+/**
+ * @brief: Waits until every queued record is in flash
+ */
+void feedlog_flush(void);
+
+/**
+ * @brief: Visits the records with from <= time <= to, sectors out of the range are not read
+ *
+ * The records are copied out in small chunks and the callback runs without the log locked, so it may block and the
+ * appends go on meanwhile. Records appended during the query may be visited as well.
+ *
+ * @return: number of records visited, negative error code otherwise
+ */
+int feedlog_query(uint32_t from, uint32_t to, feedlog_visit_cb_t cb, void *user_data);
+
+/**
+ * @brief: Same as feedlog_query(), from a cursor, to read a range in pages
+ *
+ * The cursor is left right after the last record the callback accepted. The record the callback stops on is not
+ * consumed, the next page starts with it. A cursor on a sector recycled meanwhile resumes at the oldest record.
+ *
+ * @param: cursor Zeroed for the first page, then as left by the previous one
+ * @return: number of records accepted by the callback, negative error code otherwise
+ */
+int feedlog_query_at(struct feedlog_cursor *cursor, uint32_t from, uint32_t to, feedlog_visit_cb_t cb,
+                     void *user_data);
+
+/**
+ * @brief: Packs an entry for the binary protocol, little endian
+ * @param: out Must hold FEEDLOG_ENTRY_WIRE bytes
+ */
+void feedlog_entry_pack(const struct feedlog_entry *entry, uint8_t *out);
+
+/**
+ * @brief: Copies the log counters
+ */
+void feedlog_get_stats(struct feedlog_stats *stats);
+
+#ifdef SMART_FEEDER_UNIT_TEST
+/**
+ * @brief: Back to the state before feedlog_init(), the partition is left as is
+ */
+void feedlog_unmount(void);
+#endif
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef FILTER_H
+#define FILTER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Integer only filters, the ESP32-C6 has no FPU */
+#define FILTER_MEDIAN_LEN 5
+#define FILTER_IIR_FRAC   8 /* fractional bits kept in the IIR state */
+
+/**
+ * @brief: Running median over the last FILTER_MEDIAN_LEN values, drops isolated spikes
+ */
+struct filter_median {
+    int32_t window[FILTER_MEDIAN_LEN];
+    uint8_t next;
+    uint8_t fill;
+};
+
+/**
+ * @brief: First order low pass, y += (x - y) / 2^shift
+ */
+struct filter_iir {
+    int32_t state; /* Q FILTER_IIR_FRAC */
+    uint8_t shift;
+    bool primed;
+};
+
+/**
+ * @brief: Threshold with a dead band, trips below it when trip < release, above it otherwise
+ */
+struct filter_hyst {
+    int32_t trip;
+    int32_t release;
+    bool tripped;
+};
+
+/**
+ * @brief: Rounded mean of every stride-th sample, used to decimate an ADC burst
+ * @param: samples First sample of the channel
+ * @param: count Samples of the channel
+ * @param: stride Distance between two samples of the channel
+ */
+int32_t filter_mean(const int16_t *samples, uint32_t count, uint32_t stride);
+
+/**
+ * @brief: Adds a value to the window
+ * @return: median of the values in the window
+ */
+int32_t filter_median_push(struct filter_median *f, int32_t value);
+
+/**
+ * @brief: Empties the window
+ */
+void filter_median_reset(struct filter_median *f);
+
+/**
+ * @brief: Sets the time constant, the next value primes the filter
+ * @param: shift Time constant of 2^shift values
+ */
+void filter_iir_init(struct filter_iir *f, uint8_t shift);
+
+/**
+ * @brief: Adds a value
+ * @return: filtered value, rounded
+ */
+int32_t filter_iir_push(struct filter_iir *f, int32_t value);
+
+/**
+ * @brief: Compares a value to the threshold
+ * @return: true while tripped
+ */
+bool filter_hyst_update(struct filter_hyst *h, int32_t value);
+
+#endif
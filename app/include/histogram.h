@@ -0,0 +1,95 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdint.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/util.h>
+
+/*
+ * Log2 buckets split in HIST_SUB_COUNT linear sub-buckets: values under HIST_SUB_COUNT * 2 are exact, above that a
+ * bucket is at most 1 / HIST_SUB_COUNT wide relative to its value (25 %), from 1 up to UINT32_MAX.
+ */
+#define HIST_SUB_BITS  2
+#define HIST_SUB_COUNT BIT(HIST_SUB_BITS)
+#define HIST_BUCKETS   ((32 - HIST_SUB_BITS + 1) * HIST_SUB_COUNT)
+
+/**
+ * @brief: Fixed memory histogram, recorded into with atomics only so threads and ISRs can share it
+ */
+struct histogram {
+    atomic_t buckets[HIST_BUCKETS];
+    atomic_t max;
+};
+
+struct histogram_summary {
+    uint32_t count;
+    uint32_t p50; /* percentiles are the upper bound of their bucket */
+    uint32_t p90;
+    uint32_t p99;
+    uint32_t p999;
+    uint32_t max;
+};
+
+/* Latency histograms of the app, all in hardware cycles */
+enum hist_id {
+    HIST_STEP_JITTER = 0, /* step ISR, distance to the expected interval */
+    HIST_PROTO_FRAME,     /* binary protocol, one frame decoded and handled */
+    HIST_SHELL_CMD,       /* shell command, output included */
+    HIST_HEALTH_SCAN,     /* health thread, one pass of the stack sampler */
+    HIST_COUNT
+};
+
+/**
+ * @brief: Index of the bucket holding a value
+ */
+uint32_t histogram_bucket(uint32_t value);
+
+/**
+ * @brief: Largest value that falls in a bucket
+ */
+uint32_t histogram_bucket_ceil(uint32_t bucket);
+
+/**
+ * @brief: Adds a value, safe from any context
+ */
+void histogram_record(struct histogram *hist, uint32_t value);
+
+/**
+ * @brief: Value under which a share of the recorded values fall
+ * @param: per_mille Share, 999 for the 99.9th percentile
+ * @return: upper bound of the matching bucket, capped by the max, 0 without samples
+ */
+uint32_t histogram_percentile(const struct histogram *hist, uint32_t per_mille);
+
+/**
+ * @brief: Count, max and the usual percentiles
+ */
+void histogram_summarize(const struct histogram *hist, struct histogram_summary *out);
+
+/**
+ * @brief: Clears a histogram, values recorded at the same time may be lost
+ */
+void histogram_reset(struct histogram *hist);
+
+/**
+ * @brief: Records into one of the app histograms
+ */
+void hist_record(enum hist_id id, uint32_t cycles);
+
+/**
+ * @brief: Gives one of the app histograms
+ * @return: NULL for an unknown id
+ */
+struct histogram *hist_get(enum hist_id id);
+
+/**
+ * @brief: Name of one of the app histograms, used by the shell
+ */
+const char *hist_name(enum hist_id id);
+
+/**
+ * @brief: Clears every app histogram
+ */
+void hist_reset_all(void);
+
+#endif
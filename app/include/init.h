@@ -1,11 +1,69 @@
 #ifndef INIT_H
 #define INIT_H
 
+#include <stdbool.h>
+#include <stdint.h>
+#include <zephyr/kernel.h>
+
+/* Cold boot to ready budget, checked by the tests */
+#define BOOT_READY_BUDGET_MS 500
+
+enum boot_phase {
+    BOOT_PHASE_RESET_INFO = 0,
+    BOOT_PHASE_WATCHDOG,
+    BOOT_PHASE_STORAGE,     /* storage work queue start */
+    BOOT_PHASE_THREADS,     /* motor (safe pin state), health and comm threads */
+    BOOT_PHASE_NVS_MOUNT,   /* from here on, runs on the storage queue */
+    BOOT_PHASE_CONFIG_LOAD,
+    BOOT_PHASE_FEEDLOG,
+    BOOT_PHASE_READY,       /* whole bring-up, from processes_init() to config loaded */
+    BOOT_PHASE_COUNT
+};
+
+struct boot_phase_info {
+    const char *name;
+    uint32_t start_cyc;
+    uint32_t end_cyc;
+    uint32_t end_ms; /* uptime */
+    int result;
+    bool done;
+};
+
 /**
  * @brief: Initialize all application subsystems
  *
- * @return: 0 on success, negative error code on failure
+ * Only what must be up before anything else runs is done here (reset info, watchdog). The NVS mount, the config load
+ * and the feed log scan are queued on the storage work queue, so the threads can start while the flash is read.
+ *
+ * A watchdog failure doesn't stop the boot, the config is loaded anyway. If the load can't be queued the defaults are
+ * used, processes_wait_ready() never waits forever.
+ *
+ * @return: 0 on success, negative error code of the watchdog or storage start otherwise
  */
 int processes_init(void);
 
+/**
+ * @brief: Waits for the config to be loaded by the storage queue
+ * @param: timeout How long to wait
+ * @return: 0 when loaded (defaults included), -EAGAIN on timeout
+ */
+int processes_wait_ready(k_timeout_t timeout);
+
+/**
+ * @brief: Timestamps the start of a boot phase
+ */
+void boot_phase_begin(enum boot_phase phase);
+
+/**
+ * @brief: Timestamps the end of a boot phase
+ * @param: result Result of the step, 0 or a negative error code
+ */
+void boot_phase_end(enum boot_phase phase, int result);
+
+/**
+ * @brief: Gives the timestamps of a boot phase
+ * @return: NULL for an unknown phase
+ */
+const struct boot_phase_info *boot_phase_get(enum boot_phase phase);
+
 #endif
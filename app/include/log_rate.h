@@ -0,0 +1,53 @@
+#ifndef LOG_RATE_H
+#define LOG_RATE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+/* Period of the status logs of the thread loops */
+#define LOG_STATUS_PERIOD_MS 10000
+
+/**
+ * @brief: Tells if a rate limited log may go out at a given time
+ * @param: last_ms Time of the last log of the call site, 0 if it never logged
+ * @param: period_ms Minimum time between two logs
+ * @param: now_ms Current uptime
+ * @return: true if the log can go out, last_ms is updated then
+ */
+static inline bool log_rate_allow_at(uint32_t *last_ms, uint32_t period_ms, uint32_t now_ms)
+{
+    if (*last_ms != 0 && now_ms - *last_ms < period_ms) {
+        return false;
+    }
+
+    /* 0 is kept for "never logged" */
+    *last_ms = (now_ms != 0) ? now_ms : 1;
+    return true;
+}
+
+/**
+ * @brief: Same as log_rate_allow_at() with the current uptime
+ *
+ * Use it to gate a whole block when the log arguments are costly to get (stack usage, snapshots...).
+ */
+static inline bool log_rate_allow(uint32_t *last_ms, uint32_t period_ms)
+{
+    return log_rate_allow_at(last_ms, period_ms, k_uptime_get_32());
+}
+
+/* At most one log every period_ms per call site, the others are dropped before anything is formatted */
+#define LOG_RATE_LIMITED(_log, period_ms, ...)                                                                         \
+    do {                                                                                                               \
+        static uint32_t _log_rate_last_ms;                                                                             \
+        if (log_rate_allow(&_log_rate_last_ms, (period_ms))) {                                                         \
+            _log(__VA_ARGS__);                                                                                         \
+        }                                                                                                              \
+    } while (0)
+
+#define LOG_INF_RATE(period_ms, ...) LOG_RATE_LIMITED(LOG_INF, period_ms, __VA_ARGS__)
+#define LOG_WRN_RATE(period_ms, ...) LOG_RATE_LIMITED(LOG_WRN, period_ms, __VA_ARGS__)
+#define LOG_ERR_RATE(period_ms, ...) LOG_RATE_LIMITED(LOG_ERR, period_ms, __VA_ARGS__)
+
+#endif
@@ -1,19 +1,140 @@
 #ifndef MOTOR_CONTROL_H
 #define MOTOR_CONTROL_H
 
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "cmd_ring.h"
+
 #define MOTOR_CTRL_STACK    512
 #define MOTOR_CTRL_PRIORITY 1
 
+/* Step intervals are stored as Q24.8 fixed point timer ticks */
+#define MOTOR_Q_SHIFT         8
+#define MOTOR_RAMP_TABLE_LEN  512
+#define MOTOR_START_SPEED_SPS 200
+#define MOTOR_MAX_SPEED_SPS   40000
+#define MOTOR_STEP_PULSE_US   2
+
+#define MOTOR_DFLT_SPEED_SPS    2000
+#define MOTOR_DFLT_ACCEL        20000
+#define MOTOR_STEPS_PER_GRAM    50
+#define MOTOR_MAX_FEED_GRAMS    UINT16_MAX /* the feed log keeps 16 bits, the steps still fit an int32 */
+#define MOTOR_MAX_JOG_STEPS     INT32_MAX  /* both ways, INT32_MIN has no positive counterpart */
+#define MOTOR_CMD_BATCH         8
+#define MOTOR_IDLE_REPORT_MS    250
+#define MOTOR_HEALTH_TIMEOUT_MS (2 * MOTOR_IDLE_REPORT_MS)
+#define MOTOR_WDT_PERIOD_MS     (4 * MOTOR_IDLE_REPORT_MS)
+
+#ifdef SMART_FEEDER_UNIT_TEST
+#define MOTOR_STEP_TRACE_LEN 4096
+#endif
+
+enum motor_profile {
+    MOTOR_PROFILE_TRAPEZOID = 0,
+    MOTOR_PROFILE_SCURVE,
+};
+
+/* Every producer owns its own ring, so each ring keeps a single producer */
+enum motor_cmd_src {
+    MOTOR_SRC_SHELL = 0,
+    MOTOR_SRC_COMM,
+    MOTOR_SRC_SCHEDULE,
+    MOTOR_SRC_COUNT
+};
+
+struct motor_move {
+    int32_t steps;      /* sign selects the direction */
+    uint32_t max_speed; /* steps/s */
+    uint32_t accel;     /* steps/s^2 */
+    enum motor_profile profile;
+};
+
 /**
  * @brief: Starts the motor control thread
+ *
+ * With CONFIG_FEEDER_EVENT_LOOP the motor gets no thread, its state machine is attached to the event loop instead.
  */
 void start_motor_control_thread(void);
 
+/**
+ * @brief: Runs the motor state machine once, called by the event loop (CONFIG_FEEDER_EVENT_LOOP)
+ * @param: events EVENT_LOOP_* bits posted since the last run, 0 on a heartbeat
+ */
+void motor_loop_run(uint32_t events);
+
+/**
+ * @brief: Fills a ramp table with the step intervals of the acceleration phase
+ * @param: table Output table, Q24.8 timer ticks per step
+ * @param: len Number of entries of the table
+ * @param: move Move to compute the ramp for
+ * @param: tick_hz Frequency of the timer that will consume the table
+ * @return: number of entries used (>= 1), negative error code otherwise
+ */
+int motor_ramp_build(uint32_t *table, size_t len, const struct motor_move *move, uint32_t tick_hz);
+
+/**
+ * @brief: Starts a move on the step engine, the steps are generated from the timer ISR
+ * @param: move Move to execute
+ * @return: 0 on success, -EBUSY if a move is running, -EINVAL on bad parameters
+ */
+int motor_move_start(const struct motor_move *move);
+
+/**
+ * @brief: Requests a controlled stop, the engine decelerates using the current ramp
+ *
+ * Every move posted before the stop and not started yet is dropped, a feed is logged as cancelled.
+ */
+void motor_stop(void);
+
+/**
+ * @brief: Tells if the step engine is generating steps
+ * @return: true while a move is running
+ */
+bool motor_is_busy(void);
+
+/**
+ * @brief: Returns the frequency of the timer that drives the step engine
+ */
+uint32_t motor_tick_hz(void);
+
+/**
+ * @brief: Queues a command for the motor thread, never blocks
+ *
+ * A stop is also applied to the running move right away, the queued copy drops any move still waiting to start.
+ *
+ * @param: src Producer posting the command, each producer must use its own source
+ * @param: type Command to execute
+ * @param: arg Command argument (grams, steps or steps/s), feeds take 1..MOTOR_MAX_FEED_GRAMS grams, jogs a non zero
+ *              count of at most MOTOR_MAX_JOG_STEPS steps either way and speeds
+ *              MOTOR_START_SPEED_SPS..MOTOR_MAX_SPEED_SPS steps/s
+ * @return: 0 on success, -EINVAL on a bad source/type/argument, -ENOBUFS if the ring is full
+ */
+int motor_cmd_post(enum motor_cmd_src src, enum motor_cmd_type type, int32_t arg);
+
+/**
+ * @brief: Latency between the last executed move command being posted and its first step
+ * @return: latency in hardware cycles, 0 if no command has moved the motor yet
+ */
+uint32_t motor_cmd_latency_cyc(void);
+
 #ifdef SMART_FEEDER_UNIT_TEST
 /**
  * @brief: Stops the motor control thread
  */
 void stop_motor_control_thread(void);
+
+/**
+ * @brief: Gives access to the cycle timestamp of every step of the last moves
+ * @param: trace Pointer that receives the trace buffer
+ * @return: number of steps recorded
+ */
+size_t motor_step_trace_get(const uint32_t **trace);
+
+/**
+ * @brief: Clears the step trace
+ */
+void motor_step_trace_reset(void);
 #endif
 
 #endif
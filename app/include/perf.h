@@ -0,0 +1,69 @@
+#ifndef PERF_H
+#define PERF_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <zephyr/kernel.h>
+
+#define PERF_MAX_THREADS 16 /* threads whose context switches are counted */
+
+/**
+ * @brief: Runtime figures of one thread, since the last perf_reset()
+ */
+struct perf_thread {
+    k_tid_t tid;
+    const char *name;     /* NULL without CONFIG_THREAD_NAME */
+    uint64_t cycles;      /* time spent running, ISRs included */
+    uint32_t load_pm;     /* share of the elapsed cycles, per mille */
+    uint32_t switches;    /* times the thread was switched in */
+    size_t stack_size;
+    size_t stack_unused;  /* high water mark, never used since boot */
+};
+
+struct perf_isr {
+    uint64_t cycles;      /* time spent in interrupts */
+    uint32_t count;       /* outermost interrupts */
+    uint32_t longest_cyc; /* longest interrupt, nested ones included */
+    uint32_t load_pm;     /* share of the elapsed cycles, per mille */
+};
+
+struct perf_mem {
+    size_t heap_used;     /* system heap, 0 without one */
+    size_t heap_free;
+    size_t heap_max_used;
+    uint32_t slabs;       /* memory slabs of the image */
+    uint32_t slab_blocks; /* blocks of all the slabs */
+    uint32_t slab_used;
+    uint32_t slab_max_used;
+};
+
+/**
+ * @brief: Takes a snapshot of every thread
+ * @param: out Array filled with the threads, in the kernel list order
+ * @param: max Length of the array, the other threads are left out
+ * @return: number of threads copied, negative error code if the runtime stats are not enabled
+ */
+int perf_threads_get(struct perf_thread *out, size_t max);
+
+/**
+ * @brief: Copies the interrupt figures
+ * @return: 0 on success, -ENOTSUP if the interrupts are not traced on this build
+ */
+int perf_isr_get(struct perf_isr *out);
+
+/**
+ * @brief: Copies the heap and slab usage
+ */
+void perf_mem_get(struct perf_mem *out);
+
+/**
+ * @brief: Elapsed cycles since the last perf_reset(), the base of the load figures
+ */
+uint64_t perf_window_cycles(void);
+
+/**
+ * @brief: Restarts the CPU, context switch and ISR counters, the stack and memory high water marks are kept
+ */
+void perf_reset(void);
+
+#endif
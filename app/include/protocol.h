@@ -0,0 +1,121 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <zephyr/sys/ring_buffer.h>
+#include "feedlog.h"
+#include "telemetry.h"
+
+/*
+ * Frame layout before COBS encoding:
+ *   [type:u8][seq:u8][payload:0..PROTO_MAX_PAYLOAD][crc16:u16 le]
+ * The crc is CRC-16/CCITT-FALSE over type, seq and payload. On the wire the frame is COBS encoded and terminated by a
+ * single 0x00 byte.
+ */
+#define PROTO_HEADER_SIZE  2
+#define PROTO_CRC_SIZE     2
+#define PROTO_MAX_PAYLOAD  64
+#define PROTO_MAX_DECODED  (PROTO_HEADER_SIZE + PROTO_MAX_PAYLOAD + PROTO_CRC_SIZE)
+/* COBS adds one byte every 254 plus the leading code byte, plus the delimiter */
+#define PROTO_MAX_ENCODED  (PROTO_MAX_DECODED + PROTO_MAX_DECODED / 254 + 2)
+
+/* Feed log entries packed in one PROTO_LOG frame */
+#define PROTO_LOG_PER_FRAME (PROTO_MAX_PAYLOAD / FEEDLOG_ENTRY_WIRE)
+
+/* PROTO_LOG frames answering one PROTO_GET_LOG, sized so the page, its PROTO_LOG_NEXT and the ACK fit the TX ring */
+#define PROTO_LOG_PAGE_FRAMES 4
+#define PROTO_LOG_PAGE        (PROTO_LOG_PAGE_FRAMES * PROTO_LOG_PER_FRAME)
+#define PROTO_LOG_CURSOR_WIRE 8
+
+/* Payload of a PROTO_HIST frame */
+#define PROTO_HIST_WIRE 25
+
+/* Telemetry points packed in one PROTO_TELEM frame, after the tier, metric and index bytes */
+#define PROTO_TELEM_HEADER    3
+#define PROTO_TELEM_PER_FRAME ((PROTO_MAX_PAYLOAD - PROTO_TELEM_HEADER) / TELEM_POINT_WIRE)
+
+enum proto_type {
+    PROTO_PING = 0x01,
+    PROTO_FEED = 0x10,      /* u16 grams */
+    PROTO_JOG = 0x11,       /* i32 steps */
+    PROTO_STOP = 0x12,      /* no payload */
+    PROTO_SET_SPEED = 0x13, /* u32 steps/s */
+    PROTO_GET_STATUS = 0x20,
+    PROTO_GET_LOG = 0x21,   /* u32 from, u32 to (unix time) [, cursor of PROTO_LOG_NEXT], see proto_get_log() */
+    PROTO_GET_HIST = 0x22,  /* no payload, answered by one PROTO_HIST frame per latency histogram then an ACK */
+    PROTO_GET_TELEM = 0x23, /* u8 tier, u8 metric, answered by PROTO_TELEM frames then an ACK */
+    PROTO_ACK = 0x80,    /* u8 request type, i8 result (0 or -errno) */
+    PROTO_STATUS = 0x81, /* u8 busy, u32 last command latency in us */
+    PROTO_LOG = 0x82,    /* up to PROTO_LOG_PER_FRAME packed feed log entries */
+    PROTO_HIST = 0x83,   /* u8 id, u32 count, u32 p50, p90, p99, p99.9 and max in us */
+    PROTO_TELEM = 0x84,  /* u8 tier, u8 metric, u8 index of the first point, points oldest first */
+    PROTO_LOG_NEXT = 0x85, /* u32 seq, u32 rec: cursor to send back in the PROTO_GET_LOG of the next page */
+};
+
+struct proto_frame {
+    uint8_t type;
+    uint8_t seq;
+    const uint8_t *payload; /* points into the RX buffer, valid only during the handler call */
+    size_t payload_len;
+};
+
+struct proto_stats {
+    uint32_t frames_ok;
+    uint32_t crc_errors;
+    uint32_t framing_errors;
+    uint32_t unknown_types;
+};
+
+/**
+ * @brief: Hooks the protocol parser to the communication RX path
+ */
+void protocol_init(void);
+
+/**
+ * @brief: COBS encodes a buffer, without the trailing delimiter
+ * @param: out Must hold at least len + len / 254 + 1 bytes
+ * @return: encoded length
+ */
+size_t cobs_encode(const uint8_t *in, size_t len, uint8_t *out);
+
+/**
+ * @brief: COBS decodes a buffer in place, the decoded data is never longer than the encoded one
+ * @return: decoded length, -EINVAL on a malformed buffer
+ */
+int cobs_decode_in_place(uint8_t *buf, size_t len);
+
+/**
+ * @brief: Builds a complete wire frame, delimiter included
+ * @return: number of bytes written to out, negative error code otherwise
+ */
+int proto_encode(uint8_t type, uint8_t seq, const uint8_t *payload, size_t payload_len, uint8_t *out,
+                 size_t out_size);
+
+/**
+ * @brief: Encodes a frame and queues it on the communication link
+ * @return: 0 on success, negative error code otherwise
+ */
+int proto_send(uint8_t type, uint8_t seq, const uint8_t *payload, size_t payload_len);
+
+/**
+ * @brief: Parses every complete frame of the RX ring buffer in place and dispatches it
+ *
+ * Frames are decoded directly in the ring buffer memory, only a frame split by the ring wrap around is copied to a
+ * small scratch buffer. Incomplete frames stay in the ring until more bytes arrive.
+ */
+void proto_rx_process(struct ring_buf *rx);
+
+/**
+ * @brief: Copies the parser counters
+ */
+void proto_get_stats(struct proto_stats *stats);
+
+#ifdef SMART_FEEDER_UNIT_TEST
+/**
+ * @brief: Clears the parser state and counters
+ */
+void proto_reset(void);
+#endif
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef RESET_INFO_H
+#define RESET_INFO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "check_health.h"
+
+#define RESET_INFO_MAGIC    0x52535432 /* "RST2", bump when the layout changes */
+#define RESET_INFO_NAME_LEN 16
+
+/* Kept in no-init RAM, survives warm resets (watchdog, sys_reboot) but not a power cycle */
+struct reset_info {
+    uint32_t magic;
+    uint32_t reset_count;
+    uint32_t uptime_ms;
+    uint32_t seq; /* bumped by every change, a seal only stores its CRC if nothing changed meanwhile */
+    char culprit[RESET_INFO_NAME_LEN]; /* thread whose watchdog channel starved, empty otherwise */
+    struct {
+        char name[RESET_INFO_NAME_LEN];
+        uint32_t last_beat_ms; /* uptime of the last heartbeat */
+    } threads[HEALTH_MAX_THREADS];
+    uint32_t crc;
+};
+
+/**
+ * @brief: Checks the record left by the previous boot, logs it and starts a new one
+ */
+void reset_info_boot(void);
+
+/**
+ * @brief: Stores the last heartbeat of a monitored thread, reset_info_seal() makes it valid
+ *
+ * Cheap enough to call for every thread while the steps run: only the name and time are stored with the interrupts
+ * locked, the CRC is left to the seal.
+ *
+ * @param: slot Health slot of the thread
+ * @param: name Name of the thread
+ * @param: last_beat_ms Uptime of the last heartbeat
+ */
+void reset_info_thread(int slot, const char *name, uint32_t last_beat_ms);
+
+/**
+ * @brief: Stamps the record with the uptime and updates its CRC
+ *
+ * The CRC is computed with the interrupts on. If the record changes meanwhile the CRC is not stored: the culprit
+ * seals its own change, heartbeats must be sealed again by their caller. A reset before the CRC is stored leaves a
+ * record that doesn't match it, rejected on the next boot.
+ */
+void reset_info_seal(void);
+
+/**
+ * @brief: Records the thread responsible for the coming reset, safe from ISR context
+ */
+void reset_info_set_culprit(const char *name);
+
+/**
+ * @brief: Gives the record left by the previous boot
+ * @return: true if there was a valid one, false after a power cycle or a corrupted record
+ */
+bool reset_info_last(struct reset_info *out);
+
+#ifdef SMART_FEEDER_UNIT_TEST
+/**
+ * @brief: Gives access to the retained record to simulate resets and corruptions
+ */
+struct reset_info *reset_info_retained(void);
+#endif
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef SCHEDULE_H
+#define SCHEDULE_H
+
+#include <stdint.h>
+
+#define SCHEDULE_MAX_SLOTS  256
+#define SCHEDULE_SECS_DAY   86400
+#define SCHEDULE_NOT_QUEUED UINT16_MAX
+
+/* Times are UTC, the feeder has no notion of time zones */
+enum schedule_kind {
+    SCHEDULE_FREE = 0,
+    SCHEDULE_DAILY,  /* time: seconds since midnight */
+    SCHEDULE_WEEKLY, /* time: seconds since midnight, days: bit 0 = Monday ... bit 6 = Sunday */
+    SCHEDULE_ONCE,   /* time: unix time */
+};
+
+struct schedule_slot {
+    uint8_t kind;
+    uint8_t days;
+    uint16_t grams;
+    uint32_t time;
+};
+
+/**
+ * @brief: Called from the system work queue for every event that is due
+ * @param: slot Index of the slot in the schedule table
+ * @param: grams Amount to dispense
+ * @param: due Unix time the event was scheduled for
+ */
+typedef void (*schedule_fire_cb_t)(uint16_t slot, uint16_t grams, uint32_t due);
+
+/**
+ * @brief: Builds the event heap from the schedule stored in the configuration and arms the timer
+ * @param: cb Event consumer, NULL posts a feed command to the motor thread
+ */
+void schedule_init(schedule_fire_cb_t cb);
+
+/**
+ * @brief: Rebuilds the event heap after the configuration was replaced (load, defaults)
+ */
+void schedule_reload(void);
+
+/**
+ * @brief: Adds a slot to the first free entry of the table
+ * @return: slot index on success, -EINVAL on a bad or past slot, -ENOMEM if the table is full
+ */
+int schedule_add(const struct schedule_slot *slot);
+
+/**
+ * @brief: Frees a slot and cancels its next event
+ * @return: 0 on success, -EINVAL if the slot is out of range or already free
+ */
+int schedule_remove(uint16_t slot);
+
+/**
+ * @brief: Sets the wall clock, upcoming events are recomputed
+ */
+void schedule_set_time(uint32_t unix_time);
+
+/**
+ * @brief: Current wall clock time
+ * @return: unix time in seconds
+ */
+uint32_t schedule_now(void);
+
+/**
+ * @brief: Gives the next event that will fire
+ * @return: 0 on success, -ENOENT if nothing is scheduled
+ */
+int schedule_next(uint32_t *due, uint16_t *slot);
+
+#ifdef SMART_FEEDER_UNIT_TEST
+/**
+ * @brief: Forgets the wall clock and drops every pending event, as after a reboot
+ */
+void schedule_reset(void);
+#endif
+
+#endif
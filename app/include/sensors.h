@@ -0,0 +1,95 @@
+#ifndef SENSORS_H
+#define SENSORS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SENSORS_STACK             1024
+#define SENSORS_PRIORITY          7
+#define SENSORS_PERIOD_MS         1000
+#define SENSORS_BURST             16   /* samples per channel and period, averaged into one reading */
+#define SENSORS_BURST_INTERVAL_US 1000 /* between two samples of a burst, the average also smooths the mains hum */
+#define SENSORS_OVERSAMPLING      2    /* 2^n conversions per sample, when the ADC can do it */
+#define SENSORS_IIR_SHIFT         3    /* time constant of 8 periods */
+#define SENSORS_SAMPLE_TIMEOUT_MS (2 * SENSORS_BURST * SENSORS_BURST_INTERVAL_US / 1000 + 10)
+#define SENSORS_HEALTH_TIMEOUT_MS (3 * SENSORS_PERIOD_MS)
+#define SENSORS_WDT_PERIOD_MS     (4 * SENSORS_PERIOD_MS)
+
+/* Battery behind a divider by SENSORS_BATTERY_DIVIDER */
+#define SENSORS_BATTERY_DIVIDER 2
+#define SENSORS_BATTERY_LOW_MV  3300 /* fault under it */
+#define SENSORS_BATTERY_OK_MV   3450 /* cleared over it */
+
+/* Linear temperature sensor, 500 mV at 0 degrees and 10 mV per degree, read in tenths of a degree */
+#define SENSORS_TEMP_OFFSET_MV 500
+#define SENSORS_TEMP_HIGH_DC   600 /* fault over it */
+#define SENSORS_TEMP_OK_DC     550 /* cleared under it */
+
+/* Channels of a burst, ordered like their ADC channel numbers */
+enum sensor_id {
+    SENSOR_BATTERY = 0,
+    SENSOR_TEMPERATURE,
+    SENSOR_COUNT
+};
+
+struct sensors_reading {
+    int32_t battery_mv;
+    int32_t temperature_dc;
+    bool battery_ok;
+    bool temperature_ok;
+    bool valid; /* false until the first burst is processed */
+};
+
+struct sensors_stats {
+    uint32_t bursts;
+    uint32_t samples;
+    uint32_t errors;
+};
+
+/**
+ * @brief: Starts the sensor thread, does nothing on boards without the sensor ADC channels
+ */
+void start_sensors_thread(void);
+
+/**
+ * @brief: Sets up the ADC channels and the burst sequence, called by start_sensors_thread()
+ * @return: 0 on success, -ENODEV without sensor ADC channels, negative error code from the ADC otherwise
+ */
+int sensors_init(void);
+
+/**
+ * @brief: Samples one burst of every sensor and runs it through the filters, the sensor thread does it every period
+ * @return: 0 on success, -ENODEV without sensor ADC channels, negative error code from the ADC otherwise
+ */
+int sensors_update(void);
+
+/**
+ * @brief: Runs a burst of raw samples through the filters and the thresholds, reports the health changes
+ * @param: raw Samples of every channel interleaved, SENSOR_COUNT per conversion
+ * @param: count Conversions in the burst
+ */
+void sensors_process(const int16_t *raw, uint32_t count);
+
+/**
+ * @brief: Copies the filtered readings
+ */
+void sensors_get(struct sensors_reading *out);
+
+/**
+ * @brief: Copies the sampling counters
+ */
+void sensors_get_stats(struct sensors_stats *out);
+
+#ifdef SMART_FEEDER_UNIT_TEST
+/**
+ * @brief: Stops the sensor thread
+ */
+void stop_sensors_thread(void);
+
+/**
+ * @brief: Forgets the filter history and the thresholds state
+ */
+void sensors_reset(void);
+#endif
+
+#endif
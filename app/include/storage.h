@@ -0,0 +1,71 @@
+#ifndef STORAGE_H
+#define STORAGE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <zephyr/kernel.h>
+
+#define STORAGE_STACK               1024
+#define STORAGE_PRIORITY            7
+#define STORAGE_COMMIT_QUIET_MS     500   /* default quiet period before a burst of changes is written */
+#define STORAGE_COMMIT_MAX_DELAY_MS 5000  /* a steady stream of changes still gets written */
+#define STORAGE_COMMIT_RETRY_MS     10000 /* delay before a failed commit is tried again */
+#define STORAGE_GC_IDLE_MS          1000  /* after a commit, before the NVS free room is checked */
+#define STORAGE_GC_RETRY_MS         1000  /* the feeder was busy, check again after that */
+
+struct config_commit_status {
+    bool pending;           /* a commit is scheduled */
+    int last_result;        /* result of the last commit */
+    uint32_t requests;      /* commit requests since boot */
+    uint32_t commits;       /* commits that reached the NVS */
+    int64_t last_commit_ms; /* uptime of the last successful commit, -1 if none yet */
+    size_t last_bytes;      /* bytes written by the last successful commit */
+    uint32_t idle_gcs;      /* NVS garbage collections run ahead of time while idle */
+    uint32_t commit_gcs;    /* commits that had to run the garbage collection themselves */
+};
+
+/**
+ * @brief: Starts the storage work queue, flash writes are done from there
+ */
+void storage_init(void);
+
+/**
+ * @brief: Runs a work item on the storage queue, for anything else that has to write the flash
+ * @return: same as k_work_submit_to_queue(), -ENODEV before storage_init()
+ */
+int storage_submit(struct k_work *work);
+
+/**
+ * @brief: Asks for the config to be saved, never waits on the flash
+ *
+ * Requests are coalesced: the commit runs once no request came for the quiet period, or at the latest
+ * STORAGE_COMMIT_MAX_DELAY_MS after the first one.
+ */
+void config_commit_request(void);
+
+/**
+ * @brief: Writes any pending change right away and waits for it, used before rebooting
+ * @return: 0 on success, the save_config() error otherwise
+ */
+int config_commit_flush(void);
+
+/**
+ * @brief: Changes the quiet period used to coalesce commit requests
+ * @param: quiet_ms New quiet period, 0 commits on the next run of the work queue
+ */
+void config_commit_set_quiet(uint32_t quiet_ms);
+
+/**
+ * @brief: Copies the state of the commit service
+ */
+void config_commit_get_status(struct config_commit_status *status);
+
+#ifdef SMART_FEEDER_UNIT_TEST
+/**
+ * @brief: Cancels any pending commit and clears the status
+ */
+void storage_reset(void);
+#endif
+
+#endif
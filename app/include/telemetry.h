@@ -0,0 +1,85 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define TELEM_PERIOD_MS   1000 /* one raw sample of every metric per period */
+#define TELEM_SEC_POINTS  60   /* last minute, one point per sample */
+#define TELEM_MIN_POINTS  60   /* last hour, one point per minute */
+#define TELEM_HOUR_POINTS 24   /* last day, one point per hour */
+#define TELEM_POINT_WIRE  6    /* i16 min, max and mean, little endian */
+#define TELEM_NO_VALUE    INT32_MIN /* sample of a metric that had nothing to report */
+
+enum telem_metric {
+    TELEM_BEAT_AGE = 0, /* ms since the oldest heartbeat */
+    TELEM_STACK_FREE,   /* lowest stack headroom, bytes */
+    TELEM_BATTERY,      /* mV */
+    TELEM_TEMPERATURE,  /* tenths of a degree */
+    TELEM_METRIC_COUNT
+};
+
+enum telem_tier {
+    TELEM_TIER_SEC = 0,
+    TELEM_TIER_MIN,
+    TELEM_TIER_HOUR,
+    TELEM_TIER_COUNT
+};
+
+/**
+ * @brief: Summary of the raw samples covered by one point, values saturated to 16 bits
+ *
+ * A point without any sample has min > max.
+ */
+struct telem_point {
+    int16_t min;
+    int16_t max;
+    int16_t mean;
+};
+
+/**
+ * @brief: Starts sampling every metric once per TELEM_PERIOD_MS, on the system work queue
+ */
+void telemetry_init(void);
+
+/**
+ * @brief: Adds one raw sample of every metric and closes the points that are complete
+ * @param: values One per metric, TELEM_NO_VALUE when a metric has nothing to report
+ */
+void telemetry_record(const int32_t values[TELEM_METRIC_COUNT]);
+
+/**
+ * @brief: Copies the points of one metric in a tier, oldest first
+ * @param: out Room for max points
+ * @return: number of points copied, -EINVAL on an unknown tier or metric
+ */
+int telemetry_read(enum telem_tier tier, enum telem_metric metric, struct telem_point *out, size_t max);
+
+/**
+ * @brief: Serializes a point to TELEM_POINT_WIRE bytes
+ */
+void telemetry_point_pack(const struct telem_point *point, uint8_t *out);
+
+/**
+ * @brief: Seconds covered by one point of a tier, 0 for an unknown tier
+ */
+uint32_t telemetry_tier_span_s(enum telem_tier tier);
+
+/**
+ * @brief: Name of a tier, NULL for an unknown one
+ */
+const char *telemetry_tier_name(enum telem_tier tier);
+
+/**
+ * @brief: Name of a metric, NULL for an unknown one
+ */
+const char *telemetry_metric_name(enum telem_metric metric);
+
+#ifdef SMART_FEEDER_UNIT_TEST
+/**
+ * @brief: Stops the sampling and forgets every point
+ */
+void telemetry_reset(void);
+#endif
+
+#endif
@@ -1,23 +1,43 @@
 #ifndef WATCHDOG_H
 #define WATCHDOG_H
 
-#define WDT_TIMEOUT_MS               1000
-#define SUPERVISOR_CHECK_INTERVAL_MS 500
+#include <stdint.h>
 
 /**
- * @brief: feeds the watchdog so the board doesn't reset
+ * @brief: Initializes the task watchdog, backed by the hardware watchdog
+ * @return: 0 on success, errorcode otherwise
  */
-void watchdog_feed(void);
+int init_watchdog(void);
 
 /**
- * @brief: Initializes the watchdog
- * @return: 0 on success, errorcode otherwise
+ * @brief: Adds a software channel for a thread, the system resets if it's not fed within its period
+ * @param: name Name of the thread, reported when the channel starves. Must stay valid forever
+ * @param: period_ms Maximum time between two feeds
+ * @return: channel id (>= 0) on success, negative error code otherwise
  */
-int init_watchdog(void);
+int watchdog_add_channel(const char *name, uint32_t period_ms);
+
+/**
+ * @brief: feeds a channel so the board doesn't reset
+ * @param: channel Id given by watchdog_add_channel(), negative ids are ignored
+ */
+void watchdog_feed(int channel);
 
 /**
  * @brief: Disables the watchdog
  */
 void watchdog_disable(void);
 
+#ifdef SMART_FEEDER_UNIT_TEST
+/**
+ * @brief: Name of the last thread whose channel starved, test builds don't reset
+ */
+const char *watchdog_starved_thread(void);
+
+/**
+ * @brief: Forgets the last starved thread, so the next one can be told apart
+ */
+void watchdog_clear_starved(void);
+#endif
+
 #endif
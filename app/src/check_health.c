@@ -2,28 +2,231 @@
  * @file: check_healt.c
  * @brief: Monitoring of the system.
  *
- * Here we have all the monitoring of the non time critical stuff, like battery, temp, etc.
+ * Here we have all the monitoring of the non time critical stuff, like battery, temp, etc. The sensors are sampled
+ * and filtered elsewhere, they only report here whether they are within their limits.
+ *
+ * Threads register at runtime and report alive by stamping their own slot with the cycle counter, no lock is taken.
+ * Each slot owns a deadline timer: when it expires it compares the last stamp with the timeout, re-arms itself for the
+ * exact remaining time if the thread reported in between, or flags the stall. The health thread only wakes up on a
+ * stall or a recovery, and once in a while to feed its own watchdog channel.
+ *
+ * Measuring a stack means walking its unused part, so the worker loops don't do it: the health thread samples every
+ * watched stack at a low rate and keeps the running minimum of the free space.
+ *
+ * With CONFIG_FEEDER_EVENT_LOOP the same work is done by a one state machine that the event loop runs, the deadline
+ * timers post an event instead of giving the semaphore.
  */
 #include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
 #include <zephyr/logging/log.h>
 #include "check_health.h"
+#include "watchdog.h"
+#include "reset_info.h"
+#include "histogram.h"
+
+#ifdef CONFIG_FEEDER_EVENT_LOOP
+#include <zephyr/smf.h>
+#include "event_loop.h"
+#endif
 
 LOG_MODULE_REGISTER(check_health, LOG_LEVEL_INF);
+#ifndef CONFIG_FEEDER_EVENT_LOOP
 K_THREAD_STACK_DEFINE(health_stack_area, CHECK_HEALTH_STACK);
+#endif
 
 /* Local prototypes */
 static bool check_threads_health(void);
 
-static struct k_thread health_thread_data;
+struct health_slot {
+    atomic_t last_beat; /* cycle counter at the last report */
+    atomic_t ready;     /* set once the slot is filled */
+    atomic_t stalled;
+    atomic_t stack_min_free; /* lowest free stack seen, -1 before the first sample */
+    const struct k_thread *thread;
+    const char *name;
+    uint32_t timeout_ms;
+    uint32_t timeout_cyc;
+    struct k_timer deadline;
+};
+
 static struct {
-    uint32_t last_heartbeat[THREAD_COUNT];
-    struct k_spinlock lock;
-    bool threads_ok;
-    // TODO: here we will add other things like battery, temperature, etc
-} health_status;
+    struct health_slot slots[HEALTH_MAX_THREADS];
+    atomic_t claimed;
+    atomic_t threads_ok;
+    atomic_t stacks_ok;
+    atomic_t sensor_faults; /* one bit per enum health_sensor */
+} health_status = {.stacks_ok = ATOMIC_INIT(true)};
+
+static int health_wdt = -1;
+static atomic_t stack_period_ms = ATOMIC_INIT(HEALTH_STACK_SAMPLE_MS);
+static uint32_t stack_next_ms;
+
+#ifdef CONFIG_FEEDER_EVENT_LOOP
+enum health_sm_state {
+    HEALTH_SM_MONITOR = 0,
+};
 
+static struct health_sm {
+    struct smf_ctx ctx;
+    uint32_t events; /* EVENT_LOOP_* bits of the current run */
+    uint32_t due_ms; /* uptime of the next watchdog feed or stack sample */
+    bool attached;
+} health_sm;
+#else
+/* Given on every stall and recovery */
+K_SEM_DEFINE(health_event_sem, 0, 1);
+
+static struct k_thread health_thread_data;
 static k_tid_t health_tid = NULL;
+#endif
+
+/**
+ * @brief: Wakes up the health thread on a stall or a recovery, callable from an ISR
+ */
+static void health_wake(void)
+{
+#ifdef CONFIG_FEEDER_EVENT_LOOP
+    event_loop_post(EVENT_LOOP_HEALTH);
+#else
+    k_sem_give(&health_event_sem);
+#endif
+}
+
+/**
+ * @brief: Deadline of a slot, runs in ISR context
+ */
+static void health_deadline_expiry(struct k_timer *timer)
+{
+    struct health_slot *slot = k_timer_user_data_get(timer);
+    uint32_t elapsed = k_cycle_get_32() - (uint32_t)atomic_get(&slot->last_beat);
+
+    if (elapsed < slot->timeout_cyc) {
+        k_timer_start(timer, K_CYC(slot->timeout_cyc - elapsed), K_NO_WAIT);
+        return;
+    }
+
+    atomic_set(&slot->stalled, 1);
+    atomic_set(&health_status.threads_ok, false);
+    health_wake();
+}
+
+/**
+ * @brief: Copies the last heartbeat of every thread to the retained reset info
+ */
+static void health_snapshot(void)
+{
+    uint32_t now_ms = k_uptime_get_32();
+    uint32_t now_cyc = k_cycle_get_32();
+
+    for (int i = 0; i < HEALTH_MAX_THREADS; i++) {
+        struct health_slot *slot = &health_status.slots[i];
+
+        if (atomic_get(&slot->ready)) {
+            uint32_t ago_ms = k_cyc_to_ms_floor32(now_cyc - (uint32_t)atomic_get(&slot->last_beat));
+
+            reset_info_thread(i, slot->name, now_ms - ago_ms);
+        }
+    }
+    reset_info_seal();
+}
+
+/**
+ * @brief: Measures the free space of every watched stack and flags the ones running out
+ */
+static void stack_sample(void)
+{
+    for (int i = 0; i < HEALTH_MAX_THREADS; i++) {
+        struct health_slot *slot = &health_status.slots[i];
+        atomic_val_t min_free;
+        size_t unused;
+
+        if (!atomic_get(&slot->ready) || slot->thread == NULL ||
+            k_thread_stack_space_get(slot->thread, &unused) < 0) {
+            continue;
+        }
+
+        min_free = atomic_get(&slot->stack_min_free);
+        if (min_free >= 0 && (size_t)min_free <= unused) {
+            continue;
+        }
+
+        atomic_set(&slot->stack_min_free, (atomic_val_t)unused);
+        if (unused < HEALTH_STACK_MIN_FREE) {
+            LOG_ERR("Stack of %s down to %zu free bytes", slot->name, unused);
+            atomic_set(&health_status.stacks_ok, false);
+        } else {
+            LOG_DBG("Stack of %s: %zu bytes free at worst", slot->name, unused);
+        }
+    }
+}
+
+/**
+ * @brief: Samples the stacks if it's time to
+ * @return: how long the health thread can sleep
+ */
+static uint32_t stack_sample_if_due(void)
+{
+    uint32_t period = (uint32_t)atomic_get(&stack_period_ms);
+    uint32_t now = k_uptime_get_32();
+    int32_t left = (int32_t)(stack_next_ms - now);
+
+    if (period == 0) {
+        return HEALTH_WDT_FEED_MS;
+    }
+
+    /* Also catches a period shortened since the last sample */
+    if (left <= 0 || (uint32_t)left > period) {
+        uint32_t start = k_cycle_get_32();
+
+        stack_sample();
+        hist_record(HIST_HEALTH_SCAN, k_cycle_get_32() - start);
+        stack_next_ms = now + period;
+        left = (int32_t)period;
+    }
+
+    return MIN((uint32_t)left, HEALTH_WDT_FEED_MS);
+}
+
+#ifdef CONFIG_FEEDER_EVENT_LOOP
+static enum smf_state_result health_monitor_run(void *obj)
+{
+    struct health_sm *sm = obj;
+    uint32_t now = k_uptime_get_32();
+
+    if (sm->events & EVENT_LOOP_HEALTH) {
+        check_threads_health();
+    } else if ((int32_t)(sm->due_ms - now) > 0) {
+        /* Woken up for another machine */
+        return SMF_EVENT_HANDLED;
+    }
+
+    watchdog_feed(health_wdt);
+    health_snapshot();
+    sm->due_ms = now + stack_sample_if_due();
+
+    return SMF_EVENT_HANDLED;
+}
+
+/* The stall detection itself runs in the deadline timers, a single state is enough */
+static const struct smf_state health_states[] = {
+    [HEALTH_SM_MONITOR] = SMF_CREATE_STATE(NULL, health_monitor_run, NULL, NULL, NULL),
+};
+
+uint32_t health_loop_run(uint32_t events)
+{
+    int32_t left;
+
+    if (!health_sm.attached) {
+        return HEALTH_WDT_FEED_MS;
+    }
 
+    health_sm.events = events;
+    smf_run_state(SMF_CTX(&health_sm));
+
+    left = (int32_t)(health_sm.due_ms - k_uptime_get_32());
+    return (uint32_t)MAX(left, 0);
+}
+#else
 /**
  * @brief: Thread that checks general system info
  */
@@ -33,28 +236,55 @@ void check_health_thread(void *p1, void *p2, void *p3)
     ARG_UNUSED(p2);
     ARG_UNUSED(p3);
 
-    size_t unused_stack;
+    uint32_t wait_ms;
 
     LOG_INF("Check health started at priority: %d", CHECK_HEALTH_PRIORITY);
 
     while (1) {
-        k_thread_stack_space_get(&health_thread_data, &unused_stack);
-        LOG_INF("Check health loop. Unused stack: %d bytes", unused_stack);
+        watchdog_feed(health_wdt);
+        health_snapshot();
+        wait_ms = stack_sample_if_due();
+        if (k_sem_take(&health_event_sem, K_MSEC(wait_ms)) < 0) {
+            continue;
+        }
 
         check_threads_health();
-        k_sleep(K_MSEC(HEALTH_CHECK_INTERVAL_MS));
     }
 }
+#endif
 
 void start_check_health_thread(void)
 {
-    uint32_t now = k_uptime_get_32();
+    uint32_t now = k_cycle_get_32();
 
-    for (int i = 0; i < THREAD_COUNT; i++) {
-        health_status.last_heartbeat[i] = now;
+    /* Every thread gets a full timeout from now on */
+    for (int i = 0; i < HEALTH_MAX_THREADS; i++) {
+        struct health_slot *slot = &health_status.slots[i];
+
+        if (atomic_get(&slot->ready)) {
+            atomic_set(&slot->last_beat, (atomic_val_t)now);
+            atomic_clear(&slot->stalled);
+            k_timer_start(&slot->deadline, K_CYC(slot->timeout_cyc), K_NO_WAIT);
+        }
     }
-    health_status.threads_ok = true;
+    atomic_set(&health_status.threads_ok, true);
+    stack_next_ms = k_uptime_get_32() + (uint32_t)atomic_get(&stack_period_ms);
 
+    if (health_wdt < 0) {
+        health_wdt = watchdog_add_channel("check_health", HEALTH_WDT_PERIOD_MS);
+    }
+
+#ifdef CONFIG_FEEDER_EVENT_LOOP
+    /* No thread of its own, the event loop runs the state machine */
+    event_loop_start();
+    smf_set_initial(SMF_CTX(&health_sm), &health_states[HEALTH_SM_MONITOR]);
+    health_sm.due_ms = k_uptime_get_32();
+    health_sm.attached = true;
+    event_loop_post(EVENT_LOOP_HEALTH);
+
+    LOG_INF("Check health attached to the event loop");
+#else
+    k_sem_reset(&health_event_sem);
     health_tid = k_thread_create(&health_thread_data,
                                  health_stack_area,
                                  K_THREAD_STACK_SIZEOF(health_stack_area),
@@ -65,74 +295,203 @@ void start_check_health_thread(void)
                                  CHECK_HEALTH_PRIORITY,
                                  0,
                                  K_NO_WAIT);
+    k_thread_name_set(health_tid, "check_health");
 
     LOG_INF("Check health thread started (tid=%p)", (void *)health_tid);
+#endif
 }
 
-// TODO: Unit tests
-void thread_report_alive(thread_id_t thread_id)
+health_handle_t health_register(const char *name, uint32_t timeout_ms)
 {
-    uint32_t now;
+    struct health_slot *slot;
+    atomic_val_t idx;
+
+    /* Elapsed times are computed on the 32 bit cycle counter, the timeout must stay well within a wrap */
+    if (timeout_ms == 0 || k_ms_to_cyc_ceil64(timeout_ms) > INT32_MAX) {
+        return -EINVAL;
+    }
+
+    idx = atomic_inc(&health_status.claimed);
+    if (idx >= HEALTH_MAX_THREADS) {
+        atomic_dec(&health_status.claimed);
+        LOG_ERR("No health slot left for %s", name);
+        return -ENOMEM;
+    }
+
+    slot = &health_status.slots[idx];
+    slot->name = name;
+    slot->timeout_ms = timeout_ms;
+    slot->timeout_cyc = k_ms_to_cyc_ceil32(timeout_ms);
+    atomic_set(&slot->last_beat, (atomic_val_t)k_cycle_get_32());
+    atomic_clear(&slot->stalled);
+    atomic_set(&slot->stack_min_free, -1);
+    slot->thread = NULL;
+    k_timer_init(&slot->deadline, health_deadline_expiry, NULL);
+    k_timer_user_data_set(&slot->deadline, slot);
+    atomic_set(&slot->ready, 1);
+    k_timer_start(&slot->deadline, K_CYC(slot->timeout_cyc), K_NO_WAIT);
 
-    if (thread_id >= THREAD_COUNT) {
+    LOG_INF("Monitoring %s (timeout %u ms)", name, timeout_ms);
+    return (health_handle_t)idx;
+}
+
+void thread_report_alive(health_handle_t handle)
+{
+    struct health_slot *slot;
+
+    if ((unsigned int)handle >= HEALTH_MAX_THREADS) {
         return;
     }
 
-    now = k_uptime_get_32();
-    k_spinlock_key_t key = k_spin_lock(&health_status.lock);
-    health_status.last_heartbeat[thread_id] = now;
-    k_spin_unlock(&health_status.lock, key);
+    slot = &health_status.slots[handle];
+    atomic_set(&slot->last_beat, (atomic_val_t)k_cycle_get_32());
+
+    /* The deadline timer is stopped while stalled, the health thread restarts it */
+    if (atomic_get(&slot->stalled)) {
+        health_wake();
+    }
+}
+
+int health_stack_watch(health_handle_t handle, const struct k_thread *thread)
+{
+    if ((unsigned int)handle >= HEALTH_MAX_THREADS || thread == NULL) {
+        return -EINVAL;
+    }
+
+    health_status.slots[handle].thread = thread;
+    return 0;
+}
+
+void health_stack_set_period(uint32_t period_ms)
+{
+    atomic_set(&stack_period_ms, (atomic_val_t)period_ms);
+
+    /* The health thread may be asleep for a whole watchdog period */
+    health_wake();
+}
+
+int health_stack_min_free(health_handle_t handle)
+{
+    atomic_val_t min_free;
+
+    if ((unsigned int)handle >= HEALTH_MAX_THREADS) {
+        return -EINVAL;
+    }
+
+    min_free = atomic_get(&health_status.slots[handle].stack_min_free);
+    return (min_free < 0) ? -ENODATA : (int)min_free;
+}
+
+int health_stack_headroom(void)
+{
+    int headroom = -ENODATA;
+
+    for (int i = 0; i < HEALTH_MAX_THREADS; i++) {
+        int min_free = atomic_get(&health_status.slots[i].ready) ? health_stack_min_free(i) : -ENODATA;
+
+        if (min_free >= 0 && (headroom < 0 || min_free < headroom)) {
+            headroom = min_free;
+        }
+    }
+
+    return headroom;
+}
+
+uint32_t health_beat_age_max_ms(void)
+{
+    uint32_t now = k_cycle_get_32();
+    uint32_t oldest = 0;
+
+    for (int i = 0; i < HEALTH_MAX_THREADS; i++) {
+        struct health_slot *slot = &health_status.slots[i];
+
+        if (atomic_get(&slot->ready)) {
+            oldest = MAX(oldest, now - (uint32_t)atomic_get(&slot->last_beat));
+        }
+    }
+
+    return k_cyc_to_ms_floor32(oldest);
 }
 
 /**
- * @brief: checks the health of all the threads
+ * @brief: Logs the stalled threads and restarts the deadline of the ones that came back
  * @return: true if all threads are ok, false otherwise
  */
 static bool check_threads_health(void)
 {
-    uint32_t now = k_uptime_get_32();
     bool all_ok = true;
 
-    for (int i = 0; i < THREAD_COUNT; i++) {
-        uint32_t last_hb;
+    for (int i = 0; i < HEALTH_MAX_THREADS; i++) {
+        struct health_slot *slot = &health_status.slots[i];
         uint32_t elapsed;
 
-        k_spinlock_key_t key = k_spin_lock(&health_status.lock);
-        last_hb = health_status.last_heartbeat[i];
-        k_spin_unlock(&health_status.lock, key);
+        if (!atomic_get(&slot->ready) || !atomic_get(&slot->stalled)) {
+            continue;
+        }
 
-        elapsed = now - last_hb;
-        if (elapsed > THREAD_TIMEOUT_MS) {
-            LOG_INF("Thread %d not responding (last seen %u ms ago)", i, elapsed);
-            all_ok = false;
+        elapsed = k_cycle_get_32() - (uint32_t)atomic_get(&slot->last_beat);
+        if (elapsed < slot->timeout_cyc) {
+            LOG_INF("Thread %s is responding again", slot->name);
+            atomic_clear(&slot->stalled);
+            k_timer_start(&slot->deadline, K_CYC(slot->timeout_cyc - elapsed), K_NO_WAIT);
+            continue;
         }
+
+        LOG_INF("Thread %s not responding (last seen %u ms ago)", slot->name, k_cyc_to_ms_floor32(elapsed));
+        all_ok = false;
     }
 
-    k_spinlock_key_t key = k_spin_lock(&health_status.lock);
-    health_status.threads_ok = all_ok;
-    k_spin_unlock(&health_status.lock, key);
+    atomic_set(&health_status.threads_ok, all_ok);
 
     return all_ok;
 }
 
-bool is_system_healthy(void)
+void health_sensor_report(enum health_sensor sensor, bool ok)
 {
-    bool healthy;
-    k_spinlock_key_t key = k_spin_lock(&health_status.lock);
-    // TODO:  we should add ands to check everything, like battery health
-    healthy = health_status.threads_ok;
-    k_spin_unlock(&health_status.lock, key);
+    if (sensor >= HEALTH_SENSOR_COUNT) {
+        return;
+    }
+
+    if (ok) {
+        atomic_clear_bit(&health_status.sensor_faults, sensor);
+    } else {
+        atomic_set_bit(&health_status.sensor_faults, sensor);
+    }
+}
 
-    return healthy;
+bool is_system_healthy(void)
+{
+    return atomic_get(&health_status.threads_ok) != 0 && atomic_get(&health_status.stacks_ok) != 0 &&
+           atomic_get(&health_status.sensor_faults) == 0;
 }
 
 #ifdef SMART_FEEDER_UNIT_TEST
 void stop_check_health_thread(void)
 {
+#ifdef CONFIG_FEEDER_EVENT_LOOP
+    health_sm.attached = false;
+#else
     if (health_tid != NULL) {
         LOG_INF("Stopping check health thread");
         k_thread_abort(health_tid);
         health_tid = NULL;
     }
+#endif
+}
+
+void health_reset(void)
+{
+    for (int i = 0; i < HEALTH_MAX_THREADS; i++) {
+        if (atomic_get(&health_status.slots[i].ready)) {
+            k_timer_stop(&health_status.slots[i].deadline);
+        }
+        atomic_clear(&health_status.slots[i].ready);
+        atomic_clear(&health_status.slots[i].stalled);
+        health_status.slots[i].thread = NULL;
+    }
+    atomic_clear(&health_status.claimed);
+    atomic_set(&health_status.threads_ok, true);
+    atomic_set(&health_status.stacks_ok, true);
+    atomic_clear(&health_status.sensor_faults);
 }
 #endif
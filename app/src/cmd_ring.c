@@ -0,0 +1,46 @@
+/**
+ * @file: cmd_ring.c
+ * @brief: Lock-free command ring.
+ *
+ * Fixed size SPSC ring used to hand commands from the shell/comm threads to the motor thread without allocations.
+ * Indexes run freely and are masked on access, the ring is full when head - tail == CMD_RING_LEN.
+ */
+#include <zephyr/kernel.h>
+#include "cmd_ring.h"
+
+BUILD_ASSERT(IS_POWER_OF_TWO(CMD_RING_LEN), "CMD_RING_LEN must be a power of two");
+
+void cmd_ring_init(struct cmd_ring *ring)
+{
+    atomic_set(&ring->head, 0);
+    atomic_set(&ring->tail, 0);
+}
+
+bool cmd_ring_put(struct cmd_ring *ring, const struct motor_cmd *cmd)
+{
+    uint32_t head = (uint32_t)atomic_get(&ring->head);
+
+    if (head - (uint32_t)atomic_get(&ring->tail) >= CMD_RING_LEN) {
+        return false;
+    }
+
+    ring->slots[head & (CMD_RING_LEN - 1)] = *cmd;
+    /* Publishing head is a full barrier, the slot is visible before the consumer can see it */
+    atomic_set(&ring->head, (atomic_val_t)(head + 1));
+
+    return true;
+}
+
+size_t cmd_ring_get_batch(struct cmd_ring *ring, struct motor_cmd *out, size_t max)
+{
+    uint32_t tail = (uint32_t)atomic_get(&ring->tail);
+    size_t count = MIN((size_t)((uint32_t)atomic_get(&ring->head) - tail), max);
+
+    for (size_t i = 0; i < count; i++) {
+        out[i] = ring->slots[(tail + i) & (CMD_RING_LEN - 1)];
+    }
+
+    atomic_set(&ring->tail, (atomic_val_t)(tail + count));
+
+    return count;
+}
@@ -3,20 +3,232 @@
  * @brief: Thread that is in charge of the comms.
  *
  * In this file, is the main communication thread, that will take charge of interfacing with the pc/app or other nodes
+ *
+ * The UART runs on the async API: the driver DMAs into two small buffers that the callback copies into the RX ring
+ * buffer, then wakes the comm thread up through a semaphore. The thread only runs when bytes arrive (or to report
+ * alive to the health monitor). Transmission goes through a dedicated work queue so senders never wait on the line.
+ *
+ * With CONFIG_FEEDER_EVENT_LOOP the callback posts an event instead, and a one state machine run by the event loop
+ * hands the bytes to the RX handler.
  */
 #include <zephyr/kernel.h>
+#include <zephyr/device.h>
+#include <zephyr/drivers/uart.h>
 #include <zephyr/logging/log.h>
 #include "communication.h"
 #include "check_health.h"
+#include "watchdog.h"
+
+#ifdef CONFIG_FEEDER_EVENT_LOOP
+#include <zephyr/smf.h>
+#include "event_loop.h"
+#endif
 
 LOG_MODULE_REGISTER(communication, LOG_LEVEL_INF);
+#ifndef CONFIG_FEEDER_EVENT_LOOP
 K_THREAD_STACK_DEFINE(comm_stack_area, COMMUNICATION_STACK);
+#endif
+K_THREAD_STACK_DEFINE(comm_tx_stack_area, COMM_TX_STACK);
 
-static struct k_thread communication_thread_data;
+#if DT_HAS_CHOSEN(feeder_comm_uart) && defined(CONFIG_UART_ASYNC_API)
+#define COMM_HAS_UART 1
+static const struct device *const comm_uart = DEVICE_DT_GET(DT_CHOSEN(feeder_comm_uart));
+static uint8_t rx_dma_bufs[2][COMM_RX_DMA_BUF_SIZE];
+static uint8_t rx_next_buf;
+static volatile bool tx_done; /* the last transfer completed, false after an abort */
+#endif
+
+RING_BUF_DECLARE(comm_rx_ring, COMM_RX_RING_SIZE);
+RING_BUF_DECLARE(comm_tx_ring, COMM_TX_RING_SIZE);
+K_SEM_DEFINE(comm_tx_done_sem, 0, 1);
+
+static struct k_work_q comm_tx_work_q;
+static struct k_work comm_tx_work;
+static struct k_spinlock comm_tx_lock;
+static comm_rx_handler_t comm_rx_handler;
+static struct comm_stats stats;
+static atomic_t last_rx_ms;
 
+static health_handle_t comm_health = -1;
+static int comm_wdt = -1;
+
+#ifdef CONFIG_FEEDER_EVENT_LOOP
+enum comm_sm_state {
+    COMM_SM_LISTEN = 0,
+};
+
+static struct comm_sm {
+    struct smf_ctx ctx;
+    uint32_t events; /* EVENT_LOOP_* bits of the current run */
+    bool attached;
+} comm_sm;
+#else
+K_SEM_DEFINE(comm_rx_sem, 0, 1);
+
+static struct k_thread communication_thread_data;
 static k_tid_t comm_tid = NULL;
+#endif
+
+#ifdef COMM_HAS_UART
+static void comm_uart_cb(const struct device *dev, struct uart_event *evt, void *user_data)
+{
+    ARG_UNUSED(user_data);
+
+    uint32_t written;
+
+    switch (evt->type) {
+        case UART_RX_RDY:
+            written = ring_buf_put(&comm_rx_ring, evt->data.rx.buf + evt->data.rx.offset, evt->data.rx.len);
+            stats.rx_bytes += written;
+            stats.rx_dropped += evt->data.rx.len - written;
+            atomic_set(&last_rx_ms, (atomic_val_t)k_uptime_get_32());
+#ifdef CONFIG_FEEDER_EVENT_LOOP
+            event_loop_post(EVENT_LOOP_COMM);
+#else
+            k_sem_give(&comm_rx_sem);
+#endif
+            break;
+        case UART_RX_BUF_REQUEST:
+            uart_rx_buf_rsp(dev, rx_dma_bufs[rx_next_buf], sizeof(rx_dma_bufs[0]));
+            rx_next_buf ^= 1;
+            break;
+        case UART_RX_STOPPED:
+            stats.rx_errors++;
+            break;
+        case UART_RX_DISABLED:
+            /* Errors and breaks disable the receiver, start over with the first buffer */
+            rx_next_buf = 1;
+            uart_rx_enable(dev, rx_dma_bufs[0], sizeof(rx_dma_bufs[0]), COMM_RX_TIMEOUT_US);
+            break;
+        case UART_TX_DONE:
+            tx_done = true;
+            k_sem_give(&comm_tx_done_sem);
+            break;
+        case UART_TX_ABORTED:
+            k_sem_give(&comm_tx_done_sem);
+            break;
+        default:
+            break;
+    }
+}
+#endif
+
+/**
+ * @brief: TX work, drains the TX ring in contiguous chunks
+ */
+static void comm_tx_work_handler(struct k_work *work)
+{
+    ARG_UNUSED(work);
+
+    uint8_t *data;
+    uint32_t len;
+
+    while ((len = ring_buf_get_claim(&comm_tx_ring, &data, COMM_TX_RING_SIZE)) > 0) {
+#ifdef COMM_HAS_UART
+        k_sem_reset(&comm_tx_done_sem);
+        tx_done = false;
+        if (uart_tx(comm_uart, data, len, COMM_TX_TIMEOUT_MS * USEC_PER_MSEC) == 0 &&
+            k_sem_take(&comm_tx_done_sem, K_MSEC(2 * COMM_TX_TIMEOUT_MS)) < 0) {
+            /* The UART may still read the chunk, it can't go back to comm_send() before the abort is reported */
+            uart_tx_abort(comm_uart);
+            if (k_sem_take(&comm_tx_done_sem, K_MSEC(COMM_TX_TIMEOUT_MS)) < 0) {
+                k_spinlock_key_t key = k_spin_lock(&comm_tx_lock);
+
+                len = ring_buf_size_get(&comm_tx_ring);
+                ring_buf_reset(&comm_tx_ring);
+                k_spin_unlock(&comm_tx_lock, key);
+                stats.tx_errors++;
+                LOG_ERR("UART TX stuck, %u bytes dropped", len);
+                return;
+            }
+        }
+        /* The UART is done with the chunk, only a completed transfer counts as sent */
+        if (tx_done) {
+            stats.tx_bytes += len;
+        } else {
+            stats.tx_errors++;
+        }
+#endif
+        ring_buf_get_finish(&comm_tx_ring, len);
+    }
+}
+
+int comm_send(const uint8_t *data, size_t len)
+{
+    k_spinlock_key_t key = k_spin_lock(&comm_tx_lock);
+
+    if (ring_buf_space_get(&comm_tx_ring) < len) {
+        k_spin_unlock(&comm_tx_lock, key);
+        return -ENOBUFS;
+    }
+
+    ring_buf_put(&comm_tx_ring, data, len);
+    k_spin_unlock(&comm_tx_lock, key);
+
+    k_work_submit_to_queue(&comm_tx_work_q, &comm_tx_work);
+    return 0;
+}
+
+void comm_set_rx_handler(comm_rx_handler_t handler)
+{
+    comm_rx_handler = handler;
+}
+
+void comm_get_stats(struct comm_stats *out)
+{
+    *out = stats;
+}
+
+bool comm_is_idle(void)
+{
+    /* The TX ring is only released once the line is done with the bytes */
+    return ring_buf_is_empty(&comm_tx_ring) && k_uptime_get_32() - (uint32_t)atomic_get(&last_rx_ms) >= COMM_IDLE_MS;
+}
 
-// TODO: should be always listenning and use work_queue when we need to transmit something
+/**
+ * @brief: Hands the received bytes to the RX handler
+ */
+static void comm_rx_dispatch(void)
+{
+    /* A partial frame left by the handler waits in the ring until more bytes arrive */
+    stats.rx_wakeups++;
+    if (comm_rx_handler != NULL) {
+        comm_rx_handler(&comm_rx_ring);
+    } else {
+        ring_buf_get(&comm_rx_ring, NULL, ring_buf_size_get(&comm_rx_ring));
+    }
+}
+
+#ifdef CONFIG_FEEDER_EVENT_LOOP
+static enum smf_state_result comm_listen_run(void *obj)
+{
+    struct comm_sm *sm = obj;
+
+    if (sm->events & EVENT_LOOP_COMM) {
+        comm_rx_dispatch();
+    }
+
+    return SMF_EVENT_HANDLED;
+}
+
+/* The link has a single state for now, the machine keeps it in step with the others of the loop */
+static const struct smf_state comm_states[] = {
+    [COMM_SM_LISTEN] = SMF_CREATE_STATE(NULL, comm_listen_run, NULL, NULL, NULL),
+};
+
+void comm_loop_run(uint32_t events)
+{
+    if (!comm_sm.attached) {
+        return;
+    }
+
+    thread_report_alive(comm_health);
+    watchdog_feed(comm_wdt);
+
+    comm_sm.events = events;
+    smf_run_state(SMF_CTX(&comm_sm));
+}
+#else
 /**
  * @brief: starts the communication thread
  */
@@ -26,20 +238,83 @@ void comm_thread(void *p1, void *p2, void *p3)
     ARG_UNUSED(p2);
     ARG_UNUSED(p3);
 
-    size_t unused_stack;
-
     LOG_INF("Comm thread started with priority: %d", COMMUNICATION_PRIORITY);
 
     while (1) {
-        k_thread_stack_space_get(&communication_thread_data, &unused_stack);
-        thread_report_alive(THREAD_COMMUNICATION);
-        LOG_INF("Communication loop. Unused stack: %d bytes", unused_stack);
-        k_sleep(K_MSEC(100));
+        thread_report_alive(comm_health);
+        watchdog_feed(comm_wdt);
+
+        if (k_sem_take(&comm_rx_sem, K_MSEC(COMM_HEARTBEAT_MS)) < 0) {
+            continue;
+        }
+
+        comm_rx_dispatch();
+    }
+}
+#endif
+
+/**
+ * @brief: Brings up the TX work queue and the async UART receiver
+ */
+static void comm_init(void)
+{
+    static bool initialized;
+
+    if (initialized) {
+        return;
+    }
+    initialized = true;
+
+    k_work_queue_init(&comm_tx_work_q);
+    k_work_queue_start(&comm_tx_work_q,
+                       comm_tx_stack_area,
+                       K_THREAD_STACK_SIZEOF(comm_tx_stack_area),
+                       COMM_TX_PRIORITY,
+                       NULL);
+    k_thread_name_set(&comm_tx_work_q.thread, "comm_tx");
+    k_work_init(&comm_tx_work, comm_tx_work_handler);
+
+#ifdef COMM_HAS_UART
+    int ret;
+
+    if (!device_is_ready(comm_uart)) {
+        LOG_ERR("Comm UART not ready");
+        return;
+    }
+
+    ret = uart_callback_set(comm_uart, comm_uart_cb, NULL);
+    if (ret == 0) {
+        rx_next_buf = 1;
+        ret = uart_rx_enable(comm_uart, rx_dma_bufs[0], sizeof(rx_dma_bufs[0]), COMM_RX_TIMEOUT_US);
+    }
+    if (ret < 0) {
+        LOG_ERR("Failed to start async RX: %d", ret);
     }
+#else
+    LOG_WRN("No comm UART, only the heartbeat will run");
+#endif
 }
 
 void start_comm_thread(void)
 {
+    if (comm_health < 0) {
+        comm_health = health_register("communication", COMM_HEALTH_TIMEOUT_MS);
+    }
+    if (comm_wdt < 0) {
+        comm_wdt = watchdog_add_channel("communication", COMM_WDT_PERIOD_MS);
+    }
+
+    comm_init();
+
+#ifdef CONFIG_FEEDER_EVENT_LOOP
+    /* No thread of its own, the event loop runs the state machine */
+    event_loop_start();
+    smf_set_initial(SMF_CTX(&comm_sm), &comm_states[COMM_SM_LISTEN]);
+    comm_sm.attached = true;
+    health_stack_watch(comm_health, event_loop_thread());
+
+    LOG_INF("Communication attached to the event loop");
+#else
     comm_tid = k_thread_create(&communication_thread_data,
                                comm_stack_area,
                                K_THREAD_STACK_SIZEOF(comm_stack_area),
@@ -50,18 +325,25 @@ void start_comm_thread(void)
                                COMMUNICATION_PRIORITY,
                                0,
                                K_NO_WAIT);
+    k_thread_name_set(comm_tid, "communication");
+    health_stack_watch(comm_health, comm_tid);
 
     LOG_INF("Communication thread started (tid=%p)", (void *)comm_tid);
+#endif
 }
 
 #ifdef SMART_FEEDER_UNIT_TEST
 void stop_comm_thread(void)
 {
+#ifdef CONFIG_FEEDER_EVENT_LOOP
+    comm_sm.attached = false;
+#else
     if (comm_tid != NULL) {
         LOG_INF("Stopping communication thread");
         k_thread_abort(comm_tid);
         comm_tid = NULL;
     }
+#endif
 }
 
 #endif /* ifdef MACRO */
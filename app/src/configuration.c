@@ -3,6 +3,13 @@
  * @brief: NVS related things.
  *
  * Here we have all the things related to the configuration that we want on the non-volatile storage
+ *
+ * The config is described by a schema table: every field (or chunk of a big field) has its own NVS entry, prefixed
+ * with the field version. A shadow copy of what's in flash tells which entries changed, so a commit only writes those.
+ *
+ * The settings read by the motor and comm threads are published in a double buffer guarded by a sequence counter:
+ * the writer fills the buffer readers aren't using and then bumps the counter. A reader only retries if a publish
+ * completed while it was copying, it never waits on a writer, even when it preempts one.
  */
 #include <zephyr/fs/nvs.h>
 #include <zephyr/kernel.h>
@@ -10,20 +17,66 @@
 #include <zephyr/drivers/flash.h>
 #include <zephyr/storage/flash_map.h>
 #include <zephyr/logging/log.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/barrier.h>
+#include <string.h>
 #include "configuration.h"
+#include "motor_control.h"
 
 LOG_MODULE_REGISTER(configuration, LOG_LEVEL_INF);
 // TODO: add description to the file
 
+#define CFG_FIELD(_name, _id, _member, _chunk, _version, _dflt, _migrate)                                             \
+    {                                                                                                                  \
+        .name = (_name), .id = (_id), .version = (_version), .offset = offsetof(struct config, _member),             \
+        .size = sizeof(((struct config *)0)->_member), .chunk = (_chunk), .dflt = (_dflt), .migrate = (_migrate),   \
+    }
+
+#define CFG_MAX_CHUNK (CFG_SCHEDULE_CHUNK * sizeof(struct schedule_slot))
+
+BUILD_ASSERT(SCHEDULE_MAX_SLOTS % CFG_SCHEDULE_CHUNK == 0, "schedule must split in whole chunks");
+
 struct config cfg;
 struct nvs_fs fs;
+K_MUTEX_DEFINE(config_lock);
 
-int init_nvs(void)
+static const int dflt_random_value;
+static const uint32_t dflt_max_speed = MOTOR_DFLT_SPEED_SPS;
+static const uint32_t dflt_accel = MOTOR_DFLT_ACCEL;
+
+static const struct config_field schema[] = {
+    CFG_FIELD("random_value", CFG_NVS_ID_RANDOM_VALUE, random_value, sizeof(int), 1, &dflt_random_value, NULL),
+    CFG_FIELD("max_speed", CFG_NVS_ID_MAX_SPEED, max_speed_sps, sizeof(uint32_t), 1, &dflt_max_speed, NULL),
+    CFG_FIELD("accel", CFG_NVS_ID_ACCEL, accel, sizeof(uint32_t), 1, &dflt_accel, NULL),
+    CFG_FIELD("schedule", CFG_NVS_ID_SCHEDULE, schedule, CFG_MAX_CHUNK, 1, NULL, NULL),
+};
+
+/* What the NVS holds, compared against cfg to find the dirty entries */
+static struct config stored;
+static size_t last_commit_bytes;
+static uint8_t entry_buf[1 + CFG_MAX_CHUNK];
+
+/* Readers use hot[seq & 1], the writer fills the other one */
+static struct config_hot hot[2] = {
+    {.max_speed_sps = MOTOR_DFLT_SPEED_SPS, .accel = MOTOR_DFLT_ACCEL},
+    {.max_speed_sps = MOTOR_DFLT_SPEED_SPS, .accel = MOTOR_DFLT_ACCEL},
+};
+static atomic_t hot_seq;
+K_MUTEX_DEFINE(publish_lock);
+
+#ifdef SMART_FEEDER_UNIT_TEST
+static void (*publish_hook)(void);
+#endif
+
+/**
+ * @brief: Mounts the NVS on the storage partition of a flash device
+ */
+static int nvs_setup(const struct device *dev, uint16_t sector_count)
 {
     struct flash_pages_info info;
     int ret;
 
-    fs.flash_device = FIXED_PARTITION_DEVICE(storage_partition);
+    fs.flash_device = dev;
     if (!device_is_ready(fs.flash_device)) {
         LOG_ERR("Flash device not ready\n");
         return -ENODEV;
@@ -38,7 +91,7 @@ int init_nvs(void)
     }
 
     fs.sector_size = info.size;
-    fs.sector_count = 3;
+    fs.sector_count = sector_count;
     ret = nvs_mount(&fs);
     if (ret) {
         LOG_ERR("NVS mount failed: %d\n", ret);
@@ -49,35 +102,307 @@ int init_nvs(void)
     return 0;
 }
 
-int save_config(void)
+int init_nvs(void)
+{
+    return nvs_setup(FIXED_PARTITION_DEVICE(storage_partition), CFG_NVS_SECTORS);
+}
+
+size_t config_nvs_free(void)
+{
+    if (!fs.ready) {
+        return 0;
+    }
+
+    /* Data grows up from the start of the sector, allocation entries down from its end */
+    return fs.ate_wra - fs.data_wra;
+}
+
+/**
+ * @brief: NVS room the next commit needs: the chunks changed since the last one, at least the largest entry
+ *
+ * Read without the shell in sync, it's only an estimate. Sizing for a commit of every entry instead would leave every
+ * sector half empty and double the erases.
+ */
+static size_t next_commit_size(void)
+{
+    const uint8_t *cur = (const uint8_t *)&cfg;
+    const uint8_t *old = (const uint8_t *)&stored;
+    size_t block = MAX(fs.flash_parameters->write_block_size, 1U);
+    size_t ate = ROUND_UP(CFG_NVS_ATE_SIZE, block);
+    size_t largest = 0;
+    size_t dirty = 0;
+
+    for (size_t f = 0; f < ARRAY_SIZE(schema); f++) {
+        size_t entry = ROUND_UP(schema[f].chunk + 1U, block) + ate;
+
+        largest = MAX(largest, entry);
+        for (size_t off = 0; off < schema[f].size; off += schema[f].chunk) {
+            size_t pos = schema[f].offset + off;
+
+            if (memcmp(&cur[pos], &old[pos], schema[f].chunk) != 0) {
+                dirty += entry;
+            }
+        }
+    }
+
+    /* The NVS always keeps room for one delete */
+    return ate + MAX(dirty, largest);
+}
+
+int config_nvs_gc_if_low(void)
 {
     int ret;
 
-    ret = nvs_write(&fs, CONFIG_ID, &cfg, sizeof(cfg));
+    if (!fs.ready) {
+        return -ENODEV;
+    }
+
+    if (config_nvs_free() >= next_commit_size()) {
+        return 0;
+    }
+
+    ret = nvs_sector_use_next(&fs);
     if (ret < 0) {
-        LOG_ERR("Failed to write config: %d\n", ret);
+        LOG_ERR("NVS garbage collection failed: %d", ret);
         return ret;
     }
 
-    LOG_INF("Saved %d bytes\n", ret);
+    LOG_INF("NVS garbage collection done ahead of time, %zu bytes free", config_nvs_free());
+    return 1;
+}
+
+/**
+ * @brief: Applies the default of one chunk of a field
+ */
+static void chunk_set_dflt(const struct config_field *field, size_t chunk_off)
+{
+    uint8_t *dst = (uint8_t *)&cfg + field->offset + chunk_off;
+
+    if (field->dflt != NULL) {
+        memcpy(dst, (const uint8_t *)field->dflt + chunk_off, field->chunk);
+    } else {
+        memset(dst, 0, field->chunk);
+    }
+}
+
+/**
+ * @brief: Reads one chunk of a field, older versions are migrated and newer or unreadable ones get the default
+ * @return: 1 if the chunk was up to date, 0 if it needs to be written again, -ENOENT if it's not stored
+ */
+static int chunk_load(const struct config_field *field, size_t chunk_off, uint16_t id)
+{
+    uint8_t *dst = (uint8_t *)&cfg + field->offset + chunk_off;
+    int len = nvs_read(&fs, id, entry_buf, field->chunk + 1);
+
+    if (len <= 0) {
+        chunk_set_dflt(field, chunk_off);
+        return -ENOENT;
+    }
+
+    if (entry_buf[0] == field->version && (size_t)len == field->chunk + 1U) {
+        memcpy(dst, &entry_buf[1], field->chunk);
+        return 1;
+    }
+
+    if (field->migrate == NULL || entry_buf[0] > field->version ||
+        field->migrate(dst, &entry_buf[1], MIN((size_t)len, field->chunk + 1) - 1, entry_buf[0]) < 0) {
+        LOG_WRN("%s v%u can't be migrated, using the default", field->name, entry_buf[0]);
+        chunk_set_dflt(field, chunk_off);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief: Reads the whole struct written by firmware older than the schema table
+ * @return: 0 if it was found
+ */
+static int load_legacy(void)
+{
+    /* Older layouts are a prefix of the current one, the fields past the stored length keep their default */
+    int len = nvs_read(&fs, CFG_NVS_ID_LEGACY, &cfg, sizeof(cfg));
+
+    if (len <= 0) {
+        return -ENOENT;
+    }
+
+    LOG_INF("Migrating %d bytes of legacy config", len);
+    return 0;
+}
+
+int save_config(void)
+{
+    const uint8_t *cur = (const uint8_t *)&cfg;
+    uint8_t *old = (uint8_t *)&stored;
+    size_t written = 0;
+    int ret;
+
+    for (size_t f = 0; f < ARRAY_SIZE(schema); f++) {
+        const struct config_field *field = &schema[f];
+
+        for (size_t off = 0; off < field->size; off += field->chunk) {
+            size_t pos = field->offset + off;
+
+            /* A snapshot of the chunk, the schedule may be editing it */
+            k_mutex_lock(&config_lock, K_FOREVER);
+            memcpy(&entry_buf[1], &cur[pos], field->chunk);
+            k_mutex_unlock(&config_lock);
+            if (memcmp(&entry_buf[1], &old[pos], field->chunk) == 0) {
+                continue;
+            }
+
+            entry_buf[0] = field->version;
+            ret = nvs_write(&fs, field->id + off / field->chunk, entry_buf, field->chunk + 1);
+            if (ret < 0) {
+                LOG_ERR("Failed to write %s: %d\n", field->name, ret);
+                last_commit_bytes = written;
+                return ret;
+            }
+
+            /* What was written, not cfg: a shell change since then must stay dirty */
+            memcpy(&old[pos], &entry_buf[1], field->chunk);
+            written += field->chunk + 1;
+        }
+    }
+
+    last_commit_bytes = written;
+    LOG_INF("Saved %zu bytes\n", written);
     return 0;
 }
 
 int load_config(void)
 {
+    bool found = false;
+    bool rewrite = false;
     int ret;
 
-    ret = nvs_read(&fs, CONFIG_ID, &cfg, sizeof(cfg));
-    if (ret < 0) {
-        LOG_ERR("Failed to read config: %d\n", ret);
-        return ret;
+    for (size_t f = 0; f < ARRAY_SIZE(schema); f++) {
+        const struct config_field *field = &schema[f];
+
+        for (size_t off = 0; off < field->size; off += field->chunk) {
+            size_t pos = field->offset + off;
+
+            ret = chunk_load(field, off, field->id + off / field->chunk);
+            found |= (ret >= 0);
+            /* Migrated chunks are left dirty so the next save writes them in the current format */
+            if (ret != 0) {
+                memcpy((uint8_t *)&stored + pos, (uint8_t *)&cfg + pos, field->chunk);
+            } else {
+                memset((uint8_t *)&stored + pos, 0, field->chunk);
+                ((uint8_t *)&stored)[pos] = ~((uint8_t *)&cfg)[pos];
+                rewrite = true;
+            }
+        }
     }
 
-    LOG_INF("Loaded %d bytes\n", ret);
+    if (!found) {
+        if (load_legacy() < 0) {
+            LOG_ERR("Failed to read config: %d\n", -ENOENT);
+            return -ENOENT;
+        }
+        /* Every entry is written before the old blob is dropped */
+        for (size_t i = 0; i < sizeof(stored); i++) {
+            ((uint8_t *)&stored)[i] = ~((uint8_t *)&cfg)[i];
+        }
+        rewrite = true;
+    }
+
+    config_publish();
+
+    if (rewrite) {
+        ret = save_config();
+        if (ret < 0) {
+            return ret;
+        }
+    }
+
+    if (!found) {
+        nvs_delete(&fs, CFG_NVS_ID_LEGACY);
+    }
+
+    LOG_INF("Config loaded\n");
     return 0;
 }
 
 void set_dflt_cfg(void)
 {
-    cfg.random_value = 0;
+    for (size_t f = 0; f < ARRAY_SIZE(schema); f++) {
+        for (size_t off = 0; off < schema[f].size; off += schema[f].chunk) {
+            chunk_set_dflt(&schema[f], off);
+        }
+    }
+
+    config_publish();
+}
+
+bool config_is_dirty(void)
+{
+    return memcmp(&cfg, &stored, sizeof(cfg)) != 0;
+}
+
+size_t config_last_commit_bytes(void)
+{
+    return last_commit_bytes;
+}
+
+void config_publish(void)
+{
+    struct config_hot *next;
+    atomic_val_t seq;
+
+    k_mutex_lock(&publish_lock, K_FOREVER);
+
+    seq = atomic_get(&hot_seq);
+    next = &hot[(seq + 1) & 1];
+    next->random_value = cfg.random_value;
+#ifdef SMART_FEEDER_UNIT_TEST
+    if (publish_hook != NULL) {
+        publish_hook();
+    }
+#endif
+    next->max_speed_sps = cfg.max_speed_sps;
+    next->accel = cfg.accel;
+
+    /* The buffer has to be complete before readers are sent to it */
+    barrier_dmem_fence_full();
+    atomic_set(&hot_seq, seq + 1);
+
+    k_mutex_unlock(&publish_lock);
+}
+
+uint32_t config_hot_get(struct config_hot *out)
+{
+    atomic_val_t seq;
+
+    do {
+        seq = atomic_get(&hot_seq);
+        barrier_dmem_fence_full();
+        *out = hot[seq & 1];
+        barrier_dmem_fence_full();
+        /* A publish completed meanwhile, the next one may already be overwriting this buffer */
+    } while (atomic_get(&hot_seq) != seq);
+
+    return (uint32_t)seq;
+}
+
+uint32_t config_hot_version(void)
+{
+    return (uint32_t)atomic_get(&hot_seq);
+}
+
+#ifdef SMART_FEEDER_UNIT_TEST
+void config_set_publish_hook(void (*hook)(void))
+{
+    publish_hook = hook;
+}
+
+int config_nvs_remount(const struct device *dev, uint16_t sector_count)
+{
+    /* Nothing is known to be stored, the next save writes every entry */
+    for (size_t i = 0; i < sizeof(stored); i++) {
+        ((uint8_t *)&stored)[i] = ~((uint8_t *)&cfg)[i];
+    }
+
+    return nvs_setup(dev, sector_count);
 }
+#endif
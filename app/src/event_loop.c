@@ -0,0 +1,98 @@
+/**
+ * @file: event_loop.c
+ * @brief: Single thread driving the motor, comm and health state machines.
+ *
+ * Low RAM profile, built with CONFIG_FEEDER_EVENT_LOOP. Instead of three threads that each own a stack and spend most
+ * of their time asleep, one thread waits on a k_event and runs the SMF state machine of every subsystem in turn. The
+ * step ISR, the UART callbacks and the health deadline timers stay asynchronous, they only post their event bit.
+ *
+ * Without events the loop still wakes up once per heartbeat so every machine reports alive and feeds its watchdog
+ * channel. The machines never block: a long run delays the others, slow work belongs on a work queue (the UART TX and
+ * the config commits already are).
+ */
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include "event_loop.h"
+#include "motor_control.h"
+#include "communication.h"
+#include "check_health.h"
+
+LOG_MODULE_REGISTER(event_loop, LOG_LEVEL_INF);
+K_THREAD_STACK_DEFINE(event_loop_stack_area, EVENT_LOOP_STACK);
+K_EVENT_DEFINE(loop_events);
+
+BUILD_ASSERT(EVENT_LOOP_HEARTBEAT_MS <= MOTOR_IDLE_REPORT_MS && EVENT_LOOP_HEARTBEAT_MS <= COMM_HEARTBEAT_MS,
+             "the loop must run the machines as often as their threads would");
+
+static struct k_thread event_loop_thread_data;
+static k_tid_t loop_tid = NULL;
+
+void event_loop_post(uint32_t events)
+{
+    k_event_post(&loop_events, events);
+}
+
+/**
+ * @brief: Thread that runs every state machine each time something happens
+ */
+void event_loop_thread_fn(void *p1, void *p2, void *p3)
+{
+    ARG_UNUSED(p1);
+    ARG_UNUSED(p2);
+    ARG_UNUSED(p3);
+
+    uint32_t wait_ms = EVENT_LOOP_HEARTBEAT_MS;
+    uint32_t events;
+
+    LOG_INF("Event loop started at priority: %d", EVENT_LOOP_PRIORITY);
+
+    while (1) {
+        /* 0 on a heartbeat */
+        events = k_event_wait(&loop_events, EVENT_LOOP_ALL, false, K_MSEC(wait_ms));
+
+        /* Cleared before the machines run, whatever is posted while they do wakes the loop up again */
+        k_event_clear(&loop_events, events);
+
+        motor_loop_run(events);
+        comm_loop_run(events);
+        wait_ms = MIN(health_loop_run(events), EVENT_LOOP_HEARTBEAT_MS);
+    }
+}
+
+void event_loop_start(void)
+{
+    if (loop_tid != NULL) {
+        return;
+    }
+
+    loop_tid = k_thread_create(&event_loop_thread_data,
+                               event_loop_stack_area,
+                               K_THREAD_STACK_SIZEOF(event_loop_stack_area),
+                               event_loop_thread_fn,
+                               NULL,
+                               NULL,
+                               NULL,
+                               EVENT_LOOP_PRIORITY,
+                               0,
+                               K_NO_WAIT);
+    k_thread_name_set(loop_tid, "event_loop");
+
+    LOG_INF("Event loop thread started (tid=%p)", (void *)loop_tid);
+}
+
+const struct k_thread *event_loop_thread(void)
+{
+    return loop_tid;
+}
+
+#ifdef SMART_FEEDER_UNIT_TEST
+void stop_event_loop(void)
+{
+    if (loop_tid != NULL) {
+        LOG_INF("Stopping event loop thread");
+        k_thread_abort(loop_tid);
+        loop_tid = NULL;
+        k_event_clear(&loop_events, EVENT_LOOP_ALL);
+    }
+}
+#endif
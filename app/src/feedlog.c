@@ -0,0 +1,442 @@
+/**
+ * @file: feedlog.c
+ * @brief: Append-only log of every dispense.
+ *
+ * The log lives on its own flash partition, used as a ring of sectors. Each sector starts with a header holding a
+ * sequence number, followed by fixed size records protected by a CRC. Records are only ever appended, when the last
+ * sector is full the oldest one is erased and reused, so the flash wears evenly and nothing is rewritten in place.
+ *
+ * A small index in RAM keeps the sequence, record count and time span of every sector. It's rebuilt by scanning the
+ * partition at boot, and lets range queries skip every sector that can't hold a matching record.
+ *
+ * The motor thread only copies its record to a message queue, the flash writes are done by the storage work queue.
+ */
+#include <zephyr/kernel.h>
+#include <zephyr/drivers/flash.h>
+#include <zephyr/storage/flash_map.h>
+#include <zephyr/sys/crc.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/logging/log.h>
+#include <string.h>
+#include "feedlog.h"
+#include "schedule.h"
+#include "storage.h"
+
+LOG_MODULE_REGISTER(feedlog, LOG_LEVEL_INF);
+
+#define FEEDLOG_HDR_SIZE    16
+#define FEEDLOG_REC_SIZE    16
+#define FEEDLOG_READ_CHUNK  16 /* records read from flash at once */
+#define FEEDLOG_VISIT_CHUNK 4  /* entries copied out per lock hold, on the caller's stack */
+#define FEEDLOG_REC_WRITTEN 0x00
+#define FEEDLOG_REC_ERASED  0xFF
+
+struct feedlog_header {
+    uint32_t magic;
+    uint32_t seq;
+    uint8_t reserved[8];
+} __packed;
+
+struct feedlog_record {
+    uint32_t time;
+    uint32_t steps;
+    uint16_t grams;
+    uint16_t duration_ms;
+    int8_t result;
+    uint8_t flags; /* still 0xFF in an erased slot */
+    uint16_t crc;
+} __packed;
+
+BUILD_ASSERT(sizeof(struct feedlog_header) == FEEDLOG_HDR_SIZE, "header layout changed");
+BUILD_ASSERT(sizeof(struct feedlog_record) == FEEDLOG_REC_SIZE, "record layout changed");
+
+/* A record copied out by a query, with its place in the log */
+struct query_hit {
+    struct feedlog_entry entry;
+    struct feedlog_cursor at;
+};
+
+struct sector_index {
+    bool valid;
+    uint32_t seq;
+    uint32_t count;
+    uint32_t min_time;
+    uint32_t max_time;
+};
+
+static void feedlog_work_handler(struct k_work *work);
+
+K_MUTEX_DEFINE(feedlog_lock);
+K_MSGQ_DEFINE(feedlog_q, sizeof(struct feedlog_entry), FEEDLOG_QUEUE_LEN, 4);
+K_WORK_DEFINE(feedlog_work, feedlog_work_handler);
+
+static const struct flash_area *fa;
+static struct sector_index sectors[FEEDLOG_MAX_SECTORS];
+static uint32_t sector_size;
+static uint32_t sector_count;
+static uint32_t recs_per_sector;
+static uint32_t head; /* sector being filled */
+static bool ready;
+static bool unusable; /* init failed, nothing will ever drain the queue */
+
+static struct feedlog_stats stats;
+static atomic_t dropped;
+static struct feedlog_record rec_buf[FEEDLOG_READ_CHUNK];
+
+static off_t record_offset(uint32_t sector, uint32_t rec)
+{
+    return (off_t)sector * sector_size + FEEDLOG_HDR_SIZE + (off_t)rec * FEEDLOG_REC_SIZE;
+}
+
+static uint16_t record_crc(const struct feedlog_record *rec)
+{
+    return crc16_itu_t(0xFFFF, (const uint8_t *)rec, offsetof(struct feedlog_record, crc));
+}
+
+static void index_add(struct sector_index *idx, uint32_t time)
+{
+    idx->min_time = MIN(idx->min_time, time);
+    idx->max_time = MAX(idx->max_time, time);
+}
+
+/**
+ * @brief: Rebuilds the index entry of one sector from its contents
+ */
+static void sector_scan(uint32_t s)
+{
+    struct sector_index *idx = &sectors[s];
+    struct feedlog_header hdr;
+    uint32_t n;
+
+    memset(idx, 0, sizeof(*idx));
+    idx->min_time = UINT32_MAX;
+
+    if (flash_area_read(fa, (off_t)s * sector_size, &hdr, sizeof(hdr)) < 0 || hdr.magic != FEEDLOG_MAGIC) {
+        return;
+    }
+    idx->valid = true;
+    idx->seq = hdr.seq;
+
+    for (uint32_t first = 0; first < recs_per_sector; first += n) {
+        n = MIN(FEEDLOG_READ_CHUNK, recs_per_sector - first);
+        if (flash_area_read(fa, record_offset(s, first), rec_buf, n * FEEDLOG_REC_SIZE) < 0) {
+            return;
+        }
+        for (uint32_t i = 0; i < n; i++) {
+            if (rec_buf[i].flags == FEEDLOG_REC_ERASED) {
+                return;
+            }
+            /* A torn record still takes its slot, it's just never reported */
+            idx->count++;
+            if (rec_buf[i].crc == record_crc(&rec_buf[i])) {
+                index_add(idx, rec_buf[i].time);
+            }
+        }
+    }
+}
+
+/**
+ * @brief: Erases a sector and opens it for appends
+ */
+static int sector_start(uint32_t s, uint32_t seq)
+{
+    struct feedlog_header hdr = {.magic = FEEDLOG_MAGIC, .seq = seq};
+    int ret;
+
+    memset(hdr.reserved, 0xFF, sizeof(hdr.reserved));
+    sectors[s] = (struct sector_index){.min_time = UINT32_MAX};
+
+    ret = flash_area_erase(fa, (off_t)s * sector_size, sector_size);
+    ret = ret ? ret : flash_area_write(fa, (off_t)s * sector_size, &hdr, sizeof(hdr));
+    if (ret < 0) {
+        LOG_ERR("Failed to start sector %u: %d", s, ret);
+        return ret;
+    }
+
+    sectors[s].valid = true;
+    sectors[s].seq = seq;
+    return 0;
+}
+
+/**
+ * @brief: Appends a record to the head sector, must be called with the lock held
+ */
+static void record_write(const struct feedlog_entry *entry)
+{
+    struct feedlog_record rec;
+    int ret;
+
+    if (sectors[head].count >= recs_per_sector) {
+        uint32_t next = (head + 1) % sector_count;
+
+        /* The oldest sector is the next one in the ring */
+        if (sector_start(next, sectors[head].seq + 1) < 0) {
+            return;
+        }
+        head = next;
+    }
+
+    rec.time = entry->time;
+    rec.steps = entry->steps;
+    rec.grams = entry->grams;
+    rec.duration_ms = entry->duration_ms;
+    rec.result = entry->result;
+    rec.flags = FEEDLOG_REC_WRITTEN;
+    rec.crc = record_crc(&rec);
+
+    ret = flash_area_write(fa, record_offset(head, sectors[head].count), &rec, sizeof(rec));
+    sectors[head].count++;
+    if (ret < 0) {
+        LOG_ERR("Failed to write record: %d", ret);
+        return;
+    }
+
+    index_add(&sectors[head], rec.time);
+    stats.appended++;
+}
+
+static void feedlog_work_handler(struct k_work *work)
+{
+    ARG_UNUSED(work);
+
+    struct feedlog_entry entry;
+
+    /* Entries logged before the mount wait in the queue, feedlog_init() drains them */
+    if (!ready) {
+        return;
+    }
+
+    k_mutex_lock(&feedlog_lock, K_FOREVER);
+    while (k_msgq_get(&feedlog_q, &entry, K_NO_WAIT) == 0) {
+        record_write(&entry);
+    }
+    k_mutex_unlock(&feedlog_lock);
+}
+
+int feedlog_init(void)
+{
+#if FIXED_PARTITION_EXISTS(feedlog_partition)
+    struct flash_pages_info info;
+    uint32_t newest = 0;
+    int ret;
+
+    ret = flash_area_open(FIXED_PARTITION_ID(feedlog_partition), &fa);
+    if (ret < 0) {
+        LOG_ERR("Unable to open the feed log partition: %d", ret);
+        return ret;
+    }
+
+    ret = flash_get_page_info_by_offs(flash_area_get_device(fa), fa->fa_off, &info);
+    if (ret < 0) {
+        LOG_ERR("Unable to get page info: %d", ret);
+        return ret;
+    }
+
+    k_mutex_lock(&feedlog_lock, K_FOREVER);
+
+    sector_size = info.size;
+    sector_count = MIN(fa->fa_size / sector_size, FEEDLOG_MAX_SECTORS);
+    recs_per_sector = (sector_size - FEEDLOG_HDR_SIZE) / FEEDLOG_REC_SIZE;
+    head = 0;
+
+    for (uint32_t s = 0; s < sector_count; s++) {
+        sector_scan(s);
+        if (sectors[s].valid && sectors[s].seq >= newest) {
+            newest = sectors[s].seq;
+            head = s;
+        }
+    }
+
+    ret = (newest == 0) ? sector_start(0, 1) : 0;
+    ready = (ret == 0 && sector_count >= 2);
+    unusable = !ready;
+
+    stats.sectors_total = sector_count;
+    stats.capacity = sector_count * recs_per_sector;
+    k_mutex_unlock(&feedlog_lock);
+
+    if (!ready) {
+        LOG_ERR("Feed log unusable: %u sectors, %d", sector_count, ret);
+        k_msgq_purge(&feedlog_q);
+        return (ret < 0) ? ret : -ENOSPC;
+    }
+
+    LOG_INF("Feed log: %u sectors of %u records, head %u with %u records", sector_count, recs_per_sector, head,
+            sectors[head].count);
+    if (k_msgq_num_used_get(&feedlog_q) > 0) {
+        storage_submit(&feedlog_work);
+    }
+    return 0;
+#else
+    LOG_WRN("No feedlog partition, dispenses won't be logged");
+    unusable = true;
+    k_msgq_purge(&feedlog_q);
+    return -ENODEV;
+#endif
+}
+
+int feedlog_append(const struct feedlog_entry *entry)
+{
+    struct feedlog_entry rec = *entry;
+
+    if (unusable) {
+        return -ENODEV;
+    }
+
+    rec.time = schedule_now();
+    if (k_msgq_put(&feedlog_q, &rec, K_NO_WAIT) < 0) {
+        atomic_inc(&dropped);
+        return -ENOBUFS;
+    }
+
+    /* Already queued is fine, the handler drains everything. Not mounted yet: feedlog_init() submits it */
+    if (ready) {
+        storage_submit(&feedlog_work);
+    }
+    return 0;
+}
+
+void feedlog_flush(void)
+{
+    struct k_work_sync sync;
+
+    k_work_flush(&feedlog_work, &sync);
+    if (k_msgq_num_used_get(&feedlog_q) > 0) {
+        /* Storage queue not running yet */
+        feedlog_work_handler(&feedlog_work);
+    }
+}
+
+/**
+ * @brief: Copies the next matching records from the cursor on, must be called with the lock held
+ *
+ * The cursor names a sector by its sequence, not its slot: if the sector was recycled since the last chunk, the
+ * query resumes at the oldest sector still there.
+ *
+ * @return: number of records copied, less than FEEDLOG_VISIT_CHUNK once the whole range was read
+ */
+static size_t query_fill(struct feedlog_cursor *cur, uint32_t from, uint32_t to, struct query_hit *out)
+{
+    size_t found = 0;
+    uint32_t n;
+
+    /* Oldest sector first, it's the one right after the head */
+    for (uint32_t k = 1; k <= sector_count; k++) {
+        uint32_t s = (head + k) % sector_count;
+        const struct sector_index *idx = &sectors[s];
+
+        if (!idx->valid || idx->seq < cur->seq) {
+            continue;
+        }
+        if (idx->seq > cur->seq) {
+            cur->seq = idx->seq;
+            cur->rec = 0;
+        }
+        if (idx->count == 0 || idx->max_time < from || idx->min_time > to) {
+            cur->seq++;
+            cur->rec = 0;
+            continue;
+        }
+        if (cur->rec == 0) {
+            stats.sectors_read++;
+        }
+
+        for (; cur->rec < idx->count; cur->rec += n) {
+            n = MIN(FEEDLOG_READ_CHUNK, MIN(idx->count - cur->rec, FEEDLOG_VISIT_CHUNK - found));
+            if (flash_area_read(fa, record_offset(s, cur->rec), rec_buf, n * FEEDLOG_REC_SIZE) < 0) {
+                break;
+            }
+            for (uint32_t i = 0; i < n; i++) {
+                const struct feedlog_record *rec = &rec_buf[i];
+
+                if (rec->crc != record_crc(rec) || rec->time < from || rec->time > to) {
+                    continue;
+                }
+                out[found].entry.time = rec->time;
+                out[found].entry.steps = rec->steps;
+                out[found].entry.grams = rec->grams;
+                out[found].entry.duration_ms = rec->duration_ms;
+                out[found].entry.result = rec->result;
+                out[found].at.seq = cur->seq;
+                out[found].at.rec = cur->rec + i;
+                found++;
+            }
+            if (found == FEEDLOG_VISIT_CHUNK) {
+                cur->rec += n;
+                return found;
+            }
+        }
+        cur->seq++;
+        cur->rec = 0;
+    }
+
+    return found;
+}
+
+int feedlog_query_at(struct feedlog_cursor *cursor, uint32_t from, uint32_t to, feedlog_visit_cb_t cb,
+                     void *user_data)
+{
+    struct query_hit chunk[FEEDLOG_VISIT_CHUNK];
+    int visited = 0;
+    size_t n;
+
+    if (!ready) {
+        return -ENODEV;
+    }
+
+    do {
+        struct feedlog_cursor next = *cursor;
+
+        k_mutex_lock(&feedlog_lock, K_FOREVER);
+        n = query_fill(&next, from, to, chunk);
+        k_mutex_unlock(&feedlog_lock);
+
+        /* Outside the lock: the callback may block on a UART, the appends must not wait for it */
+        for (size_t i = 0; i < n; i++) {
+            if (cb(&chunk[i].entry, user_data) != 0) {
+                /* Not consumed, the next page starts with it */
+                *cursor = chunk[i].at;
+                return visited;
+            }
+            visited++;
+        }
+        *cursor = next;
+    } while (n == FEEDLOG_VISIT_CHUNK);
+
+    return visited;
+}
+
+int feedlog_query(uint32_t from, uint32_t to, feedlog_visit_cb_t cb, void *user_data)
+{
+    struct feedlog_cursor cursor = {0};
+
+    return feedlog_query_at(&cursor, from, to, cb, user_data);
+}
+
+void feedlog_entry_pack(const struct feedlog_entry *entry, uint8_t *out)
+{
+    sys_put_le32(entry->time, &out[0]);
+    sys_put_le32(entry->steps, &out[4]);
+    sys_put_le16(entry->grams, &out[8]);
+    sys_put_le16(entry->duration_ms, &out[10]);
+    out[12] = (uint8_t)entry->result;
+}
+
+#ifdef SMART_FEEDER_UNIT_TEST
+void feedlog_unmount(void)
+{
+    k_mutex_lock(&feedlog_lock, K_FOREVER);
+    ready = false;
+    unusable = false;
+    k_mutex_unlock(&feedlog_lock);
+}
+#endif
+
+void feedlog_get_stats(struct feedlog_stats *out)
+{
+    k_mutex_lock(&feedlog_lock, K_FOREVER);
+    *out = stats;
+    k_mutex_unlock(&feedlog_lock);
+
+    out->dropped = (uint32_t)atomic_get(&dropped);
+}
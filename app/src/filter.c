@@ -0,0 +1,88 @@
+/**
+ * @file: filter.c
+ * @brief: Fixed point filters for the sensor readings.
+ *
+ * Everything is done on integers: soft float on the ESP32-C6 costs tens of cycles per operation and the readings are
+ * small numbers of mV or tenths of a degree, so a few fractional bits in the IIR state are all the precision needed.
+ */
+#include <string.h>
+#include <zephyr/sys/util.h>
+#include "filter.h"
+
+int32_t filter_mean(const int16_t *samples, uint32_t count, uint32_t stride)
+{
+    int32_t sum = 0;
+
+    if (count == 0) {
+        return 0;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        sum += samples[i * stride];
+    }
+
+    /* Round half away from zero */
+    return (sum >= 0) ? (sum + (int32_t)count / 2) / (int32_t)count : (sum - (int32_t)count / 2) / (int32_t)count;
+}
+
+int32_t filter_median_push(struct filter_median *f, int32_t value)
+{
+    int32_t sorted[FILTER_MEDIAN_LEN];
+
+    f->window[f->next] = value;
+    f->next = (f->next + 1) % FILTER_MEDIAN_LEN;
+    f->fill = MIN(f->fill + 1, FILTER_MEDIAN_LEN);
+
+    /* Insertion sort, five values at most */
+    for (int i = 0; i < f->fill; i++) {
+        int j = i;
+
+        while (j > 0 && sorted[j - 1] > f->window[i]) {
+            sorted[j] = sorted[j - 1];
+            j--;
+        }
+        sorted[j] = f->window[i];
+    }
+
+    return sorted[f->fill / 2];
+}
+
+void filter_median_reset(struct filter_median *f)
+{
+    memset(f, 0, sizeof(*f));
+}
+
+void filter_iir_init(struct filter_iir *f, uint8_t shift)
+{
+    f->state = 0;
+    f->shift = shift;
+    f->primed = false;
+}
+
+int32_t filter_iir_push(struct filter_iir *f, int32_t value)
+{
+    int32_t in = value * (1 << FILTER_IIR_FRAC);
+
+    /* Starting from zero would take many time constants to reach the first reading */
+    if (!f->primed) {
+        f->state = in;
+        f->primed = true;
+    } else {
+        f->state += (in - f->state) / (1 << f->shift);
+    }
+
+    return (f->state + (1 << (FILTER_IIR_FRAC - 1))) >> FILTER_IIR_FRAC;
+}
+
+bool filter_hyst_update(struct filter_hyst *h, int32_t value)
+{
+    bool low_side = h->trip < h->release;
+
+    if (!h->tripped) {
+        h->tripped = low_side ? (value < h->trip) : (value > h->trip);
+    } else {
+        h->tripped = low_side ? (value < h->release) : (value > h->release);
+    }
+
+    return h->tripped;
+}
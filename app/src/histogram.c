@@ -0,0 +1,145 @@
+/**
+ * @file: histogram.c
+ * @brief: Fixed memory latency histograms.
+ *
+ * Averages hide the rare long stalls, so the latencies that matter are kept as histograms and read as percentiles.
+ * The buckets follow the HDR layout: a power of two range is split in a few linear sub-buckets, which keeps the
+ * relative error constant from a few cycles up to seconds in 124 counters. Recording is one bucket lookup (a count
+ * leading zeros) and two atomics, so it can be done from the step ISR.
+ */
+#include <zephyr/kernel.h>
+#include <string.h>
+#include "histogram.h"
+
+static struct histogram hists[HIST_COUNT];
+
+static const char *const hist_names[HIST_COUNT] = {
+    [HIST_STEP_JITTER] = "step_jitter",
+    [HIST_PROTO_FRAME] = "proto_frame",
+    [HIST_SHELL_CMD] = "shell_cmd",
+    [HIST_HEALTH_SCAN] = "health_scan",
+};
+
+uint32_t histogram_bucket(uint32_t value)
+{
+    uint32_t msb;
+    uint32_t shift;
+
+    if (value < HIST_SUB_COUNT) {
+        return value;
+    }
+
+    msb = 31U - (uint32_t)__builtin_clz(value);
+    shift = msb - HIST_SUB_BITS;
+
+    return (shift + 1) * HIST_SUB_COUNT + ((value >> shift) & (HIST_SUB_COUNT - 1));
+}
+
+uint32_t histogram_bucket_ceil(uint32_t bucket)
+{
+    uint32_t group = bucket / HIST_SUB_COUNT;
+    uint32_t sub = bucket % HIST_SUB_COUNT;
+    uint64_t floor;
+
+    if (group == 0) {
+        return bucket;
+    }
+
+    floor = (uint64_t)(HIST_SUB_COUNT + sub) << (group - 1);
+    return (uint32_t)MIN(floor + BIT64(group - 1) - 1, UINT32_MAX);
+}
+
+void histogram_record(struct histogram *hist, uint32_t value)
+{
+    atomic_val_t old;
+
+    atomic_inc(&hist->buckets[histogram_bucket(value)]);
+
+    do {
+        old = atomic_get(&hist->max);
+        if ((uint32_t)old >= value) {
+            return;
+        }
+    } while (!atomic_cas(&hist->max, old, (atomic_val_t)value));
+}
+
+static uint32_t histogram_count(const struct histogram *hist)
+{
+    uint32_t count = 0;
+
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        count += (uint32_t)atomic_get(&hist->buckets[i]);
+    }
+    return count;
+}
+
+/**
+ * @brief: Walks the buckets up to the rank of a percentile
+ */
+static uint32_t percentile_of(const struct histogram *hist, uint32_t count, uint32_t per_mille)
+{
+    uint32_t rank = (uint32_t)DIV_ROUND_UP((uint64_t)count * per_mille, 1000U);
+    uint32_t max = (uint32_t)atomic_get(&hist->max);
+    uint32_t seen = 0;
+
+    if (count == 0) {
+        return 0;
+    }
+
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += (uint32_t)atomic_get(&hist->buckets[i]);
+        if (seen >= MAX(rank, 1U)) {
+            return MIN(histogram_bucket_ceil(i), max);
+        }
+    }
+
+    /* Values recorded while walking */
+    return max;
+}
+
+uint32_t histogram_percentile(const struct histogram *hist, uint32_t per_mille)
+{
+    return percentile_of(hist, histogram_count(hist), per_mille);
+}
+
+void histogram_summarize(const struct histogram *hist, struct histogram_summary *out)
+{
+    out->count = histogram_count(hist);
+    out->p50 = percentile_of(hist, out->count, 500);
+    out->p90 = percentile_of(hist, out->count, 900);
+    out->p99 = percentile_of(hist, out->count, 990);
+    out->p999 = percentile_of(hist, out->count, 999);
+    out->max = (uint32_t)atomic_get(&hist->max);
+}
+
+void histogram_reset(struct histogram *hist)
+{
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        atomic_clear(&hist->buckets[i]);
+    }
+    atomic_clear(&hist->max);
+}
+
+void hist_record(enum hist_id id, uint32_t cycles)
+{
+    if (id < HIST_COUNT) {
+        histogram_record(&hists[id], cycles);
+    }
+}
+
+struct histogram *hist_get(enum hist_id id)
+{
+    return (id < HIST_COUNT) ? &hists[id] : NULL;
+}
+
+const char *hist_name(enum hist_id id)
+{
+    return (id < HIST_COUNT) ? hist_names[id] : NULL;
+}
+
+void hist_reset_all(void)
+{
+    for (int i = 0; i < HIST_COUNT; i++) {
+        histogram_reset(&hists[i]);
+    }
+}
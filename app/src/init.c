@@ -3,38 +3,148 @@
  * @brief: basic initialization.
  *
  * All the needed hardware things should be initialized here, so we can run the threads correctly
+ *
+ * Mounting the NVS gets slower as its history grows, so the bring-up is split: the reset info and the watchdog are
+ * done right away, then the flash work (NVS mount, config load, feed log scan) is queued on the storage work queue
+ * while main starts the threads. Until the config is loaded the hot paths run with the default settings.
+ *
+ * Every step is timestamped with the cycle counter and the uptime, the `boot` shell command prints them.
  */
 #include <zephyr/logging/log.h>
 #include "init.h"
 #include "configuration.h"
 #include "watchdog.h"
+#include "reset_info.h"
+#include "storage.h"
+#include "feedlog.h"
 
 LOG_MODULE_REGISTER(init, LOG_LEVEL_INF);
 
+static void storage_boot_handler(struct k_work *work);
+
+K_WORK_DEFINE(storage_boot_work, storage_boot_handler);
+K_EVENT_DEFINE(boot_events);
+
+#define BOOT_EVENT_CONFIG_READY BIT(0)
+
+static struct boot_phase_info phases[BOOT_PHASE_COUNT] = {
+    [BOOT_PHASE_RESET_INFO] = {.name = "reset_info"},
+    [BOOT_PHASE_WATCHDOG] = {.name = "watchdog"},
+    [BOOT_PHASE_STORAGE] = {.name = "storage"},
+    [BOOT_PHASE_THREADS] = {.name = "threads"},
+    [BOOT_PHASE_NVS_MOUNT] = {.name = "nvs_mount"},
+    [BOOT_PHASE_CONFIG_LOAD] = {.name = "config_load"},
+    [BOOT_PHASE_FEEDLOG] = {.name = "feedlog"},
+    [BOOT_PHASE_READY] = {.name = "ready"},
+};
+
+void boot_phase_begin(enum boot_phase phase)
+{
+    if (phase < BOOT_PHASE_COUNT) {
+        phases[phase].start_cyc = k_cycle_get_32();
+        phases[phase].done = false;
+    }
+}
+
+void boot_phase_end(enum boot_phase phase, int result)
+{
+    if (phase < BOOT_PHASE_COUNT) {
+        phases[phase].end_cyc = k_cycle_get_32();
+        phases[phase].end_ms = k_uptime_get_32();
+        phases[phase].result = result;
+        phases[phase].done = true;
+    }
+}
+
+const struct boot_phase_info *boot_phase_get(enum boot_phase phase)
+{
+    return (phase < BOOT_PHASE_COUNT) ? &phases[phase] : NULL;
+}
+
+/**
+ * @brief: Flash bring-up, first item ever run by the storage queue so no commit can overtake the config load
+ */
+static void storage_boot_handler(struct k_work *work)
+{
+    ARG_UNUSED(work);
+
+    int ret;
+
+    boot_phase_begin(BOOT_PHASE_NVS_MOUNT);
+    ret = init_nvs();
+    boot_phase_end(BOOT_PHASE_NVS_MOUNT, ret);
+
+    boot_phase_begin(BOOT_PHASE_CONFIG_LOAD);
+    if (ret < 0) {
+        LOG_ERR("NVS init failed: %d, running on defaults", ret);
+        set_dflt_cfg();
+    } else {
+        ret = load_config();
+        if (ret < 0) {
+            LOG_INF("No saved config, using defaults");
+            set_dflt_cfg();
+        }
+    }
+    boot_phase_end(BOOT_PHASE_CONFIG_LOAD, ret);
+
+    boot_phase_end(BOOT_PHASE_READY, 0);
+    k_event_post(&boot_events, BOOT_EVENT_CONFIG_READY);
+
+    /* Only the feed log needs this, nobody waits for it */
+    boot_phase_begin(BOOT_PHASE_FEEDLOG);
+    boot_phase_end(BOOT_PHASE_FEEDLOG, feedlog_init());
+
+    LOG_INF("Config ready %u ms after boot", phases[BOOT_PHASE_READY].end_ms);
+}
+
 int processes_init(void)
 {
+    int wdt_ret;
     int ret;
 
     LOG_INF("Starting initialization...");
+    boot_phase_begin(BOOT_PHASE_READY);
+    k_event_clear(&boot_events, BOOT_EVENT_CONFIG_READY);
 
-    ret = init_nvs();
-    if (ret < 0) {
-        LOG_ERR("NVS init failed: %d", ret);
-        return ret;
+    boot_phase_begin(BOOT_PHASE_RESET_INFO);
+    reset_info_boot();
+    boot_phase_end(BOOT_PHASE_RESET_INFO, 0);
+
+    /* The watchdog comes first, a hung flash must not stall the boot forever */
+    boot_phase_begin(BOOT_PHASE_WATCHDOG);
+    wdt_ret = init_watchdog();
+    boot_phase_end(BOOT_PHASE_WATCHDOG, wdt_ret);
+    if (wdt_ret < 0) {
+        /* Still load the config, a feeder without watchdog beats one stuck waiting for it */
+        LOG_ERR("Failed to initialize watchdog, system unsafe");
     }
 
-    ret = load_config();
+    boot_phase_begin(BOOT_PHASE_STORAGE);
+    storage_init();
+    ret = storage_submit(&storage_boot_work);
+    boot_phase_end(BOOT_PHASE_STORAGE, ret);
     if (ret < 0) {
-        LOG_INF("No saved config, using defaults");
+        /* Nothing will load the config, whoever waits for it goes on with the defaults */
+        LOG_ERR("Failed to queue the config load: %d, using defaults", ret);
         set_dflt_cfg();
+        boot_phase_end(BOOT_PHASE_READY, ret);
+        k_event_post(&boot_events, BOOT_EVENT_CONFIG_READY);
+        return ret;
     }
 
-    ret = init_watchdog();
-    if (ret < 0) {
-        LOG_ERR("Failed to initialize watchdog, system unsafe");
-        return ret;
+    if (wdt_ret < 0) {
+        return wdt_ret;
+    }
+
+    LOG_INF("Initialization complete, config loading in the background");
+    return 0;
+}
+
+int processes_wait_ready(k_timeout_t timeout)
+{
+    if (k_event_wait(&boot_events, BOOT_EVENT_CONFIG_READY, false, timeout) == 0) {
+        return -EAGAIN;
     }
 
-    LOG_INF("Initialization complete");
     return 0;
 }
@@ -6,6 +6,10 @@
 #include "check_health.h"
 #include "watchdog.h"
 #include "communication.h"
+#include "protocol.h"
+#include "schedule.h"
+#include "sensors.h"
+#include "telemetry.h"
 
 LOG_MODULE_REGISTER(main, LOG_LEVEL_INF);
 
@@ -14,23 +18,27 @@ LOG_MODULE_REGISTER(main, LOG_LEVEL_INF);
 // TODO: We can use a FOTA to actualize the firmware.
 int main(void)
 {
-    /* INFO: start all the hardware related stuff */
-    processes_init();
+    /* INFO: start all the hardware related stuff, the flash is read in the background */
+    int ret = processes_init();
 
-    /*INFO: start all the threads of the system */
+    if (ret < 0) {
+        LOG_ERR("Degraded boot: %d, see the boot phases", ret);
+    }
+
+    /*INFO: start all the threads of the system, the motor pins go to their safe state right away */
+    boot_phase_begin(BOOT_PHASE_THREADS);
     start_motor_control_thread();
     start_check_health_thread();
+    start_sensors_thread();
+    telemetry_init();
+    protocol_init();
     start_comm_thread();
+    boot_phase_end(BOOT_PHASE_THREADS, 0);
 
-    while (1) {
-        if (is_system_healthy()) {
-            watchdog_feed();
-        } else {
-            LOG_WRN("System unhealthy");
-        }
-
-        k_sleep(K_MSEC(SUPERVISOR_CHECK_INTERVAL_MS));
-    }
+    /* INFO: the schedule lives in the config */
+    processes_wait_ready(K_FOREVER);
+    schedule_init(NULL);
 
+    /* INFO: every thread feeds its own watchdog channel, nothing left to supervise here */
     return 0;
 }
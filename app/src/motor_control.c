@@ -3,18 +3,688 @@
  * @brief: Motor control functions.
  *
  * All the functions directly related to the control of the stepper motor should be here.
+ *
+ * Steps are generated by a timer ISR (a counter channel when the board has a `stepper-timer` alias, a k_timer
+ * otherwise). Before a move starts the acceleration ramp is precomputed as a table of Q24.8 timer ticks, the ISR only
+ * picks the entry for the current step and adds it to a fixed point accumulator, so step timing never depends on the
+ * thread scheduling. Deceleration walks the same table backwards.
+ *
+ * Commands reach the motor thread through one lock-free SPSC ring per producer, the thread sleeps on a semaphore and
+ * drains them in batches.
+ *
+ * With CONFIG_FEEDER_EVENT_LOOP there is no motor thread: the rings are drained by a two state machine (idle, moving)
+ * that the event loop runs, the producers and the ISR post an event instead of giving the semaphore.
  */
 #include <zephyr/kernel.h>
+#include <zephyr/device.h>
+#include <zephyr/drivers/gpio.h>
+#include <zephyr/drivers/counter.h>
+#include <zephyr/sys/atomic.h>
 #include <zephyr/logging/log.h>
 #include "motor_control.h"
 #include "check_health.h"
+#include "watchdog.h"
+#include "configuration.h"
+#include "feedlog.h"
+#include "log_rate.h"
+#include "histogram.h"
+
+#ifdef CONFIG_FEEDER_EVENT_LOOP
+#include <zephyr/smf.h>
+#include "event_loop.h"
+#endif
 
 LOG_MODULE_REGISTER(motor_control, LOG_LEVEL_INF);
+#ifndef CONFIG_FEEDER_EVENT_LOOP
 K_THREAD_STACK_DEFINE(motor_stack_area, MOTOR_CTRL_STACK);
+#endif
+
+#define MOTOR_NODE DT_PATH(zephyr_user)
+
+#if DT_NODE_HAS_STATUS(DT_ALIAS(stepper_timer), okay)
+#define MOTOR_HAS_COUNTER 1
+#endif
+
+#if DT_NODE_HAS_PROP(MOTOR_NODE, step_gpios)
+#define MOTOR_HAS_GPIOS 1
+static const struct gpio_dt_spec step_gpio = GPIO_DT_SPEC_GET(MOTOR_NODE, step_gpios);
+static const struct gpio_dt_spec dir_gpio = GPIO_DT_SPEC_GET(MOTOR_NODE, dir_gpios);
+static const struct gpio_dt_spec enable_gpio = GPIO_DT_SPEC_GET_OR(MOTOR_NODE, enable_gpios, {0});
+#endif
+
+enum {
+    ENGINE_RUNNING = 0,
+    ENGINE_STOP_REQ,
+};
+
+static struct {
+    uint32_t total;
+    uint32_t done;
+    uint32_t ramp_len;
+    uint32_t acc;
+    uint32_t deadline;
+    uint32_t cmd_stamp;
+    uint32_t start_stamp;
+    uint32_t end_stamp;
+    uint32_t step_stamp;   /* cycle counter at the last step */
+    uint32_t expected_cyc; /* cycles until the next step */
+    uint64_t cyc_per_tick; /* Q16 */
+    atomic_t flags;
+} engine;
+
+/* Feed being dispensed, logged once the engine is done with it */
+static struct {
+    bool active;
+    uint16_t grams;
+    uint32_t steps;
+} feed;
+
+static uint32_t ramp_table[MOTOR_RAMP_TABLE_LEN];
+
+static struct cmd_ring cmd_rings[MOTOR_SRC_COUNT];
+static uint32_t last_cmd_latency;
+static uint32_t motor_speed; /* set by MOTOR_CMD_SET_SPEED, 0 follows the config */
+static atomic_t stop_gen;    /* bumped by every stop, moves posted before it never start */
+#ifndef CONFIG_FEEDER_EVENT_LOOP
+K_SEM_DEFINE(motor_cmd_sem, 0, 1);
+#endif
 
+#ifdef MOTOR_HAS_COUNTER
+static const struct device *const step_counter = DEVICE_DT_GET(DT_ALIAS(stepper_timer));
+static struct counter_alarm_cfg step_alarm;
+static uint32_t counter_top;
+#else
+static void step_timer_expiry(struct k_timer *timer);
+K_TIMER_DEFINE(step_timer, step_timer_expiry, NULL);
+#endif
+
+#ifdef SMART_FEEDER_UNIT_TEST
+static uint32_t step_trace[MOTOR_STEP_TRACE_LEN];
+static size_t step_trace_len;
+#endif
+
+static health_handle_t motor_health = -1;
+static int motor_wdt = -1;
+
+#ifdef CONFIG_FEEDER_EVENT_LOOP
+enum motor_sm_state {
+    MOTOR_SM_IDLE = 0,
+    MOTOR_SM_MOVING,
+};
+
+static struct motor_sm {
+    struct smf_ctx ctx;
+    uint32_t events; /* EVENT_LOOP_* bits of the current run */
+    bool attached;
+} motor_sm;
+#else
 static struct k_thread motor_thread_data;
 static k_tid_t motor_tid = NULL;
+#endif
+
+/**
+ * @brief: Wakes up whoever drains the command rings, callable from the ISR
+ */
+static void motor_wake(void)
+{
+#ifdef CONFIG_FEEDER_EVENT_LOOP
+    event_loop_post(EVENT_LOOP_MOTOR);
+#else
+    k_sem_give(&motor_cmd_sem);
+#endif
+}
+
+/**
+ * @brief: Integer square root, the ramp builder can't use floats (no FPU on the ESP32-C6)
+ */
+static uint32_t isqrt64(uint64_t value)
+{
+    uint64_t res = 0;
+    uint64_t bit = 1ULL << 62;
+
+    while (bit > value) {
+        bit >>= 2;
+    }
+
+    while (bit != 0) {
+        if (value >= res + bit) {
+            value -= res + bit;
+            res = (res >> 1) + bit;
+        } else {
+            res >>= 1;
+        }
+        bit >>= 2;
+    }
+
+    return (uint32_t)res;
+}
+
+static uint32_t speed_to_interval(uint32_t speed, uint32_t tick_hz)
+{
+    return (uint32_t)(((uint64_t)tick_hz << MOTOR_Q_SHIFT) / speed);
+}
+
+int motor_ramp_build(uint32_t *table, size_t len, const struct motor_move *move, uint32_t tick_hz)
+{
+    uint32_t vmax;
+    uint32_t v0;
+    size_t ramp;
+
+    if (table == NULL || len == 0 || move == NULL || tick_hz == 0) {
+        return -EINVAL;
+    }
+
+    if (move->steps == 0 || move->max_speed == 0 || move->max_speed > MOTOR_MAX_SPEED_SPS || move->accel == 0) {
+        return -EINVAL;
+    }
+
+    vmax = move->max_speed;
+    v0 = MIN(MOTOR_START_SPEED_SPS, vmax);
+
+    switch (move->profile) {
+        case MOTOR_PROFILE_TRAPEZOID:
+            /* Constant acceleration: v(n)^2 = v0^2 + 2 * a * n */
+            for (size_t n = 0; n < len; n++) {
+                uint32_t v = isqrt64((uint64_t)v0 * v0 + 2ULL * move->accel * n);
+
+                if (v >= vmax) {
+                    table[n] = speed_to_interval(vmax, tick_hz);
+                    return (int)(n + 1);
+                }
+                table[n] = speed_to_interval(v, tick_hz);
+            }
+            return (int)len;
+
+        case MOTOR_PROFILE_SCURVE:
+            /* Smoothstep over twice the trapezoid distance, so accel is zero at both ends of the ramp */
+            ramp = (size_t)(((uint64_t)vmax * vmax - (uint64_t)v0 * v0) / move->accel);
+            ramp = CLAMP(ramp, 1, len);
+            for (size_t n = 0; n < ramp; n++) {
+                uint64_t u = ((uint64_t)(n + 1) << 16) / ramp;
+                uint64_t u2 = (u * u) >> 16;
+                uint64_t u3 = (u2 * u) >> 16;
+                uint64_t s = 3 * u2 - 2 * u3;
+
+                table[n] = speed_to_interval(v0 + (uint32_t)(((uint64_t)(vmax - v0) * s) >> 16), tick_hz);
+            }
+            return (int)ramp;
+
+        default:
+            return -EINVAL;
+    }
+}
+
+static void emit_step(void)
+{
+#ifdef MOTOR_HAS_GPIOS
+    gpio_pin_set_dt(&step_gpio, 1);
+    k_busy_wait(MOTOR_STEP_PULSE_US);
+    gpio_pin_set_dt(&step_gpio, 0);
+#endif
+#ifdef SMART_FEEDER_UNIT_TEST
+    if (step_trace_len < MOTOR_STEP_TRACE_LEN) {
+        step_trace[step_trace_len++] = k_cycle_get_32();
+    }
+#endif
+}
 
+/**
+ * @brief: Interval, in timer ticks, until step number `step`
+ *
+ * The ramp index is the distance to the closest end of the move, so short moves become a triangle profile.
+ */
+static uint32_t next_interval(uint32_t step)
+{
+    uint32_t idx = MIN(step, engine.total - 1 - step);
+    uint32_t ticks;
+
+    idx = MIN(idx, engine.ramp_len - 1);
+    engine.acc += ramp_table[idx];
+    ticks = engine.acc >> MOTOR_Q_SHIFT;
+    engine.acc -= ticks << MOTOR_Q_SHIFT;
+
+    return MAX(ticks, 1);
+}
+
+/**
+ * @brief: Body of the step ISR
+ * @return: ticks until the next step, 0 when the move is over
+ */
+static uint32_t step_engine_isr(void)
+{
+    uint32_t now = k_cycle_get_32();
+    uint32_t next;
+
+    if (engine.done > 0) {
+        int32_t err = (int32_t)(now - engine.step_stamp - engine.expected_cyc);
+
+        hist_record(HIST_STEP_JITTER, (uint32_t)ABS(err));
+    }
+    engine.step_stamp = now;
+
+    if (atomic_test_and_clear_bit(&engine.flags, ENGINE_STOP_REQ)) {
+        /* Start decelerating from the current speed */
+        uint32_t idx = MIN(engine.done, engine.ramp_len - 1);
+
+        if (engine.total - engine.done > idx + 1) {
+            engine.total = engine.done + idx + 1;
+        }
+    }
+
+    if (engine.done == 0) {
+        last_cmd_latency = now - engine.cmd_stamp;
+    }
+
+    emit_step();
+    engine.done++;
+
+    if (engine.done >= engine.total) {
+        engine.end_stamp = k_cycle_get_32();
+        atomic_clear_bit(&engine.flags, ENGINE_RUNNING);
+        /* Lets the motor thread start the next queued move */
+        motor_wake();
+        return 0;
+    }
+
+    next = next_interval(engine.done);
+    engine.expected_cyc = (uint32_t)(((uint64_t)next * engine.cyc_per_tick) >> 16);
+    return next;
+}
+
+#ifdef MOTOR_HAS_COUNTER
+static uint32_t counter_wrap(uint32_t ticks)
+{
+    return (counter_top == UINT32_MAX) ? ticks : ticks % (counter_top + 1);
+}
+
+static void step_alarm_cb(const struct device *dev, uint8_t chan_id, uint32_t ticks, void *user_data)
+{
+    ARG_UNUSED(ticks);
+    ARG_UNUSED(user_data);
+
+    uint32_t next = step_engine_isr();
+
+    if (next == 0) {
+        return;
+    }
+
+    engine.deadline = counter_wrap(engine.deadline + next);
+    step_alarm.ticks = engine.deadline;
+    counter_set_channel_alarm(dev, chan_id, &step_alarm);
+}
+
+static int step_timer_arm(uint32_t ticks)
+{
+    uint32_t now;
+    int ret;
+
+    ret = counter_get_value(step_counter, &now);
+    if (ret < 0) {
+        return ret;
+    }
+
+    engine.deadline = counter_wrap(now + ticks);
+    step_alarm.ticks = engine.deadline;
+
+    return counter_set_channel_alarm(step_counter, 0, &step_alarm);
+}
+
+uint32_t motor_tick_hz(void)
+{
+    return counter_get_frequency(step_counter);
+}
+#else
+static void step_timer_expiry(struct k_timer *timer)
+{
+    uint32_t next = step_engine_isr();
+
+    if (next != 0) {
+        /* Restarting from the expiry handler is relative to the expired deadline, so there is no drift */
+        k_timer_start(timer, K_TICKS(next), K_NO_WAIT);
+    }
+}
+
+static int step_timer_arm(uint32_t ticks)
+{
+    k_timer_start(&step_timer, K_TICKS(ticks), K_NO_WAIT);
+    return 0;
+}
+
+uint32_t motor_tick_hz(void)
+{
+    return CONFIG_SYS_CLOCK_TICKS_PER_SEC;
+}
+#endif
+
+static int engine_start(const struct motor_move *move, uint32_t stamp)
+{
+    int ret;
+
+    if (atomic_test_and_set_bit(&engine.flags, ENGINE_RUNNING)) {
+        return -EBUSY;
+    }
+
+    ret = motor_ramp_build(ramp_table, ARRAY_SIZE(ramp_table), move, motor_tick_hz());
+    if (ret < 0) {
+        atomic_clear_bit(&engine.flags, ENGINE_RUNNING);
+        return ret;
+    }
+
+    engine.ramp_len = (uint32_t)ret;
+    engine.total = (uint32_t)ABS(move->steps);
+    engine.done = 0;
+    engine.acc = 0;
+    engine.cmd_stamp = stamp;
+    engine.start_stamp = k_cycle_get_32();
+    engine.cyc_per_tick = ((uint64_t)sys_clock_hw_cycles_per_sec() << 16) / motor_tick_hz();
+    atomic_clear_bit(&engine.flags, ENGINE_STOP_REQ);
+
+#ifdef MOTOR_HAS_GPIOS
+    gpio_pin_set_dt(&dir_gpio, move->steps < 0 ? 1 : 0);
+    if (enable_gpio.port != NULL) {
+        gpio_pin_set_dt(&enable_gpio, 1);
+    }
+#endif
+
+    ret = step_timer_arm(next_interval(0));
+    if (ret < 0) {
+        LOG_ERR("Failed to arm the step timer: %d", ret);
+        atomic_clear_bit(&engine.flags, ENGINE_RUNNING);
+        return ret;
+    }
+
+    return 0;
+}
+
+int motor_move_start(const struct motor_move *move)
+{
+    return engine_start(move, k_cycle_get_32());
+}
+
+void motor_stop(void)
+{
+    atomic_inc(&stop_gen);
+    if (atomic_test_bit(&engine.flags, ENGINE_RUNNING)) {
+        atomic_set_bit(&engine.flags, ENGINE_STOP_REQ);
+    }
+}
+
+bool motor_is_busy(void)
+{
+    return atomic_test_bit(&engine.flags, ENGINE_RUNNING);
+}
+
+BUILD_ASSERT((int64_t)MOTOR_MAX_FEED_GRAMS * MOTOR_STEPS_PER_GRAM <= INT32_MAX, "a feed must fit the move steps");
+
+/**
+ * @brief: Checks the argument range of a command, whoever posts it
+ */
+static bool cmd_arg_valid(enum motor_cmd_type type, int32_t arg)
+{
+    switch (type) {
+        case MOTOR_CMD_FEED:
+            return arg > 0 && arg <= MOTOR_MAX_FEED_GRAMS;
+        case MOTOR_CMD_JOG:
+            return arg != 0 && arg >= -MOTOR_MAX_JOG_STEPS && arg <= MOTOR_MAX_JOG_STEPS;
+        case MOTOR_CMD_SET_SPEED:
+            return arg >= MOTOR_START_SPEED_SPS && arg <= MOTOR_MAX_SPEED_SPS;
+        default:
+            return true;
+    }
+}
+
+int motor_cmd_post(enum motor_cmd_src src, enum motor_cmd_type type, int32_t arg)
+{
+    struct motor_cmd cmd = {.type = type, .arg = arg, .stamp = k_cycle_get_32()};
+
+    if (src >= MOTOR_SRC_COUNT || type > MOTOR_CMD_SET_SPEED || !cmd_arg_valid(type, arg)) {
+        return -EINVAL;
+    }
+
+    if (type == MOTOR_CMD_STOP) {
+        motor_stop();
+    }
+    cmd.gen = (uint32_t)atomic_get(&stop_gen);
+
+    if (!cmd_ring_put(&cmd_rings[src], &cmd)) {
+        return -ENOBUFS;
+    }
+
+    motor_wake();
+    return 0;
+}
+
+uint32_t motor_cmd_latency_cyc(void)
+{
+    return last_cmd_latency;
+}
+
+/**
+ * @brief: Turns a feed/jog command into a move with the current speed settings
+ */
+static void cmd_to_move(const struct motor_cmd *cmd, struct motor_move *move)
+{
+    struct config_hot hot;
+
+    config_hot_get(&hot);
+    move->steps = (cmd->type == MOTOR_CMD_FEED) ? cmd->arg * MOTOR_STEPS_PER_GRAM : cmd->arg;
+    move->max_speed = (motor_speed != 0) ? motor_speed : hot.max_speed_sps;
+    move->accel = hot.accel;
+    move->profile = MOTOR_PROFILE_SCURVE;
+}
+
+/**
+ * @brief: Logs the tracked feed once its move is over
+ */
+static void feed_log_if_done(void)
+{
+    struct feedlog_entry entry = {0};
+
+    if (!feed.active || motor_is_busy()) {
+        return;
+    }
+
+    entry.grams = feed.grams;
+    entry.steps = engine.done;
+    entry.duration_ms = (uint16_t)MIN(k_cyc_to_ms_near32(engine.end_stamp - engine.start_stamp), UINT16_MAX);
+    entry.result = (engine.done < feed.steps) ? -ECANCELED : 0;
+    feed.active = false;
+
+    if (feedlog_append(&entry) == -ENOBUFS) {
+        LOG_WRN_RATE(LOG_STATUS_PERIOD_MS, "Feed log queue full, dispense of %u g not logged", entry.grams);
+    }
+}
+
+/**
+ * @brief: Starts tracking a feed, rejected ones are logged right away
+ * @param: move Only read when the feed started (result 0)
+ */
+static void feed_track(const struct motor_cmd *cmd, const struct motor_move *move, int result)
+{
+    struct feedlog_entry entry = {0};
+
+    if (result == 0) {
+        feed.active = true;
+        feed.grams = (uint16_t)cmd->arg;
+        feed.steps = (uint32_t)ABS(move->steps);
+        return;
+    }
+
+    entry.grams = (uint16_t)cmd->arg;
+    entry.result = (int8_t)result;
+    feedlog_append(&entry);
+}
+
+/**
+ * @brief: Executes one command
+ * @return: false if the command is a move that has to wait for the engine to be free
+ */
+static bool motor_exec_cmd(const struct motor_cmd *cmd)
+{
+    struct motor_move move;
+    int ret;
+
+    switch (cmd->type) {
+        case MOTOR_CMD_STOP:
+            /* Already applied to the engine by motor_cmd_post() */
+            return true;
+        case MOTOR_CMD_SET_SPEED:
+            /* Range checked by motor_cmd_post() */
+            motor_speed = (uint32_t)cmd->arg;
+            return true;
+        default:
+            if (cmd->gen != (uint32_t)atomic_get(&stop_gen)) {
+                /* A stop was posted after this move, wherever it waits */
+                if (cmd->type == MOTOR_CMD_FEED) {
+                    feed_track(cmd, NULL, -ECANCELED);
+                }
+                return true;
+            }
+            if (motor_is_busy()) {
+                return false;
+            }
+            /* The previous feed has to be logged before the engine state is reused */
+            feed_log_if_done();
+            cmd_to_move(cmd, &move);
+            ret = engine_start(&move, cmd->stamp);
+            if (ret < 0) {
+                LOG_WRN_RATE(LOG_STATUS_PERIOD_MS, "Rejected move of %d steps", move.steps);
+            }
+            if (cmd->type == MOTOR_CMD_FEED) {
+                feed_track(cmd, &move, ret);
+            }
+            return true;
+    }
+}
+
+/**
+ * @brief: Drains the command rings in batches, round robin between producers
+ *
+ * Moves run one after the other in the order they were posted. When a move has to wait for the engine the rest of
+ * the batch stays here until the ISR wakes the thread up at the end of the running move. A stop posted meanwhile
+ * already bumped the stop generation, the waiting moves are then dropped and logged as they come up.
+ */
+static void motor_process_commands(void)
+{
+    static struct {
+        struct motor_cmd cmds[MOTOR_CMD_BATCH];
+        size_t pos;
+        size_t len;
+        int src;
+    } batch;
+    int empty_rings = 0;
+
+    while (empty_rings < MOTOR_SRC_COUNT) {
+        if (batch.pos == batch.len) {
+            batch.src = (batch.src + 1) % MOTOR_SRC_COUNT;
+            batch.len = cmd_ring_get_batch(&cmd_rings[batch.src], batch.cmds, ARRAY_SIZE(batch.cmds));
+            batch.pos = 0;
+            empty_rings = (batch.len == 0) ? empty_rings + 1 : 0;
+            continue;
+        }
+
+        if (!motor_exec_cmd(&batch.cmds[batch.pos])) {
+            return;
+        }
+        batch.pos++;
+    }
+}
+
+/**
+ * @brief: Puts the driver pins in a known, motor disabled, state
+ */
+static int motor_hw_init(void)
+{
+#ifdef MOTOR_HAS_GPIOS
+    int ret;
+
+    if (!gpio_is_ready_dt(&step_gpio) || !gpio_is_ready_dt(&dir_gpio)) {
+        LOG_ERR("Stepper GPIOs not ready");
+        return -ENODEV;
+    }
+
+    ret = gpio_pin_configure_dt(&step_gpio, GPIO_OUTPUT_INACTIVE);
+    ret = ret ? ret : gpio_pin_configure_dt(&dir_gpio, GPIO_OUTPUT_INACTIVE);
+    if (ret == 0 && enable_gpio.port != NULL) {
+        ret = gpio_pin_configure_dt(&enable_gpio, GPIO_OUTPUT_INACTIVE);
+    }
+    if (ret < 0) {
+        LOG_ERR("Failed to configure the stepper GPIOs: %d", ret);
+        return ret;
+    }
+#endif
+
+#ifdef MOTOR_HAS_COUNTER
+    if (!device_is_ready(step_counter)) {
+        LOG_ERR("Step timer not ready");
+        return -ENODEV;
+    }
+
+    counter_top = counter_get_top_value(step_counter);
+    step_alarm.callback = step_alarm_cb;
+    step_alarm.flags = COUNTER_ALARM_CFG_ABSOLUTE | COUNTER_ALARM_CFG_EXPIRE_WHEN_LATE;
+
+    return counter_start(step_counter);
+#else
+    return 0;
+#endif
+}
+
+#ifdef CONFIG_FEEDER_EVENT_LOOP
+static const struct smf_state motor_states[];
+
+static enum smf_state_result motor_idle_run(void *obj)
+{
+    struct motor_sm *sm = obj;
+
+    feed_log_if_done();
+    if (sm->events & EVENT_LOOP_MOTOR) {
+        motor_process_commands();
+    }
+    if (motor_is_busy()) {
+        smf_set_state(SMF_CTX(sm), &motor_states[MOTOR_SM_MOVING]);
+    }
+
+    return SMF_EVENT_HANDLED;
+}
+
+static enum smf_state_result motor_moving_run(void *obj)
+{
+    struct motor_sm *sm = obj;
+
+    if (!motor_is_busy()) {
+        /* The ISR ended the move: log it and start the queued one on the next run */
+        smf_set_state(SMF_CTX(sm), &motor_states[MOTOR_SM_IDLE]);
+        event_loop_post(EVENT_LOOP_MOTOR);
+        return SMF_EVENT_HANDLED;
+    }
+
+    /* Stops and speed changes apply right away, moves wait in the batch */
+    if (sm->events & EVENT_LOOP_MOTOR) {
+        motor_process_commands();
+    }
+
+    return SMF_EVENT_HANDLED;
+}
+
+static const struct smf_state motor_states[] = {
+    [MOTOR_SM_IDLE] = SMF_CREATE_STATE(NULL, motor_idle_run, NULL, NULL, NULL),
+    [MOTOR_SM_MOVING] = SMF_CREATE_STATE(NULL, motor_moving_run, NULL, NULL, NULL),
+};
+
+void motor_loop_run(uint32_t events)
+{
+    if (!motor_sm.attached) {
+        return;
+    }
+
+    thread_report_alive(motor_health);
+    watchdog_feed(motor_wdt);
+
+    motor_sm.events = events;
+    smf_run_state(SMF_CTX(&motor_sm));
+}
+#else
 /**
  * @brief: Thread that is in charge of controlling the stepper motor
  */
@@ -23,20 +693,48 @@ void motor_control_thread(void *p1, void *p2, void *p3)
     ARG_UNUSED(p1);
     ARG_UNUSED(p2);
     ARG_UNUSED(p3);
-    size_t unused_stack;
 
     LOG_INF("Motor control started at priority: %d", MOTOR_CTRL_PRIORITY);
 
     while (1) {
-        thread_report_alive(THREAD_MOTOR_CONTROL);
-        k_thread_stack_space_get(&motor_thread_data, &unused_stack);
-        LOG_INF("Motor control loop. Unused Stack: %d bytes", unused_stack);
-        k_sleep(K_MSEC(500));
+        thread_report_alive(motor_health);
+        watchdog_feed(motor_wdt);
+
+        /* Woken up by producers and by the ISR at the end of a move, otherwise just report alive */
+        k_sem_take(&motor_cmd_sem, K_MSEC(MOTOR_IDLE_REPORT_MS));
+        feed_log_if_done();
+        motor_process_commands();
     }
 }
+#endif
 
 void start_motor_control_thread(void)
 {
+    if (motor_health < 0) {
+        motor_health = health_register("motor_control", MOTOR_HEALTH_TIMEOUT_MS);
+    }
+    if (motor_wdt < 0) {
+        motor_wdt = watchdog_add_channel("motor_control", MOTOR_WDT_PERIOD_MS);
+    }
+
+    for (int src = 0; src < MOTOR_SRC_COUNT; src++) {
+        cmd_ring_init(&cmd_rings[src]);
+    }
+
+    if (motor_hw_init() < 0) {
+        LOG_ERR("Step engine unavailable");
+    }
+
+#ifdef CONFIG_FEEDER_EVENT_LOOP
+    /* No thread of its own, the event loop runs the state machine */
+    event_loop_start();
+    smf_set_initial(SMF_CTX(&motor_sm), &motor_states[MOTOR_SM_IDLE]);
+    motor_sm.attached = true;
+    health_stack_watch(motor_health, event_loop_thread());
+    event_loop_post(EVENT_LOOP_MOTOR);
+
+    LOG_INF("Motor control attached to the event loop");
+#else
     motor_tid = k_thread_create(&motor_thread_data,
                                 motor_stack_area,
                                 K_THREAD_STACK_SIZEOF(motor_stack_area),
@@ -47,17 +745,35 @@ void start_motor_control_thread(void)
                                 MOTOR_CTRL_PRIORITY,
                                 0,
                                 K_NO_WAIT);
+    k_thread_name_set(motor_tid, "motor");
+    health_stack_watch(motor_health, motor_tid);
 
     LOG_INF("Motor control thread started (tid=%p)", (void *)motor_tid);
+#endif
 }
 
 #ifdef SMART_FEEDER_UNIT_TEST
 void stop_motor_control_thread(void)
 {
+#ifdef CONFIG_FEEDER_EVENT_LOOP
+    motor_sm.attached = false;
+#else
     if (motor_tid != NULL) {
         LOG_INF("Stopping motor control thread");
         k_thread_abort(motor_tid);
         motor_tid = NULL;
     }
+#endif
+}
+
+size_t motor_step_trace_get(const uint32_t **trace)
+{
+    *trace = step_trace;
+    return step_trace_len;
+}
+
+void motor_step_trace_reset(void)
+{
+    step_trace_len = 0;
 }
 #endif
@@ -0,0 +1,254 @@
+/**
+ * @file: perf.c
+ * @brief: Runtime statistics for the `perf` shell commands.
+ *
+ * The CPU time of every thread comes from the kernel runtime stats, which can't be cleared, so a baseline is kept per
+ * thread and the figures are given since the last perf_reset(). Context switches and interrupt time are counted by the
+ * user tracing hooks, which run with the interrupts locked, from a small table indexed by thread.
+ */
+#include <zephyr/kernel.h>
+#include <zephyr/sys/iterable_sections.h>
+#include <string.h>
+#include "perf.h"
+
+#if defined(CONFIG_SYS_HEAP_RUNTIME_STATS) && (K_HEAP_MEM_POOL_SIZE > 0)
+#include <zephyr/sys/sys_heap.h>
+
+extern struct k_heap _system_heap;
+#endif
+
+struct perf_slot {
+    k_tid_t tid;
+    uint64_t base_cycles; /* runtime stats at the last reset */
+    uint32_t switches;
+};
+
+static struct perf_slot slots[PERF_MAX_THREADS];
+static struct k_spinlock perf_lock;
+static uint64_t window_base;
+
+static struct perf_isr isr_stats;
+static uint32_t isr_depth;
+static uint32_t isr_start;
+
+/**
+ * @brief: Finds the slot of a thread, must be called with the lock held
+ * @param: add Take a free slot if the thread has none
+ */
+static struct perf_slot *slot_find(k_tid_t tid, bool add)
+{
+    struct perf_slot *free_slot = NULL;
+
+    for (int i = 0; i < PERF_MAX_THREADS; i++) {
+        if (slots[i].tid == tid) {
+            return &slots[i];
+        }
+        if (free_slot == NULL && slots[i].tid == NULL) {
+            free_slot = &slots[i];
+        }
+    }
+
+    if (add && free_slot != NULL) {
+        /* Created after the last reset, everything it did counts */
+        free_slot->tid = tid;
+        free_slot->base_cycles = 0;
+        free_slot->switches = 0;
+    }
+    return add ? free_slot : NULL;
+}
+
+#if defined(CONFIG_TRACING_USER)
+void sys_trace_thread_switched_in_user(void)
+{
+    k_spinlock_key_t key = k_spin_lock(&perf_lock);
+    struct perf_slot *slot = slot_find(k_current_get(), true);
+
+    if (slot != NULL) {
+        slot->switches++;
+    }
+    k_spin_unlock(&perf_lock, key);
+}
+
+void sys_trace_isr_enter_user(int nested_interrupts)
+{
+    ARG_UNUSED(nested_interrupts);
+
+    if (isr_depth++ == 0) {
+        isr_start = k_cycle_get_32();
+    }
+}
+
+void sys_trace_isr_exit_user(int nested_interrupts)
+{
+    ARG_UNUSED(nested_interrupts);
+
+    uint32_t cycles;
+
+    if (isr_depth == 0 || --isr_depth > 0) {
+        return;
+    }
+
+    cycles = k_cycle_get_32() - isr_start;
+    isr_stats.cycles += cycles;
+    isr_stats.count++;
+    isr_stats.longest_cyc = MAX(isr_stats.longest_cyc, cycles);
+}
+#endif
+
+static uint64_t thread_cycles(k_tid_t tid)
+{
+    k_thread_runtime_stats_t stats;
+
+    if (k_thread_runtime_stats_get(tid, &stats) < 0) {
+        return 0;
+    }
+    return stats.execution_cycles;
+}
+
+static uint64_t all_cycles(void)
+{
+    k_thread_runtime_stats_t stats;
+
+    if (k_thread_runtime_stats_all_get(&stats) < 0) {
+        return 0;
+    }
+    return stats.execution_cycles;
+}
+
+static uint32_t load_pm(uint64_t cycles, uint64_t window)
+{
+    return (window == 0) ? 0 : (uint32_t)MIN(cycles * 1000U / window, 1000U);
+}
+
+uint64_t perf_window_cycles(void)
+{
+    return all_cycles() - window_base;
+}
+
+struct threads_ctx {
+    struct perf_thread *out;
+    size_t max;
+    size_t count;
+    uint64_t window;
+};
+
+static void thread_snapshot(const struct k_thread *cthread, void *user_data)
+{
+    struct threads_ctx *ctx = user_data;
+    k_tid_t tid = (k_tid_t)cthread;
+    struct perf_thread *t;
+    struct perf_slot *slot;
+    k_spinlock_key_t key;
+    uint64_t base = 0;
+
+    if (ctx->count >= ctx->max) {
+        return;
+    }
+    t = &ctx->out[ctx->count++];
+    memset(t, 0, sizeof(*t));
+
+    key = k_spin_lock(&perf_lock);
+    slot = slot_find(tid, false);
+    if (slot != NULL) {
+        base = slot->base_cycles;
+        t->switches = slot->switches;
+    }
+    k_spin_unlock(&perf_lock, key);
+
+    t->tid = tid;
+    t->name = k_thread_name_get(tid);
+    t->cycles = thread_cycles(tid) - base;
+    t->load_pm = load_pm(t->cycles, ctx->window);
+#if defined(CONFIG_THREAD_STACK_INFO)
+    t->stack_size = cthread->stack_info.size;
+#endif
+    if (k_thread_stack_space_get(cthread, &t->stack_unused) < 0) {
+        t->stack_unused = 0;
+    }
+}
+
+int perf_threads_get(struct perf_thread *out, size_t max)
+{
+    struct threads_ctx ctx = {.out = out, .max = max};
+
+    if (!IS_ENABLED(CONFIG_THREAD_RUNTIME_STATS)) {
+        return -ENOTSUP;
+    }
+
+    ctx.window = perf_window_cycles();
+    /* The stack scan is slow, the scheduler stays unlocked */
+    k_thread_foreach_unlocked(thread_snapshot, &ctx);
+    return (int)ctx.count;
+}
+
+int perf_isr_get(struct perf_isr *out)
+{
+    if (!IS_ENABLED(CONFIG_TRACING_ISR) || !IS_ENABLED(CONFIG_TRACING_USER)) {
+        return -ENOTSUP;
+    }
+
+    unsigned int key = irq_lock();
+
+    *out = isr_stats;
+    irq_unlock(key);
+
+    out->load_pm = load_pm(out->cycles, perf_window_cycles());
+    return 0;
+}
+
+void perf_mem_get(struct perf_mem *out)
+{
+    memset(out, 0, sizeof(*out));
+
+#if defined(CONFIG_SYS_HEAP_RUNTIME_STATS) && (K_HEAP_MEM_POOL_SIZE > 0)
+    struct sys_memory_stats heap;
+
+    if (sys_heap_runtime_stats_get(&_system_heap.heap, &heap) == 0) {
+        out->heap_used = heap.allocated_bytes;
+        out->heap_free = heap.free_bytes;
+        out->heap_max_used = heap.max_allocated_bytes;
+    }
+#endif
+
+    STRUCT_SECTION_FOREACH(k_mem_slab, slab) {
+        out->slabs++;
+        out->slab_blocks += slab->info.num_blocks;
+        out->slab_used += k_mem_slab_num_used_get(slab);
+#if defined(CONFIG_MEM_SLAB_TRACE_MAX_UTILIZATION)
+        out->slab_max_used += k_mem_slab_max_used_get(slab);
+#endif
+    }
+}
+
+static void thread_reset(const struct k_thread *cthread, void *user_data)
+{
+    ARG_UNUSED(user_data);
+
+    k_tid_t tid = (k_tid_t)cthread;
+    uint64_t cycles = thread_cycles(tid);
+    k_spinlock_key_t key = k_spin_lock(&perf_lock);
+    struct perf_slot *slot = slot_find(tid, true);
+
+    if (slot != NULL) {
+        slot->base_cycles = cycles;
+        slot->switches = 0;
+    }
+    k_spin_unlock(&perf_lock, key);
+}
+
+void perf_reset(void)
+{
+    k_spinlock_key_t key = k_spin_lock(&perf_lock);
+    unsigned int irq_key;
+
+    /* Slots of the threads that exited are freed */
+    memset(slots, 0, sizeof(slots));
+    k_spin_unlock(&perf_lock, key);
+
+    k_thread_foreach_unlocked(thread_reset, NULL);
+
+    irq_key = irq_lock();
+    memset(&isr_stats, 0, sizeof(isr_stats));
+    window_base = all_cycles();
+    irq_unlock(irq_key);
+}
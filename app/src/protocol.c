@@ -0,0 +1,435 @@
+/**
+ * @file: protocol.c
+ * @brief: Binary command/telemetry protocol.
+ *
+ * Compact COBS framed protocol for host tools, much cheaper to parse and to transmit than the text shell when many
+ * feeders are polled at once. The parser works in place on the communication RX ring buffer.
+ */
+#include <zephyr/kernel.h>
+#include <zephyr/sys/crc.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/logging/log.h>
+#include <string.h>
+#include "protocol.h"
+#include "communication.h"
+#include "motor_control.h"
+#include "feedlog.h"
+#include "histogram.h"
+#include "telemetry.h"
+
+LOG_MODULE_REGISTER(protocol, LOG_LEVEL_INF);
+
+static struct proto_stats stats;
+
+/* Only used for frames split by the ring buffer wrap around */
+static struct {
+    uint8_t buf[PROTO_MAX_ENCODED];
+    size_t len;
+} straddle;
+
+size_t cobs_encode(const uint8_t *in, size_t len, uint8_t *out)
+{
+    size_t code_pos = 0;
+    size_t wr = 1;
+    uint8_t code = 1;
+
+    for (size_t rd = 0; rd < len; rd++) {
+        if (in[rd] != 0) {
+            out[wr++] = in[rd];
+            code++;
+        }
+        if (in[rd] == 0 || code == 0xFF) {
+            out[code_pos] = code;
+            code_pos = wr++;
+            code = 1;
+        }
+    }
+    out[code_pos] = code;
+
+    return wr;
+}
+
+int cobs_decode_in_place(uint8_t *buf, size_t len)
+{
+    size_t rd = 0;
+    size_t wr = 0;
+
+    while (rd < len) {
+        uint8_t code = buf[rd];
+
+        if (code == 0 || rd + code > len) {
+            return -EINVAL;
+        }
+
+        rd++;
+        /* wr never passes rd, so moving the block down is safe */
+        for (uint8_t i = 1; i < code; i++) {
+            buf[wr++] = buf[rd++];
+        }
+        if (code != 0xFF && rd < len) {
+            buf[wr++] = 0;
+        }
+    }
+
+    return (int)wr;
+}
+
+int proto_encode(uint8_t type, uint8_t seq, const uint8_t *payload, size_t payload_len, uint8_t *out,
+                 size_t out_size)
+{
+    uint8_t raw[PROTO_MAX_DECODED];
+    size_t raw_len = PROTO_HEADER_SIZE + payload_len;
+    size_t len;
+
+    if (payload_len > PROTO_MAX_PAYLOAD || out_size < PROTO_MAX_ENCODED) {
+        return -EINVAL;
+    }
+
+    raw[0] = type;
+    raw[1] = seq;
+    if (payload_len > 0) {
+        memcpy(&raw[PROTO_HEADER_SIZE], payload, payload_len);
+    }
+    sys_put_le16(crc16_itu_t(0xFFFF, raw, raw_len), &raw[raw_len]);
+    raw_len += PROTO_CRC_SIZE;
+
+    len = cobs_encode(raw, raw_len, out);
+    out[len++] = 0;
+
+    return (int)len;
+}
+
+int proto_send(uint8_t type, uint8_t seq, const uint8_t *payload, size_t payload_len)
+{
+    uint8_t frame[PROTO_MAX_ENCODED];
+    int len = proto_encode(type, seq, payload, payload_len, frame, sizeof(frame));
+
+    if (len < 0) {
+        return len;
+    }
+
+    return comm_send(frame, (size_t)len);
+}
+
+static void proto_ack(const struct proto_frame *frame, int result)
+{
+    uint8_t payload[2] = {frame->type, (uint8_t)(int8_t)result};
+
+    proto_send(PROTO_ACK, frame->seq, payload, sizeof(payload));
+}
+
+BUILD_ASSERT((PROTO_LOG_PAGE_FRAMES + 2) * PROTO_MAX_ENCODED <= COMM_TX_RING_SIZE,
+             "a log page must fit the TX ring along with its cursor and ACK");
+
+struct proto_log_batch {
+    uint8_t seq;
+    int err;
+    size_t count; /* entries packed in the payload */
+    size_t total; /* entries of the page */
+    bool more;    /* the page is full, entries are left */
+    uint8_t payload[PROTO_LOG_PER_FRAME * FEEDLOG_ENTRY_WIRE];
+};
+
+static int proto_log_send(struct proto_log_batch *batch)
+{
+    int ret = 0;
+
+    if (batch->count > 0) {
+        ret = proto_send(PROTO_LOG, batch->seq, batch->payload, batch->count * FEEDLOG_ENTRY_WIRE);
+        batch->count = 0;
+    }
+
+    return ret;
+}
+
+static int proto_log_visit(const struct feedlog_entry *entry, void *user_data)
+{
+    struct proto_log_batch *batch = user_data;
+
+    /* Not consumed, the next page starts with it */
+    if (batch->total == PROTO_LOG_PAGE) {
+        batch->more = true;
+        return 1;
+    }
+
+    feedlog_entry_pack(entry, &batch->payload[batch->count * FEEDLOG_ENTRY_WIRE]);
+    batch->total++;
+    if (++batch->count < PROTO_LOG_PER_FRAME) {
+        return 0;
+    }
+
+    /* TX queue full, stop instead of dropping frames in the middle of the range */
+    batch->err = proto_log_send(batch);
+    return batch->err;
+}
+
+/**
+ * @brief: Sends one page of the feed log entries of a time range
+ *
+ * A page is at most PROTO_LOG_PAGE entries, what the TX ring takes without waiting. When entries are left, a
+ * PROTO_LOG_NEXT frame gives the cursor the host appends to the range of its next request. The page is closed by the
+ * ACK either way. An error ACK leaves the cursor as it was, the same page can be asked again.
+ *
+ * @return: 0 once the page was sent, negative error code otherwise
+ */
+static int proto_get_log(const struct proto_frame *frame)
+{
+    struct proto_log_batch batch = {.seq = frame->seq};
+    struct feedlog_cursor cursor = {0};
+    uint8_t next[PROTO_LOG_CURSOR_WIRE];
+    int ret;
+
+    if (frame->payload_len != 8 && frame->payload_len != 8 + PROTO_LOG_CURSOR_WIRE) {
+        return -EINVAL;
+    }
+    if (frame->payload_len > 8) {
+        cursor.seq = sys_get_le32(&frame->payload[8]);
+        cursor.rec = sys_get_le32(&frame->payload[12]);
+    }
+
+    ret = feedlog_query_at(&cursor, sys_get_le32(frame->payload), sys_get_le32(&frame->payload[4]), proto_log_visit,
+                           &batch);
+    if (ret < 0) {
+        return ret;
+    }
+    if (batch.err < 0) {
+        return batch.err;
+    }
+
+    ret = proto_log_send(&batch);
+    if (ret < 0 || !batch.more) {
+        return ret;
+    }
+
+    sys_put_le32(cursor.seq, &next[0]);
+    sys_put_le32(cursor.rec, &next[4]);
+    return proto_send(PROTO_LOG_NEXT, frame->seq, next, sizeof(next));
+}
+
+/**
+ * @brief: Sends the summary of every latency histogram
+ * @return: 0 once every histogram was sent, negative error code otherwise
+ */
+static int proto_get_hist(const struct proto_frame *frame)
+{
+    uint8_t payload[PROTO_HIST_WIRE];
+    struct histogram_summary sum;
+    int ret;
+
+    if (frame->payload_len != 0) {
+        return -EINVAL;
+    }
+
+    for (int id = 0; id < HIST_COUNT; id++) {
+        histogram_summarize(hist_get(id), &sum);
+        payload[0] = (uint8_t)id;
+        sys_put_le32(sum.count, &payload[1]);
+        sys_put_le32(k_cyc_to_us_ceil32(sum.p50), &payload[5]);
+        sys_put_le32(k_cyc_to_us_ceil32(sum.p90), &payload[9]);
+        sys_put_le32(k_cyc_to_us_ceil32(sum.p99), &payload[13]);
+        sys_put_le32(k_cyc_to_us_ceil32(sum.p999), &payload[17]);
+        sys_put_le32(k_cyc_to_us_ceil32(sum.max), &payload[21]);
+
+        ret = proto_send(PROTO_HIST, frame->seq, payload, sizeof(payload));
+        if (ret < 0) {
+            return ret;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief: Sends the history of one metric in one tier, oldest point first
+ * @return: 0 once every point was sent, negative error code otherwise
+ */
+static int proto_get_telem(const struct proto_frame *frame)
+{
+    /* Too big for the comm stack, frames are handled one at a time */
+    static struct telem_point points[MAX(TELEM_SEC_POINTS, MAX(TELEM_MIN_POINTS, TELEM_HOUR_POINTS))];
+    uint8_t payload[PROTO_TELEM_HEADER + PROTO_TELEM_PER_FRAME * TELEM_POINT_WIRE];
+    int count;
+    int ret;
+
+    if (frame->payload_len != 2) {
+        return -EINVAL;
+    }
+
+    count = telemetry_read(frame->payload[0], frame->payload[1], points, ARRAY_SIZE(points));
+    if (count < 0) {
+        return count;
+    }
+
+    payload[0] = frame->payload[0];
+    payload[1] = frame->payload[1];
+    for (int first = 0; first < count; first += PROTO_TELEM_PER_FRAME) {
+        int n = MIN(count - first, PROTO_TELEM_PER_FRAME);
+
+        payload[2] = (uint8_t)first;
+        for (int i = 0; i < n; i++) {
+            telemetry_point_pack(&points[first + i], &payload[PROTO_TELEM_HEADER + i * TELEM_POINT_WIRE]);
+        }
+
+        ret = proto_send(PROTO_TELEM, frame->seq, payload, PROTO_TELEM_HEADER + n * TELEM_POINT_WIRE);
+        if (ret < 0) {
+            return ret;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief: Executes a decoded frame
+ */
+static void proto_dispatch(const struct proto_frame *frame)
+{
+    uint8_t status[5];
+    int ret;
+
+    switch (frame->type) {
+        case PROTO_PING:
+            ret = 0;
+            break;
+        case PROTO_FEED:
+            ret = (frame->payload_len == 2)
+                      ? motor_cmd_post(MOTOR_SRC_COMM, MOTOR_CMD_FEED, sys_get_le16(frame->payload))
+                      : -EINVAL;
+            break;
+        case PROTO_JOG:
+            ret = (frame->payload_len == 4)
+                      ? motor_cmd_post(MOTOR_SRC_COMM, MOTOR_CMD_JOG, (int32_t)sys_get_le32(frame->payload))
+                      : -EINVAL;
+            break;
+        case PROTO_STOP:
+            ret = motor_cmd_post(MOTOR_SRC_COMM, MOTOR_CMD_STOP, 0);
+            break;
+        case PROTO_SET_SPEED:
+            ret = (frame->payload_len == 4)
+                      ? motor_cmd_post(MOTOR_SRC_COMM, MOTOR_CMD_SET_SPEED, (int32_t)sys_get_le32(frame->payload))
+                      : -EINVAL;
+            break;
+        case PROTO_GET_LOG:
+            ret = proto_get_log(frame);
+            break;
+        case PROTO_GET_HIST:
+            ret = proto_get_hist(frame);
+            break;
+        case PROTO_GET_TELEM:
+            ret = proto_get_telem(frame);
+            break;
+        case PROTO_GET_STATUS:
+            status[0] = motor_is_busy() ? 1 : 0;
+            sys_put_le32(k_cyc_to_us_near32(motor_cmd_latency_cyc()), &status[1]);
+            proto_send(PROTO_STATUS, frame->seq, status, sizeof(status));
+            return;
+        default:
+            stats.unknown_types++;
+            ret = -EBADMSG;
+            break;
+    }
+
+    proto_ack(frame, ret);
+}
+
+/**
+ * @brief: Decodes one COBS frame (delimiter excluded) in place, checks it and dispatches it
+ */
+static void proto_frame_process(uint8_t *buf, size_t len)
+{
+    uint32_t start = k_cycle_get_32();
+    struct proto_frame frame;
+    int decoded;
+
+    if (len == 0) {
+        /* Back to back delimiters, used by hosts to resync */
+        return;
+    }
+
+    decoded = cobs_decode_in_place(buf, len);
+    if (decoded < PROTO_HEADER_SIZE + PROTO_CRC_SIZE) {
+        stats.framing_errors++;
+        return;
+    }
+
+    decoded -= PROTO_CRC_SIZE;
+    if (crc16_itu_t(0xFFFF, buf, decoded) != sys_get_le16(&buf[decoded])) {
+        stats.crc_errors++;
+        return;
+    }
+
+    frame.type = buf[0];
+    frame.seq = buf[1];
+    frame.payload = &buf[PROTO_HEADER_SIZE];
+    frame.payload_len = decoded - PROTO_HEADER_SIZE;
+
+    stats.frames_ok++;
+    proto_dispatch(&frame);
+    hist_record(HIST_PROTO_FRAME, k_cycle_get_32() - start);
+}
+
+void proto_rx_process(struct ring_buf *rx)
+{
+    uint8_t *data;
+    uint32_t avail;
+    uint32_t len;
+
+    while ((avail = ring_buf_size_get(rx)) > 0) {
+        len = ring_buf_get_claim(rx, &data, avail);
+
+        uint8_t *delim = memchr(data, 0, len);
+        size_t take = (delim != NULL) ? (size_t)(delim - data) + 1 : len;
+
+        if (straddle.len > 0 || (delim == NULL && len < avail)) {
+            /* Frame split by the wrap around, glue both halves in the scratch buffer */
+            if (straddle.len + take > sizeof(straddle.buf)) {
+                stats.framing_errors++;
+                straddle.len = 0;
+                ring_buf_get_finish(rx, take);
+                continue;
+            }
+            memcpy(&straddle.buf[straddle.len], data, take);
+            straddle.len += take;
+            ring_buf_get_finish(rx, take);
+            if (delim != NULL) {
+                proto_frame_process(straddle.buf, straddle.len - 1);
+                straddle.len = 0;
+            }
+            continue;
+        }
+
+        if (delim == NULL) {
+            if (len >= PROTO_MAX_ENCODED) {
+                /* No delimiter in a whole frame worth of bytes, it's garbage */
+                stats.framing_errors++;
+                ring_buf_get_finish(rx, len);
+                continue;
+            }
+            /* Incomplete frame, wait for the rest */
+            ring_buf_get_finish(rx, 0);
+            return;
+        }
+
+        proto_frame_process(data, take - 1);
+        ring_buf_get_finish(rx, take);
+    }
+}
+
+void proto_get_stats(struct proto_stats *out)
+{
+    *out = stats;
+}
+
+void protocol_init(void)
+{
+    comm_set_rx_handler(proto_rx_process);
+    LOG_INF("Binary protocol ready");
+}
+
+#ifdef SMART_FEEDER_UNIT_TEST
+void proto_reset(void)
+{
+    memset(&stats, 0, sizeof(stats));
+    straddle.len = 0;
+}
+#endif
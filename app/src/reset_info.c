@@ -0,0 +1,139 @@
+/**
+ * @file: reset_info.c
+ * @brief: Post-mortem data kept across resets.
+ *
+ * The health and watchdog code keep a small record up to date in RAM that the startup code doesn't clear. On the next
+ * boot it's checked against its CRC, logged and a new one is started. Nothing is written to flash, so it's safe to
+ * update right before a watchdog reset.
+ */
+#include <zephyr/kernel.h>
+#include <zephyr/linker/section_tags.h>
+#include <zephyr/sys/crc.h>
+#include <zephyr/logging/log.h>
+#include <string.h>
+#include "reset_info.h"
+
+#ifdef CONFIG_HWINFO
+#include <zephyr/drivers/hwinfo.h>
+#endif
+
+LOG_MODULE_REGISTER(reset_info, LOG_LEVEL_INF);
+
+static __noinit struct reset_info retained;
+static struct reset_info last_boot;
+static bool last_boot_valid;
+
+static uint32_t reset_info_crc(const struct reset_info *info)
+{
+    return crc32_ieee((const uint8_t *)info, offsetof(struct reset_info, crc));
+}
+
+static void copy_name(char *dst, const char *src)
+{
+    strncpy(dst, (src != NULL) ? src : "", RESET_INFO_NAME_LEN - 1);
+    dst[RESET_INFO_NAME_LEN - 1] = '\0';
+}
+
+/**
+ * @brief: Logs the record left by the previous boot
+ */
+static void reset_info_log(const struct reset_info *info)
+{
+    LOG_INF("Reset #%u after %u ms of uptime", info->reset_count, info->uptime_ms);
+    if (info->culprit[0] != '\0') {
+        LOG_WRN("Watchdog reset caused by %s", info->culprit);
+    }
+
+    for (int i = 0; i < HEALTH_MAX_THREADS; i++) {
+        if (info->threads[i].name[0] == '\0') {
+            continue;
+        }
+        LOG_INF("  %s last seen %u ms before the reset", info->threads[i].name,
+                info->uptime_ms - info->threads[i].last_beat_ms);
+    }
+}
+
+void reset_info_boot(void)
+{
+    last_boot_valid = (retained.magic == RESET_INFO_MAGIC && retained.crc == reset_info_crc(&retained));
+
+#ifdef CONFIG_HWINFO
+    uint32_t cause;
+
+    if (hwinfo_get_reset_cause(&cause) == 0) {
+        LOG_INF("Reset cause: 0x%08x", cause);
+        hwinfo_clear_reset_cause();
+    }
+#endif
+
+    if (last_boot_valid) {
+        last_boot = retained;
+        reset_info_log(&last_boot);
+    } else {
+        LOG_INF("No reset info, cold boot");
+        memset(&last_boot, 0, sizeof(last_boot));
+    }
+
+    memset(&retained, 0, sizeof(retained));
+    retained.magic = RESET_INFO_MAGIC;
+    retained.reset_count = last_boot_valid ? last_boot.reset_count + 1 : 0;
+    reset_info_seal();
+}
+
+void reset_info_thread(int slot, const char *name, uint32_t last_beat_ms)
+{
+    if ((unsigned int)slot >= HEALTH_MAX_THREADS) {
+        return;
+    }
+
+    unsigned int key = irq_lock();
+
+    copy_name(retained.threads[slot].name, name);
+    retained.threads[slot].last_beat_ms = last_beat_ms;
+    retained.seq++;
+    irq_unlock(key);
+}
+
+void reset_info_seal(void)
+{
+    unsigned int key = irq_lock();
+    uint32_t seq = ++retained.seq;
+    uint32_t crc;
+
+    retained.uptime_ms = k_uptime_get_32();
+    irq_unlock(key);
+
+    /* About 40 us bitwise, far too long to lock out the step ISR */
+    crc = reset_info_crc(&retained);
+
+    key = irq_lock();
+    if (retained.seq == seq) {
+        retained.crc = crc;
+    }
+    irq_unlock(key);
+}
+
+void reset_info_set_culprit(const char *name)
+{
+    unsigned int key = irq_lock();
+
+    /* Right before the watchdog reset, the steps no longer matter */
+    copy_name(retained.culprit, name);
+    retained.seq++;
+    retained.uptime_ms = k_uptime_get_32();
+    retained.crc = reset_info_crc(&retained);
+    irq_unlock(key);
+}
+
+bool reset_info_last(struct reset_info *out)
+{
+    *out = last_boot;
+    return last_boot_valid;
+}
+
+#ifdef SMART_FEEDER_UNIT_TEST
+struct reset_info *reset_info_retained(void)
+{
+    return &retained;
+}
+#endif
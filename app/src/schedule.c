@@ -0,0 +1,382 @@
+/**
+ * @file: schedule.c
+ * @brief: Calendar feed scheduler.
+ *
+ * Every active slot of the schedule table has exactly one pending event, kept in a min-heap ordered by due time. A
+ * position index per slot makes cancelling an event O(log n) too. A single k_timer is armed for the head of the heap,
+ * so the CPU sleeps until the next feed instead of polling the table. Events are fired from the system work queue.
+ *
+ * The slots live in the config: every change requests a commit, and the table is only touched under config_lock so a
+ * save never copies a half written slot. Nothing is armed before the wall clock is set, the uptime alone would fire
+ * the daily slots at hours counted from the boot.
+ */
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <string.h>
+#include "schedule.h"
+#include "configuration.h"
+#include "motor_control.h"
+#include "storage.h"
+
+LOG_MODULE_REGISTER(schedule, LOG_LEVEL_INF);
+
+#define SCHEDULE_DAYS_MASK   0x7F
+#define SCHEDULE_EPOCH_WDAY  3 /* 1970-01-01 was a Thursday, 0 is Monday */
+#define SCHEDULE_NO_EVENT    0
+
+struct sched_event {
+    uint32_t due;
+    uint16_t slot;
+};
+
+static struct sched_event heap[SCHEDULE_MAX_SLOTS];
+static uint16_t heap_pos[SCHEDULE_MAX_SLOTS];
+static size_t heap_len;
+
+static void sched_timer_expiry(struct k_timer *timer);
+static void sched_work_handler(struct k_work *work);
+static void schedule_feed(uint16_t slot, uint16_t grams, uint32_t due);
+
+K_TIMER_DEFINE(sched_timer, sched_timer_expiry, NULL);
+K_WORK_DEFINE(sched_work, sched_work_handler);
+static schedule_fire_cb_t fire_cb = schedule_feed;
+
+/* unix time in ms = uptime in ms + offset */
+static int64_t epoch_offset_ms;
+static bool clock_set;
+
+static void heap_swap(size_t a, size_t b)
+{
+    struct sched_event tmp = heap[a];
+
+    heap[a] = heap[b];
+    heap[b] = tmp;
+    heap_pos[heap[a].slot] = a;
+    heap_pos[heap[b].slot] = b;
+}
+
+static void heap_up(size_t i)
+{
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+
+        if (heap[parent].due <= heap[i].due) {
+            break;
+        }
+        heap_swap(parent, i);
+        i = parent;
+    }
+}
+
+static void heap_down(size_t i)
+{
+    while (1) {
+        size_t left = 2 * i + 1;
+        size_t right = left + 1;
+        size_t min = i;
+
+        if (left < heap_len && heap[left].due < heap[min].due) {
+            min = left;
+        }
+        if (right < heap_len && heap[right].due < heap[min].due) {
+            min = right;
+        }
+        if (min == i) {
+            break;
+        }
+        heap_swap(min, i);
+        i = min;
+    }
+}
+
+static void heap_insert(uint16_t slot, uint32_t due)
+{
+    size_t i = heap_len++;
+
+    heap[i].due = due;
+    heap[i].slot = slot;
+    heap_pos[slot] = i;
+    heap_up(i);
+}
+
+static void heap_remove(uint16_t slot)
+{
+    size_t i = heap_pos[slot];
+    size_t last;
+    uint16_t moved;
+
+    if (i == SCHEDULE_NOT_QUEUED || i >= heap_len) {
+        return;
+    }
+
+    last = --heap_len;
+    if (i != last) {
+        /* The last event fills the hole, it may have to go either way */
+        moved = heap[last].slot;
+        heap[i] = heap[last];
+        heap_pos[moved] = i;
+        heap_up(i);
+        heap_down(heap_pos[moved]);
+    }
+    heap_pos[slot] = SCHEDULE_NOT_QUEUED;
+}
+
+static bool slot_is_valid(const struct schedule_slot *slot)
+{
+    if (slot->grams == 0) {
+        return false;
+    }
+
+    switch (slot->kind) {
+        case SCHEDULE_DAILY:
+            return slot->time < SCHEDULE_SECS_DAY;
+        case SCHEDULE_WEEKLY:
+            return slot->time < SCHEDULE_SECS_DAY && (slot->days & SCHEDULE_DAYS_MASK) != 0 &&
+                   (slot->days & ~SCHEDULE_DAYS_MASK) == 0;
+        case SCHEDULE_ONCE:
+            return slot->time != SCHEDULE_NO_EVENT;
+        default:
+            return false;
+    }
+}
+
+/**
+ * @brief: Computes the first occurrence of a slot strictly after a given time
+ * @return: unix time of the occurrence, SCHEDULE_NO_EVENT if the slot won't fire again
+ */
+static uint32_t slot_next_due(const struct schedule_slot *slot, uint32_t after)
+{
+    uint32_t day = after / SCHEDULE_SECS_DAY;
+    uint32_t due;
+
+    switch (slot->kind) {
+        case SCHEDULE_DAILY:
+            due = day * SCHEDULE_SECS_DAY + slot->time;
+            return (due > after) ? due : due + SCHEDULE_SECS_DAY;
+        case SCHEDULE_WEEKLY:
+            /* Today might be on the mask but already past, so up to 8 days are checked */
+            for (uint32_t i = 0; i <= 7; i++) {
+                uint32_t wday = (day + i + SCHEDULE_EPOCH_WDAY) % 7;
+
+                due = (day + i) * SCHEDULE_SECS_DAY + slot->time;
+                if ((slot->days & BIT(wday)) && due > after) {
+                    return due;
+                }
+            }
+            return SCHEDULE_NO_EVENT;
+        case SCHEDULE_ONCE:
+            return (slot->time > after) ? slot->time : SCHEDULE_NO_EVENT;
+        default:
+            return SCHEDULE_NO_EVENT;
+    }
+}
+
+/**
+ * @brief: Reference time to look for the next occurrences from, events due right now still fire
+ */
+static uint32_t sched_after_now(void)
+{
+    uint32_t now = schedule_now();
+
+    return (now > 0) ? now - 1 : 0;
+}
+
+/**
+ * @brief: Queues the next occurrence of a slot, one shot slots that already fired are freed
+ */
+static void slot_requeue(uint16_t slot, uint32_t after)
+{
+    uint32_t due = slot_next_due(&cfg.schedule[slot], after);
+
+    if (due != SCHEDULE_NO_EVENT) {
+        heap_insert(slot, due);
+    } else if (cfg.schedule[slot].kind == SCHEDULE_ONCE) {
+        cfg.schedule[slot].kind = SCHEDULE_FREE;
+        config_commit_request();
+    }
+}
+
+/**
+ * @brief: Arms the timer for the head of the heap, must be called with the lock held
+ */
+static void sched_arm(void)
+{
+    if (heap_len == 0) {
+        k_timer_stop(&sched_timer);
+        return;
+    }
+
+    int64_t deadline_ms = (int64_t)heap[0].due * MSEC_PER_SEC - epoch_offset_ms;
+
+    k_timer_start(&sched_timer, K_TIMEOUT_ABS_MS(MAX(deadline_ms, 0)), K_NO_WAIT);
+}
+
+/**
+ * @brief: Drops every pending event and queues the next occurrence of each slot, none before the clock is set
+ */
+static void sched_rebuild(void)
+{
+    uint32_t after = sched_after_now();
+
+    heap_len = 0;
+    memset(heap_pos, 0xFF, sizeof(heap_pos));
+
+    for (uint16_t i = 0; i < SCHEDULE_MAX_SLOTS && clock_set; i++) {
+        if (cfg.schedule[i].kind != SCHEDULE_FREE) {
+            slot_requeue(i, after);
+        }
+    }
+
+    sched_arm();
+}
+
+static void sched_work_handler(struct k_work *work)
+{
+    ARG_UNUSED(work);
+
+    struct sched_event ev;
+    uint16_t grams;
+
+    k_mutex_lock(&config_lock, K_FOREVER);
+
+    /* Late events (busy work queue) are fired one by one from their own due time, none is skipped */
+    while (heap_len > 0 && heap[0].due <= schedule_now()) {
+        ev = heap[0];
+        grams = cfg.schedule[ev.slot].grams;
+        heap_remove(ev.slot);
+        slot_requeue(ev.slot, ev.due);
+
+        k_mutex_unlock(&config_lock);
+        LOG_DBG("Slot %u due at %u: %u g", ev.slot, ev.due, grams);
+        fire_cb(ev.slot, grams, ev.due);
+        k_mutex_lock(&config_lock, K_FOREVER);
+    }
+
+    sched_arm();
+    k_mutex_unlock(&config_lock);
+}
+
+static void sched_timer_expiry(struct k_timer *timer)
+{
+    ARG_UNUSED(timer);
+
+    k_work_submit(&sched_work);
+}
+
+static void schedule_feed(uint16_t slot, uint16_t grams, uint32_t due)
+{
+    ARG_UNUSED(due);
+
+    int ret = motor_cmd_post(MOTOR_SRC_SCHEDULE, MOTOR_CMD_FEED, grams);
+
+    if (ret < 0) {
+        LOG_ERR("Scheduled feed of slot %u lost: %d", slot, ret);
+    }
+}
+
+void schedule_init(schedule_fire_cb_t cb)
+{
+    fire_cb = (cb != NULL) ? cb : schedule_feed;
+    schedule_reload();
+    if (!clock_set) {
+        LOG_WRN("Clock not set, the schedule waits for it");
+    }
+    LOG_INF("Schedule ready, %zu events pending", heap_len);
+}
+
+void schedule_reload(void)
+{
+    k_mutex_lock(&config_lock, K_FOREVER);
+    sched_rebuild();
+    k_mutex_unlock(&config_lock);
+}
+
+int schedule_add(const struct schedule_slot *slot)
+{
+    int ret = -ENOMEM;
+
+    if (!slot_is_valid(slot) || slot_next_due(slot, sched_after_now()) == SCHEDULE_NO_EVENT) {
+        return -EINVAL;
+    }
+
+    k_mutex_lock(&config_lock, K_FOREVER);
+
+    for (uint16_t i = 0; i < SCHEDULE_MAX_SLOTS; i++) {
+        if (cfg.schedule[i].kind == SCHEDULE_FREE) {
+            cfg.schedule[i] = *slot;
+            if (clock_set) {
+                slot_requeue(i, sched_after_now());
+                sched_arm();
+            }
+            config_commit_request();
+            ret = i;
+            break;
+        }
+    }
+
+    k_mutex_unlock(&config_lock);
+    return ret;
+}
+
+int schedule_remove(uint16_t slot)
+{
+    int ret = -EINVAL;
+
+    if (slot >= SCHEDULE_MAX_SLOTS) {
+        return -EINVAL;
+    }
+
+    k_mutex_lock(&config_lock, K_FOREVER);
+    if (cfg.schedule[slot].kind != SCHEDULE_FREE) {
+        heap_remove(slot);
+        cfg.schedule[slot].kind = SCHEDULE_FREE;
+        sched_arm();
+        config_commit_request();
+        ret = 0;
+    }
+    k_mutex_unlock(&config_lock);
+
+    return ret;
+}
+
+void schedule_set_time(uint32_t unix_time)
+{
+    k_mutex_lock(&config_lock, K_FOREVER);
+    epoch_offset_ms = (int64_t)unix_time * MSEC_PER_SEC - k_uptime_get();
+    clock_set = true;
+    sched_rebuild();
+    k_mutex_unlock(&config_lock);
+
+    LOG_INF("Clock set to %u", unix_time);
+}
+
+uint32_t schedule_now(void)
+{
+    return (uint32_t)((k_uptime_get() + epoch_offset_ms) / MSEC_PER_SEC);
+}
+
+int schedule_next(uint32_t *due, uint16_t *slot)
+{
+    int ret = -ENOENT;
+
+    k_mutex_lock(&config_lock, K_FOREVER);
+    if (heap_len > 0) {
+        *due = heap[0].due;
+        *slot = heap[0].slot;
+        ret = 0;
+    }
+    k_mutex_unlock(&config_lock);
+
+    return ret;
+}
+
+#ifdef SMART_FEEDER_UNIT_TEST
+void schedule_reset(void)
+{
+    k_mutex_lock(&config_lock, K_FOREVER);
+    clock_set = false;
+    epoch_offset_ms = 0;
+    sched_rebuild();
+    k_mutex_unlock(&config_lock);
+}
+#endif
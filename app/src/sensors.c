@@ -0,0 +1,356 @@
+/**
+ * @file: sensors.c
+ * @brief: Battery and temperature sampling.
+ *
+ * Once per period the sensor thread starts one ADC sequence that converts every sensor channel SENSORS_BURST times,
+ * SENSORS_BURST_INTERVAL_US apart, and waits for it on a poll signal: the conversions run in the background, the CPU
+ * only sees the finished burst. Each burst is averaged per channel (with hardware oversampling on top when the ADC
+ * supports it), converted to mV, passed through a median to drop the spikes of the motor and a first order IIR, then
+ * compared to thresholds with hysteresis. Only the threshold state is reported to the health monitor.
+ *
+ * No floats anywhere, the ESP32-C6 has no FPU.
+ */
+#include <zephyr/kernel.h>
+#include <zephyr/drivers/adc.h>
+#include <zephyr/logging/log.h>
+#include <stdlib.h>
+#include "sensors.h"
+#include "filter.h"
+#include "check_health.h"
+#include "watchdog.h"
+
+LOG_MODULE_REGISTER(sensors, LOG_LEVEL_INF);
+
+#define SENSORS_NODE DT_PATH(zephyr_user)
+
+#if DT_NODE_HAS_PROP(SENSORS_NODE, io_channels) && defined(CONFIG_ADC)
+#define SENSORS_HAS_ADC 1
+static const struct adc_dt_spec sensor_adc[SENSOR_COUNT] = {
+    [SENSOR_BATTERY] = ADC_DT_SPEC_GET_BY_NAME(SENSORS_NODE, battery),
+    [SENSOR_TEMPERATURE] = ADC_DT_SPEC_GET_BY_NAME(SENSORS_NODE, temperature),
+};
+static int16_t burst_buf[SENSORS_BURST * SENSOR_COUNT];
+static struct adc_sequence_options burst_opts = {
+    .interval_us = SENSORS_BURST_INTERVAL_US,
+    .extra_samplings = SENSORS_BURST - 1,
+};
+static struct adc_sequence burst_seq;
+#ifdef CONFIG_ADC_ASYNC
+static struct k_poll_signal burst_done = K_POLL_SIGNAL_INITIALIZER(burst_done);
+#endif
+#endif
+
+K_THREAD_STACK_DEFINE(sensors_stack_area, SENSORS_STACK);
+
+struct sensor_chain {
+    struct filter_median median;
+    struct filter_iir iir;
+    struct filter_hyst limit;
+};
+
+static struct k_thread sensors_thread_data;
+static struct k_spinlock sensors_lock;
+static struct sensor_chain chains[SENSOR_COUNT];
+static struct sensors_reading reading;
+static struct sensors_stats stats;
+/* Position of each sensor in a conversion, the ADC stores the channels by ascending number */
+static uint8_t sample_pos[SENSOR_COUNT] = {SENSOR_BATTERY, SENSOR_TEMPERATURE};
+
+static health_handle_t sensors_health = -1;
+static int sensors_wdt = -1;
+
+static k_tid_t sensors_tid = NULL;
+
+/**
+ * @brief: Raw ADC value to mV at the pin
+ */
+static int32_t sensor_raw_to_mv(enum sensor_id id, int32_t raw)
+{
+#ifdef SENSORS_HAS_ADC
+    int32_t mv = raw;
+
+    if (adc_raw_to_millivolts_dt(&sensor_adc[id], &mv) == 0) {
+        return mv;
+    }
+#else
+    ARG_UNUSED(id);
+#endif
+    return raw;
+}
+
+/**
+ * @brief: mV at the pin to the unit of the sensor
+ */
+static int32_t sensor_scale(enum sensor_id id, int32_t mv)
+{
+    switch (id) {
+        case SENSOR_BATTERY:
+            return mv * SENSORS_BATTERY_DIVIDER;
+        case SENSOR_TEMPERATURE:
+            /* 10 mV per degree: one mV is a tenth of a degree */
+            return mv - SENSORS_TEMP_OFFSET_MV;
+        default:
+            return mv;
+    }
+}
+
+void sensors_process(const int16_t *raw, uint32_t count)
+{
+    int32_t value[SENSOR_COUNT];
+    bool ok[SENSOR_COUNT];
+    bool was_ok[SENSOR_COUNT];
+    bool first;
+    k_spinlock_key_t key;
+
+    if (count == 0) {
+        return;
+    }
+
+    for (int id = 0; id < SENSOR_COUNT; id++) {
+        struct sensor_chain *chain = &chains[id];
+        int32_t mean = filter_mean(raw + sample_pos[id], count, SENSOR_COUNT);
+
+        value[id] = sensor_scale(id, sensor_raw_to_mv(id, mean));
+        value[id] = filter_iir_push(&chain->iir, filter_median_push(&chain->median, value[id]));
+        ok[id] = !filter_hyst_update(&chain->limit, value[id]);
+    }
+
+    key = k_spin_lock(&sensors_lock);
+    first = !reading.valid;
+    was_ok[SENSOR_BATTERY] = reading.battery_ok;
+    was_ok[SENSOR_TEMPERATURE] = reading.temperature_ok;
+    reading.battery_mv = value[SENSOR_BATTERY];
+    reading.temperature_dc = value[SENSOR_TEMPERATURE];
+    reading.battery_ok = ok[SENSOR_BATTERY];
+    reading.temperature_ok = ok[SENSOR_TEMPERATURE];
+    reading.valid = true;
+    stats.bursts++;
+    stats.samples += count * SENSOR_COUNT;
+    k_spin_unlock(&sensors_lock, key);
+
+    if (first || ok[SENSOR_BATTERY] != was_ok[SENSOR_BATTERY]) {
+        health_sensor_report(HEALTH_SENSOR_BATTERY, ok[SENSOR_BATTERY]);
+        if (!ok[SENSOR_BATTERY]) {
+            LOG_WRN("Battery low: %d mV", value[SENSOR_BATTERY]);
+        } else if (!first) {
+            LOG_INF("Battery back to %d mV", value[SENSOR_BATTERY]);
+        }
+    }
+    if (first || ok[SENSOR_TEMPERATURE] != was_ok[SENSOR_TEMPERATURE]) {
+        health_sensor_report(HEALTH_SENSOR_TEMPERATURE, ok[SENSOR_TEMPERATURE]);
+        if (!ok[SENSOR_TEMPERATURE]) {
+            LOG_WRN("Temperature high: %d.%d C", value[SENSOR_TEMPERATURE] / 10, abs(value[SENSOR_TEMPERATURE] % 10));
+        } else if (!first) {
+            LOG_INF("Temperature back to %d.%d C", value[SENSOR_TEMPERATURE] / 10, abs(value[SENSOR_TEMPERATURE] % 10));
+        }
+    }
+}
+
+#ifdef SENSORS_HAS_ADC
+/**
+ * @brief: Starts the burst and waits for it, the conversions don't need the CPU
+ */
+static int sensors_read_burst(void)
+{
+#ifdef CONFIG_ADC_ASYNC
+    struct k_poll_event done = K_POLL_EVENT_INITIALIZER(K_POLL_TYPE_SIGNAL, K_POLL_MODE_NOTIFY_ONLY, &burst_done);
+    unsigned int signaled;
+    int result;
+    int ret;
+
+    k_poll_signal_reset(&burst_done);
+    ret = adc_read_async(sensor_adc[0].dev, &burst_seq, &burst_done);
+    if (ret < 0) {
+        return ret;
+    }
+
+    ret = k_poll(&done, 1, K_MSEC(SENSORS_SAMPLE_TIMEOUT_MS));
+    if (ret < 0) {
+        return ret;
+    }
+
+    k_poll_signal_check(&burst_done, &signaled, &result);
+    return result;
+#else
+    return adc_read(sensor_adc[0].dev, &burst_seq);
+#endif
+}
+#endif
+
+int sensors_update(void)
+{
+#ifdef SENSORS_HAS_ADC
+    int ret = sensors_read_burst();
+
+    /* Not every ADC oversamples, the burst average alone is still fine */
+    if ((ret == -ENOTSUP || ret == -EINVAL) && burst_seq.oversampling != 0) {
+        LOG_INF("No hardware oversampling, averaging the burst only");
+        burst_seq.oversampling = 0;
+        ret = sensors_read_burst();
+    }
+
+    if (ret < 0) {
+        k_spinlock_key_t key = k_spin_lock(&sensors_lock);
+
+        stats.errors++;
+        k_spin_unlock(&sensors_lock, key);
+        return ret;
+    }
+
+    sensors_process(burst_buf, SENSORS_BURST);
+    return 0;
+#else
+    return -ENODEV;
+#endif
+}
+
+void sensors_get(struct sensors_reading *out)
+{
+    k_spinlock_key_t key = k_spin_lock(&sensors_lock);
+
+    *out = reading;
+    k_spin_unlock(&sensors_lock, key);
+}
+
+void sensors_get_stats(struct sensors_stats *out)
+{
+    k_spinlock_key_t key = k_spin_lock(&sensors_lock);
+
+    *out = stats;
+    k_spin_unlock(&sensors_lock, key);
+}
+
+/**
+ * @brief: Filters and thresholds back to their initial state
+ */
+static void sensors_chains_init(void)
+{
+    for (int id = 0; id < SENSOR_COUNT; id++) {
+        filter_median_reset(&chains[id].median);
+        filter_iir_init(&chains[id].iir, SENSORS_IIR_SHIFT);
+    }
+    chains[SENSOR_BATTERY].limit = (struct filter_hyst){
+        .trip = SENSORS_BATTERY_LOW_MV, .release = SENSORS_BATTERY_OK_MV};
+    chains[SENSOR_TEMPERATURE].limit = (struct filter_hyst){
+        .trip = SENSORS_TEMP_HIGH_DC, .release = SENSORS_TEMP_OK_DC};
+}
+
+int sensors_init(void)
+{
+#ifdef SENSORS_HAS_ADC
+    int ret;
+
+    sensors_chains_init();
+
+    for (int id = 0; id < SENSOR_COUNT; id++) {
+        if (!adc_is_ready_dt(&sensor_adc[id]) || sensor_adc[id].dev != sensor_adc[0].dev) {
+            LOG_ERR("Sensor ADC channel %d not usable", id);
+            return -ENODEV;
+        }
+
+        ret = adc_channel_setup_dt(&sensor_adc[id]);
+        if (ret < 0) {
+            LOG_ERR("Failed to set up ADC channel %d: %d", sensor_adc[id].channel_id, ret);
+            return ret;
+        }
+    }
+
+    /* Two channels: the lower number comes first in every conversion */
+    sample_pos[SENSOR_BATTERY] = (sensor_adc[SENSOR_BATTERY].channel_id > sensor_adc[SENSOR_TEMPERATURE].channel_id);
+    sample_pos[SENSOR_TEMPERATURE] = !sample_pos[SENSOR_BATTERY];
+
+    ret = adc_sequence_init_dt(&sensor_adc[0], &burst_seq);
+    if (ret < 0) {
+        return ret;
+    }
+    burst_seq.channels = BIT(sensor_adc[SENSOR_BATTERY].channel_id) | BIT(sensor_adc[SENSOR_TEMPERATURE].channel_id);
+    burst_seq.buffer = burst_buf;
+    burst_seq.buffer_size = sizeof(burst_buf);
+    burst_seq.options = &burst_opts;
+    burst_seq.oversampling = SENSORS_OVERSAMPLING;
+
+    return 0;
+#else
+    sensors_chains_init();
+    return -ENODEV;
+#endif
+}
+
+/**
+ * @brief: Thread that samples the sensors every period
+ */
+void sensors_thread(void *p1, void *p2, void *p3)
+{
+    ARG_UNUSED(p1);
+    ARG_UNUSED(p2);
+    ARG_UNUSED(p3);
+
+    int64_t next = k_uptime_get();
+    int ret;
+
+    LOG_INF("Sensors started at priority: %d", SENSORS_PRIORITY);
+
+    while (1) {
+        thread_report_alive(sensors_health);
+        watchdog_feed(sensors_wdt);
+
+        ret = sensors_update();
+        if (ret < 0) {
+            LOG_ERR("Sensor burst failed: %d", ret);
+        }
+
+        next += SENSORS_PERIOD_MS;
+        k_sleep(K_TIMEOUT_ABS_MS(next));
+    }
+}
+
+void start_sensors_thread(void)
+{
+    if (sensors_init() < 0) {
+        LOG_WRN("No sensor ADC, battery and temperature not monitored");
+        return;
+    }
+
+    if (sensors_health < 0) {
+        sensors_health = health_register("sensors", SENSORS_HEALTH_TIMEOUT_MS);
+    }
+    if (sensors_wdt < 0) {
+        sensors_wdt = watchdog_add_channel("sensors", SENSORS_WDT_PERIOD_MS);
+    }
+
+    sensors_tid = k_thread_create(&sensors_thread_data,
+                                  sensors_stack_area,
+                                  K_THREAD_STACK_SIZEOF(sensors_stack_area),
+                                  sensors_thread,
+                                  NULL,
+                                  NULL,
+                                  NULL,
+                                  SENSORS_PRIORITY,
+                                  0,
+                                  K_NO_WAIT);
+    k_thread_name_set(sensors_tid, "sensors");
+    health_stack_watch(sensors_health, sensors_tid);
+
+    LOG_INF("Sensors thread started (tid=%p)", (void *)sensors_tid);
+}
+
+#ifdef SMART_FEEDER_UNIT_TEST
+void stop_sensors_thread(void)
+{
+    if (sensors_tid != NULL) {
+        LOG_INF("Stopping sensors thread");
+        k_thread_abort(sensors_tid);
+        sensors_tid = NULL;
+    }
+}
+
+void sensors_reset(void)
+{
+    k_spinlock_key_t key = k_spin_lock(&sensors_lock);
+
+    sensors_chains_init();
+    reading = (struct sensors_reading){0};
+    stats = (struct sensors_stats){0};
+    k_spin_unlock(&sensors_lock, key);
+}
+#endif
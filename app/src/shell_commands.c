@@ -7,10 +7,19 @@
 #include <zephyr/shell/shell.h>
 #include <zephyr/logging/log.h>
 #include <zephyr/sys/reboot.h>
+#include <errno.h>
 #include <stdlib.h>
+#include <string.h>
 #include "configuration.h"
+#include "motor_control.h"
+#include "schedule.h"
+#include "storage.h"
+#include "feedlog.h"
+#include "init.h"
+#include "perf.h"
+#include "histogram.h"
+#include "telemetry.h"
 
-// TODO: commit command
 // TODO: restore dflt command
 
 LOG_MODULE_REGISTER(console_shell, LOG_LEVEL_INF);
@@ -27,6 +36,7 @@ static int cmd_status(const struct shell *shell, size_t argc, char **argv)
     ARG_UNUSED(argv);
 
     shell_print(shell, "Current config: %d", cfg.random_value);
+    shell_print(shell, "Last command latency: %u us", k_cyc_to_us_near32(motor_cmd_latency_cyc()));
 
     return 0;
 }
@@ -44,6 +54,7 @@ static int cmd_change_value(const struct shell *shell, size_t argc, char **argv)
         return 0;
     } else if (argc == 2) {
         cfg.random_value = atoi(argv[1]);
+        config_publish();
         shell_print(shell, "changing value to: %d", cfg.random_value);
         return 0;
     }
@@ -52,6 +63,37 @@ static int cmd_change_value(const struct shell *shell, size_t argc, char **argv)
     return -EINVAL;
 }
 
+/**
+ * @brief: Shows or changes the motor speed and acceleration used by feeds and jogs
+ *
+ * Usage:
+ *   limits [<speed> <accel>]
+ */
+static int cmd_limits(const struct shell *shell, size_t argc, char **argv)
+{
+    uint32_t speed;
+    uint32_t accel;
+
+    if (argc == 3) {
+        speed = strtoul(argv[1], NULL, 10);
+        accel = strtoul(argv[2], NULL, 10);
+        if (speed < MOTOR_START_SPEED_SPS || speed > MOTOR_MAX_SPEED_SPS || accel == 0) {
+            shell_error(shell, "Speed must be %u..%u steps/s and accel > 0", MOTOR_START_SPEED_SPS,
+                        MOTOR_MAX_SPEED_SPS);
+            return -EINVAL;
+        }
+        cfg.max_speed_sps = speed;
+        cfg.accel = accel;
+        config_publish();
+    } else if (argc != 1) {
+        shell_print(shell, "Usage: limits [<speed> <accel>]");
+        return -EINVAL;
+    }
+
+    shell_print(shell, "Speed %u steps/s, accel %u steps/s^2", cfg.max_speed_sps, cfg.accel);
+    return 0;
+}
+
 /**
  * @brief: Cold reboots the system
  *
@@ -63,24 +105,51 @@ static int cmd_reboot(const struct shell *shell, size_t argc, char **argv)
     ARG_UNUSED(argc);
     ARG_UNUSED(argv);
 
+    if (config_commit_flush() < 0) {
+        shell_warn(shell, "Pending config changes could not be saved");
+    }
+    feedlog_flush();
+
     shell_print(shell, "Rebooting the system . . .");
     sys_reboot(SYS_REBOOT_COLD);
     return 0;
 }
 
 /**
- * @brief: Saves the current config in the nvs
+ * @brief: Saves the current config in the nvs, the write is done by the storage queue
  *
  * Usage:
- *     commit
+ *     commit          queue a commit, bursts are written once
+ *     commit now      write right away and wait for it
+ *     commit status   state of the commit service
  */
 static int cmd_commit(const struct shell *shell, size_t argc, char **argv)
 {
-    ARG_UNUSED(argc);
-    ARG_UNUSED(argv);
+    struct config_commit_status st;
+    int ret;
+
+    if (argc > 1 && strcmp(argv[1], "now") == 0) {
+        ret = config_commit_flush();
+        if (ret < 0) {
+            shell_error(shell, "Config commit failed: %d", ret);
+            return ret;
+        }
+        shell_print(shell, "Config saved in the NVS");
+        return 0;
+    }
 
-    save_config();
-    shell_print(shell, "Config saved in the NVS");
+    if (argc > 1 && strcmp(argv[1], "status") == 0) {
+        config_commit_get_status(&st);
+        shell_print(shell, "Commit %s, last result %d", st.pending ? "pending" : "idle", st.last_result);
+        shell_print(shell, "%u requests, %u commits, last one %zu bytes at %lld ms", st.requests, st.commits,
+                    st.last_bytes, (long long)st.last_commit_ms);
+        shell_print(shell, "NVS garbage collections: %u ahead of time, %u during a commit", st.idle_gcs,
+                    st.commit_gcs);
+        return 0;
+    }
+
+    config_commit_request();
+    shell_print(shell, "Config commit queued");
     return 0;
 }
 
@@ -96,13 +165,595 @@ static int cmd_restore_dflt(const struct shell *shell, size_t argc, char **argv)
     ARG_UNUSED(argv);
 
     set_dflt_cfg();
+    schedule_reload();
     shell_print(shell, "Default values restored");
     return 0;
 }
 
+/**
+ * @brief: Parses a decimal argument, atoi would silently wrap or accept trailing garbage
+ * @return: 0 on success, -EINVAL if it is not a number within [min, max]
+ */
+static int parse_long_arg(const char *str, long min, long max, long *value)
+{
+    char *end;
+
+    errno = 0;
+    *value = strtol(str, &end, 10);
+    if (errno != 0 || end == str || *end != '\0' || *value < min || *value > max) {
+        return -EINVAL;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief: Posts a motor command and reports if it was rejected
+ */
+static int post_motor_cmd(const struct shell *shell, enum motor_cmd_type type, int32_t arg)
+{
+    int ret = motor_cmd_post(MOTOR_SRC_SHELL, type, arg);
+
+    if (ret == -ENOBUFS) {
+        shell_error(shell, "Motor queue full: %d", ret);
+    } else if (ret < 0) {
+        shell_error(shell, "Motor command rejected: %d", ret);
+    }
+
+    return ret;
+}
+
+/**
+ * @brief: Dispenses the given amount of food
+ *
+ * Usage:
+ *     feed <grams>
+ */
+static int cmd_feed(const struct shell *shell, size_t argc, char **argv)
+{
+    ARG_UNUSED(argc);
+
+    long grams;
+
+    if (parse_long_arg(argv[1], 1, MOTOR_MAX_FEED_GRAMS, &grams) < 0) {
+        shell_print(shell, "Usage: feed <grams>, 1..%d", MOTOR_MAX_FEED_GRAMS);
+        return -EINVAL;
+    }
+
+    return post_motor_cmd(shell, MOTOR_CMD_FEED, (int32_t)grams);
+}
+
+/**
+ * @brief: Moves the motor a number of steps, negative goes backwards
+ *
+ * Usage:
+ *     jog <steps>
+ */
+static int cmd_jog(const struct shell *shell, size_t argc, char **argv)
+{
+    ARG_UNUSED(argc);
+
+    long steps;
+
+    if (parse_long_arg(argv[1], -MOTOR_MAX_JOG_STEPS, MOTOR_MAX_JOG_STEPS, &steps) < 0 || steps == 0) {
+        shell_print(shell, "Usage: jog <steps>, non zero, at most %d either way", MOTOR_MAX_JOG_STEPS);
+        return -EINVAL;
+    }
+
+    return post_motor_cmd(shell, MOTOR_CMD_JOG, (int32_t)steps);
+}
+
+/**
+ * @brief: Stops the motor and drops the queued moves
+ *
+ * Usage:
+ *     stop
+ */
+static int cmd_stop(const struct shell *shell, size_t argc, char **argv)
+{
+    ARG_UNUSED(argc);
+    ARG_UNUSED(argv);
+
+    return post_motor_cmd(shell, MOTOR_CMD_STOP, 0);
+}
+
+/**
+ * @brief: Sets the cruise speed used by the next moves
+ *
+ * Usage:
+ *     speed <steps/s>
+ */
+static int cmd_speed(const struct shell *shell, size_t argc, char **argv)
+{
+    ARG_UNUSED(argc);
+
+    long speed;
+
+    if (parse_long_arg(argv[1], MOTOR_START_SPEED_SPS, MOTOR_MAX_SPEED_SPS, &speed) < 0) {
+        shell_print(shell, "Usage: speed <steps/s>, %d..%d", MOTOR_START_SPEED_SPS, MOTOR_MAX_SPEED_SPS);
+        return -EINVAL;
+    }
+
+    return post_motor_cmd(shell, MOTOR_CMD_SET_SPEED, (int32_t)speed);
+}
+
+static int print_feedlog_entry(const struct feedlog_entry *entry, void *user_data)
+{
+    const struct shell *shell = user_data;
+
+    shell_print(shell, "%u: %u g, %u steps in %u ms, result %d", entry->time, entry->grams, entry->steps,
+                entry->duration_ms, entry->result);
+    return 0;
+}
+
+/**
+ * @brief: Prints the dispenses logged in a time range
+ *
+ * Usage:
+ *     feedlog [<from> [<to>]]
+ */
+static int cmd_feedlog(const struct shell *shell, size_t argc, char **argv)
+{
+    struct feedlog_stats st;
+    uint32_t from = (argc > 1) ? strtoul(argv[1], NULL, 10) : 0;
+    uint32_t to = (argc > 2) ? strtoul(argv[2], NULL, 10) : UINT32_MAX;
+    int ret = feedlog_query(from, to, print_feedlog_entry, (void *)shell);
+
+    if (ret < 0) {
+        shell_error(shell, "Feed log unavailable: %d", ret);
+        return ret;
+    }
+
+    feedlog_get_stats(&st);
+    shell_print(shell, "%d records, %u sectors read, %u dropped", ret, st.sectors_read, st.dropped);
+    return 0;
+}
+
+/**
+ * @brief: Prints how long every step of the boot took
+ *
+ * Usage:
+ *     boot
+ */
+static int cmd_boot(const struct shell *shell, size_t argc, char **argv)
+{
+    ARG_UNUSED(argc);
+    ARG_UNUSED(argv);
+
+    const struct boot_phase_info *first = boot_phase_get(BOOT_PHASE_RESET_INFO);
+
+    shell_print(shell, "%-12s %10s %10s %8s %6s", "phase", "start us", "took us", "at ms", "result");
+    for (int i = 0; i < BOOT_PHASE_COUNT; i++) {
+        const struct boot_phase_info *phase = boot_phase_get(i);
+
+        if (!phase->done) {
+            shell_print(shell, "%-12s %10s", phase->name, "pending");
+            continue;
+        }
+        shell_print(shell, "%-12s %10u %10u %8u %6d", phase->name,
+                    k_cyc_to_us_near32(phase->start_cyc - first->start_cyc),
+                    k_cyc_to_us_near32(phase->end_cyc - phase->start_cyc), phase->end_ms, phase->result);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief: CPU, context switches and stack of every thread since the last `perf reset`
+ *
+ * Usage:
+ *     perf threads
+ */
+static int cmd_perf_threads(const struct shell *shell, size_t argc, char **argv)
+{
+    ARG_UNUSED(argc);
+    ARG_UNUSED(argv);
+
+    /* Too big for the shell stack, the shell runs one command at a time */
+    static struct perf_thread threads[PERF_MAX_THREADS];
+    int count = perf_threads_get(threads, ARRAY_SIZE(threads));
+
+    if (count < 0) {
+        shell_error(shell, "Thread runtime stats not enabled: %d", count);
+        return count;
+    }
+
+    shell_print(shell, "Window: %llu us", k_cyc_to_us_floor64(perf_window_cycles()));
+    shell_print(shell, "%-16s %6s %12s %9s %12s", "thread", "cpu", "us", "switches", "stack used");
+    for (int i = 0; i < count; i++) {
+        const struct perf_thread *t = &threads[i];
+
+        shell_print(shell, "%-16s %3u.%u%% %12llu %9u %5zu/%-6zu", (t->name != NULL) ? t->name : "?",
+                    t->load_pm / 10, t->load_pm % 10, k_cyc_to_us_floor64(t->cycles), t->switches,
+                    t->stack_size - t->stack_unused, t->stack_size);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief: Time spent in interrupts since the last `perf reset`
+ *
+ * Usage:
+ *     perf isr
+ */
+static int cmd_perf_isr(const struct shell *shell, size_t argc, char **argv)
+{
+    ARG_UNUSED(argc);
+    ARG_UNUSED(argv);
+
+    struct perf_isr isr;
+    int ret = perf_isr_get(&isr);
+
+    if (ret < 0) {
+        shell_error(shell, "Interrupts not traced on this build: %d", ret);
+        return ret;
+    }
+
+    shell_print(shell, "%u interrupts, %llu us (%u.%u%%), longest %u us", isr.count, k_cyc_to_us_floor64(isr.cycles),
+                isr.load_pm / 10, isr.load_pm % 10, k_cyc_to_us_near32(isr.longest_cyc));
+    return 0;
+}
+
+/**
+ * @brief: Heap and memory slab usage
+ *
+ * Usage:
+ *     perf mem
+ */
+static int cmd_perf_mem(const struct shell *shell, size_t argc, char **argv)
+{
+    ARG_UNUSED(argc);
+    ARG_UNUSED(argv);
+
+    struct perf_mem mem;
+
+    perf_mem_get(&mem);
+    shell_print(shell, "Heap: %zu used, %zu free, %zu max used", mem.heap_used, mem.heap_free, mem.heap_max_used);
+    shell_print(shell, "Slabs: %u, %u/%u blocks used, %u max used", mem.slabs, mem.slab_used, mem.slab_blocks,
+                mem.slab_max_used);
+    return 0;
+}
+
+/**
+ * @brief: Restarts the CPU, context switch and interrupt counters
+ *
+ * Usage:
+ *     perf reset
+ */
+static int cmd_perf_reset(const struct shell *shell, size_t argc, char **argv)
+{
+    ARG_UNUSED(argc);
+    ARG_UNUSED(argv);
+
+    perf_reset();
+    hist_reset_all();
+    shell_print(shell, "Perf counters and histograms cleared");
+    return 0;
+}
+
+/**
+ * @brief: Latency percentiles of every histogram, or the buckets of one of them
+ *
+ * Usage:
+ *     perf hist [<name>]
+ */
+static int cmd_perf_hist(const struct shell *shell, size_t argc, char **argv)
+{
+    struct histogram_summary sum;
+    const struct histogram *hist;
+
+    if (argc == 1) {
+        shell_print(shell, "%-12s %8s %8s %8s %8s %8s %8s", "us", "count", "p50", "p90", "p99", "p99.9", "max");
+        for (int i = 0; i < HIST_COUNT; i++) {
+            histogram_summarize(hist_get(i), &sum);
+            shell_print(shell, "%-12s %8u %8u %8u %8u %8u %8u", hist_name(i), sum.count, k_cyc_to_us_ceil32(sum.p50),
+                        k_cyc_to_us_ceil32(sum.p90), k_cyc_to_us_ceil32(sum.p99), k_cyc_to_us_ceil32(sum.p999),
+                        k_cyc_to_us_ceil32(sum.max));
+        }
+        return 0;
+    }
+
+    for (int i = 0; i < HIST_COUNT; i++) {
+        if (strcmp(argv[1], hist_name(i)) != 0) {
+            continue;
+        }
+
+        hist = hist_get(i);
+        shell_print(shell, "%12s %10s", "<= us", "count");
+        for (int b = 0; b < HIST_BUCKETS; b++) {
+            uint32_t count = (uint32_t)atomic_get(&hist->buckets[b]);
+
+            if (count > 0) {
+                shell_print(shell, "%12u %10u", k_cyc_to_us_ceil32(histogram_bucket_ceil(b)), count);
+            }
+        }
+        return 0;
+    }
+
+    shell_error(shell, "Unknown histogram %s", argv[1]);
+    return -EINVAL;
+}
+
+/**
+ * @brief: Telemetry tier from its name
+ * @return: tier, -EINVAL if unknown
+ */
+static int telemetry_tier_lookup(const char *name)
+{
+    for (int i = 0; i < TELEM_TIER_COUNT; i++) {
+        if (strcmp(name, telemetry_tier_name(i)) == 0) {
+            return i;
+        }
+    }
+    return -EINVAL;
+}
+
+/**
+ * @brief: Telemetry metric from its name
+ * @return: metric, -EINVAL if unknown
+ */
+static int telemetry_metric_lookup(const char *name)
+{
+    for (int i = 0; i < TELEM_METRIC_COUNT; i++) {
+        if (strcmp(name, telemetry_metric_name(i)) == 0) {
+            return i;
+        }
+    }
+    return -EINVAL;
+}
+
+/**
+ * @brief: History of one health metric, oldest first
+ *
+ * Usage:
+ *     telemetry <sec|min|hour> <beat_age|stack_free|battery|temperature>
+ */
+static int cmd_telemetry(const struct shell *shell, size_t argc, char **argv)
+{
+    ARG_UNUSED(argc);
+
+    /* Too big for the shell stack, the shell runs one command at a time */
+    static struct telem_point points[MAX(TELEM_SEC_POINTS, MAX(TELEM_MIN_POINTS, TELEM_HOUR_POINTS))];
+    int tier = telemetry_tier_lookup(argv[1]);
+    int metric = telemetry_metric_lookup(argv[2]);
+    uint32_t span;
+    int count;
+
+    if (tier < 0 || metric < 0) {
+        shell_error(shell, "Unknown tier or metric");
+        return -EINVAL;
+    }
+
+    count = telemetry_read(tier, metric, points, ARRAY_SIZE(points));
+    if (count < 0) {
+        return count;
+    }
+
+    span = telemetry_tier_span_s(tier);
+    shell_print(shell, "%s, %d points of %u s", argv[2], count, span);
+    shell_print(shell, "%8s %7s %7s %7s", "age s", "min", "max", "mean");
+    for (int i = 0; i < count; i++) {
+        const struct telem_point *p = &points[i];
+        uint32_t age = (count - i) * span;
+
+        if (p->min > p->max) {
+            shell_print(shell, "%8u %7s %7s %7s", age, "-", "-", "-");
+        } else {
+            shell_print(shell, "%8u %7d %7d %7d", age, p->min, p->max, p->mean);
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief: Parses a HH:MM time of day
+ * @return: seconds since midnight, negative error code otherwise
+ */
+static int parse_time_of_day(const char *str)
+{
+    char *end;
+    long hours = strtol(str, &end, 10);
+    long minutes;
+
+    if (*end != ':') {
+        return -EINVAL;
+    }
+    minutes = strtol(end + 1, &end, 10);
+    if (*end != '\0' || hours < 0 || hours > 23 || minutes < 0 || minutes > 59) {
+        return -EINVAL;
+    }
+
+    return (int)(hours * 3600 + minutes * 60);
+}
+
+/**
+ * @brief: Shows or sets the wall clock
+ *
+ * Usage:
+ *     time [<unix time>]
+ */
+static int cmd_time(const struct shell *shell, size_t argc, char **argv)
+{
+    if (argc == 2) {
+        schedule_set_time(strtoul(argv[1], NULL, 10));
+    }
+
+    shell_print(shell, "Time: %u", schedule_now());
+    return 0;
+}
+
+/**
+ * @brief: Lists the used slots of the schedule and the next event
+ *
+ * Usage:
+ *     schedule list
+ */
+static int cmd_schedule_list(const struct shell *shell, size_t argc, char **argv)
+{
+    ARG_UNUSED(argc);
+    ARG_UNUSED(argv);
+
+    static const char *const kinds[] = {"free", "daily", "weekly", "once"};
+    const struct schedule_slot *slot;
+    uint32_t due;
+    uint16_t next;
+
+    for (uint16_t i = 0; i < SCHEDULE_MAX_SLOTS; i++) {
+        slot = &cfg.schedule[i];
+        if (slot->kind == SCHEDULE_FREE || slot->kind >= ARRAY_SIZE(kinds)) {
+            continue;
+        }
+        shell_print(shell, "%3u: %-6s time %u days 0x%02x %u g", i, kinds[slot->kind], slot->time, slot->days,
+                    slot->grams);
+    }
+
+    if (schedule_next(&due, &next) == 0) {
+        shell_print(shell, "Next: slot %u at %u", next, due);
+    } else {
+        shell_print(shell, "Nothing scheduled");
+    }
+
+    return 0;
+}
+
+/**
+ * @brief: Adds a slot to the schedule, days is a bit mask with bit 0 = Monday
+ *
+ * Usage:
+ *     schedule add daily <HH:MM> <grams>
+ *     schedule add weekly <HH:MM> <grams> <days>
+ *     schedule add once <unix time> <grams>
+ */
+static int cmd_schedule_add(const struct shell *shell, size_t argc, char **argv)
+{
+    struct schedule_slot slot = {0};
+    long grams;
+    int time;
+    int ret;
+
+    if (strcmp(argv[1], "daily") == 0 && argc == 4) {
+        slot.kind = SCHEDULE_DAILY;
+    } else if (strcmp(argv[1], "weekly") == 0 && argc == 5) {
+        slot.kind = SCHEDULE_WEEKLY;
+        slot.days = (uint8_t)strtoul(argv[4], NULL, 0);
+    } else if (strcmp(argv[1], "once") == 0 && argc == 4) {
+        slot.kind = SCHEDULE_ONCE;
+    } else {
+        shell_print(shell, "Usage: schedule add <daily|weekly|once> <HH:MM|unix> <grams> [days]");
+        return -EINVAL;
+    }
+
+    if (slot.kind == SCHEDULE_ONCE) {
+        slot.time = strtoul(argv[2], NULL, 10);
+    } else {
+        time = parse_time_of_day(argv[2]);
+        if (time < 0) {
+            shell_error(shell, "Bad time of day: %s", argv[2]);
+            return time;
+        }
+        slot.time = (uint32_t)time;
+    }
+    if (parse_long_arg(argv[3], 1, MOTOR_MAX_FEED_GRAMS, &grams) < 0) {
+        shell_error(shell, "Bad amount: %s, 1..%d g", argv[3], MOTOR_MAX_FEED_GRAMS);
+        return -EINVAL;
+    }
+    slot.grams = (uint16_t)grams;
+
+    ret = schedule_add(&slot);
+    if (ret < 0) {
+        shell_error(shell, "Schedule rejected: %d", ret);
+        return ret;
+    }
+
+    shell_print(shell, "Added slot %d", ret);
+    return 0;
+}
+
+/**
+ * @brief: Removes a slot from the schedule
+ *
+ * Usage:
+ *     schedule del <slot>
+ */
+static int cmd_schedule_del(const struct shell *shell, size_t argc, char **argv)
+{
+    ARG_UNUSED(argc);
+
+    int ret = schedule_remove((uint16_t)atoi(argv[1]));
+
+    if (ret < 0) {
+        shell_error(shell, "No such slot: %s", argv[1]);
+    }
+
+    return ret;
+}
+
+/*
+ * Every command goes through a wrapper that records its run time, output included, in the shell histogram
+ */
+#define SHELL_TIMED(_handler)                                                                                          \
+    static int _handler##_timed(const struct shell *shell, size_t argc, char **argv)                                   \
+    {                                                                                                                  \
+        uint32_t start = k_cycle_get_32();                                                                             \
+        int ret = _handler(shell, argc, argv);                                                                         \
+                                                                                                                       \
+        hist_record(HIST_SHELL_CMD, k_cycle_get_32() - start);                                                         \
+        return ret;                                                                                                    \
+    }
+
+SHELL_TIMED(cmd_status)
+SHELL_TIMED(cmd_change_value)
+SHELL_TIMED(cmd_limits)
+SHELL_TIMED(cmd_feedlog)
+SHELL_TIMED(cmd_boot)
+SHELL_TIMED(cmd_reboot)
+SHELL_TIMED(cmd_commit)
+SHELL_TIMED(cmd_restore_dflt)
+SHELL_TIMED(cmd_feed)
+SHELL_TIMED(cmd_jog)
+SHELL_TIMED(cmd_stop)
+SHELL_TIMED(cmd_speed)
+SHELL_TIMED(cmd_time)
+SHELL_TIMED(cmd_schedule_list)
+SHELL_TIMED(cmd_schedule_add)
+SHELL_TIMED(cmd_schedule_del)
+SHELL_TIMED(cmd_perf_threads)
+SHELL_TIMED(cmd_perf_isr)
+SHELL_TIMED(cmd_perf_mem)
+SHELL_TIMED(cmd_perf_reset)
+SHELL_TIMED(cmd_perf_hist)
+SHELL_TIMED(cmd_telemetry)
+
 /* Register shell commands */
-SHELL_CMD_REGISTER(status, NULL, "Print relevant info", cmd_status);
-SHELL_CMD_REGISTER(value, NULL, "Change the random value", cmd_change_value);
-SHELL_CMD_REGISTER(reboot, NULL, "Colds reboots the system", cmd_reboot);
-SHELL_CMD_REGISTER(commit, NULL, "Saves the current config in the NVS", cmd_commit);
-SHELL_CMD_REGISTER(default, NULL, "Restores the default values", cmd_restore_dflt);
+SHELL_STATIC_SUBCMD_SET_CREATE(sub_schedule,
+                               SHELL_CMD(list, NULL, "Lists the feed schedule", cmd_schedule_list_timed),
+                               SHELL_CMD_ARG(add, NULL, "Adds a feed to the schedule", cmd_schedule_add_timed, 4, 1),
+                               SHELL_CMD_ARG(del, NULL, "Removes a scheduled feed", cmd_schedule_del_timed, 2, 0),
+                               SHELL_SUBCMD_SET_END);
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sub_perf,
+                               SHELL_CMD(threads, NULL, "CPU, switches and stack per thread", cmd_perf_threads_timed),
+                               SHELL_CMD(isr, NULL, "Time spent in interrupts", cmd_perf_isr_timed),
+                               SHELL_CMD(mem, NULL, "Heap and slab usage", cmd_perf_mem_timed),
+                               SHELL_CMD(reset, NULL, "Clears the counters and histograms", cmd_perf_reset_timed),
+                               SHELL_CMD_ARG(hist, NULL, "Latency percentiles [<name>]", cmd_perf_hist_timed, 1, 1),
+                               SHELL_SUBCMD_SET_END);
+
+SHELL_CMD_REGISTER(status, NULL, "Print relevant info", cmd_status_timed);
+SHELL_CMD_REGISTER(value, NULL, "Change the random value", cmd_change_value_timed);
+SHELL_CMD_REGISTER(limits, NULL, "Motor speed and acceleration", cmd_limits_timed);
+SHELL_CMD_ARG_REGISTER(feedlog, NULL, "Dispenses logged in a time range", cmd_feedlog_timed, 1, 2);
+SHELL_CMD_REGISTER(boot, NULL, "Time taken by every boot step", cmd_boot_timed);
+SHELL_CMD_REGISTER(reboot, NULL, "Colds reboots the system", cmd_reboot_timed);
+SHELL_CMD_REGISTER(commit, NULL, "Saves the current config in the NVS [now|status]", cmd_commit_timed);
+SHELL_CMD_REGISTER(default, NULL, "Restores the default values", cmd_restore_dflt_timed);
+SHELL_CMD_ARG_REGISTER(feed, NULL, "Dispenses <grams> of food", cmd_feed_timed, 2, 0);
+SHELL_CMD_ARG_REGISTER(jog, NULL, "Moves the motor <steps> steps", cmd_jog_timed, 2, 0);
+SHELL_CMD_REGISTER(stop, NULL, "Stops the motor", cmd_stop_timed);
+SHELL_CMD_ARG_REGISTER(speed, NULL, "Sets the motor speed in steps/s", cmd_speed_timed, 2, 0);
+SHELL_CMD_ARG_REGISTER(time, NULL, "Shows or sets the unix time", cmd_time_timed, 1, 1);
+SHELL_CMD_REGISTER(schedule, &sub_schedule, "Feed schedule", NULL);
+SHELL_CMD_REGISTER(perf, &sub_perf, "Runtime statistics", NULL);
+SHELL_CMD_ARG_REGISTER(telemetry, NULL, "Health history <sec|min|hour> <metric>", cmd_telemetry_timed, 3, 0);
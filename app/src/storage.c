@@ -0,0 +1,207 @@
+/**
+ * @file: storage.c
+ * @brief: Deferred config commits.
+ *
+ * Flash writes (and the NVS garbage collection they can trigger) take milliseconds, so callers only ask for a commit
+ * and the storage work queue does the write later. Requests are debounced: a burst of changes ends up as one write
+ * once things are quiet, bounded by a maximum delay so a steady stream of changes can't postpone it forever.
+ *
+ * After every commit the free room of the NVS is checked once the feeder is idle (motor stopped, link quiet). When the
+ * active sector couldn't take another full commit, its garbage collection is run right there, so the sector erase
+ * never lands in a save_config() that has to be quick, like the one right after a feed.
+ */
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <string.h>
+#include "storage.h"
+#include "configuration.h"
+#include "motor_control.h"
+#include "communication.h"
+
+LOG_MODULE_REGISTER(storage, LOG_LEVEL_INF);
+
+#define STORAGE_NO_REQUEST (-1)
+
+static void commit_handler(struct k_work *work);
+static void gc_handler(struct k_work *work);
+
+K_THREAD_STACK_DEFINE(storage_stack, STORAGE_STACK);
+static struct k_work_q storage_q;
+static K_WORK_DELAYABLE_DEFINE(commit_work, commit_handler);
+static K_WORK_DELAYABLE_DEFINE(gc_work, gc_handler);
+static struct k_spinlock commit_lock;
+static bool storage_started;
+
+static uint32_t quiet_ms = STORAGE_COMMIT_QUIET_MS;
+static int64_t first_request_ms = STORAGE_NO_REQUEST;
+static struct config_commit_status status = {.last_commit_ms = -1};
+
+static void commit_handler(struct k_work *work)
+{
+    ARG_UNUSED(work);
+
+    k_spinlock_key_t key = k_spin_lock(&commit_lock);
+    bool collected = false;
+    bool wrote = false;
+    int ret = 0;
+
+    first_request_ms = STORAGE_NO_REQUEST;
+    k_spin_unlock(&commit_lock, key);
+
+    if (config_is_dirty()) {
+        size_t free_before = config_nvs_free();
+
+        ret = save_config();
+        /* More room after writing means the write had to collect a sector */
+        collected = (config_nvs_free() > free_before);
+        /* Dirty but equal to what is stored, e.g. a value set back: nothing reached the NVS */
+        wrote = (ret == 0 && config_last_commit_bytes() > 0);
+    }
+
+    key = k_spin_lock(&commit_lock);
+    status.last_result = ret;
+    if (wrote) {
+        status.commits++;
+        status.last_commit_ms = k_uptime_get();
+        status.last_bytes = config_last_commit_bytes();
+    }
+    if (collected) {
+        status.commit_gcs++;
+    }
+    k_spin_unlock(&commit_lock, key);
+
+    if (ret < 0) {
+        LOG_ERR("Config commit failed: %d, retrying in %d ms", ret, STORAGE_COMMIT_RETRY_MS);
+        k_work_reschedule_for_queue(&storage_q, &commit_work, K_MSEC(STORAGE_COMMIT_RETRY_MS));
+        return;
+    }
+
+    k_work_reschedule_for_queue(&storage_q, &gc_work, K_MSEC(STORAGE_GC_IDLE_MS));
+}
+
+/**
+ * @brief: Runs the NVS garbage collection ahead of time, only while the feeder is idle
+ */
+static void gc_handler(struct k_work *work)
+{
+    int ret;
+
+    if (motor_is_busy() || !comm_is_idle() || k_work_delayable_is_pending(&commit_work)) {
+        k_work_reschedule_for_queue(&storage_q, k_work_delayable_from_work(work), K_MSEC(STORAGE_GC_RETRY_MS));
+        return;
+    }
+
+    ret = config_nvs_gc_if_low();
+    if (ret > 0) {
+        k_spinlock_key_t key = k_spin_lock(&commit_lock);
+
+        status.idle_gcs++;
+        k_spin_unlock(&commit_lock, key);
+    }
+}
+
+void storage_init(void)
+{
+    if (storage_started) {
+        return;
+    }
+
+    k_work_queue_start(&storage_q, storage_stack, K_THREAD_STACK_SIZEOF(storage_stack), STORAGE_PRIORITY, NULL);
+    k_thread_name_set(&storage_q.thread, "storage");
+    storage_started = true;
+
+    /* Changes requested while booting are written once the queue runs */
+    if (first_request_ms != STORAGE_NO_REQUEST) {
+        k_work_reschedule_for_queue(&storage_q, &commit_work, K_MSEC(quiet_ms));
+    }
+    /* The NVS may have been left nearly full by the previous run */
+    k_work_reschedule_for_queue(&storage_q, &gc_work, K_MSEC(STORAGE_GC_IDLE_MS));
+
+    LOG_INF("Storage queue ready, commits after %u ms of quiet", quiet_ms);
+}
+
+int storage_submit(struct k_work *work)
+{
+    if (!storage_started) {
+        return -ENODEV;
+    }
+
+    return k_work_submit_to_queue(&storage_q, work);
+}
+
+void config_commit_request(void)
+{
+    k_spinlock_key_t key = k_spin_lock(&commit_lock);
+    int64_t now = k_uptime_get();
+    int64_t deadline = now + quiet_ms;
+
+    if (first_request_ms == STORAGE_NO_REQUEST) {
+        first_request_ms = now;
+    }
+    deadline = MIN(deadline, first_request_ms + STORAGE_COMMIT_MAX_DELAY_MS);
+    status.requests++;
+    k_spin_unlock(&commit_lock, key);
+
+    if (!storage_started) {
+        return;
+    }
+
+    k_work_reschedule_for_queue(&storage_q, &commit_work, K_MSEC(MAX(deadline - now, 0)));
+}
+
+int config_commit_flush(void)
+{
+    struct k_work_sync sync;
+    int ret;
+
+    if (!storage_started) {
+        /* Too early for the queue, nobody else can be writing */
+        return config_is_dirty() ? save_config() : 0;
+    }
+
+    k_work_reschedule_for_queue(&storage_q, &commit_work, K_NO_WAIT);
+    k_work_flush_delayable(&commit_work, &sync);
+
+    k_spinlock_key_t key = k_spin_lock(&commit_lock);
+
+    ret = status.last_result;
+    k_spin_unlock(&commit_lock, key);
+
+    return ret;
+}
+
+void config_commit_set_quiet(uint32_t new_quiet_ms)
+{
+    k_spinlock_key_t key = k_spin_lock(&commit_lock);
+
+    quiet_ms = new_quiet_ms;
+    k_spin_unlock(&commit_lock, key);
+}
+
+void config_commit_get_status(struct config_commit_status *out)
+{
+    k_spinlock_key_t key = k_spin_lock(&commit_lock);
+
+    *out = status;
+    k_spin_unlock(&commit_lock, key);
+
+    out->pending = k_work_delayable_is_pending(&commit_work);
+}
+
+#ifdef SMART_FEEDER_UNIT_TEST
+void storage_reset(void)
+{
+    struct k_work_sync sync;
+
+    k_work_cancel_delayable_sync(&commit_work, &sync);
+    k_work_cancel_delayable_sync(&gc_work, &sync);
+
+    k_spinlock_key_t key = k_spin_lock(&commit_lock);
+
+    memset(&status, 0, sizeof(status));
+    status.last_commit_ms = -1;
+    first_request_ms = STORAGE_NO_REQUEST;
+    quiet_ms = STORAGE_COMMIT_QUIET_MS;
+    k_spin_unlock(&commit_lock, key);
+}
+#endif
@@ -0,0 +1,240 @@
+/**
+ * @file: telemetry.c
+ * @brief: On-device history of the health metrics.
+ *
+ * Every second the health metrics are sampled once and kept in three rings of fixed size: the last minute at one point
+ * per second, the last hour at one point per minute and the last day at one point per hour. A point holds the min, max
+ * and mean of the raw samples it covers. Each tier owns an accumulator that every raw sample updates in place, so
+ * closing a minute or an hour is a division and a copy, nothing is ever rescanned. After an incident the tooling reads
+ * the tier it needs over the link instead of streaming raw samples all the time.
+ */
+#include <zephyr/kernel.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/logging/log.h>
+#include <string.h>
+#include "telemetry.h"
+#include "check_health.h"
+#include "sensors.h"
+
+LOG_MODULE_REGISTER(telemetry, LOG_LEVEL_INF);
+
+/* Whole history, kept well under a few KiB of RAM */
+#define TELEM_RAM_BUDGET 4096
+
+struct telem_acc {
+    int32_t min;
+    int32_t max;
+    int32_t sum; /* an hour of 16 bit samples fits */
+    uint16_t count;
+};
+
+struct telem_tier_state {
+    struct telem_point *points; /* [TELEM_METRIC_COUNT][capacity] */
+    uint16_t capacity;
+    uint16_t span;   /* raw samples per point */
+    uint16_t head;   /* next point to write */
+    uint16_t count;  /* points held */
+    uint16_t filled; /* raw samples in the accumulators */
+    struct telem_acc acc[TELEM_METRIC_COUNT];
+};
+
+static struct telem_point sec_points[TELEM_METRIC_COUNT][TELEM_SEC_POINTS];
+static struct telem_point min_points[TELEM_METRIC_COUNT][TELEM_MIN_POINTS];
+static struct telem_point hour_points[TELEM_METRIC_COUNT][TELEM_HOUR_POINTS];
+
+static struct telem_tier_state tiers[TELEM_TIER_COUNT] = {
+    [TELEM_TIER_SEC] = {.points = &sec_points[0][0], .capacity = TELEM_SEC_POINTS, .span = 1},
+    [TELEM_TIER_MIN] = {.points = &min_points[0][0], .capacity = TELEM_MIN_POINTS, .span = SEC_PER_MIN},
+    [TELEM_TIER_HOUR] = {.points = &hour_points[0][0], .capacity = TELEM_HOUR_POINTS, .span = SEC_PER_HOUR},
+};
+
+BUILD_ASSERT(sizeof(sec_points) + sizeof(min_points) + sizeof(hour_points) + sizeof(tiers) <= TELEM_RAM_BUDGET,
+             "telemetry history over its RAM budget");
+
+static const char *const tier_names[TELEM_TIER_COUNT] = {
+    [TELEM_TIER_SEC] = "sec",
+    [TELEM_TIER_MIN] = "min",
+    [TELEM_TIER_HOUR] = "hour",
+};
+
+static const char *const metric_names[TELEM_METRIC_COUNT] = {
+    [TELEM_BEAT_AGE] = "beat_age",
+    [TELEM_STACK_FREE] = "stack_free",
+    [TELEM_BATTERY] = "battery",
+    [TELEM_TEMPERATURE] = "temperature",
+};
+
+static struct k_spinlock telem_lock;
+static int64_t telem_next_ms;
+
+static void telem_sample_handler(struct k_work *work);
+K_WORK_DELAYABLE_DEFINE(telem_work, telem_sample_handler);
+
+static void acc_clear(struct telem_acc *acc)
+{
+    *acc = (struct telem_acc){.min = INT16_MAX, .max = INT16_MIN};
+}
+
+/**
+ * @brief: Closes the accumulator of a metric into the next point of the tier
+ */
+static void acc_close(struct telem_tier_state *tier, int metric)
+{
+    struct telem_acc *acc = &tier->acc[metric];
+    struct telem_point *point = &tier->points[metric * tier->capacity + tier->head];
+
+    point->min = (int16_t)acc->min;
+    point->max = (int16_t)acc->max;
+    point->mean = 0;
+    if (acc->count > 0) {
+        /* Rounded to nearest */
+        point->mean = (int16_t)((acc->sum + ((acc->sum >= 0) ? 1 : -1) * acc->count / 2) / acc->count);
+    }
+    acc_clear(acc);
+}
+
+void telemetry_record(const int32_t values[TELEM_METRIC_COUNT])
+{
+    k_spinlock_key_t key = k_spin_lock(&telem_lock);
+
+    for (int t = 0; t < TELEM_TIER_COUNT; t++) {
+        struct telem_tier_state *tier = &tiers[t];
+
+        for (int m = 0; m < TELEM_METRIC_COUNT; m++) {
+            struct telem_acc *acc = &tier->acc[m];
+            int32_t value;
+
+            if (values[m] == TELEM_NO_VALUE) {
+                continue;
+            }
+
+            value = CLAMP(values[m], INT16_MIN, INT16_MAX);
+            acc->min = MIN(acc->min, value);
+            acc->max = MAX(acc->max, value);
+            acc->sum += value;
+            acc->count++;
+        }
+
+        if (++tier->filled < tier->span) {
+            continue;
+        }
+
+        for (int m = 0; m < TELEM_METRIC_COUNT; m++) {
+            acc_close(tier, m);
+        }
+        tier->filled = 0;
+        tier->head = (tier->head + 1) % tier->capacity;
+        tier->count = MIN(tier->count + 1, tier->capacity);
+    }
+
+    k_spin_unlock(&telem_lock, key);
+}
+
+int telemetry_read(enum telem_tier tier, enum telem_metric metric, struct telem_point *out, size_t max)
+{
+    const struct telem_tier_state *state;
+    k_spinlock_key_t key;
+    uint16_t first;
+    size_t count;
+
+    if (tier >= TELEM_TIER_COUNT || metric >= TELEM_METRIC_COUNT) {
+        return -EINVAL;
+    }
+
+    state = &tiers[tier];
+    key = k_spin_lock(&telem_lock);
+
+    /* The newest points are the useful ones when the caller has less room */
+    count = MIN(state->count, max);
+    first = (state->head + state->capacity - count) % state->capacity;
+    for (size_t i = 0; i < count; i++) {
+        out[i] = state->points[metric * state->capacity + (first + i) % state->capacity];
+    }
+
+    k_spin_unlock(&telem_lock, key);
+    return (int)count;
+}
+
+void telemetry_point_pack(const struct telem_point *point, uint8_t *out)
+{
+    sys_put_le16((uint16_t)point->min, &out[0]);
+    sys_put_le16((uint16_t)point->max, &out[2]);
+    sys_put_le16((uint16_t)point->mean, &out[4]);
+}
+
+uint32_t telemetry_tier_span_s(enum telem_tier tier)
+{
+    return (tier < TELEM_TIER_COUNT) ? tiers[tier].span * TELEM_PERIOD_MS / MSEC_PER_SEC : 0;
+}
+
+const char *telemetry_tier_name(enum telem_tier tier)
+{
+    return (tier < TELEM_TIER_COUNT) ? tier_names[tier] : NULL;
+}
+
+const char *telemetry_metric_name(enum telem_metric metric)
+{
+    return (metric < TELEM_METRIC_COUNT) ? metric_names[metric] : NULL;
+}
+
+/**
+ * @brief: Samples every metric, runs on the system work queue once per period
+ */
+static void telem_sample_handler(struct k_work *work)
+{
+    int32_t values[TELEM_METRIC_COUNT];
+    struct sensors_reading reading;
+    int headroom = health_stack_headroom();
+
+    values[TELEM_BEAT_AGE] = (int32_t)health_beat_age_max_ms();
+    values[TELEM_STACK_FREE] = (headroom < 0) ? TELEM_NO_VALUE : headroom;
+
+    sensors_get(&reading);
+    values[TELEM_BATTERY] = reading.valid ? reading.battery_mv : TELEM_NO_VALUE;
+    values[TELEM_TEMPERATURE] = reading.valid ? reading.temperature_dc : TELEM_NO_VALUE;
+
+    telemetry_record(values);
+
+    /* Absolute deadlines, the time spent sampling does not add up */
+    telem_next_ms += TELEM_PERIOD_MS;
+    k_work_schedule(k_work_delayable_from_work(work), K_TIMEOUT_ABS_MS(telem_next_ms));
+}
+
+/**
+ * @brief: Empties every tier
+ */
+static void telemetry_clear(void)
+{
+    k_spinlock_key_t key = k_spin_lock(&telem_lock);
+
+    for (int t = 0; t < TELEM_TIER_COUNT; t++) {
+        tiers[t].head = 0;
+        tiers[t].count = 0;
+        tiers[t].filled = 0;
+        for (int m = 0; m < TELEM_METRIC_COUNT; m++) {
+            acc_clear(&tiers[t].acc[m]);
+        }
+    }
+
+    k_spin_unlock(&telem_lock, key);
+}
+
+void telemetry_init(void)
+{
+    telemetry_clear();
+    telem_next_ms = k_uptime_get() + TELEM_PERIOD_MS;
+    k_work_schedule(&telem_work, K_TIMEOUT_ABS_MS(telem_next_ms));
+
+    LOG_INF("Telemetry history: %u B of RAM", (unsigned int)(sizeof(sec_points) + sizeof(min_points) +
+                                                              sizeof(hour_points) + sizeof(tiers)));
+}
+
+#ifdef SMART_FEEDER_UNIT_TEST
+void telemetry_reset(void)
+{
+    struct k_work_sync sync;
+
+    k_work_cancel_delayable_sync(&telem_work, &sync);
+    telemetry_clear();
+}
+#endif
@@ -3,25 +3,28 @@
  * @brief: watchdog handling.
  *
  * All the functions that focus on controlling or maninpulating the watchdog
+ *
+ * Every thread owns a task watchdog channel with its own period, the task watchdog feeds the hardware one as long as
+ * no channel starves. When one does, its callback names the thread before resetting the system.
  */
 #include <zephyr/drivers/watchdog.h>
+#include <zephyr/task_wdt/task_wdt.h>
+#include <zephyr/sys/reboot.h>
 #include <zephyr/logging/log.h>
 #include "watchdog.h"
+#include "reset_info.h"
 
 LOG_MODULE_REGISTER(watchdog, LOG_LEVEL_INF);
 
 const struct device *wdt;
-int wdt_channel_id;
+static const char *starved_thread;
 
 /* Local prototypes */
-static void wdt_callback(const struct device *dev, int channel_id);
+static void wdt_callback(int channel_id, void *user_data);
 
 int init_watchdog(void)
 {
     int ret;
-    // TODO: add a functions that prints reset stuf before reseting
-    struct wdt_timeout_cfg wdt_config = {
-        .window.min = 0, .window.max = WDT_TIMEOUT_MS, .callback = wdt_callback, .flags = WDT_FLAG_RESET_SOC};
 
     wdt = DEVICE_DT_GET(DT_ALIAS(watchdog0));
     if (!device_is_ready(wdt)) {
@@ -29,37 +32,69 @@ int init_watchdog(void)
         return -ENODEV;
     }
 
-    wdt_channel_id = wdt_install_timeout(wdt, &wdt_config);
-    if (wdt_channel_id < 0) {
-        LOG_ERR("Watchdog intall error: %d", wdt_channel_id);
-        return wdt_channel_id;
-    }
-
-    ret = wdt_setup(wdt, WDT_OPT_PAUSE_HALTED_BY_DBG);
+    starved_thread = NULL;
+    ret = task_wdt_init(wdt);
     if (ret < 0) {
-        LOG_ERR("Watchdog setup error: %d", ret);
+        LOG_ERR("Task watchdog init error: %d", ret);
         return ret;
     }
 
-    LOG_INF("Watchdog initialized with %dms timeout", WDT_TIMEOUT_MS);
+    LOG_INF("Task watchdog initialized");
     return 0;
 }
 
-void watchdog_feed(void)
+int watchdog_add_channel(const char *name, uint32_t period_ms)
+{
+    int channel = task_wdt_add(period_ms, wdt_callback, (void *)name);
+
+    if (channel < 0) {
+        LOG_ERR("No watchdog channel for %s: %d", name, channel);
+        return channel;
+    }
+
+    LOG_INF("Watchdog channel %d for %s, %u ms", channel, name, period_ms);
+    return channel;
+}
+
+void watchdog_feed(int channel)
 {
-    wdt_feed(wdt, wdt_channel_id);
+    if (channel >= 0) {
+        task_wdt_feed(channel);
+    }
 }
 
 /**
- * @brief: function that is called when the watchdog is activated.
+ * @brief: function that is called when a channel starves.
  */
-static void wdt_callback(const struct device *dev, int channel_id)
+static void wdt_callback(int channel_id, void *user_data)
 {
     LOG_ERR("!!! WATCHDOG TIMEOUT !!! System will reset NOW");
-    LOG_ERR("Channel: %d", channel_id);
+    LOG_ERR("Channel: %d (%s)", channel_id, (const char *)user_data);
+    starved_thread = user_data;
+    reset_info_set_culprit(user_data);
+
+#ifndef SMART_FEEDER_UNIT_TEST
+    LOG_PANIC();
+    sys_reboot(SYS_REBOOT_COLD);
+#endif
 }
 
 void watchdog_disable(void)
 {
+    for (int i = 0; i < CONFIG_TASK_WDT_CHANNELS; i++) {
+        task_wdt_delete(i);
+    }
     wdt_disable(wdt);
 }
+
+#ifdef SMART_FEEDER_UNIT_TEST
+const char *watchdog_starved_thread(void)
+{
+    return starved_thread;
+}
+
+void watchdog_clear_starved(void)
+{
+    starved_thread = NULL;
+}
+#endif
@@ -0,0 +1,75 @@
+#!/usr/bin/env python3
+"""Compares the benchmark medians of a twister run against a stored baseline.
+
+The benchmark suite prints one "bench:" JSON line per benchmark, twister records them in twister.json. A median
+slower than the baseline by more than the tolerance fails, --update stores the run as the new baseline. The suite is
+built once per mode (threads, event_loop), results are keyed "mode/name".
+
+Without a baseline file, or for a benchmark missing from it, the medians are only reported: the first run on the
+reference runner gives the numbers to store with --update and commit.
+"""
+import argparse
+import json
+import sys
+from pathlib import Path
+
+
+def load_results(outdir):
+    """Returns {"mode/name": record} for every benchmark recorded in the twister report."""
+    report = json.loads((Path(outdir) / "twister.json").read_text())
+    results = {}
+
+    for suite in report.get("testsuites", []):
+        for entry in suite.get("recording") or []:
+            bench = entry.get("bench")
+            if isinstance(bench, str):
+                bench = json.loads(bench)
+            if bench:
+                results[f"{bench.get('mode', 'threads')}/{bench['name']}"] = bench
+
+    return results
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("outdir", help="twister output directory")
+    parser.add_argument("baseline", help="baseline JSON file, {mode/name: median}")
+    parser.add_argument("--tolerance", type=float, default=1.5, help="allowed ratio to the baseline")
+    parser.add_argument("--update", action="store_true", help="store this run as the baseline")
+    args = parser.parse_args()
+
+    results = load_results(args.outdir)
+    if not results:
+        print("No benchmark results in the twister report")
+        return 1
+
+    baseline_path = Path(args.baseline)
+    if args.update:
+        baseline = {name: r["median"] for name, r in sorted(results.items())}
+        baseline_path.write_text(json.dumps(baseline, indent=2) + "\n")
+        print(f"Baseline of {len(baseline)} benchmarks written to {baseline_path}")
+        return 0
+
+    baseline = json.loads(baseline_path.read_text()) if baseline_path.exists() else {}
+    failed = False
+
+    print(f"{'benchmark':<36}{'median':>12}{'baseline':>12}{'ratio':>8}")
+    for name, r in sorted(results.items()):
+        ref = baseline.get(name)
+        if not ref:
+            print(f"{name:<36}{r['median']:>12}{'-':>12}{'-':>8}  no baseline, not compared")
+            continue
+
+        ratio = r["median"] / ref
+        regressed = ratio > args.tolerance
+        failed |= regressed
+        print(f"{name:<36}{r['median']:>12}{ref:>12}{ratio:>8.2f}{'  REGRESSED' if regressed else ''}")
+
+    if not baseline:
+        print(f"No baseline at {baseline_path}, medians reported only, store them with --update")
+
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
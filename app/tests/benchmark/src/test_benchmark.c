@@ -0,0 +1,285 @@
+#include <zephyr/kernel.h>
+#include <zephyr/ztest.h>
+#include <zephyr/shell/shell.h>
+#include <zephyr/shell/shell_dummy.h>
+#include <string.h>
+#include "configuration.h"
+#include "check_health.h"
+#include "communication.h"
+#include "motor_control.h"
+#include "perf.h"
+#include "event_loop.h"
+#include "bench_clock.h"
+
+/*
+ * Every benchmark is warmed up, then timed over BENCH_ROUNDS rounds of many operations. One "bench:" JSON line per
+ * benchmark is recorded by twister, tests/benchmark/compare_baseline.py checks the medians against the stored
+ * baseline. The ceilings below only catch an order of magnitude, the baseline catches the drift.
+ *
+ * The suite is built twice, with the motor, comm and health threads and with CONFIG_FEEDER_EVENT_LOOP. Every line
+ * names its mode so both runs are compared side by side.
+ */
+
+#ifdef CONFIG_FEEDER_EVENT_LOOP
+#define BENCH_MODE "event_loop"
+#else
+#define BENCH_MODE "threads"
+#endif
+
+#define BENCH_ROUNDS      7
+#define BENCH_WARMUP_DIV  4 /* warm-up runs a quarter of a round */
+#define HOP_THREADS       3
+#define HOP_STACK         512
+#define BEAT_OPS          100000
+#define HEALTHY_OPS       100000
+#define SHELL_OPS         2000
+#define CONFIG_OPS        100
+#define HOP_LAPS          5000
+#define BEAT_MAX_NS       2000
+#define HEALTHY_MAX_NS    1000
+#define SHELL_MAX_NS      (500 * NSEC_PER_USEC)
+#define CONFIG_MAX_NS     (5 * NSEC_PER_MSEC)
+#define HOP_MAX_NS        (200 * NSEC_PER_USEC)
+#define IDLE_SETTLE_MS    100
+#define IDLE_WINDOW_MS    (10 * MSEC_PER_SEC)
+#define IDLE_MAX_SWITCHES 20 /* per second, the threads mode wakes up 9 times */
+
+static const struct shell *sh;
+static health_handle_t bench_health;
+static volatile bool healthy_sink;
+
+/* Stand-ins for the motor, comm and health threads: same priorities, handing a token around */
+static const int hop_priorities[HOP_THREADS] = {MOTOR_CTRL_PRIORITY, COMMUNICATION_PRIORITY, CHECK_HEALTH_PRIORITY};
+K_THREAD_STACK_ARRAY_DEFINE(hop_stacks, HOP_THREADS, HOP_STACK);
+static struct k_thread hop_threads[HOP_THREADS];
+static struct k_sem hop_sems[HOP_THREADS];
+static K_SEM_DEFINE(hop_done, 0, 1);
+static uint32_t hop_laps_left;
+
+/* Threads of the motor, comm and health subsystems in either mode */
+static const char *const subsystem_threads[] = {"motor", "communication", "check_health", "event_loop"};
+static struct perf_thread perf_snapshot[PERF_MAX_THREADS];
+
+/**
+ * @brief: Times an operation and prints one JSON line
+ * @param: op Runs count operations
+ * @param: units Cost units per operation, the result is divided by it
+ * @return: median of the rounds, ns per unit
+ */
+static uint64_t bench_run(const char *name, void (*op)(uint32_t count), uint32_t count, uint32_t units)
+{
+    uint64_t ns[BENCH_ROUNDS];
+
+    op(MAX(count / BENCH_WARMUP_DIV, 1));
+
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        uint64_t start = bench_now_us();
+
+        op(count);
+        ns[r] = (bench_now_us() - start) * NSEC_PER_USEC / ((uint64_t)count * units);
+    }
+
+    /* Insertion sort, a handful of rounds */
+    for (int i = 1; i < BENCH_ROUNDS; i++) {
+        uint64_t v = ns[i];
+        int j = i;
+
+        for (; j > 0 && ns[j - 1] > v; j--) {
+            ns[j] = ns[j - 1];
+        }
+        ns[j] = v;
+    }
+
+    TC_PRINT("bench: {\"name\":\"%s\",\"mode\":\"%s\",\"unit\":\"ns\",\"ops\":%u,\"rounds\":%d,\"min\":%llu,"
+             "\"median\":%llu,\"max\":%llu}\n",
+             name, BENCH_MODE, count * units, BENCH_ROUNDS, ns[0], ns[BENCH_ROUNDS / 2], ns[BENCH_ROUNDS - 1]);
+
+    return ns[BENCH_ROUNDS / 2];
+}
+
+/**
+ * @brief: Prints one JSON line for a figure measured once, lower is better like the timings
+ */
+static void bench_report(const char *name, const char *unit, uint64_t value)
+{
+    TC_PRINT("bench: {\"name\":\"%s\",\"mode\":\"%s\",\"unit\":\"%s\",\"ops\":1,\"rounds\":1,\"min\":%llu,"
+             "\"median\":%llu,\"max\":%llu}\n",
+             name, BENCH_MODE, unit, value, value, value);
+}
+
+static bool is_subsystem_thread(const char *name)
+{
+    for (int i = 0; name != NULL && i < ARRAY_SIZE(subsystem_threads); i++) {
+        if (strcmp(name, subsystem_threads[i]) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void hop_thread(void *p1, void *p2, void *p3)
+{
+    ARG_UNUSED(p2);
+    ARG_UNUSED(p3);
+
+    int idx = (int)(uintptr_t)p1;
+
+    while (1) {
+        k_sem_take(&hop_sems[idx], K_FOREVER);
+        if (idx == 0 && hop_laps_left-- == 0) {
+            k_sem_give(&hop_done);
+            continue;
+        }
+        k_sem_give(&hop_sems[(idx + 1) % HOP_THREADS]);
+    }
+}
+
+static void op_beat(uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++) {
+        thread_report_alive(bench_health);
+    }
+}
+
+static void op_healthy(uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++) {
+        healthy_sink = is_system_healthy();
+    }
+}
+
+static void op_shell(uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++) {
+        zassert_ok(shell_execute_cmd(sh, "value"));
+        shell_backend_dummy_clear_output(sh);
+    }
+}
+
+static void op_save(uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++) {
+        /* Only changed fields are written, every save has one */
+        cfg.random_value++;
+        zassert_ok(save_config());
+    }
+}
+
+static void op_load(uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++) {
+        zassert_ok(load_config());
+    }
+}
+
+static void op_hop(uint32_t count)
+{
+    hop_laps_left = count;
+    k_sem_give(&hop_sems[0]);
+    zassert_ok(k_sem_take(&hop_done, K_SECONDS(10)), "the token got lost");
+}
+
+static void *benchmark_setup(void)
+{
+    sh = shell_backend_dummy_get_ptr();
+    zassert_not_null(sh, "no dummy shell backend");
+
+    zassert_ok(init_nvs(), "NVS initialization failed");
+    set_dflt_cfg();
+    zassert_ok(save_config());
+
+    bench_health = health_register("bench", MSEC_PER_SEC);
+    zassert_true(bench_health >= 0, NULL);
+
+    for (int i = 0; i < HOP_THREADS; i++) {
+        k_sem_init(&hop_sems[i], 0, 1);
+        k_thread_create(&hop_threads[i], hop_stacks[i], K_THREAD_STACK_SIZEOF(hop_stacks[i]), hop_thread,
+                        (void *)(uintptr_t)i, NULL, NULL, hop_priorities[i], 0, K_NO_WAIT);
+    }
+
+    return NULL;
+}
+
+ZTEST(benchmark, test_thread_report_alive)
+{
+    uint64_t ns = bench_run("thread_report_alive", op_beat, BEAT_OPS, 1);
+
+    zassert_true(ns < BEAT_MAX_NS, "%llu ns per report", ns);
+}
+
+ZTEST(benchmark, test_is_system_healthy)
+{
+    uint64_t ns = bench_run("is_system_healthy", op_healthy, HEALTHY_OPS, 1);
+
+    zassert_true(ns < HEALTHY_MAX_NS, "%llu ns per check", ns);
+}
+
+ZTEST(benchmark, test_shell_dispatch)
+{
+    uint64_t ns = bench_run("shell_dispatch", op_shell, SHELL_OPS, 1);
+
+    zassert_true(ns < SHELL_MAX_NS, "%llu ns per command", ns);
+}
+
+/* Against the flash simulator, the NVS garbage collection is part of the average */
+ZTEST(benchmark, test_save_config)
+{
+    uint64_t ns = bench_run("save_config", op_save, CONFIG_OPS, 1);
+
+    zassert_true(ns < CONFIG_MAX_NS, "%llu ns per save", ns);
+}
+
+ZTEST(benchmark, test_load_config)
+{
+    uint64_t ns = bench_run("load_config", op_load, CONFIG_OPS, 1);
+
+    zassert_true(ns < CONFIG_MAX_NS, "%llu ns per load", ns);
+}
+
+ZTEST(benchmark, test_context_switch)
+{
+    uint64_t ns = bench_run("context_switch", op_hop, HOP_LAPS, HOP_THREADS);
+
+    zassert_true(ns < HOP_MAX_NS, "%llu ns per switch", ns);
+}
+
+/* What the event loop is for: stack RAM reserved by the subsystems and their wake-ups while nothing happens */
+ZTEST(benchmark, test_subsystems_idle)
+{
+    uint64_t stack_bytes = 0;
+    uint64_t switches = 0;
+    int count;
+
+    start_motor_control_thread();
+    start_check_health_thread();
+    start_comm_thread();
+    k_msleep(IDLE_SETTLE_MS);
+
+    perf_reset();
+    k_msleep(IDLE_WINDOW_MS);
+    count = perf_threads_get(perf_snapshot, ARRAY_SIZE(perf_snapshot));
+
+    stop_motor_control_thread();
+    stop_check_health_thread();
+    stop_comm_thread();
+#ifdef CONFIG_FEEDER_EVENT_LOOP
+    stop_event_loop();
+#endif
+
+    zassert_true(count > 0, "no runtime stats: %d", count);
+    for (int i = 0; i < count; i++) {
+        if (is_subsystem_thread(perf_snapshot[i].name)) {
+            stack_bytes += perf_snapshot[i].stack_size;
+            switches += perf_snapshot[i].switches;
+        }
+    }
+    switches = switches * MSEC_PER_SEC / IDLE_WINDOW_MS;
+
+    bench_report("subsystem_stacks", "B", stack_bytes);
+    bench_report("idle_switches", "per_s", switches);
+
+    zassert_true(stack_bytes > 0, "no subsystem thread found");
+    zassert_true(switches <= IDLE_MAX_SWITCHES, "%llu switches per second while idle", switches);
+}
+
+ZTEST_SUITE(benchmark, NULL, benchmark_setup, NULL, NULL, NULL);
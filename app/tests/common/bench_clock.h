@@ -0,0 +1,22 @@
+#ifndef BENCH_CLOCK_H
+#define BENCH_CLOCK_H
+
+#include <stdint.h>
+#include <zephyr/kernel.h>
+
+#if defined(CONFIG_ARCH_POSIX)
+/* native_sim time only advances on timers, so CPU bound work has to be measured with the host clock */
+#include "native_rtc.h"
+
+static inline uint64_t bench_now_us(void)
+{
+    return native_rtc_gettime_us(RTC_CLOCK_REALTIME);
+}
+#else
+static inline uint64_t bench_now_us(void)
+{
+    return k_cyc_to_us_floor64(k_cycle_get_64());
+}
+#endif
+
+#endif
@@ -0,0 +1,262 @@
+#include <zephyr/kernel.h>
+#include <zephyr/ztest.h>
+#include <zephyr/drivers/uart.h>
+#include <zephyr/drivers/serial/uart_emul.h>
+#include <string.h>
+#include "init.h"
+#include "motor_control.h"
+#include "configuration.h"
+#include "check_health.h"
+#include "watchdog.h"
+#include "communication.h"
+#include "protocol.h"
+
+/*
+ * Every case injects one fault into the running system, then polls how long it takes for is_system_healthy() to go
+ * false and for the task watchdog to name the starved thread. One "fault_latency:" line per case is recorded by
+ * twister, and a latency over its budget fails the case.
+ */
+
+#define FAULT_POLL_MS       2
+#define FAULT_SLACK_MS      (2 * FAULT_POLL_MS + 10) /* polling plus tick rounding */
+#define FAULT_NONE          (-1)
+#define RECOVER_BUDGET_MS   (2 * HEALTH_WDT_FEED_MS)
+#define BUSY_SLICE_US       100
+#define FLOOD_PRIORITY      (COMMUNICATION_PRIORITY - 1)
+#define FLOOD_FRAMES_PER_MS 8 /* about 5 times what 115200 baud can carry */
+#define FLOOD_WINDOW_MS     (2 * COMM_WDT_PERIOD_MS)
+#define STARVE_WINDOW_MS    (HEALTH_WDT_PERIOD_MS + HEALTH_WDT_FEED_MS)
+#define FAULT_STACK         1024
+
+struct fault_result {
+    int32_t unhealthy_ms;
+    int32_t watchdog_ms;
+    const char *starved;
+};
+
+static const struct device *const uart = DEVICE_DT_GET(DT_CHOSEN(feeder_comm_uart));
+
+K_THREAD_STACK_DEFINE(fault_stack, FAULT_STACK);
+static struct k_thread fault_thread_data;
+static atomic_t fault_stop;
+static uint32_t flood_dropped;
+
+struct thread_lookup {
+    const char *name;
+    k_tid_t tid;
+};
+
+static void match_name(const struct k_thread *thread, void *user_data)
+{
+    struct thread_lookup *lookup = user_data;
+    const char *name = k_thread_name_get((k_tid_t)thread);
+
+    if (name != NULL && strcmp(name, lookup->name) == 0) {
+        lookup->tid = (k_tid_t)thread;
+    }
+}
+
+static k_tid_t thread_by_name(const char *name)
+{
+    struct thread_lookup lookup = {.name = name};
+
+    k_thread_foreach(match_name, &lookup);
+    return lookup.tid;
+}
+
+/**
+ * @brief: Polls the health flag and the task watchdog from the moment the fault was injected
+ * @param: window_ms How long to wait for both, a detection that never came reads FAULT_NONE
+ */
+static void measure(int64_t injected_ms, uint32_t window_ms, struct fault_result *res)
+{
+    int64_t elapsed = 0;
+
+    *res = (struct fault_result){.unhealthy_ms = FAULT_NONE, .watchdog_ms = FAULT_NONE};
+
+    while (elapsed < window_ms && (res->unhealthy_ms == FAULT_NONE || res->watchdog_ms == FAULT_NONE)) {
+        k_msleep(FAULT_POLL_MS);
+        elapsed = k_uptime_get() - injected_ms;
+
+        if (res->unhealthy_ms == FAULT_NONE && !is_system_healthy()) {
+            res->unhealthy_ms = (int32_t)elapsed;
+        }
+        if (res->watchdog_ms == FAULT_NONE && watchdog_starved_thread() != NULL) {
+            res->watchdog_ms = (int32_t)elapsed;
+            res->starved = watchdog_starved_thread();
+        }
+    }
+}
+
+static void report(const char *name, const struct fault_result *res)
+{
+    TC_PRINT("fault_latency: case=%s unhealthy_ms=%d watchdog_ms=%d starved=%s\n", name, res->unhealthy_ms,
+             res->watchdog_ms, (res->starved != NULL) ? res->starved : "none");
+}
+
+/**
+ * @brief: Waits for every thread to report again and forgets the watchdog verdict of the last case
+ */
+static void recover(void)
+{
+    int64_t deadline = k_uptime_get() + RECOVER_BUDGET_MS;
+
+    while (!is_system_healthy() && k_uptime_get() < deadline) {
+        k_msleep(FAULT_POLL_MS);
+    }
+    zassert_true(is_system_healthy(), "the system did not recover within %d ms", RECOVER_BUDGET_MS);
+
+    /* An expired channel fires again on every feed until its own thread feeds it */
+    k_msleep(COMM_HEARTBEAT_MS);
+    watchdog_clear_starved();
+}
+
+static void busy_loop(void *p1, void *p2, void *p3)
+{
+    ARG_UNUSED(p1);
+    ARG_UNUSED(p2);
+    ARG_UNUSED(p3);
+
+    /* Never blocks: time only moves and interrupts only fire while busy waiting */
+    while (!atomic_get(&fault_stop)) {
+        k_busy_wait(BUSY_SLICE_US);
+    }
+}
+
+static void ping_flood(void *p1, void *p2, void *p3)
+{
+    ARG_UNUSED(p1);
+    ARG_UNUSED(p2);
+    ARG_UNUSED(p3);
+
+    uint8_t frame[PROTO_MAX_ENCODED];
+    uint8_t seq = 0;
+
+    while (!atomic_get(&fault_stop)) {
+        for (int i = 0; i < FLOOD_FRAMES_PER_MS; i++) {
+            int len = proto_encode(PROTO_PING, seq++, NULL, 0, frame, sizeof(frame));
+
+            if (len > 0 && uart_emul_put_rx_data(uart, frame, len) < (uint32_t)len) {
+                flood_dropped++;
+            }
+        }
+        /* Nobody reads the ACKs */
+        uart_emul_flush_tx_data(uart);
+        k_msleep(1);
+    }
+}
+
+static void start_fault_thread(k_thread_entry_t entry, int priority)
+{
+    atomic_clear(&fault_stop);
+    k_thread_create(&fault_thread_data, fault_stack, K_THREAD_STACK_SIZEOF(fault_stack), entry, NULL, NULL, NULL,
+                    priority, 0, K_NO_WAIT);
+}
+
+static void stop_fault_thread(void)
+{
+    atomic_set(&fault_stop, 1);
+    zassert_ok(k_thread_join(&fault_thread_data, K_MSEC(RECOVER_BUDGET_MS)), "fault thread did not stop");
+}
+
+static void *faults_setup(void)
+{
+    zassert_true(device_is_ready(uart), "UART emulator not ready");
+    zassert_ok(init_nvs(), "NVS initialization failed");
+    zassert_ok(processes_init());
+    zassert_ok(processes_wait_ready(K_MSEC(BOOT_READY_BUDGET_MS)), "config not loaded within the boot budget");
+
+    protocol_init();
+    start_motor_control_thread();
+    start_check_health_thread();
+    start_comm_thread();
+
+    return NULL;
+}
+
+static void faults_before(void *fixture)
+{
+    ARG_UNUSED(fixture);
+
+    recover();
+}
+
+static void faults_teardown(void *fixture)
+{
+    ARG_UNUSED(fixture);
+
+    watchdog_disable();
+    stop_motor_control_thread();
+    stop_check_health_thread();
+    stop_comm_thread();
+}
+
+/* The motor thread hangs, as if stuck on a driver call: both detections run from timers, nothing needs it */
+ZTEST(faults, test_motor_blocked)
+{
+    k_tid_t motor = thread_by_name("motor");
+    struct fault_result res;
+    int64_t injected;
+
+    zassert_not_null(motor, "motor thread not found");
+
+    k_thread_suspend(motor);
+    injected = k_uptime_get();
+    measure(injected, MOTOR_WDT_PERIOD_MS + FAULT_SLACK_MS, &res);
+    k_thread_resume(motor);
+
+    report("motor_blocked", &res);
+    zassert_true(res.unhealthy_ms != FAULT_NONE && res.unhealthy_ms <= MOTOR_HEALTH_TIMEOUT_MS + FAULT_SLACK_MS,
+                 "stall flagged after %d ms, budget %d ms", res.unhealthy_ms, MOTOR_HEALTH_TIMEOUT_MS);
+    zassert_true(res.watchdog_ms != FAULT_NONE && res.watchdog_ms <= MOTOR_WDT_PERIOD_MS + FAULT_SLACK_MS,
+                 "watchdog after %d ms, budget %d ms", res.watchdog_ms, MOTOR_WDT_PERIOD_MS);
+    zassert_str_equal(res.starved, "motor_control", NULL);
+}
+
+/* Frames keep the comm thread busy, it must keep up and never be mistaken for a stalled one */
+ZTEST(faults, test_comm_flooded)
+{
+    struct proto_stats before;
+    struct proto_stats after;
+    struct fault_result res;
+    int64_t injected;
+
+    proto_get_stats(&before);
+    flood_dropped = 0;
+
+    start_fault_thread(ping_flood, FLOOD_PRIORITY);
+    injected = k_uptime_get();
+    measure(injected, FLOOD_WINDOW_MS, &res);
+    stop_fault_thread();
+
+    proto_get_stats(&after);
+    report("comm_flooded", &res);
+    TC_PRINT("comm_flooded: %u frames handled, %u dropped by the UART\n", after.frames_ok - before.frames_ok,
+             flood_dropped);
+
+    zassert_true(after.frames_ok > before.frames_ok, "no frame got through");
+    zassert_equal(res.unhealthy_ms, FAULT_NONE, "busy comm thread flagged after %d ms", res.unhealthy_ms);
+    zassert_equal(res.watchdog_ms, FAULT_NONE, "watchdog fired on %s", res.starved);
+}
+
+/*
+ * A busy loop at the priority of the health thread: the threads above it still report, so only the health thread's
+ * own watchdog channel can catch it
+ */
+ZTEST(faults, test_health_starved)
+{
+    struct fault_result res;
+    int64_t injected;
+
+    start_fault_thread(busy_loop, CHECK_HEALTH_PRIORITY);
+    injected = k_uptime_get();
+    measure(injected, STARVE_WINDOW_MS, &res);
+    stop_fault_thread();
+
+    report("health_starved", &res);
+    zassert_true(res.watchdog_ms != FAULT_NONE && res.watchdog_ms <= HEALTH_WDT_PERIOD_MS + FAULT_SLACK_MS,
+                 "watchdog after %d ms, budget %d ms", res.watchdog_ms, HEALTH_WDT_PERIOD_MS);
+    zassert_str_equal(res.starved, "check_health", NULL);
+}
+
+ZTEST_SUITE(faults, NULL, faults_setup, faults_before, NULL, faults_teardown);
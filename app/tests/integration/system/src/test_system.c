@@ -7,26 +7,33 @@
 #include "watchdog.h"
 #include "communication.h"
 
+#define SYSTEM_JOG_STEPS 100
+
 ZTEST(smart_feeder_integration, test_system_threads)
 {
     int ret = init_nvs();
     zassert_equal(ret, 0, "NVS initialization failed");
 
-    processes_init();
+    zassert_ok(processes_init());
+    zassert_ok(processes_wait_ready(K_MSEC(BOOT_READY_BUDGET_MS)), "config not loaded within the boot budget");
 
     start_motor_control_thread();
     start_check_health_thread();
     start_comm_thread();
 
-    for (int i = 0; i < 11; i++) {
-        k_msleep(100);
-        watchdog_feed();
-    }
+    /* The second move waits for the first one, with the threads or the event loop alike */
+    zassert_ok(motor_cmd_post(MOTOR_SRC_SHELL, MOTOR_CMD_JOG, SYSTEM_JOG_STEPS));
+    zassert_ok(motor_cmd_post(MOTOR_SRC_SHELL, MOTOR_CMD_JOG, -SYSTEM_JOG_STEPS));
+
+    /* Every thread feeds its own watchdog channel, the system must stay up on its own */
+    k_msleep(1100);
 
     watchdog_disable();
 
     zassert_true(k_uptime_get() > 0, "System should be running");
     zassert_true(is_system_healthy(), "System reported unhealthy state");
+    zassert_false(motor_is_busy(), "queued moves not done");
+    zassert_true(motor_cmd_latency_cyc() > 0, "the motor never moved");
 
 #ifdef SMART_FEEDER_UNIT_TEST
     stop_motor_control_thread();
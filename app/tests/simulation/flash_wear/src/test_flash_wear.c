@@ -0,0 +1,295 @@
+#include <zephyr/ztest.h>
+#include <zephyr/fff.h>
+#include <zephyr/fs/nvs.h>
+#include <zephyr/drivers/flash.h>
+#include <zephyr/storage/flash_map.h>
+#include <string.h>
+#include "configuration.h"
+#include "feedlog.h"
+#include "storage.h"
+
+/*
+ * Years of config commits, schedule edits and dispenses, replayed against the flash simulator. The config NVS goes
+ * through a shim of the flash driver that counts the erases of every sector and the bytes of every call, the time a
+ * save would take on the real chip is modeled from those. One "flash_wear:" JSON line per run is recorded by twister,
+ * so sector counts and record layouts can be compared before a schema change ships.
+ */
+
+DEFINE_FFF_GLOBALS;
+
+FAKE_VALUE_FUNC(uint32_t, schedule_now);
+FAKE_VALUE_FUNC(int, storage_submit, struct k_work *);
+
+/* Workload of a busy feeder */
+#define WEAR_YEARS             5
+#define WEAR_DAYS              (WEAR_YEARS * 365)
+#define WEAR_COMMITS_PER_DAY   4 /* value or limits changed from the shell or the link */
+#define WEAR_SCHEDULE_EDIT_DAY 7 /* one schedule slot changed every week */
+#define WEAR_FEEDS_PER_DAY     8
+#define WEAR_MIN_LIFETIME      10 /* years the shipped layout has to last */
+
+/* Typical SPI NOR figures */
+#define FLASH_ENDURANCE       100000 /* erase cycles per sector */
+#define FLASH_ERASE_US        45000  /* one 4 KiB sector */
+#define FLASH_WRITE_US        30     /* command overhead of a program call */
+#define FLASH_PROG_NS_PER_B   2700   /* 256 B page programmed in 0.7 ms */
+#define WEAR_MAX_SECTORS      16
+#define FEEDLOG_FLASH_WRITE   16 /* a log sector header or record */
+#define START_TIME            1767225600U /* 2026-01-01 00:00:00 UTC */
+
+#define STORAGE_OFFSET FIXED_PARTITION_OFFSET(storage_partition)
+#define STORAGE_SIZE   FIXED_PARTITION_SIZE(storage_partition)
+
+extern struct nvs_fs fs;
+
+static const struct device *const flash = FIXED_PARTITION_DEVICE(storage_partition);
+static const struct flash_driver_api *flash_api;
+static struct flash_driver_api wear_api;
+static struct device wear_dev;
+static uint32_t sector_size;
+static uint32_t sector_erases[WEAR_MAX_SECTORS];
+static uint32_t sim_time;
+
+/* Flash work of the save being measured */
+static struct {
+    uint32_t erases;
+    uint32_t writes;
+    uint32_t bytes;
+} op;
+
+struct wear_run {
+    const char *layout;
+    int (*save)(void);
+    uint16_t sectors;
+    bool idle_gc; /* the storage queue collects ahead of time after every commit */
+    uint32_t saves;
+    uint32_t gc_saves; /* saves that had to erase a sector */
+    uint32_t max_erases;
+    uint32_t total_erases;
+    uint32_t worst_us;
+    uint64_t sum_us;
+};
+
+static int wear_read(const struct device *dev, off_t offset, void *data, size_t len)
+{
+    ARG_UNUSED(dev);
+
+    return flash_api->read(flash, offset, data, len);
+}
+
+static int wear_write(const struct device *dev, off_t offset, const void *data, size_t len)
+{
+    ARG_UNUSED(dev);
+
+    op.writes++;
+    op.bytes += len;
+    return flash_api->write(flash, offset, data, len);
+}
+
+static int wear_erase(const struct device *dev, off_t offset, size_t size)
+{
+    ARG_UNUSED(dev);
+
+    for (off_t off = offset; off < offset + (off_t)size; off += sector_size) {
+        uint32_t s = (off - STORAGE_OFFSET) / sector_size;
+
+        if (s < WEAR_MAX_SECTORS) {
+            sector_erases[s]++;
+        }
+        op.erases++;
+    }
+    return flash_api->erase(flash, offset, size);
+}
+
+static uint32_t fake_now(void)
+{
+    return sim_time;
+}
+
+static int submit_to_system_queue(struct k_work *work)
+{
+    return k_work_submit(work);
+}
+
+/**
+ * @brief: What the current layout writes: one entry per changed field
+ */
+static int save_per_field(void)
+{
+    return save_config();
+}
+
+/**
+ * @brief: What firmware before the schema table wrote: the whole struct as one entry
+ */
+static int save_blob(void)
+{
+    ssize_t ret = nvs_write(&fs, CFG_NVS_ID_LEGACY, &cfg, sizeof(cfg));
+
+    return (ret < 0) ? (int)ret : 0;
+}
+
+static uint32_t modeled_us(void)
+{
+    return op.erases * FLASH_ERASE_US + op.writes * FLASH_WRITE_US +
+           (uint32_t)((uint64_t)op.bytes * FLASH_PROG_NS_PER_B / NSEC_PER_USEC);
+}
+
+static uint32_t lifetime_years(uint32_t max_erases)
+{
+    return (max_erases == 0) ? UINT32_MAX : (uint32_t)((uint64_t)FLASH_ENDURANCE * WEAR_YEARS / max_erases);
+}
+
+static void timed_save(struct wear_run *run)
+{
+    uint32_t us;
+
+    memset(&op, 0, sizeof(op));
+    zassert_ok(run->save(), "save %u failed", run->saves);
+
+    us = modeled_us();
+    run->saves++;
+    run->gc_saves += (op.erases > 0) ? 1 : 0;
+    run->worst_us = MAX(run->worst_us, us);
+    run->sum_us += us;
+
+    if (run->idle_gc) {
+        zassert_true(config_nvs_gc_if_low() >= 0, NULL);
+    }
+}
+
+/**
+ * @brief: Replays the whole workload on a freshly erased partition
+ */
+static void run_config(struct wear_run *run)
+{
+    zassert_ok(flash_erase(flash, STORAGE_OFFSET, STORAGE_SIZE));
+    memset(sector_erases, 0, sizeof(sector_erases));
+
+    set_dflt_cfg();
+    zassert_ok(config_nvs_remount(&wear_dev, run->sectors));
+
+    for (uint32_t day = 0; day < WEAR_DAYS; day++) {
+        for (int c = 0; c < WEAR_COMMITS_PER_DAY; c++) {
+            cfg.random_value++;
+            timed_save(run);
+        }
+        if (day % WEAR_SCHEDULE_EDIT_DAY == 0) {
+            cfg.schedule[day % SCHEDULE_MAX_SLOTS].grams++;
+            timed_save(run);
+        }
+    }
+
+    for (uint16_t s = 0; s < run->sectors; s++) {
+        run->max_erases = MAX(run->max_erases, sector_erases[s]);
+        run->total_erases += sector_erases[s];
+    }
+
+    TC_PRINT("flash_wear: {\"partition\":\"config\",\"layout\":\"%s\",\"sectors\":%u,\"years\":%d,\"saves\":%u,"
+             "\"gc_saves\":%u,\"erases\":[",
+             run->layout, run->sectors, WEAR_YEARS, run->saves, run->gc_saves);
+    for (uint16_t s = 0; s < run->sectors; s++) {
+        TC_PRINT("%s%u", (s > 0) ? "," : "", sector_erases[s]);
+    }
+    TC_PRINT("],\"mean_save_us\":%llu,\"worst_save_us\":%u,\"lifetime_years\":%u}\n", run->sum_us / run->saves,
+             run->worst_us, lifetime_years(run->max_erases));
+}
+
+static void *flash_wear_setup(void)
+{
+    struct flash_pages_info info;
+
+    zassert_true(device_is_ready(flash), "flash simulator not ready");
+    zassert_ok(flash_get_page_info_by_offs(flash, STORAGE_OFFSET, &info));
+    sector_size = info.size;
+
+    /* Same device as far as the NVS can tell, only erase, read and write are counted on the way */
+    flash_api = flash->api;
+    wear_api = *flash_api;
+    wear_api.read = wear_read;
+    wear_api.write = wear_write;
+    wear_api.erase = wear_erase;
+    wear_dev = (struct device){
+        .name = "wear_flash", .config = flash->config, .api = &wear_api, .state = flash->state, .data = flash->data};
+
+    schedule_now_fake.custom_fake = fake_now;
+    storage_submit_fake.custom_fake = submit_to_system_queue;
+
+    return NULL;
+}
+
+ZTEST(flash_wear, test_config_sectors_and_layouts)
+{
+    static const uint16_t sector_counts[] = {2, 3, 4, 6, 8};
+    uint16_t available = MIN(STORAGE_SIZE / sector_size, WEAR_MAX_SECTORS);
+
+    for (int i = 0; i < ARRAY_SIZE(sector_counts) && sector_counts[i] <= available; i++) {
+        struct wear_run field = {.layout = "per_field", .save = save_per_field, .sectors = sector_counts[i]};
+        struct wear_run blob = {.layout = "blob", .save = save_blob, .sectors = sector_counts[i]};
+
+        struct wear_run idle = {
+            .layout = "per_field_idle_gc", .save = save_per_field, .sectors = sector_counts[i], .idle_gc = true};
+
+        run_config(&field);
+        run_config(&blob);
+        run_config(&idle);
+
+        zassert_true(field.max_erases <= blob.max_erases, "per field entries must not wear faster than one blob");
+        zassert_equal(idle.gc_saves, 0, "a save still paid for the garbage collection");
+        /* Collecting early must not leave sectors half used */
+        zassert_true(idle.max_erases <= field.max_erases + field.max_erases / 10 + 1,
+                     "idle GC wears %u erases against %u", idle.max_erases, field.max_erases);
+
+        if (sector_counts[i] == CFG_NVS_SECTORS) {
+            zassert_true(field.gc_saves > 0, "the workload never reached the garbage collection");
+            zassert_true(lifetime_years(field.max_erases) >= WEAR_MIN_LIFETIME, "shipped layout lasts %u years",
+                         lifetime_years(field.max_erases));
+        }
+    }
+}
+
+/* The log is a ring of sectors, each one is erased once per lap */
+ZTEST(flash_wear, test_feedlog)
+{
+    const struct flash_area *fa;
+    struct feedlog_entry entry = {.grams = 25, .steps = 1200, .duration_ms = 900};
+    struct feedlog_stats stats;
+    uint32_t per_sector;
+    uint32_t starts;
+    uint32_t worst_us;
+
+    zassert_ok(flash_area_open(FIXED_PARTITION_ID(feedlog_partition), &fa));
+    zassert_ok(flash_area_erase(fa, 0, fa->fa_size));
+    flash_area_close(fa);
+    zassert_ok(feedlog_init());
+
+    for (uint32_t day = 0; day < WEAR_DAYS; day++) {
+        for (int f = 0; f < WEAR_FEEDS_PER_DAY; f++) {
+            sim_time = START_TIME + day * SEC_PER_DAY + f * (SEC_PER_DAY / WEAR_FEEDS_PER_DAY);
+            zassert_ok(feedlog_append(&entry));
+        }
+        feedlog_flush();
+    }
+
+    feedlog_get_stats(&stats);
+    zassert_equal(stats.appended, WEAR_DAYS * WEAR_FEEDS_PER_DAY, NULL);
+    zassert_equal(stats.dropped, 0, NULL);
+
+    /* The first sector is started at init, the next one every time the head fills up */
+    starts = 1 + (stats.appended - 1) / (stats.capacity / stats.sectors_total);
+    per_sector = DIV_ROUND_UP(starts, stats.sectors_total);
+
+    /* The append that starts a sector: erase, header then record */
+    op.erases = 1;
+    op.writes = 2;
+    op.bytes = 2 * FEEDLOG_FLASH_WRITE;
+    worst_us = modeled_us();
+
+    TC_PRINT("flash_wear: {\"partition\":\"feedlog\",\"sectors\":%u,\"years\":%d,\"appends\":%u,"
+             "\"erases_per_sector\":%u,\"worst_append_us\":%u,\"lifetime_years\":%u}\n",
+             stats.sectors_total, WEAR_YEARS, stats.appended, per_sector, worst_us, lifetime_years(per_sector));
+
+    zassert_true(lifetime_years(per_sector) >= WEAR_MIN_LIFETIME, NULL);
+}
+
+ZTEST_SUITE(flash_wear, NULL, flash_wear_setup, NULL, NULL, NULL);
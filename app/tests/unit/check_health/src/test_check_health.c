@@ -2,37 +2,97 @@
 #include <zephyr/kernel.h>
 #include <zephyr/fff.h>
 #include "check_health.h"
+#include "watchdog.h"
+#include "histogram.h"
+#include "bench_clock.h"
 
 /* 1. Define FFF Globals */
 DEFINE_FFF_GLOBALS;
 
+#define TEST_TIMEOUT_MS  500
+#define DETECT_SLACK_MS  5
+#define BENCH_REPORTS    1000000
+#define FAULT_PERIOD_MS  20
+#define FAULT_TIMEOUT_MS 100
+#define FAULT_STACK      1024
+#define FAULT_PRIORITY   3
+#define STACK_SAMPLE_MS  20
+
 /* 2. Define the Fake */
 /* The linker is looking for 'z_impl_k_thread_stack_space_get'.
  * Signature: int z_impl_k_thread_stack_space_get(const struct k_thread *thread, size_t *unused_ptr)
  */
 FAKE_VALUE_FUNC(int, z_impl_k_thread_stack_space_get, const struct k_thread *, size_t *);
+FAKE_VALUE_FUNC(int, watchdog_add_channel, const char *, uint32_t);
+FAKE_VOID_FUNC(watchdog_feed, int);
+FAKE_VOID_FUNC(reset_info_thread, int, const char *, uint32_t);
+FAKE_VOID_FUNC(reset_info_seal);
+FAKE_VOID_FUNC(hist_record, enum hist_id, uint32_t);
+
+/* Free stack reported for every thread */
+static size_t stack_free;
 
-/* Optional: Custom fake to set the output parameter 'unused_ptr' to avoid printing garbage logs */
 int custom_stack_get_fake(const struct k_thread *thread, size_t *unused_ptr)
 {
     if (unused_ptr) {
-        *unused_ptr = 256; // Dummy value for the log
+        *unused_ptr = stack_free;
     }
     return 0;
 }
 
+static health_handle_t motor_handle;
+static health_handle_t comm_handle;
+
+static K_THREAD_STACK_DEFINE(fault_stack, FAULT_STACK);
+static struct k_thread fault_thread;
+static health_handle_t fault_handle;
+static volatile uint32_t fault_last_report;
+
+/**
+ * @brief: Well behaved thread that the tests freeze to inject a stall
+ */
+static void fault_worker(void *p1, void *p2, void *p3)
+{
+    ARG_UNUSED(p1);
+    ARG_UNUSED(p2);
+    ARG_UNUSED(p3);
+
+    while (1) {
+        thread_report_alive(fault_handle);
+        fault_last_report = k_cycle_get_32();
+        k_sleep(K_MSEC(FAULT_PERIOD_MS));
+    }
+}
+
+static k_tid_t start_fault_worker(void)
+{
+    fault_handle = health_register("fault", FAULT_TIMEOUT_MS);
+    zassert_true(fault_handle >= 0, NULL);
+
+    return k_thread_create(&fault_thread, fault_stack, K_THREAD_STACK_SIZEOF(fault_stack), fault_worker, NULL, NULL,
+                           NULL, FAULT_PRIORITY, 0, K_NO_WAIT);
+}
+
 static void check_health_tests_before(void *fixture)
 {
     ARG_UNUSED(fixture);
 
     /* Reset the fake and assign custom behavior */
     RESET_FAKE(z_impl_k_thread_stack_space_get);
+    RESET_FAKE(watchdog_feed);
+    RESET_FAKE(hist_record);
     z_impl_k_thread_stack_space_get_fake.custom_fake = custom_stack_get_fake;
+    stack_free = 256;
+    health_stack_set_period(HEALTH_STACK_SAMPLE_MS);
+
+    health_reset();
+    motor_handle = health_register("motor", TEST_TIMEOUT_MS);
+    comm_handle = health_register("comm", TEST_TIMEOUT_MS);
 
     start_check_health_thread();
 
     /* Allow thread to run once before test starts */
-    k_sleep(K_MSEC(HEALTH_CHECK_INTERVAL_MS + 10));
+    k_sleep(K_MSEC(10));
 }
 
 static void check_health_tests_after(void *fixture)
@@ -42,45 +102,282 @@ static void check_health_tests_after(void *fixture)
     stop_check_health_thread();
 }
 
-static void report_all_threads_alive(void)
+ZTEST(check_health, test_register_gives_distinct_handles)
+{
+    zassert_true(motor_handle >= 0, NULL);
+    zassert_true(comm_handle >= 0, NULL);
+    zassert_not_equal(motor_handle, comm_handle, NULL);
+}
+
+ZTEST(check_health, test_register_rejects_bad_requests)
 {
-    for (int i = 0; i < THREAD_COUNT; i++) {
-        thread_report_alive((thread_id_t)i);
+    int registered = 2;
+
+    zassert_equal(health_register("zero", 0), -EINVAL, NULL);
+    zassert_equal(health_register("forever", UINT32_MAX), -EINVAL, NULL);
+
+    while (registered < HEALTH_MAX_THREADS) {
+        zassert_true(health_register("filler", 10 * TEST_TIMEOUT_MS) >= 0, NULL);
+        registered++;
     }
+
+    zassert_equal(health_register("one too many", TEST_TIMEOUT_MS), -ENOMEM, NULL);
 }
 
 ZTEST(check_health, test_system_healthy_when_all_threads_report)
 {
-    report_all_threads_alive();
-
-    k_sleep(K_MSEC(HEALTH_CHECK_INTERVAL_MS + 10));
+    for (int i = 0; i < 4; i++) {
+        thread_report_alive(motor_handle);
+        thread_report_alive(comm_handle);
+        k_sleep(K_MSEC(TEST_TIMEOUT_MS / 2));
+    }
 
     zassert_true(is_system_healthy(), "system unhealthy even though all threads reported alive");
 }
 
 ZTEST(check_health, test_system_unhealthy_when_no_heartbeat)
 {
-    k_sleep(K_MSEC(THREAD_TIMEOUT_MS + 10));
+    k_sleep(K_MSEC(TEST_TIMEOUT_MS - 20));
+    zassert_true(is_system_healthy(), "stall flagged before the timeout");
 
+    k_sleep(K_MSEC(20 + DETECT_SLACK_MS));
     zassert_false(is_system_healthy(), "system healthy despite no heartbeats");
 }
 
 ZTEST(check_health, test_system_unhealthy_when_one_thread_missing)
 {
-    for (int i = 0; i < THREAD_COUNT - 1; i++) {
-        thread_report_alive((thread_id_t)i);
+    for (int i = 0; i < 10; i++) {
+        thread_report_alive(motor_handle);
+        k_sleep(K_MSEC(TEST_TIMEOUT_MS / 5));
     }
 
-    k_sleep(K_MSEC(THREAD_TIMEOUT_MS + 10));
-
     zassert_false(is_system_healthy(), "system healthy despite one missing heartbeat");
 }
 
+ZTEST(check_health, test_timeouts_are_per_thread)
+{
+    health_handle_t slow = health_register("slow", 4 * TEST_TIMEOUT_MS);
+    health_handle_t fast;
+
+    /* Keep the default threads alive, only the slow one is silent and still within its timeout */
+    for (int i = 0; i < 10; i++) {
+        thread_report_alive(motor_handle);
+        thread_report_alive(comm_handle);
+        k_sleep(K_MSEC(TEST_TIMEOUT_MS / 5));
+    }
+    zassert_true(is_system_healthy(), "slow thread flagged before its own timeout");
+
+    fast = health_register("fast", TEST_TIMEOUT_MS / 2);
+    thread_report_alive(slow);
+    for (int i = 0; i < 5; i++) {
+        thread_report_alive(motor_handle);
+        thread_report_alive(comm_handle);
+        k_sleep(K_MSEC(TEST_TIMEOUT_MS / 5));
+    }
+    zassert_false(is_system_healthy(), "fast thread registered at runtime was not monitored");
+
+    thread_report_alive(fast);
+    thread_report_alive(motor_handle);
+    thread_report_alive(comm_handle);
+    k_sleep(K_MSEC(DETECT_SLACK_MS));
+    zassert_true(is_system_healthy(), "system must recover once every thread reports again");
+}
+
 ZTEST(check_health, test_invalid_thread_id_does_not_crash)
 {
-    thread_report_alive((thread_id_t)THREAD_COUNT);
+    thread_report_alive(-ENOMEM);
+    thread_report_alive(HEALTH_MAX_THREADS);
 
     zassert_true(true, "invalid thread id caused failure");
 }
 
+ZTEST(check_health, test_no_wakeups_while_healthy)
+{
+    k_tid_t worker;
+
+    health_reset();
+    worker = start_fault_worker();
+
+    k_sleep(K_SECONDS(1));
+
+    zassert_true(is_system_healthy(), NULL);
+    zassert_equal(z_impl_k_thread_stack_space_get_fake.call_count, 0, "stack scanned %d times while idle",
+                  z_impl_k_thread_stack_space_get_fake.call_count);
+    /* Its own watchdog channel is the only thing it wakes up for */
+    zassert_true(watchdog_feed_fake.call_count <= 1000 / HEALTH_WDT_FEED_MS + 1, "fed %d times",
+                 watchdog_feed_fake.call_count);
+
+    k_thread_abort(worker);
+}
+
+ZTEST(check_health, test_frozen_thread_detection_latency)
+{
+    k_tid_t worker;
+    uint32_t latency_us;
+
+    health_reset();
+    worker = start_fault_worker();
+
+    k_sleep(K_MSEC(5 * FAULT_PERIOD_MS));
+    zassert_true(is_system_healthy(), NULL);
+
+    /* Freeze the worker, it will never report again */
+    k_thread_suspend(worker);
+
+    while (is_system_healthy()) {
+        k_sleep(K_TICKS(1));
+    }
+    latency_us = k_cyc_to_us_floor32(k_cycle_get_32() - fault_last_report);
+
+    TC_PRINT("Stall detected %u us after the last heartbeat (timeout %d ms)\n", latency_us, FAULT_TIMEOUT_MS);
+    zassert_true(latency_us >= FAULT_TIMEOUT_MS * USEC_PER_MSEC, "stall flagged early: %u us", latency_us);
+    zassert_true(latency_us <= (FAULT_TIMEOUT_MS + DETECT_SLACK_MS) * USEC_PER_MSEC, "stall flagged late: %u us",
+                 latency_us);
+
+    /* Thawing it must clear the stall */
+    k_thread_resume(worker);
+    k_sleep(K_MSEC(FAULT_PERIOD_MS));
+    zassert_true(is_system_healthy(), "worker recovered but the system is still unhealthy");
+
+    k_thread_abort(worker);
+}
+
+ZTEST(check_health, test_owns_a_watchdog_channel)
+{
+    zassert_equal(watchdog_add_channel_fake.arg1_val, HEALTH_WDT_PERIOD_MS, NULL);
+    zassert_true(HEALTH_WDT_FEED_MS < HEALTH_WDT_PERIOD_MS, "the channel would starve while idle");
+
+    k_sleep(K_MSEC(HEALTH_WDT_FEED_MS + 10));
+    zassert_true(watchdog_feed_fake.call_count >= 1, "health thread stopped feeding its channel");
+}
+
+ZTEST(check_health, test_report_cost)
+{
+    uint64_t start = bench_now_us();
+
+    for (int i = 0; i < BENCH_REPORTS; i++) {
+        thread_report_alive(motor_handle);
+    }
+
+    uint64_t elapsed_us = bench_now_us() - start;
+    uint32_t ns_per_report = (uint32_t)((elapsed_us * 1000U) / BENCH_REPORTS);
+
+    TC_PRINT("thread_report_alive: %u ns per call (%d calls in %llu us)\n", ns_per_report, BENCH_REPORTS,
+             elapsed_us);
+
+    /* A cycle counter read and an atomic store, anything near a lock or a timer re-arm would blow this */
+    zassert_true(ns_per_report < 100, "reporting alive costs %u ns", ns_per_report);
+}
+
+ZTEST(check_health, test_stack_sampler_keeps_minimum)
+{
+    const size_t samples[] = {600, 300, 500};
+
+    zassert_ok(health_stack_watch(motor_handle, &fault_thread));
+    zassert_equal(health_stack_min_free(motor_handle), -ENODATA, NULL);
+    stack_free = samples[0];
+    health_stack_set_period(STACK_SAMPLE_MS);
+
+    for (int i = 0; i < ARRAY_SIZE(samples); i++) {
+        stack_free = samples[i];
+        k_sleep(K_MSEC(STACK_SAMPLE_MS + STACK_SAMPLE_MS / 2));
+        thread_report_alive(motor_handle);
+        thread_report_alive(comm_handle);
+    }
+
+    zassert_equal(health_stack_min_free(motor_handle), 300, "the running minimum must not go back up");
+    zassert_equal(health_stack_min_free(comm_handle), -ENODATA, "comm stack is not watched");
+    zassert_equal(health_stack_headroom(), 300, NULL);
+    zassert_true(is_system_healthy(), NULL);
+}
+
+ZTEST(check_health, test_headroom_and_beat_age)
+{
+    zassert_equal(health_stack_headroom(), -ENODATA, "nothing sampled yet");
+
+    thread_report_alive(motor_handle);
+    thread_report_alive(comm_handle);
+    zassert_true(health_beat_age_max_ms() < TEST_TIMEOUT_MS / 4, NULL);
+
+    k_sleep(K_MSEC(TEST_TIMEOUT_MS / 2));
+    thread_report_alive(motor_handle);
+    zassert_within(health_beat_age_max_ms(), TEST_TIMEOUT_MS / 2, 2, "the oldest heartbeat is the comm one");
+
+    health_reset();
+    zassert_equal(health_beat_age_max_ms(), 0, NULL);
+}
+
+ZTEST(check_health, test_stack_low_headroom_is_a_fault)
+{
+    zassert_ok(health_stack_watch(comm_handle, &fault_thread));
+    stack_free = HEALTH_STACK_MIN_FREE - 1;
+    health_stack_set_period(STACK_SAMPLE_MS);
+
+    k_sleep(K_MSEC(2 * STACK_SAMPLE_MS));
+    thread_report_alive(motor_handle);
+    thread_report_alive(comm_handle);
+
+    zassert_equal(health_stack_min_free(comm_handle), HEALTH_STACK_MIN_FREE - 1, NULL);
+    zassert_false(is_system_healthy(), "low stack headroom must be a fault");
+
+    /* Latched: the worst case already happened */
+    stack_free = 1024;
+    k_sleep(K_MSEC(2 * STACK_SAMPLE_MS));
+    zassert_false(is_system_healthy(), NULL);
+}
+
+ZTEST(check_health, test_stack_sampling_rate)
+{
+    const uint32_t window_ms = 500;
+    const uint32_t expected = window_ms / (5 * STACK_SAMPLE_MS);
+
+    zassert_ok(health_stack_watch(motor_handle, &fault_thread));
+    zassert_ok(health_stack_watch(comm_handle, &fault_thread));
+    health_stack_set_period(5 * STACK_SAMPLE_MS);
+    k_sleep(K_MSEC(STACK_SAMPLE_MS));
+    RESET_FAKE(z_impl_k_thread_stack_space_get);
+    RESET_FAKE(hist_record);
+    z_impl_k_thread_stack_space_get_fake.custom_fake = custom_stack_get_fake;
+
+    k_sleep(K_MSEC(window_ms));
+
+    /* Two stacks per pass, at the configured rate and not more */
+    zassert_within(z_impl_k_thread_stack_space_get_fake.call_count, 2 * expected, 2, "%d scans",
+                   z_impl_k_thread_stack_space_get_fake.call_count);
+    zassert_within(hist_record_fake.call_count, expected, 1, "every pass must be timed");
+    zassert_equal(hist_record_fake.arg0_val, HIST_HEALTH_SCAN, NULL);
+
+    health_stack_set_period(0);
+    k_sleep(K_MSEC(STACK_SAMPLE_MS));
+    RESET_FAKE(z_impl_k_thread_stack_space_get);
+    k_sleep(K_MSEC(window_ms));
+    zassert_equal(z_impl_k_thread_stack_space_get_fake.call_count, 0, "sampling must stop with a zero period");
+}
+
+ZTEST(check_health, test_stack_watch_rejects_bad_requests)
+{
+    zassert_equal(health_stack_watch(-ENOMEM, &fault_thread), -EINVAL, NULL);
+    zassert_equal(health_stack_watch(HEALTH_MAX_THREADS, &fault_thread), -EINVAL, NULL);
+    zassert_equal(health_stack_watch(motor_handle, NULL), -EINVAL, NULL);
+    zassert_equal(health_stack_min_free(HEALTH_MAX_THREADS), -EINVAL, NULL);
+}
+
+ZTEST(check_health, test_sensor_faults)
+{
+    thread_report_alive(motor_handle);
+    thread_report_alive(comm_handle);
+    zassert_true(is_system_healthy(), NULL);
+
+    health_sensor_report(HEALTH_SENSOR_BATTERY, false);
+    health_sensor_report(HEALTH_SENSOR_TEMPERATURE, false);
+    zassert_false(is_system_healthy(), "a sensor out of its limits must be a fault");
+
+    health_sensor_report(HEALTH_SENSOR_BATTERY, true);
+    zassert_false(is_system_healthy(), "each sensor clears its own fault only");
+
+    health_sensor_report(HEALTH_SENSOR_TEMPERATURE, true);
+    health_sensor_report(HEALTH_SENSOR_COUNT, false);
+    zassert_true(is_system_healthy(), NULL);
+}
+
 ZTEST_SUITE(check_health, NULL, NULL, check_health_tests_before, check_health_tests_after, NULL);
@@ -1,8 +1,152 @@
 #include <zephyr/ztest.h>
+#include <zephyr/fff.h>
+#include <zephyr/drivers/uart.h>
+#include <zephyr/drivers/serial/uart_emul.h>
+#include <string.h>
+#include "communication.h"
+#include "check_health.h"
+#include "watchdog.h"
 
-ZTEST(my_tests, test_placeholder)
+DEFINE_FFF_GLOBALS;
+
+FAKE_VOID_FUNC(thread_report_alive, health_handle_t);
+FAKE_VALUE_FUNC(health_handle_t, health_register, const char *, uint32_t);
+FAKE_VALUE_FUNC(int, health_stack_watch, health_handle_t, const struct k_thread *);
+FAKE_VALUE_FUNC(int, watchdog_add_channel, const char *, uint32_t);
+FAKE_VOID_FUNC(watchdog_feed, int);
+
+#define STREAM_BYTES  16384
+#define STREAM_CHUNK  32
+#define STREAM_BAUD   115200
+/* 8N1: 10 bits on the line per byte */
+#define CHUNK_TIME_US (STREAM_CHUNK * 10 * USEC_PER_SEC / STREAM_BAUD)
+
+static const struct device *const uart = DEVICE_DT_GET(DT_CHOSEN(feeder_comm_uart));
+static uint32_t received;
+static bool received_in_order;
+
+static void counting_rx_handler(struct ring_buf *rx)
+{
+    uint8_t buf[32];
+    uint32_t len;
+
+    while ((len = ring_buf_get(rx, buf, sizeof(buf))) > 0) {
+        for (uint32_t i = 0; i < len; i++) {
+            received_in_order &= (buf[i] == (uint8_t)received);
+            received++;
+        }
+    }
+}
+
+static void *comm_tests_setup(void)
+{
+    zassert_true(device_is_ready(uart), "UART emulator not ready");
+
+    comm_set_rx_handler(counting_rx_handler);
+    start_comm_thread();
+    k_msleep(10);
+
+    return NULL;
+}
+
+static void comm_tests_before(void *fixture)
+{
+    ARG_UNUSED(fixture);
+
+    uart_emul_flush_rx_data(uart);
+    uart_emul_flush_tx_data(uart);
+    RESET_FAKE(thread_report_alive);
+    received = 0;
+    received_in_order = true;
+}
+
+static void comm_tests_teardown(void *fixture)
+{
+    ARG_UNUSED(fixture);
+
+    stop_comm_thread();
+}
+
+ZTEST(communication, test_rx_stream_at_full_baud)
+{
+    uint8_t chunk[STREAM_CHUNK];
+    struct comm_stats before;
+    struct comm_stats after;
+
+    comm_get_stats(&before);
+
+    for (uint32_t sent = 0; sent < STREAM_BYTES; sent += STREAM_CHUNK) {
+        for (uint32_t i = 0; i < STREAM_CHUNK; i++) {
+            chunk[i] = (uint8_t)(sent + i);
+        }
+        zassert_equal(uart_emul_put_rx_data(uart, chunk, sizeof(chunk)), sizeof(chunk), "Emulator FIFO overflow");
+        k_usleep(CHUNK_TIME_US);
+    }
+    k_msleep(20);
+
+    comm_get_stats(&after);
+
+    zassert_equal(received, STREAM_BYTES, "Received %u of %u bytes", received, STREAM_BYTES);
+    zassert_true(received_in_order, "Bytes were reordered or corrupted");
+    zassert_equal(after.rx_dropped, before.rx_dropped, "RX ring dropped bytes");
+    zassert_equal(after.rx_bytes - before.rx_bytes, STREAM_BYTES, NULL);
+
+    TC_PRINT("%u bytes at %u baud, %u thread wakeups\n", STREAM_BYTES, STREAM_BAUD,
+             after.rx_wakeups - before.rx_wakeups);
+}
+
+ZTEST(communication, test_idle_line_has_no_rx_wakeups)
 {
-    zassert_true(true, "Placeholder test");
+    struct comm_stats before;
+    struct comm_stats after;
+
+    comm_get_stats(&before);
+    k_msleep(1000);
+    comm_get_stats(&after);
+
+    zassert_equal(after.rx_wakeups, before.rx_wakeups, "Thread woke up for RX on an idle line");
+    zassert_true(thread_report_alive_fake.call_count <= 1000 / COMM_HEARTBEAT_MS + 1,
+                 "Too many idle wakeups: %u",
+                 thread_report_alive_fake.call_count);
+    zassert_true(thread_report_alive_fake.call_count > 0, "Heartbeat must keep running while idle");
+}
+
+ZTEST(communication, test_tx_goes_through_work_queue)
+{
+    static const uint8_t msg[] = "feeder online";
+    uint8_t out[sizeof(msg)];
+    struct comm_stats before;
+    struct comm_stats after;
+
+    comm_get_stats(&before);
+    zassert_equal(comm_send(msg, sizeof(msg)), 0, NULL);
+    k_msleep(10);
+
+    zassert_equal(uart_emul_get_tx_data(uart, out, sizeof(out)), sizeof(msg), "TX bytes missing");
+    zassert_mem_equal(out, msg, sizeof(msg), NULL);
+
+    comm_get_stats(&after);
+    zassert_equal(after.tx_bytes - before.tx_bytes, sizeof(msg), "only bytes the UART reported done count");
+    zassert_equal(after.tx_errors, before.tx_errors, NULL);
+}
+
+ZTEST(communication, test_idle_after_quiet_line)
+{
+    static const uint8_t byte = 0x55;
+
+    zassert_equal(uart_emul_put_rx_data(uart, &byte, 1), 1, NULL);
+    k_msleep(1);
+    zassert_false(comm_is_idle(), "a byte just arrived");
+
+    k_msleep(COMM_IDLE_MS);
+    zassert_true(comm_is_idle(), NULL);
+}
+
+ZTEST(communication, test_tx_rejects_oversized_messages)
+{
+    static uint8_t big[COMM_TX_RING_SIZE + 1];
+
+    zassert_equal(comm_send(big, sizeof(big)), -ENOBUFS, NULL);
 }
 
-ZTEST_SUITE(my_tests, NULL, NULL, NULL, NULL, NULL);
+ZTEST_SUITE(communication, NULL, comm_tests_setup, comm_tests_before, NULL, comm_tests_teardown);
@@ -4,6 +4,7 @@
 #include <zephyr/drivers/flash.h>
 #include <zephyr/storage/flash_map.h>
 #include "configuration.h"
+#include "motor_control.h"
 
 DEFINE_FFF_GLOBALS;
 
@@ -13,21 +14,111 @@ FAKE_VALUE_FUNC(int, nvs_mount, struct nvs_fs *);
 FAKE_VALUE_FUNC(ssize_t, nvs_write, struct nvs_fs *, uint16_t, const void *, size_t);
 FAKE_VALUE_FUNC(ssize_t, nvs_read, struct nvs_fs *, uint16_t, void *, size_t);
 
-static ssize_t nvs_read_custom_fake(struct nvs_fs *fs, uint16_t id, void *data, size_t len)
+FAKE_VALUE_FUNC(int, nvs_delete, struct nvs_fs *, uint16_t);
+FAKE_VALUE_FUNC(int, nvs_sector_use_next, struct nvs_fs *);
+
+#define FAKE_NVS_ENTRIES 32
+
+#define STRESS_PUBLISHES   2000
+#define STRESS_READERS     2
+#define STRESS_STACK       1024
+#define STRESS_WRITER_PRIO 7
+#define STRESS_HOOK_US     200
+#define STRESS_READER_PRIO 5
+
+/* In memory NVS, enough to check what ends up stored and how many bytes each commit writes */
+static struct {
+    bool used;
+    uint16_t id;
+    size_t len;
+    uint8_t data[sizeof(struct config)];
+} fake_nvs[FAKE_NVS_ENTRIES];
+static size_t fake_nvs_bytes;
+
+static ssize_t fake_nvs_write(struct nvs_fs *fs, uint16_t id, const void *data, size_t len)
 {
-    struct config *dest = (struct config *)data;
-    dest->random_value = 888;
+    int free_slot = -1;
+
+    for (int i = 0; i < FAKE_NVS_ENTRIES; i++) {
+        if (fake_nvs[i].used && fake_nvs[i].id == id) {
+            /* Like the real NVS, identical data is not written again */
+            if (fake_nvs[i].len == len && memcmp(fake_nvs[i].data, data, len) == 0) {
+                return 0;
+            }
+            free_slot = i;
+            break;
+        }
+        if (!fake_nvs[i].used && free_slot < 0) {
+            free_slot = i;
+        }
+    }
+
+    zassert_true(free_slot >= 0 && len <= sizeof(fake_nvs[0].data), "fake NVS full");
+    fake_nvs[free_slot].used = true;
+    fake_nvs[free_slot].id = id;
+    fake_nvs[free_slot].len = len;
+    memcpy(fake_nvs[free_slot].data, data, len);
+    fake_nvs_bytes += len;
+
     return len;
 }
 
+static ssize_t fake_nvs_read(struct nvs_fs *fs, uint16_t id, void *data, size_t len)
+{
+    for (int i = 0; i < FAKE_NVS_ENTRIES; i++) {
+        if (fake_nvs[i].used && fake_nvs[i].id == id) {
+            memcpy(data, fake_nvs[i].data, MIN(len, fake_nvs[i].len));
+            return fake_nvs[i].len;
+        }
+    }
+
+    return -ENOENT;
+}
+
+static int fake_nvs_delete(struct nvs_fs *fs, uint16_t id)
+{
+    for (int i = 0; i < FAKE_NVS_ENTRIES; i++) {
+        if (fake_nvs[i].used && fake_nvs[i].id == id) {
+            fake_nvs[i].used = false;
+        }
+    }
+
+    return 0;
+}
+
+static bool fake_nvs_has(uint16_t id)
+{
+    uint8_t dummy;
+
+    return fake_nvs_read(NULL, id, &dummy, 0) >= 0;
+}
+
+/**
+ * @brief: Simulates a reboot: the RAM copy is lost and the config is loaded again
+ */
+static int reboot_and_load(void)
+{
+    memset(&cfg, 0x5A, sizeof(cfg));
+    return load_config();
+}
+
 static void config_test_setup(void *fixture)
 {
     RESET_FAKE(nvs_mount);
     RESET_FAKE(nvs_write);
     RESET_FAKE(nvs_read);
+    RESET_FAKE(nvs_delete);
+    RESET_FAKE(nvs_sector_use_next);
     FFF_RESET_HISTORY();
 
-    memset(&cfg, 0, sizeof(struct config));
+    memset(fake_nvs, 0, sizeof(fake_nvs));
+    fake_nvs_bytes = 0;
+    nvs_write_fake.custom_fake = fake_nvs_write;
+    nvs_read_fake.custom_fake = fake_nvs_read;
+    nvs_delete_fake.custom_fake = fake_nvs_delete;
+
+    /* Start from an empty flash */
+    zassert_equal(load_config(), -ENOENT, NULL);
 }
 
 ZTEST_SUITE(configuration, NULL, NULL, config_test_setup, NULL, NULL);
@@ -62,38 +153,46 @@ ZTEST(configuration, test_init_nvs_fail_mount)
 
 ZTEST(configuration, test_save_config_success)
 {
-    nvs_write_fake.return_val = sizeof(struct config);
     cfg.random_value = 123;
 
     int ret = save_config();
 
     zassert_equal(ret, 0, "save_config failed");
-    zassert_equal(nvs_write_fake.call_count, 1, "nvs_write not called");
-    zassert_equal(nvs_write_fake.arg1_val, CONFIG_ID, "Wrong NVS ID used");
+    zassert_equal(nvs_write_fake.call_count, 1, "only the changed field must be written");
+    zassert_equal(nvs_write_fake.arg1_val, CFG_NVS_ID_RANDOM_VALUE, "Wrong NVS ID used");
 }
 
 ZTEST(configuration, test_save_config_fail)
 {
+    nvs_write_fake.custom_fake = NULL;
     nvs_write_fake.return_val = -EIO;
+    cfg.random_value = 5;
 
     int ret = save_config();
 
     zassert_equal(ret, -EIO, "Should return error code");
+    zassert_true(config_is_dirty(), "a failed write must be retried on the next commit");
 }
 
 ZTEST(configuration, test_load_config_success)
 {
-    nvs_read_fake.custom_fake = nvs_read_custom_fake;
+    cfg.random_value = 888;
+    cfg.schedule[20].kind = SCHEDULE_DAILY;
+    cfg.schedule[20].grams = 15;
+    zassert_ok(save_config());
 
-    int ret = load_config();
+    int ret = reboot_and_load();
 
     zassert_equal(ret, 0, "load_config failed");
-    zassert_equal(nvs_read_fake.call_count, 1, "nvs_read not called");
     zassert_equal(cfg.random_value, 888, "Config not updated from NVS read");
+    zassert_equal(cfg.schedule[20].grams, 15, NULL);
+    zassert_equal(cfg.schedule[0].kind, SCHEDULE_FREE, "unstored chunks must get their default");
+    zassert_false(config_is_dirty(), NULL);
 }
 
 ZTEST(configuration, test_load_config_fail)
 {
+    nvs_read_fake.custom_fake = NULL;
     nvs_read_fake.return_val = -ENOENT;
 
     int ret = load_config();
@@ -101,9 +200,274 @@ ZTEST(configuration, test_load_config_fail)
     zassert_equal(ret, -ENOENT, "Should return error code");
 }
 
+ZTEST(configuration, test_commit_without_changes_writes_nothing)
+{
+    cfg.random_value = 1;
+    zassert_ok(save_config());
+
+    zassert_false(config_is_dirty(), NULL);
+    zassert_ok(save_config());
+    zassert_equal(config_last_commit_bytes(), 0, NULL);
+    zassert_equal(nvs_write_fake.call_count, 1, NULL);
+}
+
+static ssize_t write_then_change(struct nvs_fs *fs, uint16_t id, const void *data, size_t len)
+{
+    ssize_t ret = fake_nvs_write(fs, id, data, len);
+
+    /* A shell thread changing the value while the storage queue writes it */
+    cfg.random_value++;
+    return ret;
+}
+
+ZTEST(configuration, test_change_during_write_stays_dirty)
+{
+    cfg.random_value = 1;
+    nvs_write_fake.custom_fake = write_then_change;
+
+    zassert_ok(save_config());
+    zassert_true(config_is_dirty(), "a change made during the write must be committed next time");
+
+    nvs_write_fake.custom_fake = fake_nvs_write;
+    zassert_ok(save_config());
+    zassert_false(config_is_dirty(), NULL);
+}
+
+ZTEST(configuration, test_bytes_written_per_commit)
+{
+    size_t before;
+
+    cfg.random_value = 42;
+    zassert_ok(save_config());
+    zassert_equal(config_last_commit_bytes(), 1 + sizeof(int), "version byte + value");
+
+    /* One slot only touches its own chunk */
+    before = fake_nvs_bytes;
+    cfg.schedule[37].kind = SCHEDULE_DAILY;
+    cfg.schedule[37].grams = 10;
+    zassert_ok(save_config());
+    zassert_equal(fake_nvs_bytes - before, 1 + CFG_SCHEDULE_CHUNK * sizeof(struct schedule_slot), NULL);
+    zassert_equal(nvs_write_fake.arg1_val, CFG_NVS_ID_SCHEDULE + 37 / CFG_SCHEDULE_CHUNK, NULL);
+
+    TC_PRINT("Bytes per commit: value %zu, one slot %zu, whole struct %zu\n", 1 + sizeof(int),
+             1 + CFG_SCHEDULE_CHUNK * sizeof(struct schedule_slot), sizeof(struct config));
+}
+
+ZTEST(configuration, test_migrates_legacy_blob)
+{
+    int legacy_value = 77;
+
+    /* Firmware before the schema table stored only the value under a single id */
+    fake_nvs_write(NULL, CFG_NVS_ID_LEGACY, &legacy_value, sizeof(legacy_value));
+
+    zassert_equal(load_config(), 0, NULL);
+    zassert_equal(cfg.random_value, 77, NULL);
+    zassert_equal(cfg.schedule[0].kind, SCHEDULE_FREE, NULL);
+    zassert_false(fake_nvs_has(CFG_NVS_ID_LEGACY), "legacy blob must be dropped once migrated");
+    zassert_true(fake_nvs_has(CFG_NVS_ID_RANDOM_VALUE), NULL);
+
+    zassert_equal(reboot_and_load(), 0, NULL);
+    zassert_equal(cfg.random_value, 77, "migrated value lost on the next boot");
+}
+
+ZTEST(configuration, test_unknown_version_gets_default)
+{
+    uint8_t entry[1 + sizeof(int)] = {0xFF, 1, 2, 3, 4};
+
+    fake_nvs_write(NULL, CFG_NVS_ID_RANDOM_VALUE, entry, sizeof(entry));
+
+    zassert_equal(load_config(), 0, NULL);
+    zassert_equal(cfg.random_value, 0, "entry from a newer firmware must not be trusted");
+}
+
+ZTEST(configuration, test_gc_ahead_of_time)
+{
+    static const struct flash_parameters params = {.write_block_size = 4, .erase_value = 0xFF};
+
+    zassert_equal(config_nvs_gc_if_low(), -ENODEV, "not mounted");
+    zassert_equal(config_nvs_free(), 0, NULL);
+
+    fs.ready = true;
+    fs.flash_parameters = &params;
+    fs.data_wra = 0;
+    fs.ate_wra = 4000;
+    zassert_equal(config_nvs_free(), 4000, NULL);
+    zassert_ok(save_config());
+    zassert_equal(config_nvs_gc_if_low(), 0, "room for a full commit left");
+
+    /* A quarter of a sector still takes any single entry, it must not be abandoned */
+    fs.ate_wra = 1024;
+    zassert_equal(config_nvs_gc_if_low(), 0, NULL);
+    zassert_equal(nvs_sector_use_next_fake.call_count, 0, NULL);
+
+    /* Not even the largest entry fits */
+    fs.ate_wra = 16;
+    zassert_equal(config_nvs_gc_if_low(), 1, NULL);
+    zassert_equal(nvs_sector_use_next_fake.call_count, 1, NULL);
+
+    /* A pending commit of the whole schedule doesn't fit the quarter sector */
+    for (size_t i = 0; i < SCHEDULE_MAX_SLOTS; i++) {
+        cfg.schedule[i].grams++;
+    }
+    fs.ate_wra = 1024;
+    zassert_equal(config_nvs_gc_if_low(), 1, NULL);
+    zassert_equal(nvs_sector_use_next_fake.call_count, 2, NULL);
+
+    nvs_sector_use_next_fake.return_val = -EIO;
+    zassert_equal(config_nvs_gc_if_low(), -EIO, NULL);
+
+    fs.ready = false;
+}
+
 ZTEST(configuration, test_default_cfg)
 {
     cfg.random_value = 234;
+    cfg.schedule[5].kind = SCHEDULE_DAILY;
     set_dflt_cfg();
     zassert_equal(cfg.random_value, 0, "random number should be 0, instead %d", cfg.random_value);
+    zassert_equal(cfg.schedule[5].kind, SCHEDULE_FREE, "default config has no schedule");
+}
+
+ZTEST(configuration, test_limits_have_defaults)
+{
+    struct config_hot hot;
+
+    zassert_equal(cfg.max_speed_sps, MOTOR_DFLT_SPEED_SPS, NULL);
+    zassert_equal(cfg.accel, MOTOR_DFLT_ACCEL, NULL);
+
+    cfg.accel = 12345;
+    zassert_ok(save_config());
+    zassert_equal(nvs_write_fake.arg1_val, CFG_NVS_ID_ACCEL, NULL);
+
+    zassert_equal(reboot_and_load(), 0, NULL);
+    config_hot_get(&hot);
+    zassert_equal(hot.accel, 12345, "load must publish what it read");
+    zassert_equal(hot.max_speed_sps, MOTOR_DFLT_SPEED_SPS, NULL);
+}
+
+ZTEST(configuration, test_publish_bumps_version)
+{
+    struct config_hot hot;
+    uint32_t version = config_hot_version();
+
+    cfg.random_value = 9;
+    zassert_equal(config_hot_get(&hot), version, "nothing published yet");
+    zassert_not_equal(hot.random_value, 9, NULL);
+
+    config_publish();
+    zassert_equal(config_hot_get(&hot), version + 1, NULL);
+    zassert_equal(hot.random_value, 9, NULL);
+}
+
+/* ========== SNAPSHOT STRESS TEST ========== */
+
+/* Every publish derives all the fields from one counter, a torn snapshot breaks the relation */
+static bool hot_is_consistent(const struct config_hot *hot)
+{
+    return hot->max_speed_sps == (uint32_t)hot->random_value * 3U && hot->accel == (uint32_t)hot->random_value * 7U;
+}
+
+static atomic_t stress_done;
+static atomic_t stress_reads;
+static atomic_t stress_torn;
+static atomic_t stress_backwards;
+static atomic_t stress_overlaps;
+static atomic_t in_publish;
+
+K_THREAD_STACK_ARRAY_DEFINE(reader_stacks, STRESS_READERS, STRESS_STACK);
+static struct k_thread reader_threads[STRESS_READERS];
+
+static void stress_check(uint32_t *last_version)
+{
+    struct config_hot hot;
+    uint32_t version = config_hot_get(&hot);
+
+    if (!hot_is_consistent(&hot)) {
+        atomic_inc(&stress_torn);
+    }
+    if (atomic_get(&in_publish)) {
+        atomic_inc(&stress_overlaps);
+    }
+    if (version < *last_version) {
+        atomic_inc(&stress_backwards);
+    }
+    *last_version = version;
+    atomic_inc(&stress_reads);
+}
+
+static void stress_reader(void *p1, void *p2, void *p3)
+{
+    uint32_t period_us = POINTER_TO_UINT(p1);
+    uint32_t last_version = 0;
+
+    while (!atomic_get(&stress_done)) {
+        stress_check(&last_version);
+        k_usleep(period_us);
+    }
+}
+
+static uint32_t isr_last_version;
+
+static void stress_isr_reader(struct k_timer *timer)
+{
+    stress_check(&isr_last_version);
+}
+
+K_TIMER_DEFINE(stress_timer, stress_isr_reader, NULL);
+
+/* Runs with the buffer half written, readers preempt the writer right there */
+static void stress_publish_hook(void)
+{
+    atomic_set(&in_publish, 1);
+    k_busy_wait(STRESS_HOOK_US);
+    atomic_clear(&in_publish);
+}
+
+ZTEST(configuration, test_snapshot_stress)
+{
+    static const uint32_t reader_period_us[STRESS_READERS] = {7, 13};
+    k_tid_t writer = k_current_get();
+    int old_prio = k_thread_priority_get(writer);
+
+    atomic_clear(&stress_done);
+    atomic_clear(&stress_reads);
+    atomic_clear(&stress_torn);
+    atomic_clear(&stress_backwards);
+    atomic_clear(&stress_overlaps);
+    isr_last_version = 0;
+
+    cfg.random_value = 0;
+    cfg.max_speed_sps = 0;
+    cfg.accel = 0;
+    config_publish();
+
+    k_thread_priority_set(writer, STRESS_WRITER_PRIO);
+    config_set_publish_hook(stress_publish_hook);
+
+    for (int i = 0; i < STRESS_READERS; i++) {
+        k_thread_create(&reader_threads[i], reader_stacks[i], STRESS_STACK, stress_reader,
+                        UINT_TO_POINTER(reader_period_us[i]), NULL, NULL, STRESS_READER_PRIO, 0, K_NO_WAIT);
+    }
+    k_timer_start(&stress_timer, K_USEC(11), K_USEC(11));
+
+    for (int n = 1; n <= STRESS_PUBLISHES; n++) {
+        cfg.random_value = n;
+        cfg.max_speed_sps = n * 3U;
+        cfg.accel = n * 7U;
+        config_publish();
+    }
+
+    k_timer_stop(&stress_timer);
+    atomic_set(&stress_done, 1);
+    for (int i = 0; i < STRESS_READERS; i++) {
+        k_thread_join(&reader_threads[i], K_FOREVER);
+    }
+    config_set_publish_hook(NULL);
+    k_thread_priority_set(writer, old_prio);
+
+    TC_PRINT("%d publishes, %ld reads, %ld during a publish, %ld torn\n", STRESS_PUBLISHES,
+             atomic_get(&stress_reads), atomic_get(&stress_overlaps), atomic_get(&stress_torn));
+    zassert_true(atomic_get(&stress_overlaps) > 0, "readers never preempted the writer");
+    zassert_equal(atomic_get(&stress_torn), 0, "torn snapshot read");
+    zassert_equal(atomic_get(&stress_backwards), 0, "snapshot version went backwards");
 }
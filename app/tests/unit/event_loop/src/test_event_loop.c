@@ -0,0 +1,88 @@
+#include <zephyr/ztest.h>
+#include <zephyr/fff.h>
+#include "event_loop.h"
+#include "motor_control.h"
+#include "communication.h"
+#include "check_health.h"
+
+DEFINE_FFF_GLOBALS;
+
+/* The machines themselves are tested with their module, only the dispatching is tested here */
+FAKE_VOID_FUNC(motor_loop_run, uint32_t);
+FAKE_VOID_FUNC(comm_loop_run, uint32_t);
+FAKE_VALUE_FUNC(uint32_t, health_loop_run, uint32_t);
+
+#define SETTLE_MS     5
+#define SHORT_WAIT_MS 10
+#define SHORT_WAITS   10
+
+static void event_loop_before(void *fixture)
+{
+    ARG_UNUSED(fixture);
+
+    /* A fresh loop waits a whole heartbeat before its first run */
+    stop_event_loop();
+
+    RESET_FAKE(motor_loop_run);
+    RESET_FAKE(comm_loop_run);
+    RESET_FAKE(health_loop_run);
+    FFF_RESET_HISTORY();
+
+    health_loop_run_fake.return_val = HEALTH_WDT_FEED_MS;
+    event_loop_start();
+}
+
+static void event_loop_after(void *fixture)
+{
+    ARG_UNUSED(fixture);
+
+    stop_event_loop();
+}
+
+ZTEST_SUITE(event_loop, NULL, NULL, event_loop_before, event_loop_after, NULL);
+
+ZTEST(event_loop, test_event_runs_every_machine)
+{
+    event_loop_post(EVENT_LOOP_COMM);
+    k_msleep(SETTLE_MS);
+
+    zassert_equal(motor_loop_run_fake.call_count, 1, NULL);
+    zassert_equal(comm_loop_run_fake.call_count, 1, NULL);
+    zassert_equal(health_loop_run_fake.call_count, 1, NULL);
+    zassert_equal(comm_loop_run_fake.arg0_val, EVENT_LOOP_COMM, NULL);
+    zassert_equal(motor_loop_run_fake.arg0_val, EVENT_LOOP_COMM, "each machine picks its own bits");
+}
+
+ZTEST(event_loop, test_events_are_consumed_once)
+{
+    event_loop_post(EVENT_LOOP_MOTOR);
+    event_loop_post(EVENT_LOOP_HEALTH);
+    k_msleep(SETTLE_MS);
+
+    zassert_equal(motor_loop_run_fake.call_count, 1, "posted together, handled in one run");
+    zassert_equal(motor_loop_run_fake.arg0_val, EVENT_LOOP_MOTOR | EVENT_LOOP_HEALTH, NULL);
+
+    k_msleep(SETTLE_MS);
+    zassert_equal(motor_loop_run_fake.call_count, 1, "an event must not be handled twice");
+}
+
+/* Health asks for a longer wait than the heartbeat, the other machines still have to report alive */
+ZTEST(event_loop, test_heartbeat_without_events)
+{
+    k_msleep(2 * EVENT_LOOP_HEARTBEAT_MS + EVENT_LOOP_HEARTBEAT_MS / 2);
+
+    zassert_equal(motor_loop_run_fake.call_count, 2, NULL);
+    zassert_equal(comm_loop_run_fake.call_count, 2, NULL);
+    zassert_equal(motor_loop_run_fake.arg0_history[0], 0, NULL);
+    zassert_equal(comm_loop_run_fake.arg0_history[1], 0, NULL);
+}
+
+ZTEST(event_loop, test_health_shortens_the_wait)
+{
+    health_loop_run_fake.return_val = SHORT_WAIT_MS;
+
+    event_loop_post(EVENT_LOOP_HEALTH);
+    k_msleep(SHORT_WAITS * SHORT_WAIT_MS + SETTLE_MS);
+
+    zassert_within(health_loop_run_fake.call_count, SHORT_WAITS + 1, 1, "%u runs", health_loop_run_fake.call_count);
+}
@@ -0,0 +1,297 @@
+#include <zephyr/ztest.h>
+#include <zephyr/fff.h>
+#include <zephyr/storage/flash_map.h>
+#include "feedlog.h"
+#include "storage.h"
+
+DEFINE_FFF_GLOBALS;
+
+FAKE_VALUE_FUNC(uint32_t, schedule_now);
+FAKE_VALUE_FUNC(int, storage_submit, struct k_work *);
+
+#define START_TIME 1767225600U /* 2026-01-01 00:00:00 UTC */
+
+static uint32_t test_time;
+
+static uint32_t fake_now(void)
+{
+    return test_time;
+}
+
+static int submit_to_system_queue(struct k_work *work)
+{
+    return k_work_submit(work);
+}
+
+/**
+ * @brief: Logs one dispense per second of test time, flushing before the queue fills up
+ */
+static void append_many(uint32_t count)
+{
+    struct feedlog_entry entry = {.grams = 10, .steps = 500, .duration_ms = 300};
+
+    for (uint32_t i = 0; i < count; i++) {
+        test_time++;
+        entry.grams = (uint16_t)(test_time % 100);
+        zassert_ok(feedlog_append(&entry));
+        if ((i + 1) % (FEEDLOG_QUEUE_LEN / 2) == 0) {
+            feedlog_flush();
+        }
+    }
+    feedlog_flush();
+}
+
+struct collect {
+    uint32_t count;
+    uint32_t first;
+    uint32_t last;
+    bool ordered;
+};
+
+static int collect_entry(const struct feedlog_entry *entry, void *user_data)
+{
+    struct collect *c = user_data;
+
+    if (c->count == 0) {
+        c->first = entry->time;
+    } else if (entry->time <= c->last) {
+        c->ordered = false;
+    }
+    zassert_equal(entry->grams, entry->time % 100, "record content corrupted");
+    c->last = entry->time;
+    c->count++;
+
+    return 0;
+}
+
+static struct collect query(uint32_t from, uint32_t to)
+{
+    struct collect c = {.ordered = true};
+    int ret = feedlog_query(from, to, collect_entry, &c);
+
+    zassert_equal(ret, c.count, NULL);
+    return c;
+}
+
+static void feedlog_before(void *fixture)
+{
+    ARG_UNUSED(fixture);
+
+    const struct flash_area *fa;
+
+    RESET_FAKE(schedule_now);
+    RESET_FAKE(storage_submit);
+    FFF_RESET_HISTORY();
+
+    schedule_now_fake.custom_fake = fake_now;
+    storage_submit_fake.custom_fake = submit_to_system_queue;
+    test_time = START_TIME;
+
+    /* Every test starts from a blank partition */
+    zassert_ok(flash_area_open(FIXED_PARTITION_ID(feedlog_partition), &fa));
+    zassert_ok(flash_area_erase(fa, 0, fa->fa_size));
+    zassert_ok(feedlog_init());
+}
+
+ZTEST_SUITE(feedlog, NULL, NULL, feedlog_before, NULL, NULL);
+
+ZTEST(feedlog, test_append_and_query_range)
+{
+    struct collect c;
+
+    append_many(10);
+
+    c = query(START_TIME + 3, START_TIME + 6);
+    zassert_equal(c.count, 4, NULL);
+    zassert_equal(c.first, START_TIME + 3, NULL);
+    zassert_equal(c.last, START_TIME + 6, NULL);
+    zassert_true(c.ordered, NULL);
+
+    zassert_equal(query(0, UINT32_MAX).count, 10, NULL);
+    zassert_equal(query(START_TIME + 100, UINT32_MAX).count, 0, NULL);
+}
+
+ZTEST(feedlog, test_wraps_around_oldest_first)
+{
+    struct feedlog_stats st;
+    struct collect c;
+    uint32_t total;
+
+    feedlog_get_stats(&st);
+    total = st.capacity + st.capacity / 4;
+    append_many(total);
+
+    c = query(0, UINT32_MAX);
+    feedlog_get_stats(&st);
+    TC_PRINT("%u appended, %u kept of %u, oldest %u\n", total, c.count, st.capacity, c.first - START_TIME);
+
+    zassert_true(c.ordered, "records must come oldest first across the wrap");
+    zassert_equal(c.last, START_TIME + total, "newest record lost");
+    zassert_true(c.count <= st.capacity, NULL);
+    zassert_true(c.count > st.capacity - st.capacity / st.sectors_total, "more than one sector was dropped");
+    zassert_equal(c.first, c.last - c.count + 1, "records missing in the middle");
+}
+
+ZTEST(feedlog, test_index_rebuilt_at_boot)
+{
+    struct collect before;
+    struct collect after;
+    struct feedlog_stats st;
+
+    feedlog_get_stats(&st);
+    append_many(st.capacity + 100);
+    before = query(0, UINT32_MAX);
+
+    zassert_ok(feedlog_init(), "remount failed");
+    after = query(0, UINT32_MAX);
+    zassert_equal(after.count, before.count, NULL);
+    zassert_equal(after.first, before.first, NULL);
+    zassert_equal(after.last, before.last, NULL);
+
+    /* Appends go on after the last record found */
+    append_many(5);
+    after = query(0, UINT32_MAX);
+    zassert_equal(after.last, before.last + 5, NULL);
+    zassert_true(after.ordered, NULL);
+}
+
+ZTEST(feedlog, test_query_skips_sectors_out_of_range)
+{
+    struct feedlog_stats before;
+    struct feedlog_stats after;
+
+    feedlog_get_stats(&before);
+    append_many(before.capacity - 100);
+    feedlog_get_stats(&before);
+
+    zassert_equal(query(test_time - 2, test_time).count, 3, NULL);
+    feedlog_get_stats(&after);
+
+    TC_PRINT("Narrow query read %u of %u sectors\n", after.sectors_read - before.sectors_read, after.sectors_total);
+    zassert_equal(after.sectors_read - before.sectors_read, 1, "the index must narrow the scan to one sector");
+}
+
+static int append_while_visited(const struct feedlog_entry *entry, void *user_data)
+{
+    uint32_t *visited = user_data;
+    struct feedlog_entry next = {.grams = (test_time + 1) % 100};
+
+    /* A slow visitor, e.g. the shell, must not hold up the storage queue */
+    if (*visited == 0) {
+        test_time++;
+        zassert_ok(feedlog_append(&next));
+        feedlog_flush();
+    }
+    zassert_equal(entry->grams, entry->time % 100, "record content corrupted");
+    (*visited)++;
+
+    return 0;
+}
+
+ZTEST(feedlog, test_query_callback_runs_unlocked)
+{
+    uint32_t visited = 0;
+
+    append_many(20);
+
+    zassert_equal(feedlog_query(0, UINT32_MAX, append_while_visited, &visited), 21, "the new record comes last");
+    zassert_equal(visited, 21, NULL);
+    zassert_equal(query(0, UINT32_MAX).last, test_time, NULL);
+}
+
+struct page {
+    struct collect c;
+    uint32_t left;
+};
+
+static int collect_page(const struct feedlog_entry *entry, void *user_data)
+{
+    struct page *p = user_data;
+
+    if (p->left == 0) {
+        return 1;
+    }
+    p->left--;
+    return collect_entry(entry, &p->c);
+}
+
+ZTEST(feedlog, test_query_in_pages)
+{
+    struct feedlog_cursor cursor = {0};
+    struct page p = {.c = {.ordered = true}};
+    int ret;
+
+    append_many(50);
+
+    /* Pages of 7, not a multiple of the internal chunks */
+    do {
+        p.left = 7;
+        ret = feedlog_query_at(&cursor, START_TIME + 5, UINT32_MAX, collect_page, &p);
+        zassert_true(ret >= 0 && ret <= 7, NULL);
+    } while (p.left == 0);
+
+    zassert_equal(p.c.count, 46, "records lost or repeated across pages");
+    zassert_equal(p.c.first, START_TIME + 5, NULL);
+    zassert_equal(p.c.last, test_time, NULL);
+    zassert_true(p.c.ordered, NULL);
+}
+
+ZTEST(feedlog, test_append_never_blocks)
+{
+    struct feedlog_entry entry = {.grams = START_TIME % 100};
+    struct feedlog_stats st;
+    uint32_t dropped;
+
+    feedlog_get_stats(&st);
+    dropped = st.dropped;
+
+    /* Storage queue busy elsewhere: nothing is written until the flush */
+    storage_submit_fake.custom_fake = NULL;
+
+    for (int i = 0; i < FEEDLOG_QUEUE_LEN; i++) {
+        zassert_ok(feedlog_append(&entry));
+    }
+    zassert_equal(feedlog_append(&entry), -ENOBUFS, "a full queue must drop, not wait");
+
+    feedlog_get_stats(&st);
+    zassert_equal(st.dropped, dropped + 1, NULL);
+    zassert_equal(query(0, UINT32_MAX).count, 0, "nothing is in flash before the queue runs");
+
+    feedlog_flush();
+    zassert_equal(query(0, UINT32_MAX).count, FEEDLOG_QUEUE_LEN, NULL);
+}
+
+ZTEST(feedlog, test_append_before_init_is_kept)
+{
+    struct feedlog_entry entry;
+
+    /* The motor may dispense before the storage queue mounts the log */
+    feedlog_unmount();
+    for (int i = 0; i < 3; i++) {
+        test_time++;
+        entry = (struct feedlog_entry){.grams = test_time % 100};
+        zassert_ok(feedlog_append(&entry));
+    }
+    zassert_equal(feedlog_query(0, UINT32_MAX, collect_entry, NULL), -ENODEV, NULL);
+    feedlog_flush();
+
+    zassert_ok(feedlog_init());
+    feedlog_flush();
+    zassert_equal(query(0, UINT32_MAX).count, 3, "entries queued before the mount were lost");
+    zassert_equal(query(0, UINT32_MAX).last, test_time, NULL);
+}
+
+ZTEST(feedlog, test_entry_pack)
+{
+    const struct feedlog_entry entry = {
+        .time = 0x01020304, .steps = 0x0A0B0C0D, .grams = 0x1122, .duration_ms = 0x3344, .result = -ECANCELED};
+    uint8_t out[FEEDLOG_ENTRY_WIRE];
+
+    feedlog_entry_pack(&entry, out);
+
+    zassert_equal(out[0], 0x04, NULL);
+    zassert_equal(out[4], 0x0D, NULL);
+    zassert_equal(out[8], 0x22, NULL);
+    zassert_equal(out[10], 0x44, NULL);
+    zassert_equal((int8_t)out[12], -ECANCELED, NULL);
+}
@@ -0,0 +1,89 @@
+#include <zephyr/ztest.h>
+#include "filter.h"
+
+ZTEST(filter, test_mean_rounds_and_strides)
+{
+    const int16_t interleaved[] = {10, -10, 11, -11, 11, -11, 11, -11};
+
+    zassert_equal(filter_mean(interleaved, 4, 2), 11, "10.75 rounds up");
+    zassert_equal(filter_mean(interleaved + 1, 4, 2), -11, "rounding is symmetric");
+    zassert_equal(filter_mean(interleaved, 0, 2), 0, NULL);
+}
+
+ZTEST(filter, test_median_drops_spikes)
+{
+    struct filter_median f;
+
+    filter_median_reset(&f);
+    zassert_equal(filter_median_push(&f, 100), 100, "a single value is its own median");
+
+    for (int i = 0; i < FILTER_MEDIAN_LEN; i++) {
+        filter_median_push(&f, 100);
+    }
+    zassert_equal(filter_median_push(&f, 5000), 100, "one spike must not go through");
+    zassert_equal(filter_median_push(&f, -5000), 100, NULL);
+    zassert_equal(filter_median_push(&f, 100), 100, NULL);
+}
+
+ZTEST(filter, test_median_follows_a_step)
+{
+    struct filter_median f;
+    int32_t out = 0;
+    int pushed = 0;
+
+    filter_median_reset(&f);
+    for (int i = 0; i < FILTER_MEDIAN_LEN; i++) {
+        filter_median_push(&f, 0);
+    }
+    while (out != 100) {
+        out = filter_median_push(&f, 100);
+        pushed++;
+    }
+    zassert_equal(pushed, FILTER_MEDIAN_LEN / 2 + 1, "got %d values before the step went through", pushed);
+}
+
+ZTEST(filter, test_iir_primes_and_converges)
+{
+    struct filter_iir f;
+    int32_t out;
+
+    filter_iir_init(&f, 3);
+    zassert_equal(filter_iir_push(&f, 1000), 1000, "the first value primes the filter");
+
+    out = filter_iir_push(&f, 2000);
+    zassert_equal(out, 1125, "an eighth of the step per value, got %d", out);
+
+    for (int i = 0; i < 100; i++) {
+        out = filter_iir_push(&f, 2000);
+    }
+    zassert_within(out, 2000, 1, "no offset left in steady state, got %d", out);
+
+    for (int i = 0; i < 100; i++) {
+        out = filter_iir_push(&f, -300);
+    }
+    zassert_within(out, -300, 1, "negative values too, got %d", out);
+}
+
+ZTEST(filter, test_hysteresis_low_side)
+{
+    struct filter_hyst h = {.trip = 3300, .release = 3450};
+
+    zassert_false(filter_hyst_update(&h, 3400), NULL);
+    zassert_true(filter_hyst_update(&h, 3299), NULL);
+    zassert_true(filter_hyst_update(&h, 3400), "must stay tripped inside the dead band");
+    zassert_true(filter_hyst_update(&h, 3449), NULL);
+    zassert_false(filter_hyst_update(&h, 3450), NULL);
+    zassert_false(filter_hyst_update(&h, 3300), "must not trip again inside the dead band");
+}
+
+ZTEST(filter, test_hysteresis_high_side)
+{
+    struct filter_hyst h = {.trip = 600, .release = 550};
+
+    zassert_false(filter_hyst_update(&h, 600), NULL);
+    zassert_true(filter_hyst_update(&h, 601), NULL);
+    zassert_true(filter_hyst_update(&h, 560), NULL);
+    zassert_false(filter_hyst_update(&h, 550), NULL);
+}
+
+ZTEST_SUITE(filter, NULL, NULL, NULL, NULL, NULL);
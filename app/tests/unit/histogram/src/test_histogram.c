@@ -0,0 +1,202 @@
+#include <zephyr/ztest.h>
+#include <string.h>
+#include "histogram.h"
+#include "bench_clock.h"
+
+#define WRITER_STACK     1024
+#define WRITER_PRIORITY  5
+#define WRITER_COUNT     2
+#define WRITER_RECORDS   20000
+#define WRITER_YIELD     256
+#define TIMER_PERIOD_US  500
+#define TIMER_RECORDS    200
+#define BENCH_RECORDS    100000
+#define BENCH_MAX_NS     1000
+#define PERCENTILE_RANGE 10000
+
+K_THREAD_STACK_ARRAY_DEFINE(writer_stacks, WRITER_COUNT, WRITER_STACK);
+static struct k_thread writer_threads[WRITER_COUNT];
+static struct histogram hist;
+static atomic_t timer_records;
+
+/**
+ * @brief: Records the values 1..WRITER_RECORDS, yielding now and then so the writers interleave
+ */
+static void writer_entry(void *p1, void *p2, void *p3)
+{
+    ARG_UNUSED(p1);
+    ARG_UNUSED(p2);
+    ARG_UNUSED(p3);
+
+    for (uint32_t v = 1; v <= WRITER_RECORDS; v++) {
+        histogram_record(&hist, v);
+        if (v % WRITER_YIELD == 0) {
+            k_yield();
+        }
+    }
+}
+
+static void timer_expiry(struct k_timer *timer)
+{
+    if (atomic_inc(&timer_records) + 1 >= TIMER_RECORDS) {
+        k_timer_stop(timer);
+    }
+    histogram_record(&hist, k_cycle_get_32() & 0xFFFF);
+}
+
+K_TIMER_DEFINE(record_timer, timer_expiry, NULL);
+
+static void histogram_before(void *fixture)
+{
+    ARG_UNUSED(fixture);
+
+    histogram_reset(&hist);
+    hist_reset_all();
+    atomic_clear(&timer_records);
+}
+
+ZTEST(histogram, test_small_values_exact)
+{
+    for (uint32_t v = 0; v < 2 * HIST_SUB_COUNT; v++) {
+        zassert_equal(histogram_bucket(v), v, NULL);
+        zassert_equal(histogram_bucket_ceil(v), v, NULL);
+    }
+}
+
+ZTEST(histogram, test_bucket_bounds)
+{
+    for (uint64_t v = 1; v <= UINT32_MAX; v += MAX(v / 7, 1)) {
+        uint32_t bucket = histogram_bucket((uint32_t)v);
+        uint32_t ceil = histogram_bucket_ceil(bucket);
+
+        zassert_true(bucket < HIST_BUCKETS, "value %llu in bucket %u", v, bucket);
+        zassert_true(ceil >= v, "value %llu above the bucket bound %u", v, ceil);
+        zassert_true(bucket == 0 || histogram_bucket_ceil(bucket - 1) < v, "value %llu in a too high bucket", v);
+        zassert_true(ceil - v <= v / HIST_SUB_COUNT, "bucket of %llu too wide: %u", v, ceil);
+    }
+
+    zassert_equal(histogram_bucket(UINT32_MAX), HIST_BUCKETS - 1, NULL);
+    zassert_equal(histogram_bucket_ceil(HIST_BUCKETS - 1), UINT32_MAX, NULL);
+}
+
+ZTEST(histogram, test_bucket_ceil_increasing)
+{
+    for (uint32_t b = 1; b < HIST_BUCKETS; b++) {
+        zassert_true(histogram_bucket_ceil(b) > histogram_bucket_ceil(b - 1), "bucket %u", b);
+    }
+}
+
+ZTEST(histogram, test_percentiles)
+{
+    struct histogram_summary sum;
+
+    histogram_summarize(&hist, &sum);
+    zassert_equal(sum.count, 0, NULL);
+    zassert_equal(sum.p50, 0, "no samples, no percentile");
+
+    for (uint32_t v = 1; v <= PERCENTILE_RANGE; v++) {
+        histogram_record(&hist, v);
+    }
+    histogram_summarize(&hist, &sum);
+
+    zassert_equal(sum.count, PERCENTILE_RANGE, NULL);
+    zassert_equal(sum.max, PERCENTILE_RANGE, NULL);
+    zassert_within(sum.p50, PERCENTILE_RANGE / 2, PERCENTILE_RANGE / 2 / HIST_SUB_COUNT, "p50 %u", sum.p50);
+    zassert_within(sum.p90, PERCENTILE_RANGE * 9 / 10, PERCENTILE_RANGE * 9 / 10 / HIST_SUB_COUNT, "p90 %u",
+                   sum.p90);
+    zassert_true(sum.p50 <= sum.p90 && sum.p90 <= sum.p99 && sum.p99 <= sum.p999, NULL);
+    zassert_true(sum.p999 <= sum.max, "percentiles are capped by the max");
+    zassert_equal(histogram_percentile(&hist, 1000), sum.max, NULL);
+}
+
+ZTEST(histogram, test_rare_outlier_in_tail)
+{
+    struct histogram_summary sum;
+
+    for (int i = 0; i < 999; i++) {
+        histogram_record(&hist, 100);
+    }
+    histogram_record(&hist, 100000);
+    histogram_summarize(&hist, &sum);
+
+    zassert_true(sum.p99 <= 100 + 100 / HIST_SUB_COUNT, "p99 %u", sum.p99);
+    zassert_true(sum.p999 <= 100 + 100 / HIST_SUB_COUNT, "one sample in a thousand stays out of p99.9");
+    zassert_equal(sum.max, 100000, "the outlier still shows in the max");
+}
+
+ZTEST(histogram, test_concurrent_records)
+{
+    struct histogram_summary sum;
+
+    for (int i = 0; i < WRITER_COUNT; i++) {
+        k_thread_create(&writer_threads[i],
+                        writer_stacks[i],
+                        K_THREAD_STACK_SIZEOF(writer_stacks[i]),
+                        writer_entry,
+                        NULL,
+                        NULL,
+                        NULL,
+                        WRITER_PRIORITY,
+                        0,
+                        K_NO_WAIT);
+    }
+    k_timer_start(&record_timer, K_USEC(TIMER_PERIOD_US), K_USEC(TIMER_PERIOD_US));
+
+    for (int i = 0; i < WRITER_COUNT; i++) {
+        zassert_ok(k_thread_join(&writer_threads[i], K_SECONDS(5)));
+    }
+    while (atomic_get(&timer_records) < TIMER_RECORDS) {
+        k_msleep(1);
+    }
+
+    histogram_summarize(&hist, &sum);
+    zassert_equal(sum.count, WRITER_COUNT * WRITER_RECORDS + TIMER_RECORDS, "got %u records", sum.count);
+    zassert_true(sum.max >= WRITER_RECORDS, NULL);
+}
+
+ZTEST(histogram, test_reset)
+{
+    struct histogram_summary sum;
+
+    histogram_record(&hist, 42);
+    histogram_reset(&hist);
+    histogram_summarize(&hist, &sum);
+    zassert_equal(sum.count, 0, NULL);
+    zassert_equal(sum.max, 0, NULL);
+
+    hist_record(HIST_STEP_JITTER, 42);
+    hist_record(HIST_COUNT, 42);
+    histogram_summarize(hist_get(HIST_STEP_JITTER), &sum);
+    zassert_equal(sum.count, 1, NULL);
+    hist_reset_all();
+    histogram_summarize(hist_get(HIST_STEP_JITTER), &sum);
+    zassert_equal(sum.count, 0, NULL);
+}
+
+ZTEST(histogram, test_app_histograms)
+{
+    zassert_is_null(hist_get(HIST_COUNT), NULL);
+    zassert_is_null(hist_name(HIST_COUNT), NULL);
+
+    for (int i = 0; i < HIST_COUNT; i++) {
+        zassert_not_null(hist_get(i), NULL);
+        zassert_not_null(hist_name(i), "histogram %d has no name", i);
+    }
+}
+
+/* Recording runs in the step ISR, it has to stay in the tens of ns */
+ZTEST(histogram, test_record_cost)
+{
+    uint64_t start = bench_now_us();
+    uint64_t spent_ns;
+
+    for (uint32_t i = 0; i < BENCH_RECORDS; i++) {
+        histogram_record(&hist, i * 2654435761U);
+    }
+    spent_ns = (bench_now_us() - start) * NSEC_PER_USEC / BENCH_RECORDS;
+
+    TC_PRINT("histogram_record: %llu ns\n", spent_ns);
+    zassert_true(spent_ns < BENCH_MAX_NS, "recording takes %llu ns", spent_ns);
+}
+
+ZTEST_SUITE(histogram, NULL, NULL, histogram_before, NULL, NULL);
@@ -2,6 +2,8 @@
 #include <zephyr/fff.h>
 #include "init.h"
 #include "configuration.h"
+#include "storage.h"
+#include "feedlog.h"
 
 DEFINE_FFF_GLOBALS;
 
@@ -9,6 +11,25 @@ FAKE_VALUE_FUNC(int, init_nvs);
 FAKE_VALUE_FUNC(int, load_config);
 FAKE_VOID_FUNC(set_dflt_cfg);
 FAKE_VALUE_FUNC(int, init_watchdog);
+FAKE_VOID_FUNC(reset_info_boot);
+FAKE_VOID_FUNC(storage_init);
+FAKE_VALUE_FUNC(int, storage_submit, struct k_work *);
+FAKE_VALUE_FUNC(int, feedlog_init);
+
+#define SLOW_MOUNT_MS     100
+#define MAX_INIT_BLOCK_MS 5
+
+static int submit_to_system_queue(struct k_work *work)
+{
+    return k_work_submit(work);
+}
+
+static int slow_init_nvs(void)
+{
+    /* Mount time grows with the NVS history */
+    k_msleep(SLOW_MOUNT_MS);
+    return 0;
+}
 
 static void init_tests_before(void *fixture)
 {
@@ -16,11 +37,16 @@ static void init_tests_before(void *fixture)
     RESET_FAKE(load_config);
     RESET_FAKE(set_dflt_cfg);
     RESET_FAKE(init_watchdog);
+    RESET_FAKE(reset_info_boot);
+    RESET_FAKE(storage_init);
+    RESET_FAKE(storage_submit);
+    RESET_FAKE(feedlog_init);
     FFF_RESET_HISTORY();
 
     init_nvs_fake.return_val = 0;
     load_config_fake.return_val = 0;
     init_watchdog_fake.return_val = 0;
+    storage_submit_fake.custom_fake = submit_to_system_queue;
 }
 
 ZTEST(init_tests, test_processes_init_success_with_config)
@@ -28,10 +54,13 @@ ZTEST(init_tests, test_processes_init_success_with_config)
     int ret = processes_init();
 
     zassert_equal(ret, 0, NULL);
+    zassert_ok(processes_wait_ready(K_MSEC(BOOT_READY_BUDGET_MS)));
     zassert_equal(init_nvs_fake.call_count, 1, NULL);
     zassert_equal(load_config_fake.call_count, 1, NULL);
     zassert_equal(set_dflt_cfg_fake.call_count, 0, NULL);
     zassert_equal(init_watchdog_fake.call_count, 1, NULL);
+    zassert_equal(reset_info_boot_fake.call_count, 1, NULL);
+    zassert_equal(storage_init_fake.call_count, 1, NULL);
 }
 
 ZTEST(init_tests, test_processes_init_success_with_defaults)
@@ -41,6 +70,7 @@ ZTEST(init_tests, test_processes_init_success_with_defaults)
     int ret = processes_init();
 
     zassert_equal(ret, 0, NULL);
+    zassert_ok(processes_wait_ready(K_MSEC(BOOT_READY_BUDGET_MS)));
     zassert_equal(init_nvs_fake.call_count, 1, NULL);
     zassert_equal(load_config_fake.call_count, 1, NULL);
     zassert_equal(set_dflt_cfg_fake.call_count, 1, NULL);
@@ -53,10 +83,13 @@ ZTEST(init_tests, test_processes_init_nvs_failure)
 
     int ret = processes_init();
 
-    zassert_equal(ret, -5, NULL);
+    zassert_equal(ret, 0, "the NVS is mounted in the background");
+    zassert_ok(processes_wait_ready(K_MSEC(BOOT_READY_BUDGET_MS)), "a broken flash must still end on defaults");
+    zassert_equal(reset_info_boot_fake.call_count, 1, "reset info must be logged even if the NVS fails");
     zassert_equal(load_config_fake.call_count, 0, NULL);
-    zassert_equal(set_dflt_cfg_fake.call_count, 0, NULL);
-    zassert_equal(init_watchdog_fake.call_count, 0, NULL);
+    zassert_equal(set_dflt_cfg_fake.call_count, 1, NULL);
+    zassert_equal(init_watchdog_fake.call_count, 1, NULL);
+    zassert_equal(boot_phase_get(BOOT_PHASE_NVS_MOUNT)->result, -5, NULL);
 }
 
 ZTEST(init_tests, test_processes_init_watchdog_failure)
@@ -67,6 +100,63 @@ ZTEST(init_tests, test_processes_init_watchdog_failure)
 
     zassert_equal(ret, -EINVAL, NULL);
     zassert_equal(init_watchdog_fake.call_count, 1, NULL);
+    zassert_equal(storage_init_fake.call_count, 1, "the config must load without a watchdog");
+    zassert_equal(storage_submit_fake.call_count, 1, NULL);
+    zassert_ok(processes_wait_ready(K_MSEC(BOOT_READY_BUDGET_MS)));
+    zassert_equal(load_config_fake.call_count, 1, NULL);
+}
+
+ZTEST(init_tests, test_processes_init_submit_failure)
+{
+    storage_submit_fake.custom_fake = NULL;
+    storage_submit_fake.return_val = -EBUSY;
+
+    zassert_equal(processes_init(), -EBUSY, NULL);
+    zassert_ok(processes_wait_ready(K_NO_WAIT), "nobody may wait for a load that never comes");
+    zassert_equal(set_dflt_cfg_fake.call_count, 1, NULL);
+}
+
+ZTEST(init_tests, test_watchdog_before_nvs)
+{
+    zassert_ok(processes_init());
+    zassert_ok(processes_wait_ready(K_MSEC(BOOT_READY_BUDGET_MS)));
+
+    zassert_equal(fff.call_history[0], (void *)reset_info_boot, NULL);
+    zassert_equal(fff.call_history[1], (void *)init_watchdog, "the watchdog must not wait for the flash");
+    zassert_true(boot_phase_get(BOOT_PHASE_WATCHDOG)->done, NULL);
+}
+
+ZTEST(init_tests, test_slow_mount_does_not_block_boot)
+{
+    const struct boot_phase_info *ready = boot_phase_get(BOOT_PHASE_READY);
+    int64_t start = k_uptime_get();
+
+    init_nvs_fake.custom_fake = slow_init_nvs;
+
+    zassert_ok(processes_init());
+    zassert_true(k_uptime_get() - start <= MAX_INIT_BLOCK_MS, "processes_init() waited for the flash");
+    zassert_equal(processes_wait_ready(K_NO_WAIT), -EAGAIN, "config can't be ready before the mount");
+
+    zassert_ok(processes_wait_ready(K_MSEC(BOOT_READY_BUDGET_MS)));
+    zassert_true(ready->done, NULL);
+
+    for (int i = 0; i < BOOT_PHASE_COUNT; i++) {
+        const struct boot_phase_info *phase = boot_phase_get(i);
+
+        TC_PRINT("%-12s %6u us, result %d\n", phase->name, k_cyc_to_us_near32(phase->end_cyc - phase->start_cyc),
+                 phase->result);
+    }
+
+    uint32_t ready_ms = k_cyc_to_ms_near32(ready->end_cyc - ready->start_cyc);
+
+    zassert_true(ready_ms >= SLOW_MOUNT_MS, NULL);
+    zassert_true(ready_ms <= BOOT_READY_BUDGET_MS, "boot to ready took %u ms", ready_ms);
+}
+
+ZTEST(init_tests, test_boot_phase_get_bounds)
+{
+    zassert_is_null(boot_phase_get(BOOT_PHASE_COUNT), NULL);
+    zassert_not_null(boot_phase_get(BOOT_PHASE_RESET_INFO)->name, NULL);
 }
 
 ZTEST_SUITE(init_tests, NULL, NULL, init_tests_before, NULL, NULL);
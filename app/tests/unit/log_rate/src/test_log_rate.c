@@ -0,0 +1,128 @@
+#include <zephyr/ztest.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/logging/log_ctrl.h>
+#include <zephyr/logging/log_backend.h>
+#include "log_rate.h"
+#include "bench_clock.h"
+
+LOG_MODULE_REGISTER(log_rate_test, LOG_LEVEL_INF);
+
+#define TEST_PERIOD_MS  50
+#define BENCH_SECONDS   10
+#define BENCH_THREADS   3   /* motor, comm and health loops */
+#define BENCH_TICK_MS   100 /* fastest loop period */
+#define BENCH_STACK_LEN 2048
+
+static atomic_t logged;
+
+static void count_process(const struct log_backend *const backend, union log_msg_generic *msg)
+{
+    ARG_UNUSED(backend);
+    ARG_UNUSED(msg);
+
+    atomic_inc(&logged);
+}
+
+static const struct log_backend_api count_api = {
+    .process = count_process,
+};
+
+LOG_BACKEND_DEFINE(log_counter, count_api, true);
+
+/**
+ * @brief: Runs every pending message through the backends, the processing thread is off in the deferred build
+ */
+static void log_drain(void)
+{
+    if (IS_ENABLED(CONFIG_LOG_MODE_DEFERRED)) {
+        while (log_process()) {
+        }
+    }
+}
+
+static uint32_t log_count(void)
+{
+    log_drain();
+    return (uint32_t)atomic_get(&logged);
+}
+
+/**
+ * @brief: Simulates the status logs of the thread loops for BENCH_SECONDS
+ * @param: limited Go through the rate limit like the app does, otherwise log on every loop
+ * @return: host time spent logging, in us per simulated second
+ */
+static uint64_t bench_status_logs(bool limited, uint32_t *messages)
+{
+    uint32_t last_ms[BENCH_THREADS] = {0};
+    uint32_t before = log_count();
+    uint64_t spent_us = 0;
+
+    for (uint32_t now_ms = 0; now_ms < BENCH_SECONDS * MSEC_PER_SEC; now_ms += BENCH_TICK_MS) {
+        uint64_t start = bench_now_us();
+
+        for (int t = 0; t < BENCH_THREADS; t++) {
+            if (!limited || log_rate_allow_at(&last_ms[t], LOG_STATUS_PERIOD_MS, now_ms)) {
+                LOG_INF("Thread %d loop. Unused stack: %zu bytes", t, (size_t)BENCH_STACK_LEN - now_ms % 512);
+            }
+        }
+        log_drain();
+        spent_us += bench_now_us() - start;
+    }
+
+    *messages = log_count() - before;
+    return spent_us / BENCH_SECONDS;
+}
+
+ZTEST(log_rate, test_allow_once_per_period)
+{
+    uint32_t last = 0;
+
+    zassert_true(log_rate_allow_at(&last, TEST_PERIOD_MS, 1000), "first log must always go out");
+    zassert_false(log_rate_allow_at(&last, TEST_PERIOD_MS, 1000 + TEST_PERIOD_MS - 1), NULL);
+    zassert_true(log_rate_allow_at(&last, TEST_PERIOD_MS, 1000 + TEST_PERIOD_MS), NULL);
+    zassert_equal(last, 1000 + TEST_PERIOD_MS, NULL);
+}
+
+ZTEST(log_rate, test_allow_at_boot_and_wrap)
+{
+    uint32_t last = 0;
+
+    zassert_true(log_rate_allow_at(&last, TEST_PERIOD_MS, 0), NULL);
+    zassert_false(log_rate_allow_at(&last, TEST_PERIOD_MS, 10), "a log at uptime 0 must still count");
+
+    last = UINT32_MAX - 10;
+    zassert_false(log_rate_allow_at(&last, TEST_PERIOD_MS, 20), NULL);
+    zassert_true(log_rate_allow_at(&last, TEST_PERIOD_MS, TEST_PERIOD_MS), "the uptime wrap must not block logs");
+}
+
+ZTEST(log_rate, test_macro_drops_before_formatting)
+{
+    uint32_t before = log_count();
+    int64_t start = k_uptime_get();
+
+    while (k_uptime_get() - start < 2 * TEST_PERIOD_MS + TEST_PERIOD_MS / 2) {
+        LOG_INF_RATE(TEST_PERIOD_MS, "status %u", (uint32_t)k_uptime_get());
+        k_msleep(5);
+    }
+
+    zassert_equal(log_count() - before, 3, "one log per period expected");
+}
+
+ZTEST(log_rate, test_bench_status_logs)
+{
+    uint32_t every_msgs;
+    uint32_t limited_msgs;
+    uint64_t every_us = bench_status_logs(false, &every_msgs);
+    uint64_t limited_us = bench_status_logs(true, &limited_msgs);
+    const char *mode = IS_ENABLED(CONFIG_LOG_DICTIONARY_SUPPORT) ? "dictionary" : "text";
+
+    TC_PRINT("%s logs, every loop: %u msgs, %llu us/s\n", mode, every_msgs, every_us);
+    TC_PRINT("%s logs, rate limited: %u msgs, %llu us/s\n", mode, limited_msgs, limited_us);
+
+    zassert_equal(every_msgs, BENCH_SECONDS * (MSEC_PER_SEC / BENCH_TICK_MS) * BENCH_THREADS, NULL);
+    zassert_equal(limited_msgs, BENCH_THREADS * DIV_ROUND_UP(BENCH_SECONDS * MSEC_PER_SEC, LOG_STATUS_PERIOD_MS),
+                  NULL);
+    zassert_true(limited_us < every_us, "rate limiting must cut the logging time");
+}
+
+ZTEST_SUITE(log_rate, NULL, NULL, NULL, NULL, NULL);
@@ -0,0 +1,164 @@
+#include <zephyr/ztest.h>
+#include <string.h>
+#include "perf.h"
+
+#define BUSY_STACK     2048
+#define BUSY_PRIORITY  5
+#define BUSY_ROUNDS    5
+#define BUSY_US        20000
+#define BUSY_SLEEP_MS  20
+#define BUSY_STACK_USE 512
+
+K_THREAD_STACK_DEFINE(busy_stack, BUSY_STACK);
+static struct k_thread busy_thread;
+static K_SEM_DEFINE(busy_done, 0, 1);
+static K_SEM_DEFINE(busy_exit, 0, 1);
+static bool busy_running;
+
+K_MEM_SLAB_DEFINE_STATIC(test_slab, 32, 4, 4);
+
+/**
+ * @brief: Half busy, half sleeping, then waits to be inspected
+ */
+static void busy_entry(void *p1, void *p2, void *p3)
+{
+    ARG_UNUSED(p1);
+    ARG_UNUSED(p2);
+    ARG_UNUSED(p3);
+
+    volatile uint8_t scratch[BUSY_STACK_USE];
+
+    memset((void *)scratch, 0xA5, sizeof(scratch));
+
+    for (int i = 0; i < BUSY_ROUNDS; i++) {
+        k_busy_wait(BUSY_US);
+        k_msleep(BUSY_SLEEP_MS);
+    }
+
+    k_sem_give(&busy_done);
+    k_sem_take(&busy_exit, K_FOREVER);
+}
+
+static void busy_start(void)
+{
+    k_tid_t tid = k_thread_create(&busy_thread,
+                                  busy_stack,
+                                  K_THREAD_STACK_SIZEOF(busy_stack),
+                                  busy_entry,
+                                  NULL,
+                                  NULL,
+                                  NULL,
+                                  BUSY_PRIORITY,
+                                  0,
+                                  K_NO_WAIT);
+
+    k_thread_name_set(tid, "busy");
+    busy_running = true;
+}
+
+static const struct perf_thread *find_thread(const struct perf_thread *threads, int count, const char *name)
+{
+    for (int i = 0; i < count; i++) {
+        if (threads[i].name != NULL && strcmp(threads[i].name, name) == 0) {
+            return &threads[i];
+        }
+    }
+    return NULL;
+}
+
+static void perf_after(void *fixture)
+{
+    ARG_UNUSED(fixture);
+
+    if (!busy_running) {
+        return;
+    }
+    busy_running = false;
+    k_sem_give(&busy_exit);
+    k_thread_join(&busy_thread, K_FOREVER);
+    k_sem_reset(&busy_done);
+    k_sem_reset(&busy_exit);
+}
+
+ZTEST(perf, test_busy_thread_load_and_switches)
+{
+    struct perf_thread threads[PERF_MAX_THREADS];
+    const struct perf_thread *busy;
+    int count;
+
+    perf_reset();
+    busy_start();
+    zassert_ok(k_sem_take(&busy_done, K_SECONDS(2)));
+
+    count = perf_threads_get(threads, ARRAY_SIZE(threads));
+    zassert_true(count > 0, NULL);
+    busy = find_thread(threads, count, "busy");
+    zassert_not_null(busy, "the new thread must be listed");
+
+    TC_PRINT("busy: %u per mille, %u switches, %zu/%zu stack\n", busy->load_pm, busy->switches,
+             busy->stack_size - busy->stack_unused, busy->stack_size);
+
+    /* Half of the time busy, the rest mostly idle */
+    zassert_within(busy->load_pm, 500, 150, "got %u per mille", busy->load_pm);
+    zassert_true(busy->switches >= BUSY_ROUNDS, "got %u switches", busy->switches);
+    zassert_true(busy->stack_size - busy->stack_unused >= BUSY_STACK_USE, "stack high water mark too low");
+    zassert_true(busy->cycles <= perf_window_cycles(), NULL);
+}
+
+ZTEST(perf, test_reset_clears_counters)
+{
+    struct perf_thread threads[PERF_MAX_THREADS];
+    const struct perf_thread *busy;
+    size_t used;
+    int count;
+
+    busy_start();
+    zassert_ok(k_sem_take(&busy_done, K_SECONDS(2)));
+
+    count = perf_threads_get(threads, ARRAY_SIZE(threads));
+    busy = find_thread(threads, count, "busy");
+    zassert_not_null(busy, NULL);
+    zassert_true(busy->cycles > 0, NULL);
+    used = busy->stack_size - busy->stack_unused;
+
+    /* The busy thread stays blocked from here on */
+    perf_reset();
+    count = perf_threads_get(threads, ARRAY_SIZE(threads));
+    busy = find_thread(threads, count, "busy");
+    zassert_not_null(busy, NULL);
+    zassert_equal(busy->cycles, 0, NULL);
+    zassert_equal(busy->switches, 0, NULL);
+    zassert_equal(busy->stack_size - busy->stack_unused, used, "the high water mark survives a reset");
+}
+
+ZTEST(perf, test_threads_get_truncates)
+{
+    struct perf_thread threads[1];
+
+    busy_start();
+    zassert_equal(perf_threads_get(threads, ARRAY_SIZE(threads)), 1, NULL);
+    zassert_ok(k_sem_take(&busy_done, K_SECONDS(2)));
+}
+
+ZTEST(perf, test_slab_usage)
+{
+    struct perf_mem before;
+    struct perf_mem after;
+    void *blocks[2];
+
+    perf_mem_get(&before);
+    for (int i = 0; i < ARRAY_SIZE(blocks); i++) {
+        zassert_ok(k_mem_slab_alloc(&test_slab, &blocks[i], K_NO_WAIT));
+    }
+    perf_mem_get(&after);
+
+    zassert_true(after.slabs >= 1, NULL);
+    zassert_equal(after.slab_used, before.slab_used + ARRAY_SIZE(blocks), NULL);
+    zassert_true(after.slab_max_used >= ARRAY_SIZE(blocks), NULL);
+
+    for (int i = 0; i < ARRAY_SIZE(blocks); i++) {
+        k_mem_slab_free(&test_slab, blocks[i]);
+    }
+}
+
+ZTEST_SUITE(perf, NULL, NULL, NULL, perf_after, NULL);
@@ -0,0 +1,505 @@
+#include <zephyr/ztest.h>
+#include <zephyr/fff.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/ring_buffer.h>
+#include <string.h>
+#include "protocol.h"
+#include "histogram.h"
+#include "telemetry.h"
+#include "communication.h"
+#include "motor_control.h"
+#include "feedlog.h"
+#include "bench_clock.h"
+
+DEFINE_FFF_GLOBALS;
+
+FAKE_VALUE_FUNC(int, motor_cmd_post, enum motor_cmd_src, enum motor_cmd_type, int32_t);
+FAKE_VALUE_FUNC(bool, motor_is_busy);
+FAKE_VALUE_FUNC(uint32_t, motor_cmd_latency_cyc);
+FAKE_VALUE_FUNC(int, comm_send, const uint8_t *, size_t);
+FAKE_VOID_FUNC(comm_set_rx_handler, comm_rx_handler_t);
+FAKE_VALUE_FUNC(int, feedlog_query_at, struct feedlog_cursor *, uint32_t, uint32_t, feedlog_visit_cb_t, void *);
+FAKE_VOID_FUNC(feedlog_entry_pack, const struct feedlog_entry *, uint8_t *);
+FAKE_VALUE_FUNC(int, telemetry_read, enum telem_tier, enum telem_metric, struct telem_point *, size_t);
+FAKE_VOID_FUNC(telemetry_point_pack, const struct telem_point *, uint8_t *);
+
+#define BENCH_FRAMES 200000
+#define LOG_ENTRIES  5
+
+RING_BUF_DECLARE(rx_ring, COMM_RX_RING_SIZE);
+RING_BUF_DECLARE(small_ring, 64);
+
+static uint8_t last_tx[PROTO_MAX_ENCODED];
+static size_t last_tx_len;
+static uint32_t log_entries;
+
+static int capture_comm_send(const uint8_t *data, size_t len)
+{
+    memcpy(last_tx, data, MIN(len, sizeof(last_tx)));
+    last_tx_len = len;
+    return 0;
+}
+
+/**
+ * @brief: Decodes the last transmitted frame, returns the decoded length without crc
+ */
+static int decode_last_tx(void)
+{
+    int len;
+
+    zassert_true(last_tx_len > 1, "Nothing was transmitted");
+    zassert_equal(last_tx[last_tx_len - 1], 0, "Frame must end with a delimiter");
+    len = cobs_decode_in_place(last_tx, last_tx_len - 1);
+    zassert_true(len >= PROTO_HEADER_SIZE + PROTO_CRC_SIZE, NULL);
+
+    return len - PROTO_CRC_SIZE;
+}
+
+static size_t put_frame(struct ring_buf *ring, uint8_t type, uint8_t seq, const uint8_t *payload, size_t len)
+{
+    uint8_t frame[PROTO_MAX_ENCODED];
+    int frame_len = proto_encode(type, seq, payload, len, frame, sizeof(frame));
+
+    zassert_true(frame_len > 0, NULL);
+    zassert_equal(ring_buf_put(ring, frame, frame_len), frame_len, "Ring full");
+
+    return (size_t)frame_len;
+}
+
+static void protocol_tests_before(void *fixture)
+{
+    ARG_UNUSED(fixture);
+
+    RESET_FAKE(motor_cmd_post);
+    RESET_FAKE(motor_is_busy);
+    RESET_FAKE(motor_cmd_latency_cyc);
+    RESET_FAKE(comm_send);
+    RESET_FAKE(comm_set_rx_handler);
+    RESET_FAKE(feedlog_query_at);
+    RESET_FAKE(feedlog_entry_pack);
+    RESET_FAKE(telemetry_read);
+    RESET_FAKE(telemetry_point_pack);
+    FFF_RESET_HISTORY();
+
+    comm_send_fake.custom_fake = capture_comm_send;
+    last_tx_len = 0;
+    log_entries = LOG_ENTRIES;
+    ring_buf_reset(&rx_ring);
+    ring_buf_reset(&small_ring);
+    proto_reset();
+}
+
+ZTEST(protocol, test_init_hooks_rx_path)
+{
+    protocol_init();
+
+    zassert_equal(comm_set_rx_handler_fake.call_count, 1, NULL);
+    zassert_equal(comm_set_rx_handler_fake.arg0_val, proto_rx_process, NULL);
+}
+
+ZTEST(protocol, test_cobs_round_trip)
+{
+    static const uint8_t data[] = {0x00, 0x11, 0x00, 0x00, 0x22, 0x33, 0x00};
+    uint8_t enc[sizeof(data) + 2];
+    size_t len = cobs_encode(data, sizeof(data), enc);
+
+    zassert_is_null(memchr(enc, 0, len), "Encoded data must not contain zeros");
+    zassert_equal(cobs_decode_in_place(enc, len), sizeof(data), NULL);
+    zassert_mem_equal(enc, data, sizeof(data), NULL);
+
+    enc[0] = 0x00;
+    zassert_equal(cobs_decode_in_place(enc, len), -EINVAL, "Zero code byte is malformed");
+}
+
+ZTEST(protocol, test_feed_frame_posts_command_and_acks)
+{
+    uint8_t payload[2];
+
+    sys_put_le16(25, payload);
+    put_frame(&rx_ring, PROTO_FEED, 7, payload, sizeof(payload));
+    proto_rx_process(&rx_ring);
+
+    zassert_equal(motor_cmd_post_fake.call_count, 1, NULL);
+    zassert_equal(motor_cmd_post_fake.arg0_val, MOTOR_SRC_COMM, "Protocol must post on the comm ring");
+    zassert_equal(motor_cmd_post_fake.arg1_val, MOTOR_CMD_FEED, NULL);
+    zassert_equal(motor_cmd_post_fake.arg2_val, 25, NULL);
+    zassert_true(ring_buf_is_empty(&rx_ring), "Frame should be consumed");
+
+    zassert_equal(decode_last_tx(), PROTO_HEADER_SIZE + 2, NULL);
+    zassert_equal(last_tx[0], PROTO_ACK, NULL);
+    zassert_equal(last_tx[1], 7, "Ack must echo the sequence number");
+    zassert_equal(last_tx[2], PROTO_FEED, NULL);
+    zassert_equal((int8_t)last_tx[3], 0, NULL);
+}
+
+ZTEST(protocol, test_status_request)
+{
+    motor_is_busy_fake.return_val = true;
+
+    put_frame(&rx_ring, PROTO_GET_STATUS, 3, NULL, 0);
+    proto_rx_process(&rx_ring);
+
+    zassert_equal(decode_last_tx(), PROTO_HEADER_SIZE + 5, NULL);
+    zassert_equal(last_tx[0], PROTO_STATUS, NULL);
+    zassert_equal(last_tx[2], 1, "Busy flag not reported");
+}
+
+/**
+ * @brief: A log of log_entries records, the cursor rec is the index of the next one
+ */
+static int entries_query(struct feedlog_cursor *cursor, uint32_t from, uint32_t to, feedlog_visit_cb_t cb,
+                         void *user_data)
+{
+    struct feedlog_entry entry = {0};
+    int visited = 0;
+
+    ARG_UNUSED(to);
+
+    for (; cursor->rec < log_entries; cursor->rec++) {
+        entry.time = from + cursor->rec;
+        if (cb(&entry, user_data) != 0) {
+            return visited;
+        }
+        visited++;
+    }
+
+    return visited;
+}
+
+ZTEST(protocol, test_log_request_streams_range)
+{
+    uint8_t range[8];
+
+    sys_put_le32(1000, &range[0]);
+    sys_put_le32(2000, &range[4]);
+    feedlog_query_at_fake.custom_fake = entries_query;
+
+    put_frame(&rx_ring, PROTO_GET_LOG, 9, range, sizeof(range));
+    proto_rx_process(&rx_ring);
+
+    zassert_equal(feedlog_query_at_fake.arg1_val, 1000, NULL);
+    zassert_equal(feedlog_query_at_fake.arg2_val, 2000, NULL);
+    zassert_equal(feedlog_entry_pack_fake.call_count, LOG_ENTRIES, NULL);
+
+    /* Full frames, the remainder, then the ack closing the stream */
+    zassert_equal(comm_send_fake.call_count, DIV_ROUND_UP(LOG_ENTRIES, PROTO_LOG_PER_FRAME) + 1, NULL);
+    decode_last_tx();
+    zassert_equal(last_tx[0], PROTO_ACK, NULL);
+    zassert_equal(last_tx[2], PROTO_GET_LOG, NULL);
+    zassert_equal((int8_t)last_tx[3], 0, NULL);
+}
+
+static uint8_t log_next[PROTO_LOG_CURSOR_WIRE];
+static bool log_next_sent;
+
+static int capture_log_next(const uint8_t *data, size_t len)
+{
+    capture_comm_send(data, len);
+    decode_last_tx();
+    if (last_tx[0] == PROTO_LOG_NEXT) {
+        memcpy(log_next, &last_tx[2], sizeof(log_next));
+        log_next_sent = true;
+    }
+    return 0;
+}
+
+ZTEST(protocol, test_log_request_is_paged)
+{
+    uint8_t request[8 + PROTO_LOG_CURSOR_WIRE] = {0};
+    uint32_t pages = 0;
+
+    /* Far more than the TX ring takes at once */
+    log_entries = 3 * PROTO_LOG_PAGE + 1;
+    feedlog_query_at_fake.custom_fake = entries_query;
+    comm_send_fake.custom_fake = capture_log_next;
+
+    put_frame(&rx_ring, PROTO_GET_LOG, 1, request, 8);
+    do {
+        log_next_sent = false;
+        proto_rx_process(&rx_ring);
+        pages++;
+        zassert_equal(feedlog_entry_pack_fake.call_count, MIN(pages * PROTO_LOG_PAGE, log_entries), NULL);
+        zassert_equal(last_tx[0], PROTO_ACK, "every page ends with the ACK");
+        zassert_equal((int8_t)last_tx[3], 0, NULL);
+
+        memcpy(&request[8], log_next, sizeof(log_next));
+        if (log_next_sent) {
+            put_frame(&rx_ring, PROTO_GET_LOG, 1 + pages, request, sizeof(request));
+        }
+    } while (log_next_sent && pages < 10);
+
+    zassert_equal(pages, 4, "three full pages and the last entry");
+    zassert_equal(sys_get_le32(&request[12]), 3 * PROTO_LOG_PAGE, "cursor of the last page");
+}
+
+ZTEST(protocol, test_log_request_stops_on_tx_full)
+{
+    uint8_t range[8] = {0};
+
+    feedlog_query_at_fake.custom_fake = entries_query;
+    comm_send_fake.return_val = -ENOBUFS;
+    comm_send_fake.custom_fake = NULL;
+
+    put_frame(&rx_ring, PROTO_GET_LOG, 1, range, sizeof(range));
+    proto_rx_process(&rx_ring);
+
+    zassert_equal(feedlog_entry_pack_fake.call_count, PROTO_LOG_PER_FRAME, "query must stop at the first failure");
+
+    comm_send_fake.custom_fake = capture_comm_send;
+    put_frame(&rx_ring, PROTO_GET_LOG, 2, range, 4);
+    proto_rx_process(&rx_ring);
+    decode_last_tx();
+    zassert_equal((int8_t)last_tx[3], -EINVAL, "short range must be rejected");
+}
+
+static uint8_t hist_tx[HIST_COUNT][PROTO_MAX_ENCODED];
+
+static int capture_hist_frames(const uint8_t *data, size_t len)
+{
+    /* call_count is already incremented when the custom fake runs */
+    uint32_t idx = comm_send_fake.call_count - 1;
+
+    if (idx < HIST_COUNT) {
+        memcpy(hist_tx[idx], data, MIN(len, sizeof(hist_tx[idx])));
+    }
+    return capture_comm_send(data, len);
+}
+
+ZTEST(protocol, test_hist_request_sends_every_histogram)
+{
+    uint8_t *frame = hist_tx[HIST_SHELL_CMD];
+    int len;
+
+    hist_reset_all();
+    for (uint32_t i = 1; i <= 1000; i++) {
+        hist_record(HIST_SHELL_CMD, k_us_to_cyc_ceil32(i));
+    }
+    comm_send_fake.custom_fake = capture_hist_frames;
+
+    put_frame(&rx_ring, PROTO_GET_HIST, 4, NULL, 0);
+    proto_rx_process(&rx_ring);
+
+    zassert_equal(comm_send_fake.call_count, HIST_COUNT + 1, NULL);
+    decode_last_tx();
+    zassert_equal(last_tx[0], PROTO_ACK, NULL);
+    zassert_equal((int8_t)last_tx[3], 0, NULL);
+
+    len = cobs_decode_in_place(frame, strlen((char *)frame));
+    zassert_equal(len, PROTO_HEADER_SIZE + PROTO_HIST_WIRE + PROTO_CRC_SIZE, NULL);
+    zassert_equal(frame[0], PROTO_HIST, NULL);
+    zassert_equal(frame[2], HIST_SHELL_CMD, NULL);
+    zassert_equal(sys_get_le32(&frame[3]), 1000, NULL);
+    /* Buckets are 25 % wide at most */
+    zassert_within(sys_get_le32(&frame[7]), 500, 125, "p50 %u us", sys_get_le32(&frame[7]));
+    zassert_equal(sys_get_le32(&frame[23]), 1000, "max must be exact");
+}
+
+#define TELEM_TEST_POINTS 25
+
+static uint8_t telem_tx[DIV_ROUND_UP(TELEM_TEST_POINTS, PROTO_TELEM_PER_FRAME)][PROTO_MAX_ENCODED];
+
+static int capture_telem_frames(const uint8_t *data, size_t len)
+{
+    uint32_t idx = comm_send_fake.call_count - 1;
+
+    if (idx < ARRAY_SIZE(telem_tx)) {
+        memcpy(telem_tx[idx], data, MIN(len, sizeof(telem_tx[idx])));
+    }
+    return capture_comm_send(data, len);
+}
+
+static int custom_telemetry_read(enum telem_tier tier, enum telem_metric metric, struct telem_point *out, size_t max)
+{
+    zassert_true(max >= TELEM_TEST_POINTS, NULL);
+    for (int i = 0; i < TELEM_TEST_POINTS; i++) {
+        out[i] = (struct telem_point){.min = i, .max = i, .mean = i};
+    }
+    return TELEM_TEST_POINTS;
+}
+
+static void custom_point_pack(const struct telem_point *point, uint8_t *out)
+{
+    memset(out, 0, TELEM_POINT_WIRE);
+    out[0] = (uint8_t)point->mean;
+}
+
+ZTEST(protocol, test_telemetry_request_streams_points)
+{
+    const uint8_t request[2] = {TELEM_TIER_MIN, TELEM_BATTERY};
+    uint8_t *frame = telem_tx[ARRAY_SIZE(telem_tx) - 1];
+    int len;
+
+    telemetry_read_fake.custom_fake = custom_telemetry_read;
+    telemetry_point_pack_fake.custom_fake = custom_point_pack;
+    comm_send_fake.custom_fake = capture_telem_frames;
+
+    put_frame(&rx_ring, PROTO_GET_TELEM, 6, request, sizeof(request));
+    proto_rx_process(&rx_ring);
+
+    zassert_equal(telemetry_read_fake.arg0_val, TELEM_TIER_MIN, NULL);
+    zassert_equal(telemetry_read_fake.arg1_val, TELEM_BATTERY, NULL);
+    zassert_equal(telemetry_point_pack_fake.call_count, TELEM_TEST_POINTS, NULL);
+    zassert_equal(comm_send_fake.call_count, ARRAY_SIZE(telem_tx) + 1, NULL);
+    decode_last_tx();
+    zassert_equal(last_tx[0], PROTO_ACK, NULL);
+    zassert_equal((int8_t)last_tx[3], 0, NULL);
+
+    /* The last frame carries the remainder, oldest first */
+    len = cobs_decode_in_place(frame, strlen((char *)frame));
+    zassert_equal(frame[0], PROTO_TELEM, NULL);
+    zassert_equal(frame[2], TELEM_TIER_MIN, NULL);
+    zassert_equal(frame[3], TELEM_BATTERY, NULL);
+    zassert_equal(frame[4], 2 * PROTO_TELEM_PER_FRAME, "index of the first point of the frame");
+    zassert_equal(len, PROTO_HEADER_SIZE + PROTO_TELEM_HEADER + 5 * TELEM_POINT_WIRE + PROTO_CRC_SIZE, NULL);
+    zassert_equal(frame[PROTO_HEADER_SIZE + PROTO_TELEM_HEADER], 2 * PROTO_TELEM_PER_FRAME, NULL);
+}
+
+ZTEST(protocol, test_telemetry_request_rejects_bad_queries)
+{
+    const uint8_t request[2] = {TELEM_TIER_COUNT, TELEM_BATTERY};
+
+    telemetry_read_fake.return_val = -EINVAL;
+    put_frame(&rx_ring, PROTO_GET_TELEM, 7, request, sizeof(request));
+    proto_rx_process(&rx_ring);
+    decode_last_tx();
+    zassert_equal((int8_t)last_tx[3], -EINVAL, NULL);
+
+    put_frame(&rx_ring, PROTO_GET_TELEM, 8, request, 1);
+    proto_rx_process(&rx_ring);
+    decode_last_tx();
+    zassert_equal((int8_t)last_tx[3], -EINVAL, "short request must be rejected");
+    zassert_equal(telemetry_read_fake.call_count, 1, NULL);
+}
+
+ZTEST(protocol, test_frame_handling_time_recorded)
+{
+    struct histogram_summary sum;
+
+    hist_reset_all();
+    for (int i = 0; i < 10; i++) {
+        put_frame(&rx_ring, PROTO_PING, i, NULL, 0);
+    }
+    put_frame(&rx_ring, PROTO_GET_HIST, 10, (const uint8_t *)"x", 1);
+    proto_rx_process(&rx_ring);
+
+    histogram_summarize(hist_get(HIST_PROTO_FRAME), &sum);
+    zassert_equal(sum.count, 11, "every valid frame must be timed");
+    decode_last_tx();
+    zassert_equal((int8_t)last_tx[3], -EINVAL, NULL);
+}
+
+ZTEST(protocol, test_bad_crc_is_dropped)
+{
+    uint8_t payload[4] = {1, 2, 3, 4};
+    uint8_t *data;
+    size_t len = put_frame(&rx_ring, PROTO_JOG, 1, payload, sizeof(payload));
+    struct proto_stats stats;
+
+    ring_buf_get_claim(&rx_ring, &data, len);
+    data[4] ^= 0x01;
+    ring_buf_get_finish(&rx_ring, 0);
+
+    proto_rx_process(&rx_ring);
+    proto_get_stats(&stats);
+
+    zassert_equal(stats.crc_errors, 1, NULL);
+    zassert_equal(stats.frames_ok, 0, NULL);
+    zassert_equal(motor_cmd_post_fake.call_count, 0, "Corrupted frame must not reach the motor");
+}
+
+ZTEST(protocol, test_partial_frame_waits_for_more_bytes)
+{
+    uint8_t frame[PROTO_MAX_ENCODED];
+    int len = proto_encode(PROTO_STOP, 9, NULL, 0, frame, sizeof(frame));
+
+    ring_buf_put(&rx_ring, frame, len - 2);
+    proto_rx_process(&rx_ring);
+    zassert_equal(motor_cmd_post_fake.call_count, 0, NULL);
+    zassert_equal(ring_buf_size_get(&rx_ring), len - 2, "Partial frame must stay in the ring");
+
+    ring_buf_put(&rx_ring, &frame[len - 2], 2);
+    proto_rx_process(&rx_ring);
+    zassert_equal(motor_cmd_post_fake.call_count, 1, NULL);
+    zassert_equal(motor_cmd_post_fake.arg1_val, MOTOR_CMD_STOP, NULL);
+}
+
+ZTEST(protocol, test_frame_split_by_wrap_around)
+{
+    uint8_t filler[50];
+    uint8_t payload[4];
+
+    /* Move the ring indexes close to the end so the next frame wraps */
+    ring_buf_put(&small_ring, filler, sizeof(filler));
+    ring_buf_get(&small_ring, NULL, sizeof(filler));
+
+    sys_put_le32(3000, payload);
+    put_frame(&small_ring, PROTO_SET_SPEED, 1, payload, sizeof(payload));
+    put_frame(&small_ring, PROTO_SET_SPEED, 2, payload, sizeof(payload));
+    proto_rx_process(&small_ring);
+
+    zassert_equal(motor_cmd_post_fake.call_count, 2, "Both frames should be parsed");
+    zassert_equal(motor_cmd_post_fake.arg2_history[0], 3000, NULL);
+    zassert_equal(motor_cmd_post_fake.arg2_history[1], 3000, NULL);
+}
+
+ZTEST(protocol, test_garbage_and_unknown_types)
+{
+    uint8_t garbage[PROTO_MAX_ENCODED + 4];
+    struct proto_stats stats;
+
+    memset(garbage, 0x55, sizeof(garbage));
+    ring_buf_put(&rx_ring, garbage, sizeof(garbage));
+    proto_rx_process(&rx_ring);
+
+    put_frame(&rx_ring, 0x7E, 4, NULL, 0);
+    proto_rx_process(&rx_ring);
+    proto_get_stats(&stats);
+
+    zassert_true(stats.framing_errors >= 1, "Line noise should be counted");
+    zassert_equal(stats.unknown_types, 1, NULL);
+    decode_last_tx();
+    zassert_equal((int8_t)last_tx[3], -EBADMSG, NULL);
+}
+
+ZTEST(protocol, test_parse_benchmark)
+{
+    static const char *const shell_feed = "feed 25\r\n";
+    static const char *const shell_status_reply = "Current config: 0\r\nLast command latency: 1234 us\r\n";
+    uint8_t payload[2];
+    uint8_t status[5] = {0};
+    uint8_t frame[PROTO_MAX_ENCODED];
+    int frame_len;
+    int status_len;
+    uint64_t start;
+    uint64_t elapsed_us;
+    uint32_t parsed = 0;
+
+    sys_put_le16(25, payload);
+    status_len = proto_encode(PROTO_STATUS, 0, status, sizeof(status), frame, sizeof(frame));
+    frame_len = proto_encode(PROTO_FEED, 0, payload, sizeof(payload), frame, sizeof(frame));
+    comm_send_fake.custom_fake = NULL;
+
+    start = bench_now_us();
+    while (parsed < BENCH_FRAMES) {
+        uint32_t batch = 0;
+
+        while (ring_buf_space_get(&rx_ring) >= (uint32_t)frame_len) {
+            ring_buf_put(&rx_ring, frame, frame_len);
+            batch++;
+        }
+        proto_rx_process(&rx_ring);
+        parsed += batch;
+    }
+    elapsed_us = MAX(bench_now_us() - start, 1);
+
+    zassert_equal(motor_cmd_post_fake.call_count, parsed, "Every frame should be dispatched");
+
+    TC_PRINT("proto: %u frames in %llu us (%llu frames/s)\n", parsed, elapsed_us,
+             (uint64_t)parsed * 1000000 / elapsed_us);
+    TC_PRINT("proto: feed command %d bytes, shell '%s' %zu bytes\n", frame_len, "feed 25", strlen(shell_feed));
+    TC_PRINT("proto: status reply %d bytes, shell %zu bytes\n", status_len, strlen(shell_status_reply));
+
+    zassert_true((size_t)frame_len < strlen(shell_feed), "Binary feed should be smaller than the shell command");
+}
+
+ZTEST_SUITE(protocol, NULL, NULL, protocol_tests_before, NULL, NULL);
@@ -0,0 +1,117 @@
+#include <zephyr/ztest.h>
+#include <string.h>
+#include "reset_info.h"
+
+static void reset_info_tests_before(void *fixture)
+{
+    ARG_UNUSED(fixture);
+
+    /* Start every test from a power cycle */
+    memset(reset_info_retained(), 0xA5, sizeof(struct reset_info));
+    reset_info_boot();
+}
+
+ZTEST(reset_info, test_cold_boot_has_no_record)
+{
+    struct reset_info last;
+
+    zassert_false(reset_info_last(&last), "garbage RAM taken as a record");
+    zassert_equal(reset_info_retained()->reset_count, 0, NULL);
+    zassert_equal(reset_info_retained()->magic, RESET_INFO_MAGIC, NULL);
+}
+
+ZTEST(reset_info, test_record_survives_warm_reset)
+{
+    struct reset_info last;
+
+    reset_info_thread(0, "motor_control", 1000);
+    reset_info_thread(1, "communication", 1200);
+    reset_info_seal();
+
+    reset_info_boot();
+
+    zassert_true(reset_info_last(&last), NULL);
+    zassert_str_equal(last.threads[0].name, "motor_control", NULL);
+    zassert_equal(last.threads[0].last_beat_ms, 1000, NULL);
+    zassert_str_equal(last.threads[1].name, "communication", NULL);
+    zassert_equal(last.threads[1].last_beat_ms, 1200, NULL);
+    zassert_equal(last.culprit[0], '\0', "no watchdog reset happened");
+}
+
+ZTEST(reset_info, test_culprit_and_count)
+{
+    struct reset_info last;
+
+    reset_info_set_culprit("communication");
+    reset_info_boot();
+
+    zassert_true(reset_info_last(&last), NULL);
+    zassert_str_equal(last.culprit, "communication", NULL);
+    zassert_equal(last.reset_count, 0, NULL);
+    zassert_equal(reset_info_retained()->reset_count, 1, NULL);
+    zassert_equal(reset_info_retained()->culprit[0], '\0', "the new record starts clean");
+
+    reset_info_boot();
+    zassert_equal(reset_info_retained()->reset_count, 2, NULL);
+}
+
+ZTEST(reset_info, test_long_names_truncated)
+{
+    struct reset_info last;
+
+    reset_info_set_culprit("a_thread_name_longer_than_the_slot");
+    reset_info_boot();
+
+    zassert_true(reset_info_last(&last), NULL);
+    zassert_equal(strlen(last.culprit), RESET_INFO_NAME_LEN - 1, NULL);
+}
+
+ZTEST(reset_info, test_unsealed_change_rejected)
+{
+    struct reset_info last;
+
+    /* A reset in the middle of an update leaves a record that doesn't match its CRC */
+    reset_info_thread(2, "check_health", 500);
+    reset_info_boot();
+
+    zassert_false(reset_info_last(&last), NULL);
+    zassert_equal(reset_info_retained()->reset_count, 0, NULL);
+}
+
+ZTEST(reset_info, test_culprit_survives_unsealed_heartbeat)
+{
+    struct reset_info last;
+
+    /* The watchdog fires between a heartbeat update and its seal: the culprit seals everything */
+    reset_info_thread(0, "motor_control", 700);
+    reset_info_set_culprit("motor_control");
+    reset_info_boot();
+
+    zassert_true(reset_info_last(&last), NULL);
+    zassert_str_equal(last.culprit, "motor_control", NULL);
+    zassert_equal(last.threads[0].last_beat_ms, 700, NULL);
+}
+
+ZTEST(reset_info, test_corrupted_record_rejected)
+{
+    struct reset_info last;
+
+    reset_info_set_culprit("motor_control");
+    reset_info_retained()->culprit[0] ^= 0x01;
+    reset_info_boot();
+
+    zassert_false(reset_info_last(&last), "corrupted record accepted");
+}
+
+ZTEST(reset_info, test_bad_slot_ignored)
+{
+    reset_info_thread(-1, "nope", 1);
+    reset_info_thread(HEALTH_MAX_THREADS, "nope", 1);
+    reset_info_seal();
+
+    for (int i = 0; i < HEALTH_MAX_THREADS; i++) {
+        zassert_equal(reset_info_retained()->threads[i].name[0], '\0', "slot %d written", i);
+    }
+}
+
+ZTEST_SUITE(reset_info, NULL, NULL, reset_info_tests_before, NULL, NULL);
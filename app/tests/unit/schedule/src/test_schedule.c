@@ -0,0 +1,270 @@
+#include <zephyr/ztest.h>
+#include <zephyr/fff.h>
+#include <string.h>
+#include "configuration.h"
+#include "schedule.h"
+#include "motor_control.h"
+
+DEFINE_FFF_GLOBALS;
+
+FAKE_VALUE_FUNC(int, motor_cmd_post, enum motor_cmd_src, enum motor_cmd_type, int32_t);
+FAKE_VOID_FUNC(config_commit_request);
+
+struct config cfg;
+K_MUTEX_DEFINE(config_lock);
+
+#define START_2026   1767225600U /* 2026-01-01 00:00:00 UTC, a Thursday */
+#define DAYS_2026    365
+#define MAX_RECORDS  1024
+
+#define MON BIT(0)
+#define WED BIT(2)
+#define THU BIT(3)
+#define FRI BIT(4)
+
+struct fire_record {
+    uint16_t slot;
+    uint16_t grams;
+    uint32_t due;
+    uint32_t now;
+};
+
+static struct fire_record records[MAX_RECORDS];
+static size_t record_count;
+
+static void record_fire(uint16_t slot, uint16_t grams, uint32_t due)
+{
+    if (record_count < MAX_RECORDS) {
+        records[record_count].slot = slot;
+        records[record_count].grams = grams;
+        records[record_count].due = due;
+        records[record_count].now = schedule_now();
+    }
+    record_count++;
+}
+
+static size_t count_slot(uint16_t slot)
+{
+    size_t count = 0;
+
+    for (size_t i = 0; i < MIN(record_count, MAX_RECORDS); i++) {
+        count += (records[i].slot == slot) ? 1 : 0;
+    }
+
+    return count;
+}
+
+static int add_slot(uint8_t kind, uint32_t time, uint8_t days, uint16_t grams)
+{
+    struct schedule_slot slot = {.kind = kind, .days = days, .grams = grams, .time = time};
+
+    return schedule_add(&slot);
+}
+
+static void sleep_days(uint32_t days)
+{
+    /* K_SECONDS of a whole year overflows the ms conversion, go a day at a time */
+    for (uint32_t i = 0; i < days; i++) {
+        k_sleep(K_SECONDS(SCHEDULE_SECS_DAY));
+    }
+}
+
+static void schedule_before(void *fixture)
+{
+    ARG_UNUSED(fixture);
+
+    RESET_FAKE(motor_cmd_post);
+    RESET_FAKE(config_commit_request);
+    FFF_RESET_HISTORY();
+
+    memset(cfg.schedule, 0, sizeof(cfg.schedule));
+    memset(records, 0, sizeof(records));
+    record_count = 0;
+
+    schedule_reset();
+    schedule_init(record_fire);
+    schedule_set_time(START_2026);
+    RESET_FAKE(config_commit_request);
+}
+
+ZTEST(schedule, test_rejects_bad_slots)
+{
+    zassert_equal(add_slot(SCHEDULE_DAILY, SCHEDULE_SECS_DAY, 0, 10), -EINVAL, "time of day out of range");
+    zassert_equal(add_slot(SCHEDULE_DAILY, 3600, 0, 0), -EINVAL, "zero grams");
+    zassert_equal(add_slot(SCHEDULE_WEEKLY, 3600, 0, 10), -EINVAL, "weekly without days");
+    zassert_equal(add_slot(SCHEDULE_WEEKLY, 3600, 0x80, 10), -EINVAL, "unknown day bit");
+    zassert_equal(add_slot(SCHEDULE_ONCE, START_2026 - 60, 0, 10), -EINVAL, "one shot in the past");
+    zassert_equal(add_slot(SCHEDULE_FREE, 3600, 0, 10), -EINVAL, "free is not a kind");
+
+    zassert_equal(schedule_remove(SCHEDULE_MAX_SLOTS), -EINVAL, NULL);
+    zassert_equal(schedule_remove(0), -EINVAL, "slot 0 is free");
+}
+
+ZTEST(schedule, test_table_full)
+{
+    for (int i = 0; i < SCHEDULE_MAX_SLOTS; i++) {
+        zassert_equal(add_slot(SCHEDULE_DAILY, i * 60, 0, 1), i, "slot %d", i);
+    }
+
+    zassert_equal(add_slot(SCHEDULE_DAILY, 0, 0, 1), -ENOMEM, NULL);
+
+    zassert_ok(schedule_remove(17));
+    zassert_equal(add_slot(SCHEDULE_DAILY, 0, 0, 1), 17, "freed slot must be reused");
+}
+
+ZTEST(schedule, test_next_event_is_earliest)
+{
+    uint32_t due;
+    uint16_t slot;
+
+    zassert_equal(schedule_next(&due, &slot), -ENOENT, NULL);
+
+    add_slot(SCHEDULE_DAILY, 20 * 3600, 0, 10);
+    add_slot(SCHEDULE_DAILY, 8 * 3600, 0, 10);
+    add_slot(SCHEDULE_ONCE, START_2026 + 9 * 3600, 0, 10);
+
+    zassert_ok(schedule_next(&due, &slot));
+    zassert_equal(slot, 1, NULL);
+    zassert_equal(due, START_2026 + 8 * 3600, NULL);
+
+    zassert_ok(schedule_remove(1));
+    zassert_ok(schedule_next(&due, &slot));
+    zassert_equal(slot, 2, "cancelling the head must promote the next event");
+    zassert_equal(due, START_2026 + 9 * 3600, NULL);
+}
+
+ZTEST(schedule, test_heap_random_cancel)
+{
+    uint32_t seed = 12345;
+    uint32_t last_due = 0;
+    size_t expected = 0;
+
+    /* Pseudo random times, then every third slot is cancelled from the middle of the heap */
+    for (int i = 0; i < SCHEDULE_MAX_SLOTS; i++) {
+        seed = seed * 1103515245U + 12345U;
+        zassert_equal(add_slot(SCHEDULE_DAILY, (seed >> 8) % SCHEDULE_SECS_DAY, 0, i + 1), i, NULL);
+    }
+    for (int i = 0; i < SCHEDULE_MAX_SLOTS; i += 3) {
+        zassert_ok(schedule_remove(i));
+    }
+
+    sleep_days(1);
+
+    for (int i = 0; i < SCHEDULE_MAX_SLOTS; i++) {
+        expected += (i % 3 != 0) ? 1 : 0;
+        zassert_equal(count_slot(i), (i % 3 != 0) ? 1 : 0, "slot %d", i);
+    }
+    zassert_equal(record_count, expected, NULL);
+
+    for (size_t i = 0; i < record_count; i++) {
+        zassert_true(records[i].due >= last_due, "events out of order at %zu", i);
+        zassert_equal(records[i].grams, records[i].slot + 1, NULL);
+        last_due = records[i].due;
+    }
+}
+
+ZTEST(schedule, test_simulated_year)
+{
+    const uint32_t march_15 = START_2026 + (31 + 28 + 14) * SCHEDULE_SECS_DAY + 10 * 3600;
+    uint32_t last_due[6] = {0};
+    struct fire_record *rec;
+
+    zassert_equal(add_slot(SCHEDULE_DAILY, 8 * 3600, 0, 30), 0, NULL);
+    zassert_equal(add_slot(SCHEDULE_DAILY, 23 * 3600 + 59 * 60, 0, 20), 1, NULL);
+    zassert_equal(add_slot(SCHEDULE_WEEKLY, 12 * 3600, MON | WED | FRI, 15), 2, NULL);
+    /* Due right at the start time, it must not be lost */
+    zassert_equal(add_slot(SCHEDULE_WEEKLY, 0, THU, 5), 3, NULL);
+    zassert_equal(add_slot(SCHEDULE_ONCE, march_15, 0, 50), 4, NULL);
+    zassert_equal(add_slot(SCHEDULE_ONCE, START_2026 + 400 * SCHEDULE_SECS_DAY, 0, 50), 5, NULL);
+
+    sleep_days(DAYS_2026);
+
+    zassert_equal(count_slot(0), DAYS_2026, NULL);
+    zassert_equal(count_slot(1), DAYS_2026, NULL);
+    zassert_equal(count_slot(2), 3 * 52, "2026 has 52 Mondays, Wednesdays and Fridays");
+    zassert_equal(count_slot(3), 53, "2026 starts and ends on a Thursday");
+    zassert_equal(count_slot(4), 1, NULL);
+    zassert_equal(count_slot(5), 0, NULL);
+    zassert_equal(record_count, 2 * DAYS_2026 + 3 * 52 + 53 + 1, "no event fired twice");
+
+    for (size_t i = 0; i < record_count; i++) {
+        rec = &records[i];
+        zassert_true(rec->due > last_due[rec->slot], "slot %u fired twice for %u", rec->slot, rec->due);
+        zassert_true(rec->now >= rec->due && rec->now - rec->due <= 1, "slot %u late: %u", rec->slot, rec->now);
+        if (rec->slot < 2 && last_due[rec->slot] != 0) {
+            zassert_equal(rec->due - last_due[rec->slot], SCHEDULE_SECS_DAY, "daily slot skipped a day");
+        }
+        last_due[rec->slot] = rec->due;
+    }
+
+    zassert_equal(records[0].slot, 3, NULL);
+    zassert_equal(records[0].due, START_2026, NULL);
+    zassert_equal(cfg.schedule[4].kind, SCHEDULE_FREE, "fired one shot slots are freed");
+    zassert_equal(cfg.schedule[5].kind, SCHEDULE_ONCE, NULL);
+}
+
+ZTEST(schedule, test_clock_jump_skips_past_events)
+{
+    add_slot(SCHEDULE_DAILY, 8 * 3600, 0, 10);
+    add_slot(SCHEDULE_DAILY, 9 * 3600, 0, 10);
+
+    /* Jumping forward skips the events in between: they were never due on the new timeline */
+    schedule_set_time(START_2026 + 8 * 3600 + 30 * 60);
+    k_sleep(K_SECONDS(3600));
+
+    zassert_equal(record_count, 1, NULL);
+    zassert_equal(records[0].slot, 1, NULL);
+}
+
+ZTEST(schedule, test_default_consumer_posts_feed)
+{
+    schedule_init(NULL);
+    add_slot(SCHEDULE_ONCE, START_2026 + 10, 0, 42);
+
+    k_sleep(K_SECONDS(11));
+
+    zassert_equal(motor_cmd_post_fake.call_count, 1, NULL);
+    zassert_equal(motor_cmd_post_fake.arg0_val, MOTOR_SRC_SCHEDULE, "scheduler must post on its own ring");
+    zassert_equal(motor_cmd_post_fake.arg1_val, MOTOR_CMD_FEED, NULL);
+    zassert_equal(motor_cmd_post_fake.arg2_val, 42, NULL);
+}
+
+ZTEST(schedule, test_nothing_armed_before_clock)
+{
+    uint32_t due;
+    uint16_t slot;
+
+    schedule_reset();
+    zassert_equal(add_slot(SCHEDULE_DAILY, 8 * 3600, 0, 10), 0, "slots are accepted before the clock is set");
+    zassert_equal(schedule_next(&due, &slot), -ENOENT, "uptime is not a wall clock");
+
+    k_sleep(K_SECONDS(SCHEDULE_SECS_DAY));
+    zassert_equal(record_count, 0, NULL);
+
+    schedule_set_time(START_2026);
+    zassert_ok(schedule_next(&due, &slot));
+    zassert_equal(slot, 0, NULL);
+    zassert_equal(due, START_2026 + 8 * 3600, NULL);
+}
+
+ZTEST(schedule, test_changes_request_commit)
+{
+    zassert_equal(add_slot(SCHEDULE_DAILY, 8 * 3600, 0, 10), 0, NULL);
+    zassert_equal(config_commit_request_fake.call_count, 1, "added slot must be stored");
+
+    zassert_equal(add_slot(SCHEDULE_ONCE, START_2026 + 10, 0, 10), 1, NULL);
+    zassert_equal(config_commit_request_fake.call_count, 2, NULL);
+
+    zassert_ok(schedule_remove(0));
+    zassert_equal(config_commit_request_fake.call_count, 3, "removed slot must be stored");
+
+    k_sleep(K_SECONDS(11));
+    zassert_equal(record_count, 1, NULL);
+    zassert_equal(cfg.schedule[1].kind, SCHEDULE_FREE, NULL);
+    zassert_equal(config_commit_request_fake.call_count, 4, "freed one shot slot must be stored");
+
+    zassert_equal(add_slot(SCHEDULE_DAILY, SCHEDULE_SECS_DAY, 0, 10), -EINVAL, NULL);
+    zassert_equal(config_commit_request_fake.call_count, 4, "rejected slot changes nothing");
+}
+
+ZTEST_SUITE(schedule, NULL, NULL, schedule_before, NULL, NULL);
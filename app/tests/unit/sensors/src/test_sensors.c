@@ -0,0 +1,198 @@
+#include <zephyr/ztest.h>
+#include <zephyr/fff.h>
+#include <zephyr/drivers/adc.h>
+#include <zephyr/drivers/adc/adc_emul.h>
+#include "sensors.h"
+#include "filter.h"
+#include "check_health.h"
+#include "watchdog.h"
+#include "bench_clock.h"
+
+DEFINE_FFF_GLOBALS;
+
+FAKE_VOID_FUNC(thread_report_alive, health_handle_t);
+FAKE_VALUE_FUNC(health_handle_t, health_register, const char *, uint32_t);
+FAKE_VALUE_FUNC(int, health_stack_watch, health_handle_t, const struct k_thread *);
+FAKE_VOID_FUNC(health_sensor_report, enum health_sensor, bool);
+FAKE_VALUE_FUNC(int, watchdog_add_channel, const char *, uint32_t);
+FAKE_VOID_FUNC(watchdog_feed, int);
+
+#define ADC_NODE         DT_IO_CHANNELS_CTLR_BY_NAME(DT_PATH(zephyr_user), battery)
+#define BATTERY_CHANNEL  DT_IO_CHANNELS_INPUT_BY_NAME(DT_PATH(zephyr_user), battery)
+#define TEMP_CHANNEL     DT_IO_CHANNELS_INPUT_BY_NAME(DT_PATH(zephyr_user), temperature)
+#define NOMINAL_BATT_MV  3700
+#define NOMINAL_TEMP_DC  250
+#define READ_TOLERANCE   4  /* one LSB of the 12 bit emulator is 0.8 mV, doubled by the divider */
+#define MAX_SETTLE       32 /* bursts for a step to go through the median and the IIR */
+#define THREAD_PERIODS   3
+#define BENCH_BURSTS     20000
+#define BENCH_MIN_RATE   (1000U * SENSORS_BURST * SENSOR_COUNT * MSEC_PER_SEC / SENSORS_PERIOD_MS)
+
+static const struct device *const adc = DEVICE_DT_GET(ADC_NODE);
+
+static void set_battery_mv(uint32_t mv)
+{
+    zassert_ok(adc_emul_const_value_set(adc, BATTERY_CHANNEL, mv / SENSORS_BATTERY_DIVIDER));
+}
+
+static void set_temperature_dc(int32_t dc)
+{
+    zassert_ok(adc_emul_const_value_set(adc, TEMP_CHANNEL, SENSORS_TEMP_OFFSET_MV + dc));
+}
+
+/**
+ * @brief: Runs bursts until a sensor changes state
+ * @return: bursts it took, -1 if it did not change
+ */
+static int updates_until(enum health_sensor sensor, bool ok)
+{
+    for (int i = 1; i <= MAX_SETTLE; i++) {
+        zassert_ok(sensors_update());
+        if (health_sensor_report_fake.call_count > 0 && health_sensor_report_fake.arg0_val == sensor &&
+            health_sensor_report_fake.arg1_val == ok) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void *sensors_tests_setup(void)
+{
+    zassert_true(device_is_ready(adc), "ADC emulator not ready");
+    zassert_ok(sensors_init());
+    return NULL;
+}
+
+static void sensors_tests_before(void *fixture)
+{
+    ARG_UNUSED(fixture);
+
+    sensors_reset();
+    set_battery_mv(NOMINAL_BATT_MV);
+    set_temperature_dc(NOMINAL_TEMP_DC);
+    RESET_FAKE(health_sensor_report);
+    RESET_FAKE(thread_report_alive);
+    FFF_RESET_HISTORY();
+}
+
+static void sensors_tests_after(void *fixture)
+{
+    ARG_UNUSED(fixture);
+
+    stop_sensors_thread();
+}
+
+ZTEST(sensors, test_reads_battery_and_temperature)
+{
+    struct sensors_reading reading;
+
+    sensors_get(&reading);
+    zassert_false(reading.valid, NULL);
+
+    zassert_ok(sensors_update());
+    sensors_get(&reading);
+
+    zassert_true(reading.valid, NULL);
+    zassert_within(reading.battery_mv, NOMINAL_BATT_MV, READ_TOLERANCE, "got %d mV", reading.battery_mv);
+    zassert_within(reading.temperature_dc, NOMINAL_TEMP_DC, READ_TOLERANCE, "got %d", reading.temperature_dc);
+    zassert_true(reading.battery_ok && reading.temperature_ok, NULL);
+
+    /* Both sensors report their state once, then only on changes */
+    zassert_equal(health_sensor_report_fake.call_count, SENSOR_COUNT, NULL);
+    zassert_ok(sensors_update());
+    zassert_equal(health_sensor_report_fake.call_count, SENSOR_COUNT, NULL);
+}
+
+ZTEST(sensors, test_low_battery_with_hysteresis)
+{
+    struct sensors_reading reading;
+    int bursts;
+
+    zassert_ok(sensors_update());
+
+    set_battery_mv(SENSORS_BATTERY_LOW_MV - 100);
+    bursts = updates_until(HEALTH_SENSOR_BATTERY, false);
+    zassert_true(bursts > FILTER_MEDIAN_LEN / 2, "a step must be filtered, tripped after %d bursts", bursts);
+
+    /* Back inside the dead band: still low */
+    set_battery_mv((SENSORS_BATTERY_LOW_MV + SENSORS_BATTERY_OK_MV) / 2);
+    zassert_equal(updates_until(HEALTH_SENSOR_BATTERY, true), -1, "released inside the dead band");
+    sensors_get(&reading);
+    zassert_false(reading.battery_ok, NULL);
+
+    set_battery_mv(SENSORS_BATTERY_OK_MV + 100);
+    zassert_true(updates_until(HEALTH_SENSOR_BATTERY, true) > 0, "never released");
+    sensors_get(&reading);
+    zassert_true(reading.battery_ok, NULL);
+}
+
+ZTEST(sensors, test_high_temperature)
+{
+    zassert_ok(sensors_update());
+
+    set_temperature_dc(SENSORS_TEMP_HIGH_DC + 50);
+    zassert_true(updates_until(HEALTH_SENSOR_TEMPERATURE, false) > 0, "high temperature not reported");
+
+    set_temperature_dc(SENSORS_TEMP_OK_DC - 50);
+    zassert_true(updates_until(HEALTH_SENSOR_TEMPERATURE, true) > 0, "temperature never released");
+}
+
+ZTEST(sensors, test_single_spike_filtered)
+{
+    struct sensors_reading reading;
+
+    for (int i = 0; i < FILTER_MEDIAN_LEN; i++) {
+        zassert_ok(sensors_update());
+    }
+
+    /* The motor pulls the battery down for one whole burst */
+    set_battery_mv(NOMINAL_BATT_MV / 2);
+    zassert_ok(sensors_update());
+    set_battery_mv(NOMINAL_BATT_MV);
+    zassert_ok(sensors_update());
+
+    sensors_get(&reading);
+    zassert_within(reading.battery_mv, NOMINAL_BATT_MV, READ_TOLERANCE, "got %d mV", reading.battery_mv);
+    zassert_equal(health_sensor_report_fake.call_count, SENSOR_COUNT, "no fault must be reported");
+}
+
+ZTEST(sensors, test_thread_samples_every_period)
+{
+    struct sensors_stats before;
+    struct sensors_stats after;
+
+    sensors_get_stats(&before);
+    start_sensors_thread();
+    k_msleep(THREAD_PERIODS * SENSORS_PERIOD_MS + SENSORS_PERIOD_MS / 2);
+    sensors_get_stats(&after);
+
+    zassert_equal(after.bursts - before.bursts, THREAD_PERIODS + 1, "got %u bursts", after.bursts - before.bursts);
+    zassert_equal(after.samples - before.samples, (THREAD_PERIODS + 1) * SENSORS_BURST * SENSOR_COUNT, NULL);
+    zassert_equal(after.errors, before.errors, NULL);
+    zassert_true(thread_report_alive_fake.call_count >= THREAD_PERIODS, NULL);
+}
+
+/* How many raw samples the filter chain takes per second of CPU, the thread needs a few dozen */
+ZTEST(sensors, test_process_throughput)
+{
+    static int16_t raw[SENSORS_BURST * SENSOR_COUNT];
+    uint64_t start;
+    uint64_t spent_us;
+    uint64_t rate;
+
+    for (int i = 0; i < ARRAY_SIZE(raw); i++) {
+        raw[i] = (int16_t)(2000 + (i * 37) % 64);
+    }
+
+    start = bench_now_us();
+    for (int i = 0; i < BENCH_BURSTS; i++) {
+        sensors_process(raw, SENSORS_BURST);
+    }
+    spent_us = MAX(bench_now_us() - start, 1);
+    rate = (uint64_t)BENCH_BURSTS * ARRAY_SIZE(raw) * USEC_PER_SEC / spent_us;
+
+    TC_PRINT("sensors_process: %llu samples/s (%llu ns per burst)\n", rate, spent_us * 1000 / BENCH_BURSTS);
+    zassert_true(rate > BENCH_MIN_RATE, "only %llu samples/s", rate);
+}
+
+ZTEST_SUITE(sensors, NULL, sensors_tests_setup, sensors_tests_before, sensors_tests_after, NULL);
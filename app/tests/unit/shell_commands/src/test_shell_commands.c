@@ -5,6 +5,14 @@
 #include <zephyr/sys/reboot.h>
 #include <string.h>
 #include "configuration.h"
+#include "motor_control.h"
+#include "schedule.h"
+#include "storage.h"
+#include "feedlog.h"
+#include "init.h"
+#include "perf.h"
+#include "histogram.h"
+#include "telemetry.h"
 
 DEFINE_FFF_GLOBALS;
 
@@ -14,7 +22,40 @@ struct config cfg;
 static struct config backup_cfg;
 
 FAKE_VALUE_FUNC(int, save_config);
+FAKE_VOID_FUNC(config_commit_request);
+FAKE_VALUE_FUNC(int, config_commit_flush);
+FAKE_VOID_FUNC(config_commit_get_status, struct config_commit_status *);
+FAKE_VALUE_FUNC(int, feedlog_query, uint32_t, uint32_t, feedlog_visit_cb_t, void *);
+FAKE_VOID_FUNC(feedlog_get_stats, struct feedlog_stats *);
+FAKE_VOID_FUNC(feedlog_flush);
 FAKE_VOID_FUNC(set_dflt_cfg);
+FAKE_VOID_FUNC(config_publish);
+FAKE_VALUE_FUNC(int, motor_cmd_post, enum motor_cmd_src, enum motor_cmd_type, int32_t);
+FAKE_VALUE_FUNC(uint32_t, motor_cmd_latency_cyc);
+FAKE_VOID_FUNC(schedule_reload);
+FAKE_VALUE_FUNC(int, schedule_add, const struct schedule_slot *);
+FAKE_VALUE_FUNC(int, schedule_remove, uint16_t);
+FAKE_VOID_FUNC(schedule_set_time, uint32_t);
+FAKE_VALUE_FUNC(uint32_t, schedule_now);
+FAKE_VALUE_FUNC(int, schedule_next, uint32_t *, uint16_t *);
+FAKE_VALUE_FUNC(const struct boot_phase_info *, boot_phase_get, enum boot_phase);
+FAKE_VALUE_FUNC(int, perf_threads_get, struct perf_thread *, size_t);
+FAKE_VALUE_FUNC(int, perf_isr_get, struct perf_isr *);
+FAKE_VOID_FUNC(perf_mem_get, struct perf_mem *);
+FAKE_VALUE_FUNC(uint64_t, perf_window_cycles);
+FAKE_VOID_FUNC(perf_reset);
+FAKE_VALUE_FUNC(int, telemetry_read, enum telem_tier, enum telem_metric, struct telem_point *, size_t);
+FAKE_VALUE_FUNC(uint32_t, telemetry_tier_span_s, enum telem_tier);
+FAKE_VALUE_FUNC(const char *, telemetry_tier_name, enum telem_tier);
+FAKE_VALUE_FUNC(const char *, telemetry_metric_name, enum telem_metric);
+
+static struct schedule_slot last_added_slot;
+
+static int custom_schedule_add(const struct schedule_slot *slot)
+{
+    last_added_slot = *slot;
+    return 3;
+}
 
 struct sys_reboot_fake_context {
     int call_count;
@@ -29,6 +70,7 @@ void sys_reboot(int type)
     sys_reboot_fake.arg0_val = type;
 
     zassert_equal(sys_reboot_fake.call_count, 1, "sys_reboot called more than once");
+    zassert_equal(config_commit_flush_fake.call_count, 1, "pending changes must be flushed before rebooting");
 
     ztest_test_pass();
 
@@ -45,6 +87,11 @@ int custom_save_config(void)
     return 0;
 }
 
+static void custom_commit_request(void)
+{
+    last_saved_value = cfg.random_value;
+}
+
 static void *console_shell_setup(void)
 {
     shell_backend = shell_backend_dummy_get_ptr();
@@ -59,7 +106,33 @@ static void console_shell_before(void *fixture)
     memcpy(&backup_cfg, &cfg, sizeof(struct config));
 
     RESET_FAKE(save_config);
+    RESET_FAKE(config_commit_request);
+    RESET_FAKE(config_commit_flush);
+    RESET_FAKE(config_commit_get_status);
+    RESET_FAKE(feedlog_query);
+    RESET_FAKE(feedlog_get_stats);
+    RESET_FAKE(feedlog_flush);
     RESET_FAKE(set_dflt_cfg);
+    RESET_FAKE(config_publish);
+    RESET_FAKE(motor_cmd_post);
+    RESET_FAKE(motor_cmd_latency_cyc);
+    RESET_FAKE(schedule_reload);
+    RESET_FAKE(schedule_add);
+    RESET_FAKE(schedule_remove);
+    RESET_FAKE(schedule_set_time);
+    RESET_FAKE(schedule_now);
+    RESET_FAKE(schedule_next);
+    RESET_FAKE(boot_phase_get);
+    RESET_FAKE(perf_threads_get);
+    RESET_FAKE(perf_isr_get);
+    RESET_FAKE(perf_mem_get);
+    RESET_FAKE(perf_window_cycles);
+    RESET_FAKE(perf_reset);
+    RESET_FAKE(telemetry_read);
+    RESET_FAKE(telemetry_tier_span_s);
+    RESET_FAKE(telemetry_tier_name);
+    RESET_FAKE(telemetry_metric_name);
+    hist_reset_all();
 
     sys_reboot_fake.call_count = 0;
     sys_reboot_fake.arg0_val = 0;
@@ -67,6 +140,9 @@ static void console_shell_before(void *fixture)
     FFF_RESET_HISTORY();
 
     save_config_fake.custom_fake = custom_save_config;
+    config_commit_request_fake.custom_fake = custom_commit_request;
+    schedule_add_fake.custom_fake = custom_schedule_add;
+    schedule_next_fake.return_val = -ENOENT;
     last_saved_value = 0;
 
     shell_backend_dummy_clear_output(shell_backend);
@@ -229,19 +305,37 @@ ZTEST(console_shell, test_value_cmd_does_not_save_config)
     zassert_equal(cfg.random_value, 555, "Config should be updated to 555");
 }
 
+ZTEST(console_shell, test_value_cmd_publishes)
+{
+    zassert_equal(shell_execute_cmd(shell_backend, "value 31"), 0, NULL);
+    zassert_equal(config_publish_fake.call_count, 1, "readers must see the new value");
+}
+
+ZTEST(console_shell, test_limits_cmd)
+{
+    zassert_equal(shell_execute_cmd(shell_backend, "limits 3000 15000"), 0, NULL);
+    zassert_equal(cfg.max_speed_sps, 3000, NULL);
+    zassert_equal(cfg.accel, 15000, NULL);
+    zassert_equal(config_publish_fake.call_count, 1, NULL);
+
+    zassert_not_equal(shell_execute_cmd(shell_backend, "limits 1 15000"), 0, "speed below the start speed");
+    zassert_not_equal(shell_execute_cmd(shell_backend, "limits 3000 0"), 0, NULL);
+    zassert_equal(config_publish_fake.call_count, 1, "rejected limits must not be published");
+}
+
 /* ========== COMMIT COMMAND TESTS ========== */
 
-ZTEST(console_shell, test_commit_cmd_calls_save_config)
+ZTEST(console_shell, test_commit_cmd_queues_commit)
 {
     cfg.random_value = 777;
 
     int ret = shell_execute_cmd(shell_backend, "commit");
     zassert_equal(ret, 0, "Command execution failed");
 
-    zassert_equal(save_config_fake.call_count,
+    zassert_equal(config_commit_request_fake.call_count,
                   1,
-                  "save_config should be called exactly once, was called %d times",
-                  save_config_fake.call_count);
+                  "commit should be queued exactly once, was called %d times",
+                  config_commit_request_fake.call_count);
     zassert_equal(last_saved_value, 777, "Expected saved value 777, got %d", last_saved_value);
 }
 
@@ -254,8 +348,8 @@ ZTEST(console_shell, test_commit_cmd_output)
 
     const char *output = shell_backend_dummy_get_output(shell_backend, &output_len);
     zassert_not_null(output, "No output captured");
-    zassert_true(strstr(output, "Config saved in the NVS") != NULL,
-                 "Expected 'Config saved in the NVS' in output. Got: '%s'",
+    zassert_true(strstr(output, "Config commit queued") != NULL,
+                 "Expected 'Config commit queued' in output. Got: '%s'",
                  output);
 }
 
@@ -266,7 +360,7 @@ ZTEST(console_shell, test_commit_cmd_with_args_ignored)
     int ret = shell_execute_cmd(shell_backend, "commit extra args");
     zassert_equal(ret, 0, "Command execution failed");
 
-    zassert_equal(save_config_fake.call_count, 1, "save_config should be called once");
+    zassert_equal(config_commit_request_fake.call_count, 1, "commit should be queued once");
     zassert_equal(last_saved_value, 888, "Expected saved value 888, got %d", last_saved_value);
 }
 
@@ -275,7 +369,7 @@ ZTEST(console_shell, test_commit_multiple_times)
     cfg.random_value = 100;
     int ret = shell_execute_cmd(shell_backend, "commit");
     zassert_equal(ret, 0, "First commit failed");
-    zassert_equal(save_config_fake.call_count, 1, "Expected 1 save call");
+    zassert_equal(config_commit_request_fake.call_count, 1, "Expected 1 commit request");
     zassert_equal(last_saved_value, 100, "Expected saved value 100");
 
     shell_backend_dummy_clear_output(shell_backend);
@@ -283,10 +377,40 @@ ZTEST(console_shell, test_commit_multiple_times)
     cfg.random_value = 200;
     ret = shell_execute_cmd(shell_backend, "commit");
     zassert_equal(ret, 0, "Second commit failed");
-    zassert_equal(save_config_fake.call_count, 2, "Expected 2 save calls");
+    zassert_equal(config_commit_request_fake.call_count, 2, "Expected 2 commit requests");
     zassert_equal(last_saved_value, 200, "Expected saved value 200");
 }
 
+ZTEST(console_shell, test_commit_now_flushes)
+{
+    config_commit_flush_fake.return_val = -EIO;
+
+    int ret = shell_execute_cmd(shell_backend, "commit now");
+
+    zassert_equal(ret, -EIO, "flush error should be reported");
+    zassert_equal(config_commit_flush_fake.call_count, 1, NULL);
+    zassert_equal(config_commit_request_fake.call_count, 0, NULL);
+}
+
+static void custom_commit_status(struct config_commit_status *st)
+{
+    *st = (struct config_commit_status){.pending = true, .requests = 12, .commits = 3, .last_bytes = 129};
+}
+
+ZTEST(console_shell, test_commit_status)
+{
+    size_t output_len;
+
+    config_commit_get_status_fake.custom_fake = custom_commit_status;
+
+    zassert_equal(shell_execute_cmd(shell_backend, "commit status"), 0, NULL);
+
+    const char *output = shell_backend_dummy_get_output(shell_backend, &output_len);
+    zassert_not_null(strstr(output, "pending"), "Got: '%s'", output);
+    zassert_not_null(strstr(output, "129"), "Got: '%s'", output);
+    zassert_equal(config_commit_request_fake.call_count, 0, NULL);
+}
+
 ZTEST(console_shell, test_value_then_commit_workflow)
 {
     cfg.random_value = 50;
@@ -294,13 +418,13 @@ ZTEST(console_shell, test_value_then_commit_workflow)
     int ret = shell_execute_cmd(shell_backend, "value 150");
     zassert_equal(ret, 0, "value command failed");
     zassert_equal(cfg.random_value, 150, "Config should be 150");
-    zassert_equal(save_config_fake.call_count, 0, "save_config should not be called by value");
+    zassert_equal(config_commit_request_fake.call_count, 0, "value should not queue a commit");
 
     shell_backend_dummy_clear_output(shell_backend);
 
     ret = shell_execute_cmd(shell_backend, "commit");
     zassert_equal(ret, 0, "commit command failed");
-    zassert_equal(save_config_fake.call_count, 1, "save_config should be called by commit");
+    zassert_equal(config_commit_request_fake.call_count, 1, "commit should be queued by the commit command");
     zassert_equal(last_saved_value, 150, "Expected saved value 150");
 }
 
@@ -352,13 +476,13 @@ ZTEST(console_shell, test_default_multiple_times)
     zassert_equal(set_dflt_cfg_fake.call_count, 2, "Expected 2 calls");
 }
 
-ZTEST(console_shell, test_default_does_not_save_config)
+ZTEST(console_shell, test_default_does_not_commit)
 {
     int ret = shell_execute_cmd(shell_backend, "default");
     zassert_equal(ret, 0, "Command execution failed");
 
     zassert_equal(set_dflt_cfg_fake.call_count, 1, "set_dflt_cfg should be called");
-    zassert_equal(save_config_fake.call_count, 0, "save_config should NOT be called automatically by default command");
+    zassert_equal(config_commit_request_fake.call_count, 0, "default command should NOT queue a commit");
 }
 
 ZTEST(console_shell, test_default_then_commit_workflow)
@@ -368,13 +492,13 @@ ZTEST(console_shell, test_default_then_commit_workflow)
     int ret = shell_execute_cmd(shell_backend, "default");
     zassert_equal(ret, 0, "default command failed");
     zassert_equal(set_dflt_cfg_fake.call_count, 1, "set_dflt_cfg should be called");
-    zassert_equal(save_config_fake.call_count, 0, "save_config should not be called by default");
+    zassert_equal(config_commit_request_fake.call_count, 0, "default command should not queue a commit");
 
     shell_backend_dummy_clear_output(shell_backend);
 
     ret = shell_execute_cmd(shell_backend, "commit");
     zassert_equal(ret, 0, "commit command failed");
-    zassert_equal(save_config_fake.call_count, 1, "save_config should be called by commit");
+    zassert_equal(config_commit_request_fake.call_count, 1, "commit should be queued by the commit command");
 }
 
 ZTEST(console_shell, test_value_default_commit_workflow)
@@ -395,7 +519,316 @@ ZTEST(console_shell, test_value_default_commit_workflow)
 
     ret = shell_execute_cmd(shell_backend, "commit");
     zassert_equal(ret, 0, "commit command failed");
-    zassert_equal(save_config_fake.call_count, 1, "save_config should be called");
+    zassert_equal(config_commit_request_fake.call_count, 1, "commit should be queued");
+}
+
+/* ========== MOTOR COMMAND TESTS ========== */
+
+ZTEST(console_shell, test_feed_cmd_posts_grams)
+{
+    int ret = shell_execute_cmd(shell_backend, "feed 12");
+    zassert_equal(ret, 0, "Command execution failed");
+
+    zassert_equal(motor_cmd_post_fake.call_count, 1, "motor_cmd_post should be called once");
+    zassert_equal(motor_cmd_post_fake.arg0_val, MOTOR_SRC_SHELL, "Shell must post on its own ring");
+    zassert_equal(motor_cmd_post_fake.arg1_val, MOTOR_CMD_FEED, NULL);
+    zassert_equal(motor_cmd_post_fake.arg2_val, 12, NULL);
+}
+
+ZTEST(console_shell, test_feed_cmd_rejects_invalid_amount)
+{
+    int ret = shell_execute_cmd(shell_backend, "feed 0");
+    zassert_equal(ret, -EINVAL, "Expected EINVAL, got %d", ret);
+
+    zassert_equal(motor_cmd_post_fake.call_count, 0, "Nothing should be posted");
+}
+
+ZTEST(console_shell, test_motor_cmds_reject_out_of_range)
+{
+    zassert_equal(shell_execute_cmd(shell_backend, "feed 65536"), -EINVAL, "grams above the feed log range");
+    zassert_equal(shell_execute_cmd(shell_backend, "feed 99999999999"), -EINVAL, "grams would overflow the steps");
+    zassert_equal(shell_execute_cmd(shell_backend, "feed 5g"), -EINVAL, "trailing garbage");
+    zassert_equal(shell_execute_cmd(shell_backend, "jog -2147483648"), -EINVAL, "no positive counterpart");
+    zassert_equal(shell_execute_cmd(shell_backend, "jog 3000000000"), -EINVAL, "does not fit an int32");
+    zassert_equal(shell_execute_cmd(shell_backend, "speed 100000"), -EINVAL, "above the max speed");
+
+    zassert_equal(motor_cmd_post_fake.call_count, 0, "Nothing should be posted");
+}
+
+ZTEST(console_shell, test_feed_cmd_max_amount)
+{
+    zassert_equal(shell_execute_cmd(shell_backend, "feed 65535"), 0, NULL);
+    zassert_equal(motor_cmd_post_fake.arg2_val, MOTOR_MAX_FEED_GRAMS, NULL);
+}
+
+ZTEST(console_shell, test_feed_cmd_queue_full)
+{
+    size_t output_len;
+
+    motor_cmd_post_fake.return_val = -ENOBUFS;
+
+    int ret = shell_execute_cmd(shell_backend, "feed 5");
+    zassert_equal(ret, -ENOBUFS, "Expected ENOBUFS, got %d", ret);
+
+    const char *output = shell_backend_dummy_get_output(shell_backend, &output_len);
+    zassert_true(strstr(output, "Motor queue full") != NULL, "Expected queue full message. Got: '%s'", output);
+}
+
+ZTEST(console_shell, test_jog_stop_speed_cmds)
+{
+    zassert_equal(shell_execute_cmd(shell_backend, "jog -200"), 0, NULL);
+    zassert_equal(motor_cmd_post_fake.arg1_history[0], MOTOR_CMD_JOG, NULL);
+    zassert_equal(motor_cmd_post_fake.arg2_history[0], -200, NULL);
+
+    zassert_equal(shell_execute_cmd(shell_backend, "stop"), 0, NULL);
+    zassert_equal(motor_cmd_post_fake.arg1_history[1], MOTOR_CMD_STOP, NULL);
+
+    zassert_equal(shell_execute_cmd(shell_backend, "speed 3000"), 0, NULL);
+    zassert_equal(motor_cmd_post_fake.arg1_history[2], MOTOR_CMD_SET_SPEED, NULL);
+    zassert_equal(motor_cmd_post_fake.arg2_history[2], 3000, NULL);
+}
+
+/* ========== SCHEDULE COMMAND TESTS ========== */
+
+ZTEST(console_shell, test_default_cmd_reloads_schedule)
+{
+    int ret = shell_execute_cmd(shell_backend, "default");
+    zassert_equal(ret, 0, "Command execution failed");
+
+    zassert_equal(schedule_reload_fake.call_count, 1, "The schedule must follow the restored config");
+}
+
+ZTEST(console_shell, test_schedule_add_daily)
+{
+    int ret = shell_execute_cmd(shell_backend, "schedule add daily 08:30 25");
+    zassert_equal(ret, 0, "Command execution failed");
+
+    zassert_equal(schedule_add_fake.call_count, 1, NULL);
+    zassert_equal(last_added_slot.kind, SCHEDULE_DAILY, NULL);
+    zassert_equal(last_added_slot.time, 8 * 3600 + 30 * 60, NULL);
+    zassert_equal(last_added_slot.grams, 25, NULL);
+}
+
+ZTEST(console_shell, test_schedule_add_weekly)
+{
+    int ret = shell_execute_cmd(shell_backend, "schedule add weekly 19:05 10 0x15");
+    zassert_equal(ret, 0, "Command execution failed");
+
+    zassert_equal(last_added_slot.kind, SCHEDULE_WEEKLY, NULL);
+    zassert_equal(last_added_slot.time, 19 * 3600 + 5 * 60, NULL);
+    zassert_equal(last_added_slot.days, 0x15, NULL);
+}
+
+ZTEST(console_shell, test_schedule_add_bad_time)
+{
+    zassert_equal(shell_execute_cmd(shell_backend, "schedule add daily 25:00 10"), -EINVAL, NULL);
+    zassert_equal(shell_execute_cmd(shell_backend, "schedule add daily 0800 10"), -EINVAL, NULL);
+    zassert_equal(shell_execute_cmd(shell_backend, "schedule add hourly 08:00 10"), -EINVAL, NULL);
+
+    zassert_equal(schedule_add_fake.call_count, 0, "Nothing should reach the scheduler");
+}
+
+ZTEST(console_shell, test_schedule_add_bad_grams)
+{
+    zassert_equal(shell_execute_cmd(shell_backend, "schedule add daily 08:00 0"), -EINVAL, NULL);
+    zassert_equal(shell_execute_cmd(shell_backend, "schedule add daily 08:00 -5"), -EINVAL, NULL);
+    zassert_equal(shell_execute_cmd(shell_backend, "schedule add daily 08:00 65536"), -EINVAL, "would wrap to 0 g");
+    zassert_equal(shell_execute_cmd(shell_backend, "schedule add daily 08:00 10g"), -EINVAL, NULL);
+
+    zassert_equal(schedule_add_fake.call_count, 0, "Nothing should reach the scheduler");
+}
+
+ZTEST(console_shell, test_schedule_del_and_time)
+{
+    zassert_equal(shell_execute_cmd(shell_backend, "schedule del 7"), 0, NULL);
+    zassert_equal(schedule_remove_fake.arg0_val, 7, NULL);
+
+    zassert_equal(shell_execute_cmd(shell_backend, "time 1767225600"), 0, NULL);
+    zassert_equal(schedule_set_time_fake.arg0_val, 1767225600, NULL);
+}
+
+/* ========== FEED LOG TESTS ========== */
+
+static int custom_feedlog_query(uint32_t from, uint32_t to, feedlog_visit_cb_t cb, void *user_data)
+{
+    const struct feedlog_entry entry = {.time = from + 1, .grams = 12, .steps = 600, .duration_ms = 340};
+
+    cb(&entry, user_data);
+    return 1;
+}
+
+ZTEST(console_shell, test_feedlog_cmd_range)
+{
+    size_t output_len;
+
+    feedlog_query_fake.custom_fake = custom_feedlog_query;
+
+    zassert_equal(shell_execute_cmd(shell_backend, "feedlog 1000 2000"), 0, NULL);
+    zassert_equal(feedlog_query_fake.arg0_val, 1000, NULL);
+    zassert_equal(feedlog_query_fake.arg1_val, 2000, NULL);
+
+    const char *output = shell_backend_dummy_get_output(shell_backend, &output_len);
+    zassert_not_null(strstr(output, "1001: 12 g, 600 steps in 340 ms"), "Got: '%s'", output);
+}
+
+ZTEST(console_shell, test_feedlog_cmd_whole_log)
+{
+    zassert_equal(shell_execute_cmd(shell_backend, "feedlog"), 0, NULL);
+    zassert_equal(feedlog_query_fake.arg0_val, 0, NULL);
+    zassert_equal(feedlog_query_fake.arg1_val, UINT32_MAX, NULL);
+
+    feedlog_query_fake.return_val = -ENODEV;
+    zassert_equal(shell_execute_cmd(shell_backend, "feedlog"), -ENODEV, NULL);
+}
+
+static const struct boot_phase_info *custom_boot_phase_get(enum boot_phase phase)
+{
+    static struct boot_phase_info done = {.name = "nvs_mount", .end_ms = 42, .result = -5, .done = true};
+    static struct boot_phase_info pending = {.name = "feedlog"};
+
+    return (phase == BOOT_PHASE_FEEDLOG) ? &pending : &done;
+}
+
+ZTEST(console_shell, test_boot_cmd)
+{
+    size_t output_len;
+
+    boot_phase_get_fake.custom_fake = custom_boot_phase_get;
+
+    zassert_equal(shell_execute_cmd(shell_backend, "boot"), 0, NULL);
+    zassert_true(boot_phase_get_fake.call_count > BOOT_PHASE_COUNT, "every phase must be printed");
+
+    const char *output = shell_backend_dummy_get_output(shell_backend, &output_len);
+    zassert_not_null(strstr(output, "nvs_mount"), "Got: '%s'", output);
+    zassert_not_null(strstr(output, "42"), "Got: '%s'", output);
+    zassert_not_null(strstr(output, "-5"), "Got: '%s'", output);
+    zassert_not_null(strstr(output, "pending"), "Got: '%s'", output);
+}
+
+static int custom_perf_threads_get(struct perf_thread *out, size_t max)
+{
+    zassert_true(max >= 2, NULL);
+    out[0] = (struct perf_thread){
+        .name = "motor", .load_pm = 125, .switches = 77, .stack_size = 2048, .stack_unused = 1648};
+    out[1] = (struct perf_thread){.name = NULL, .load_pm = 875};
+    return 2;
+}
+
+ZTEST(console_shell, test_perf_threads_cmd)
+{
+    size_t output_len;
+
+    perf_threads_get_fake.custom_fake = custom_perf_threads_get;
+
+    zassert_equal(shell_execute_cmd(shell_backend, "perf threads"), 0, NULL);
+
+    const char *output = shell_backend_dummy_get_output(shell_backend, &output_len);
+    zassert_not_null(strstr(output, "motor"), "Got: '%s'", output);
+    zassert_not_null(strstr(output, "12.5%"), "Got: '%s'", output);
+    zassert_not_null(strstr(output, "77"), "Got: '%s'", output);
+    zassert_not_null(strstr(output, "400/2048"), "Got: '%s'", output);
+    zassert_not_null(strstr(output, "87.5%"), "Got: '%s'", output);
+}
+
+ZTEST(console_shell, test_perf_unsupported)
+{
+    perf_threads_get_fake.return_val = -ENOTSUP;
+    perf_isr_get_fake.return_val = -ENOTSUP;
+
+    zassert_equal(shell_execute_cmd(shell_backend, "perf threads"), -ENOTSUP, NULL);
+    zassert_equal(shell_execute_cmd(shell_backend, "perf isr"), -ENOTSUP, NULL);
+}
+
+ZTEST(console_shell, test_perf_mem_and_reset_cmds)
+{
+    zassert_equal(shell_execute_cmd(shell_backend, "perf mem"), 0, NULL);
+    zassert_equal(perf_mem_get_fake.call_count, 1, NULL);
+
+    zassert_equal(shell_execute_cmd(shell_backend, "perf reset"), 0, NULL);
+    zassert_equal(perf_reset_fake.call_count, 1, NULL);
+}
+
+ZTEST(console_shell, test_perf_hist_cmd)
+{
+    uint32_t cyc = k_us_to_cyc_ceil32(1000);
+    size_t output_len;
+
+    for (int i = 0; i < 99; i++) {
+        hist_record(HIST_PROTO_FRAME, cyc);
+    }
+    hist_record(HIST_PROTO_FRAME, 10 * cyc);
+
+    zassert_equal(shell_execute_cmd(shell_backend, "perf hist"), 0, NULL);
+    const char *output = shell_backend_dummy_get_output(shell_backend, &output_len);
+    for (int i = 0; i < HIST_COUNT; i++) {
+        zassert_not_null(strstr(output, hist_name(i)), "Got: '%s'", output);
+    }
+    zassert_not_null(strstr(output, "100"), "Got: '%s'", output);
+
+    zassert_equal(shell_execute_cmd(shell_backend, "perf hist proto_frame"), 0, NULL);
+    output = shell_backend_dummy_get_output(shell_backend, &output_len);
+    zassert_not_null(strstr(output, "99"), "Got: '%s'", output);
+
+    zassert_equal(shell_execute_cmd(shell_backend, "perf hist nope"), -EINVAL, NULL);
+}
+
+ZTEST(console_shell, test_commands_are_timed)
+{
+    struct histogram_summary sum;
+
+    zassert_equal(shell_execute_cmd(shell_backend, "status"), 0, NULL);
+    zassert_equal(shell_execute_cmd(shell_backend, "schedule list"), 0, NULL);
+
+    histogram_summarize(hist_get(HIST_SHELL_CMD), &sum);
+    zassert_equal(sum.count, 2, "every command and subcommand must be timed");
+
+    zassert_equal(shell_execute_cmd(shell_backend, "perf reset"), 0, NULL);
+    histogram_summarize(hist_get(HIST_SHELL_CMD), &sum);
+    zassert_equal(sum.count, 1, "the reset clears the histograms, then its own run is recorded");
+}
+
+static const char *custom_tier_name(enum telem_tier tier)
+{
+    static const char *const names[] = {"sec", "min", "hour"};
+
+    return (tier < ARRAY_SIZE(names)) ? names[tier] : NULL;
+}
+
+static const char *custom_metric_name(enum telem_metric metric)
+{
+    static const char *const names[] = {"beat_age", "stack_free", "battery", "temperature"};
+
+    return (metric < ARRAY_SIZE(names)) ? names[metric] : NULL;
+}
+
+static int custom_telemetry_read(enum telem_tier tier, enum telem_metric metric, struct telem_point *out, size_t max)
+{
+    zassert_true(max >= 2, NULL);
+    out[0] = (struct telem_point){.min = 3650, .max = 3720, .mean = 3691};
+    out[1] = (struct telem_point){.min = INT16_MAX, .max = INT16_MIN};
+    return 2;
+}
+
+ZTEST(console_shell, test_telemetry_cmd)
+{
+    size_t output_len;
+
+    telemetry_tier_name_fake.custom_fake = custom_tier_name;
+    telemetry_metric_name_fake.custom_fake = custom_metric_name;
+    telemetry_read_fake.custom_fake = custom_telemetry_read;
+    telemetry_tier_span_s_fake.return_val = 60;
+
+    zassert_equal(shell_execute_cmd(shell_backend, "telemetry min battery"), 0, NULL);
+    zassert_equal(telemetry_read_fake.arg0_val, TELEM_TIER_MIN, NULL);
+    zassert_equal(telemetry_read_fake.arg1_val, TELEM_BATTERY, NULL);
+
+    const char *output = shell_backend_dummy_get_output(shell_backend, &output_len);
+    zassert_not_null(strstr(output, "120"), "oldest point is two minutes old. Got: '%s'", output);
+    zassert_not_null(strstr(output, "3691"), "Got: '%s'", output);
+    zassert_not_null(strstr(output, "-"), "empty points must be marked. Got: '%s'", output);
+
+    zassert_equal(shell_execute_cmd(shell_backend, "telemetry week battery"), -EINVAL, NULL);
+    zassert_equal(shell_execute_cmd(shell_backend, "telemetry min current"), -EINVAL, NULL);
 }
 
 /* ========== REBOOT TEST ========== */
@@ -0,0 +1,225 @@
+#include <zephyr/ztest.h>
+#include <zephyr/fff.h>
+#include "storage.h"
+#include "configuration.h"
+#include "motor_control.h"
+#include "communication.h"
+
+DEFINE_FFF_GLOBALS;
+
+FAKE_VALUE_FUNC(int, save_config);
+FAKE_VALUE_FUNC(bool, config_is_dirty);
+FAKE_VALUE_FUNC(size_t, config_last_commit_bytes);
+FAKE_VALUE_FUNC(size_t, config_nvs_free);
+FAKE_VALUE_FUNC(int, config_nvs_gc_if_low);
+FAKE_VALUE_FUNC(bool, motor_is_busy);
+FAKE_VALUE_FUNC(bool, comm_is_idle);
+
+#define BURST_LEN     100
+#define TEST_QUIET_MS 50
+
+static void *storage_suite_setup(void)
+{
+    storage_init();
+    return NULL;
+}
+
+static void storage_before(void *fixture)
+{
+    ARG_UNUSED(fixture);
+
+    storage_reset();
+
+    RESET_FAKE(save_config);
+    RESET_FAKE(config_is_dirty);
+    RESET_FAKE(config_last_commit_bytes);
+    RESET_FAKE(config_nvs_free);
+    RESET_FAKE(config_nvs_gc_if_low);
+    RESET_FAKE(motor_is_busy);
+    RESET_FAKE(comm_is_idle);
+    FFF_RESET_HISTORY();
+
+    config_is_dirty_fake.return_val = true;
+    config_last_commit_bytes_fake.return_val = 5;
+    comm_is_idle_fake.return_val = true;
+}
+
+ZTEST_SUITE(storage, NULL, storage_suite_setup, storage_before, NULL, NULL);
+
+ZTEST(storage, test_burst_is_one_commit)
+{
+    struct config_commit_status st;
+
+    config_commit_set_quiet(TEST_QUIET_MS);
+
+    for (int i = 0; i < BURST_LEN; i++) {
+        config_commit_request();
+    }
+
+    zassert_equal(save_config_fake.call_count, 0, "callers must not wait on the flash");
+    config_commit_get_status(&st);
+    zassert_true(st.pending, NULL);
+    zassert_equal(st.requests, BURST_LEN, NULL);
+
+    k_sleep(K_MSEC(2 * TEST_QUIET_MS));
+
+    zassert_equal(save_config_fake.call_count, 1, "the burst must be coalesced in one write");
+    config_commit_get_status(&st);
+    zassert_false(st.pending, NULL);
+    zassert_equal(st.commits, 1, NULL);
+    zassert_equal(st.last_result, 0, NULL);
+    zassert_equal(st.last_bytes, 5, NULL);
+}
+
+ZTEST(storage, test_quiet_period_restarts)
+{
+    config_commit_set_quiet(TEST_QUIET_MS);
+
+    config_commit_request();
+    k_sleep(K_MSEC(TEST_QUIET_MS / 2));
+    config_commit_request();
+    k_sleep(K_MSEC(TEST_QUIET_MS / 2 + 5));
+
+    zassert_equal(save_config_fake.call_count, 0, "the second request must push the commit back");
+
+    k_sleep(K_MSEC(TEST_QUIET_MS));
+    zassert_equal(save_config_fake.call_count, 1, NULL);
+}
+
+ZTEST(storage, test_steady_stream_is_bounded)
+{
+    int64_t start = k_uptime_get();
+
+    config_commit_set_quiet(TEST_QUIET_MS * 4);
+
+    while (save_config_fake.call_count == 0) {
+        zassert_true(k_uptime_get() - start <= STORAGE_COMMIT_MAX_DELAY_MS + TEST_QUIET_MS, "commit starved");
+        config_commit_request();
+        k_sleep(K_MSEC(TEST_QUIET_MS));
+    }
+
+    zassert_true(k_uptime_get() - start >= STORAGE_COMMIT_MAX_DELAY_MS, "committed before the max delay");
+}
+
+ZTEST(storage, test_flush_writes_now)
+{
+    struct config_commit_status st;
+
+    config_commit_set_quiet(STORAGE_COMMIT_MAX_DELAY_MS);
+    config_commit_request();
+
+    zassert_equal(config_commit_flush(), 0, NULL);
+    zassert_equal(save_config_fake.call_count, 1, "flush must not wait for the quiet period");
+
+    config_commit_get_status(&st);
+    zassert_false(st.pending, NULL);
+}
+
+ZTEST(storage, test_flush_clean_config)
+{
+    struct config_commit_status st;
+
+    config_is_dirty_fake.return_val = false;
+
+    zassert_equal(config_commit_flush(), 0, NULL);
+    zassert_equal(save_config_fake.call_count, 0, "nothing changed, nothing to write");
+
+    config_commit_get_status(&st);
+    zassert_equal(st.commits, 0, "nothing was written");
+    zassert_equal(st.last_commit_ms, -1, NULL);
+}
+
+ZTEST(storage, test_commit_without_changes_is_not_counted)
+{
+    struct config_commit_status st;
+
+    /* Dirty, but every field matches the stored one */
+    config_last_commit_bytes_fake.return_val = 0;
+
+    zassert_equal(config_commit_flush(), 0, NULL);
+    zassert_equal(save_config_fake.call_count, 1, NULL);
+
+    config_commit_get_status(&st);
+    zassert_equal(st.last_result, 0, NULL);
+    zassert_equal(st.commits, 0, NULL);
+    zassert_equal(st.last_commit_ms, -1, NULL);
+}
+
+ZTEST(storage, test_failed_commit_is_retried)
+{
+    struct config_commit_status st;
+
+    save_config_fake.return_val = -EIO;
+
+    zassert_equal(config_commit_flush(), -EIO, NULL);
+    config_commit_get_status(&st);
+    zassert_true(st.pending, "a failed commit must be retried");
+    zassert_equal(st.commits, 0, NULL);
+    zassert_equal(st.last_commit_ms, -1, NULL);
+
+    save_config_fake.return_val = 0;
+    k_sleep(K_MSEC(STORAGE_COMMIT_RETRY_MS + 10));
+
+    zassert_equal(save_config_fake.call_count, 2, NULL);
+    config_commit_get_status(&st);
+    zassert_equal(st.last_result, 0, NULL);
+    zassert_equal(st.commits, 1, NULL);
+}
+
+ZTEST(storage, test_gc_after_commit_when_idle)
+{
+    struct config_commit_status st;
+
+    config_nvs_gc_if_low_fake.return_val = 1;
+
+    zassert_equal(config_commit_flush(), 0, NULL);
+    zassert_equal(config_nvs_gc_if_low_fake.call_count, 0, "the check waits for the feeder to settle");
+
+    k_sleep(K_MSEC(STORAGE_GC_IDLE_MS + 10));
+
+    zassert_equal(config_nvs_gc_if_low_fake.call_count, 1, NULL);
+    config_commit_get_status(&st);
+    zassert_equal(st.idle_gcs, 1, NULL);
+    zassert_equal(st.commit_gcs, 0, NULL);
+}
+
+ZTEST(storage, test_gc_waits_while_busy)
+{
+    struct config_commit_status st;
+
+    config_nvs_gc_if_low_fake.return_val = 1;
+    motor_is_busy_fake.return_val = true;
+
+    zassert_equal(config_commit_flush(), 0, NULL);
+    k_sleep(K_MSEC(STORAGE_GC_IDLE_MS + STORAGE_GC_RETRY_MS + 10));
+    zassert_equal(config_nvs_gc_if_low_fake.call_count, 0, "never while dispensing");
+
+    motor_is_busy_fake.return_val = false;
+    comm_is_idle_fake.return_val = false;
+    k_sleep(K_MSEC(STORAGE_GC_RETRY_MS));
+    zassert_equal(config_nvs_gc_if_low_fake.call_count, 0, "never while the link is talking");
+
+    comm_is_idle_fake.return_val = true;
+    k_sleep(K_MSEC(STORAGE_GC_RETRY_MS));
+    zassert_equal(config_nvs_gc_if_low_fake.call_count, 1, NULL);
+    config_commit_get_status(&st);
+    zassert_equal(st.idle_gcs, 1, NULL);
+}
+
+static size_t free_after_gc(void)
+{
+    /* Read before and after the write: the sector got collected in between */
+    return (config_nvs_free_fake.call_count == 1) ? 16 : 4000;
+}
+
+ZTEST(storage, test_gc_in_commit_is_counted)
+{
+    struct config_commit_status st;
+
+    config_nvs_free_fake.custom_fake = free_after_gc;
+
+    zassert_equal(config_commit_flush(), 0, NULL);
+    config_commit_get_status(&st);
+    zassert_equal(st.commit_gcs, 1, NULL);
+    zassert_equal(st.commits, 1, NULL);
+}
@@ -0,0 +1,180 @@
+#include <zephyr/ztest.h>
+#include <zephyr/fff.h>
+#include "telemetry.h"
+#include "check_health.h"
+#include "sensors.h"
+#include "bench_clock.h"
+
+DEFINE_FFF_GLOBALS;
+
+FAKE_VALUE_FUNC(int, health_stack_headroom);
+FAKE_VALUE_FUNC(uint32_t, health_beat_age_max_ms);
+FAKE_VOID_FUNC(sensors_get, struct sensors_reading *);
+
+#define SAMPLED_PERIODS 3
+#define BENCH_SAMPLES   (24 * SEC_PER_HOUR)
+#define BENCH_MAX_NS    2000
+
+static struct telem_point points[TELEM_SEC_POINTS];
+
+/**
+ * @brief: Records the same value for every metric
+ */
+static void record_all(int32_t value)
+{
+    int32_t values[TELEM_METRIC_COUNT];
+
+    for (int m = 0; m < TELEM_METRIC_COUNT; m++) {
+        values[m] = value;
+    }
+    telemetry_record(values);
+}
+
+static void custom_sensors_get(struct sensors_reading *out)
+{
+    *out = (struct sensors_reading){.battery_mv = 3700, .temperature_dc = 215, .valid = true};
+}
+
+static void telemetry_tests_before(void *fixture)
+{
+    ARG_UNUSED(fixture);
+
+    telemetry_reset();
+    RESET_FAKE(health_stack_headroom);
+    RESET_FAKE(health_beat_age_max_ms);
+    RESET_FAKE(sensors_get);
+    FFF_RESET_HISTORY();
+}
+
+ZTEST(telemetry, test_seconds_oldest_first)
+{
+    for (int i = 1; i <= 3; i++) {
+        record_all(i * 10);
+    }
+
+    zassert_equal(telemetry_read(TELEM_TIER_SEC, TELEM_BATTERY, points, ARRAY_SIZE(points)), 3, NULL);
+    for (int i = 0; i < 3; i++) {
+        zassert_equal(points[i].mean, (i + 1) * 10, NULL);
+        zassert_equal(points[i].min, points[i].max, "one sample per second");
+    }
+    zassert_equal(telemetry_read(TELEM_TIER_MIN, TELEM_BATTERY, points, ARRAY_SIZE(points)), 0, "minute not done");
+}
+
+ZTEST(telemetry, test_ring_keeps_the_newest)
+{
+    for (int i = 0; i < TELEM_SEC_POINTS + 10; i++) {
+        record_all(i);
+    }
+
+    zassert_equal(telemetry_read(TELEM_TIER_SEC, TELEM_BEAT_AGE, points, ARRAY_SIZE(points)), TELEM_SEC_POINTS, NULL);
+    zassert_equal(points[0].mean, 10, "the oldest points are overwritten");
+    zassert_equal(points[TELEM_SEC_POINTS - 1].mean, TELEM_SEC_POINTS + 9, NULL);
+
+    /* Less room: the newest points win */
+    zassert_equal(telemetry_read(TELEM_TIER_SEC, TELEM_BEAT_AGE, points, 2), 2, NULL);
+    zassert_equal(points[1].mean, TELEM_SEC_POINTS + 9, NULL);
+}
+
+ZTEST(telemetry, test_minute_rollup)
+{
+    int32_t values[TELEM_METRIC_COUNT] = {0};
+
+    for (int i = 0; i < SEC_PER_MIN; i++) {
+        values[TELEM_BATTERY] = 3600 + i;
+        values[TELEM_TEMPERATURE] = TELEM_NO_VALUE;
+        values[TELEM_STACK_FREE] = (i % 2 == 0) ? 400 : TELEM_NO_VALUE;
+        telemetry_record(values);
+    }
+
+    zassert_equal(telemetry_read(TELEM_TIER_MIN, TELEM_BATTERY, points, ARRAY_SIZE(points)), 1, NULL);
+    zassert_equal(points[0].min, 3600, NULL);
+    zassert_equal(points[0].max, 3659, NULL);
+    zassert_equal(points[0].mean, 3630, "3629.5 rounds to nearest, got %d", points[0].mean);
+
+    zassert_equal(telemetry_read(TELEM_TIER_MIN, TELEM_TEMPERATURE, points, ARRAY_SIZE(points)), 1, NULL);
+    zassert_true(points[0].min > points[0].max, "a minute without samples must read as empty");
+
+    zassert_equal(telemetry_read(TELEM_TIER_MIN, TELEM_STACK_FREE, points, ARRAY_SIZE(points)), 1, NULL);
+    zassert_equal(points[0].mean, 400, "missing samples must not drag the mean");
+}
+
+ZTEST(telemetry, test_hour_rollup)
+{
+    for (int i = 0; i < SEC_PER_HOUR; i++) {
+        record_all((i < SEC_PER_HOUR / 2) ? -100 : 100);
+    }
+
+    zassert_equal(telemetry_read(TELEM_TIER_MIN, TELEM_TEMPERATURE, points, ARRAY_SIZE(points)), TELEM_MIN_POINTS,
+                  NULL);
+    zassert_equal(telemetry_read(TELEM_TIER_HOUR, TELEM_TEMPERATURE, points, ARRAY_SIZE(points)), 1, NULL);
+    zassert_equal(points[0].min, -100, NULL);
+    zassert_equal(points[0].max, 100, NULL);
+    zassert_equal(points[0].mean, 0, NULL);
+}
+
+ZTEST(telemetry, test_values_saturate)
+{
+    record_all(100000);
+    record_all(-100000);
+
+    zassert_equal(telemetry_read(TELEM_TIER_SEC, TELEM_BATTERY, points, ARRAY_SIZE(points)), 2, NULL);
+    zassert_equal(points[0].mean, INT16_MAX, NULL);
+    zassert_equal(points[1].mean, INT16_MIN, NULL);
+}
+
+ZTEST(telemetry, test_pack_and_names)
+{
+    const struct telem_point point = {.min = -2, .max = 0x1234, .mean = 0x0102};
+    const uint8_t expected[TELEM_POINT_WIRE] = {0xFE, 0xFF, 0x34, 0x12, 0x02, 0x01};
+    uint8_t wire[TELEM_POINT_WIRE];
+
+    telemetry_point_pack(&point, wire);
+    zassert_mem_equal(wire, expected, sizeof(wire), NULL);
+
+    zassert_equal(telemetry_read(TELEM_TIER_COUNT, TELEM_BATTERY, points, 1), -EINVAL, NULL);
+    zassert_equal(telemetry_read(TELEM_TIER_SEC, TELEM_METRIC_COUNT, points, 1), -EINVAL, NULL);
+    zassert_equal(telemetry_tier_span_s(TELEM_TIER_HOUR), SEC_PER_HOUR, NULL);
+    zassert_equal(telemetry_tier_span_s(TELEM_TIER_COUNT), 0, NULL);
+    zassert_is_null(telemetry_tier_name(TELEM_TIER_COUNT), NULL);
+    for (int m = 0; m < TELEM_METRIC_COUNT; m++) {
+        zassert_not_null(telemetry_metric_name(m), NULL);
+    }
+}
+
+ZTEST(telemetry, test_samples_every_period)
+{
+    health_beat_age_max_ms_fake.return_val = 120;
+    health_stack_headroom_fake.return_val = -ENODATA;
+    sensors_get_fake.custom_fake = custom_sensors_get;
+
+    telemetry_init();
+    k_msleep(SAMPLED_PERIODS * TELEM_PERIOD_MS + TELEM_PERIOD_MS / 2);
+
+    zassert_equal(telemetry_read(TELEM_TIER_SEC, TELEM_BEAT_AGE, points, ARRAY_SIZE(points)), SAMPLED_PERIODS, NULL);
+    zassert_equal(points[0].mean, 120, NULL);
+    telemetry_read(TELEM_TIER_SEC, TELEM_BATTERY, points, ARRAY_SIZE(points));
+    zassert_equal(points[0].mean, 3700, NULL);
+    telemetry_read(TELEM_TIER_SEC, TELEM_TEMPERATURE, points, ARRAY_SIZE(points));
+    zassert_equal(points[SAMPLED_PERIODS - 1].mean, 215, NULL);
+    telemetry_read(TELEM_TIER_SEC, TELEM_STACK_FREE, points, ARRAY_SIZE(points));
+    zassert_true(points[0].min > points[0].max, "no stack sampled yet");
+}
+
+/* A whole day of samples, the cost per sample is what the work queue pays every second */
+ZTEST(telemetry, test_record_cost)
+{
+    uint64_t start = bench_now_us();
+    uint64_t spent_ns;
+
+    for (int i = 0; i < BENCH_SAMPLES; i++) {
+        record_all(i & 0x3FF);
+    }
+    spent_ns = (bench_now_us() - start) * NSEC_PER_USEC / BENCH_SAMPLES;
+
+    TC_PRINT("telemetry_record: %llu ns per sample of every metric\n", spent_ns);
+    zassert_true(spent_ns < BENCH_MAX_NS, "recording takes %llu ns", spent_ns);
+    zassert_equal(telemetry_read(TELEM_TIER_HOUR, TELEM_BATTERY, points, ARRAY_SIZE(points)), TELEM_HOUR_POINTS,
+                  NULL);
+}
+
+ZTEST_SUITE(telemetry, NULL, NULL, telemetry_tests_before, NULL, NULL);
@@ -7,13 +7,14 @@
 
 DEFINE_FFF_GLOBALS;
 
+#define FAST_PERIOD_MS 200
+#define SLOW_PERIOD_MS 600
+
 FAKE_VALUE_FUNC(int, wdt_mock_setup, const struct device *, uint8_t);
 FAKE_VALUE_FUNC(int, wdt_mock_install_timeout, const struct device *, const struct wdt_timeout_cfg *);
 FAKE_VALUE_FUNC(int, wdt_mock_feed, const struct device *, int);
 FAKE_VALUE_FUNC(int, wdt_mock_disable, const struct device *);
-
-static wdt_callback_t stored_callback;
-static const struct device *stored_device;
+FAKE_VOID_FUNC(reset_info_set_culprit, const char *);
 
 static struct wdt_timeout_cfg stored_cfg;
 static bool cfg_captured;
@@ -23,8 +24,6 @@ static int wdt_install_timeout_capture_callback(const struct device *dev, const
     if (cfg) {
         stored_cfg = *cfg;
         cfg_captured = true;
-        stored_callback = cfg->callback;
-        stored_device = dev;
     }
     return wdt_mock_install_timeout_fake.return_val;
 }
@@ -52,10 +51,9 @@ static void watchdog_tests_before(void *fixture)
     RESET_FAKE(wdt_mock_install_timeout);
     RESET_FAKE(wdt_mock_feed);
     RESET_FAKE(wdt_mock_disable);
+    RESET_FAKE(reset_info_set_culprit);
     FFF_RESET_HISTORY();
 
-    stored_callback = NULL;
-    stored_device = NULL;
     cfg_captured = false;
 
     wdt_mock_setup_fake.return_val = 0;
@@ -69,14 +67,30 @@ static void watchdog_tests_before(void *fixture)
     ((struct device *)dev)->state->initialized = true;
 }
 
+static void watchdog_tests_after(void *fixture)
+{
+    ARG_UNUSED(fixture);
+
+    watchdog_disable();
+}
+
+/**
+ * @brief: Feeds a channel every half period during the given time
+ */
+static void keep_fed(int channel, uint32_t period_ms, uint32_t duration_ms)
+{
+    for (uint32_t t = 0; t < duration_ms; t += period_ms / 2) {
+        watchdog_feed(channel);
+        k_sleep(K_MSEC(period_ms / 2));
+    }
+}
+
 ZTEST(watchdog_tests, test_init_watchdog_success)
 {
     int ret = init_watchdog();
 
     zassert_equal(ret, 0, NULL);
     zassert_equal(wdt_mock_install_timeout_fake.call_count, 1, NULL);
-    zassert_equal(wdt_mock_setup_fake.call_count, 1, NULL);
-    zassert_equal(wdt_mock_setup_fake.arg1_val, WDT_OPT_PAUSE_HALTED_BY_DBG, NULL);
 }
 
 ZTEST(watchdog_tests, test_init_watchdog_device_not_ready)
@@ -99,99 +113,105 @@ ZTEST(watchdog_tests, test_init_watchdog_install_timeout_fails)
 
     zassert_equal(ret, -EINVAL, NULL);
     zassert_equal(wdt_mock_install_timeout_fake.call_count, 1, NULL);
-    zassert_equal(wdt_mock_setup_fake.call_count, 0, NULL);
-}
-
-ZTEST(watchdog_tests, test_init_watchdog_setup_fails)
-{
-    wdt_mock_setup_fake.return_val = -EIO;
-
-    int ret = init_watchdog();
-
-    zassert_equal(ret, -EIO, NULL);
-    zassert_equal(wdt_mock_install_timeout_fake.call_count, 1, NULL);
-    zassert_equal(wdt_mock_setup_fake.call_count, 1, NULL);
 }
 
 ZTEST(watchdog_tests, test_init_watchdog_timeout_config)
 {
     init_watchdog();
 
+    /* The hardware channel is only the fallback, the task watchdog resets the SoC if it stops feeding it */
     zassert_true(cfg_captured, NULL);
     zassert_equal(stored_cfg.window.min, 0, NULL);
-    zassert_equal(stored_cfg.window.max, WDT_TIMEOUT_MS, NULL);
-    zassert_not_null(stored_cfg.callback, NULL);
+    zassert_true(stored_cfg.window.max >= CONFIG_TASK_WDT_MIN_TIMEOUT, NULL);
     zassert_equal(stored_cfg.flags, WDT_FLAG_RESET_SOC, NULL);
 }
 
-ZTEST(watchdog_tests, test_init_watchdog_callback_registered)
+ZTEST(watchdog_tests, test_channels_are_distinct)
 {
     init_watchdog();
 
-    zassert_not_null(stored_callback, NULL);
+    int motor = watchdog_add_channel("motor", FAST_PERIOD_MS);
+    int comm = watchdog_add_channel("comm", SLOW_PERIOD_MS);
+
+    zassert_true(motor >= 0, NULL);
+    zassert_true(comm >= 0, NULL);
+    zassert_not_equal(motor, comm, NULL);
 }
 
-ZTEST(watchdog_tests, test_watchdog_feed_success)
+ZTEST(watchdog_tests, test_channel_table_full)
 {
-    wdt_mock_install_timeout_fake.return_val = 7;
     init_watchdog();
 
-    RESET_FAKE(wdt_mock_feed);
-
-    watchdog_feed();
+    for (int i = 0; i < CONFIG_TASK_WDT_CHANNELS; i++) {
+        zassert_true(watchdog_add_channel("filler", SLOW_PERIOD_MS) >= 0, NULL);
+    }
 
-    zassert_equal(wdt_mock_feed_fake.call_count, 1, NULL);
-    zassert_equal(wdt_mock_feed_fake.arg1_val, 7, NULL);
+    zassert_true(watchdog_add_channel("one too many", SLOW_PERIOD_MS) < 0, NULL);
 }
 
-ZTEST(watchdog_tests, test_watchdog_feed_multiple_calls)
+ZTEST(watchdog_tests, test_hw_watchdog_fed_while_channels_fed)
 {
-    wdt_mock_install_timeout_fake.return_val = 3;
     init_watchdog();
+    int channel = watchdog_add_channel("motor", FAST_PERIOD_MS);
 
     RESET_FAKE(wdt_mock_feed);
+    keep_fed(channel, FAST_PERIOD_MS, 5 * FAST_PERIOD_MS);
 
-    watchdog_feed();
-    watchdog_feed();
-    watchdog_feed();
-
-    zassert_equal(wdt_mock_feed_fake.call_count, 3, NULL);
+    zassert_is_null(watchdog_starved_thread(), NULL);
+    zassert_true(wdt_mock_feed_fake.call_count > 0, "hardware watchdog never fed");
+    zassert_equal(wdt_mock_feed_fake.arg0_val, DEVICE_DT_GET(DT_ALIAS(watchdog0)), NULL);
 }
 
-ZTEST(watchdog_tests, test_watchdog_feed_uses_correct_device)
+ZTEST(watchdog_tests, test_starved_channel_is_named)
 {
     init_watchdog();
+    watchdog_add_channel("stuck", FAST_PERIOD_MS);
+    int alive = watchdog_add_channel("alive", SLOW_PERIOD_MS);
 
-    RESET_FAKE(wdt_mock_feed);
+    keep_fed(alive, SLOW_PERIOD_MS, 2 * FAST_PERIOD_MS);
 
-    watchdog_feed();
+    zassert_not_null(watchdog_starved_thread(), "starved channel not reported");
+    zassert_str_equal(watchdog_starved_thread(), "stuck", NULL);
+    zassert_equal(reset_info_set_culprit_fake.call_count, 1, "culprit must survive the reset");
+    zassert_str_equal(reset_info_set_culprit_fake.arg0_val, "stuck", NULL);
+}
 
-    const struct device *expected = DEVICE_DT_GET(DT_ALIAS(watchdog0));
+ZTEST(watchdog_tests, test_channels_have_own_periods)
+{
+    init_watchdog();
+    int fast = watchdog_add_channel("fast", FAST_PERIOD_MS);
+
+    watchdog_add_channel("slow", SLOW_PERIOD_MS);
 
-    zassert_equal(wdt_mock_feed_fake.arg0_val, expected, NULL);
+    /* The slow channel is never fed but stays within its own period */
+    keep_fed(fast, FAST_PERIOD_MS, SLOW_PERIOD_MS - FAST_PERIOD_MS);
+    zassert_is_null(watchdog_starved_thread(), "slow channel starved before its period");
+
+    keep_fed(fast, FAST_PERIOD_MS, 2 * FAST_PERIOD_MS);
+    zassert_str_equal(watchdog_starved_thread(), "slow", NULL);
 }
 
-ZTEST(watchdog_tests, test_watchdog_callback_invocation)
+ZTEST(watchdog_tests, test_feed_invalid_channel_ignored)
 {
     init_watchdog();
 
-    zassert_not_null(stored_callback, NULL);
+    watchdog_feed(-ENOMEM);
 
-    if (stored_callback && stored_device) {
-        stored_callback(stored_device, 5);
-        zassert_true(true, NULL);
-    }
+    zassert_is_null(watchdog_starved_thread(), NULL);
 }
 
 ZTEST(watchdog_tests, test_watchdog_disable_success)
 {
     init_watchdog();
+    watchdog_add_channel("motor", FAST_PERIOD_MS);
 
     watchdog_disable();
+    k_sleep(K_MSEC(2 * FAST_PERIOD_MS));
 
-    zassert_equal(wdt_mock_disable_fake.call_count, 1, NULL);
+    zassert_is_null(watchdog_starved_thread(), "deleted channel still monitored");
+    zassert_true(wdt_mock_disable_fake.call_count >= 1, NULL);
     const struct device *expected = DEVICE_DT_GET(DT_ALIAS(watchdog0));
     zassert_equal(wdt_mock_disable_fake.arg0_val, expected, NULL);
 }
 
-ZTEST_SUITE(watchdog_tests, NULL, NULL, watchdog_tests_before, NULL, NULL);
+ZTEST_SUITE(watchdog_tests, NULL, NULL, watchdog_tests_before, watchdog_tests_after, NULL);